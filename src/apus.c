@@ -5,8 +5,10 @@
   @details Configures the routing table to implement a logical routing.
   Enable the Spw Interfaces and configure the baudrate to run clk_div = 0.
   Configure the Routing table to 
-  @param No parammeters needed.
-  @example ./apus
+           The receive and transmit jobs run on a pool of long-lived
+           workers, one per link, whose utilisation is printed at the end.
+  @param reg_address Register to read. -p pins the workers to CPUs.
+  @example ./apus 0x00000004
   @copyright jmgomez CSIC-IAA
 */
 
@@ -15,6 +17,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <unistd.h>
+#include <sched.h>
 #include "system_config.h"
 #include "utility.h"
 #include "star-dundee_types.h"
@@ -24,6 +28,11 @@
 #include "cfg_api_mk2_types.h"
 //#include "cfg_api_brick_mk3.h"
 #include "rmap_packet_library.h"
+#include "pkt_pool.h"
+#include "rmap_crc.h"
+#include "rx_dispatch.h"
+#include "work_pool.h"
+#include "ring.h"
 
 #define VERSION_INFO "LA Route v1.0"
 
@@ -41,10 +50,16 @@
 #define _ADDRESS_PATH 2
 #define _ADDRESS_PATH_SIZE 1
 
+#define _RX_QUEUE_ITEMS 16
+#define _RX_SLOT_LENGTH 1024
+#define _RX_RING_LENGTH 16
+#define _CONSUMER_KEY 3
+
 uint32_t GR718_ReadRegister(STAR_STREAM_ITEM **pTxStreamItem, uint32_t reg_addr);
-uint32_t processRxOperation(STAR_TRANSFER_OPERATION * const pTransferOp);
-uint32_t processPacket( STAR_SPACEWIRE_PACKET * streamItemPacket);
-uint32_t processRegister(STAR_SPACEWIRE_PACKET * streamItemPacket);
+uint32_t processRxOperation(STAR_TRANSFER_OPERATION * const pTransferOp,
+                            const uint32_t link);
+uint32_t processPacket(const uint8_t * pStreamData, uint32_t streamDataSize);
+uint32_t processRegister(const uint8_t * pStreamData, uint32_t streamDataSize);
 
 
 
@@ -58,9 +73,41 @@ struct thread_info{
   //For efficiency, it allows to access directly to the end.
   struct STAR_STREAM_ITEM *last;
 
+  //Pool jobs: the link, the key of the job, and the job to queue once
+  //this one is ready for it.
+  uint32_t link;
+  struct thread_info *next;
 };
 
-void *tx_thread(void *arg)
+/* Long-lived workers for the transfers, one per link (work_pool.h) */
+static WPOOL workPool;
+
+/* The RX job only hands the completed operations over to the consumer job,
+   which processes and disposes of them (ring.h) */
+typedef struct{
+  STAR_TRANSFER_OPERATION *pOp;
+  uint32_t link;
+} RX_DESCRIPTOR;
+
+static SPSC_RING rxRing;
+static int rxDone;
+//The consumer sleeps on it while the ring is empty.
+static pthread_mutex_t rxLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t rxReady = PTHREAD_COND_INITIALIZER;
+
+//Wakes the consumer, after a push or the end of the reception.
+static void wakeConsumer(void){
+  pthread_mutex_lock(&rxLock);
+  pthread_cond_signal(&rxReady);
+  pthread_mutex_unlock(&rxLock);
+}
+
+static void endReception(void){
+  __atomic_store_n(&rxDone, 1, __ATOMIC_RELEASE);
+  wakeConsumer();
+}
+
+void tx_job(void *arg)
 {
   struct thread_info *params;
   STAR_TRANSFER_OPERATION *pTxTransferOp = NULL;
@@ -76,7 +123,7 @@ void *tx_thread(void *arg)
   if (pTxTransferOp == NULL)
     {
       puts("\nERROR: Unable to create the transfer operation to be transmitted");
-      pthread_exit( 0);
+      return;
     }
   else{
     printf("Tx operation created. \n");
@@ -120,41 +167,54 @@ void *tx_thread(void *arg)
       STAR_disposeTransferOperation(pTxTransferOp);
     }
  
-  //  pthread_exit(0);
   printf ("End of Thread TX.\n");
-  return 0;
 }
 
-void *rx_thread(void *arg)
+void rx_job(void *arg)
 {
   struct thread_info params;
-  STAR_STREAM_ITEM * pRxStreamItem;
+  RX_DESCRIPTOR descriptor;
   STAR_TRANSFER_OPERATION *pRxTransferOp = NULL;
   const uint32_t number_of_items = 1;
-  uint32_t packetReceived = 0, i;
+  uint32_t packetReceived = 0;
   STAR_TRANSFER_STATUS rxStatus;
 
   //It should be safer to reserve space for the params and do a copy. This avoid 
   //memory corruption in case the thread creator, frees the memory of the parammeters.
   params.channelId = ((struct thread_info *) arg)->channelId;
+  params.next = ((struct thread_info *) arg)->next;
+  params.link = ((struct thread_info *) arg)->link;
 
   // Create an RX operation to receive the Packet on port 2.
   pRxTransferOp = STAR_createRxOperation(number_of_items , STAR_RECEIVE_PACKETS);
   if (pRxTransferOp == NULL)
     {
       printf("[RXThread] : Error, unable to create receive operation.\n");
-      pthread_exit(0);
+      endReception();
+      return;
     }
 
   /* Submit the receive operation */
   if (STAR_submitTransferOperation( params.channelId, pRxTransferOp) == 0)
     {
       printf("\nERROR occurred during receive.  Test failed.\n");
-      pthread_exit(0);
+      STAR_disposeTransferOperation(pRxTransferOp);
+      endReception();
+      return;
     }
 
   printf ("RX opReady.\n");
 
+  //The reply has somewhere to land: the command can go now.
+  if ((params.next != NULL) &&
+      !WPOOL_Submit(&workPool, params.next->link, tx_job, params.next))
+    {
+      printf("\nERROR queueing the TX job.  Test failed.\n");
+      STAR_disposeTransferOperation(pRxTransferOp);
+      endReception();
+      return;
+    }
+
   /* Wait on the receive operation completing */
 
   while(!packetReceived)
@@ -164,68 +224,95 @@ void *rx_thread(void *arg)
       if (rxStatus != STAR_TRANSFER_STATUS_COMPLETE)
 	{
 	  printf("\nERROR occurred during receive.  Test failed.\n");
-	  return 0;
+	  STAR_disposeTransferOperation(pRxTransferOp);
+	  endReception();
+	  return;
 	}
       else
 	{
-	  printf("Packet Received.\n");
 	  packetReceived = 1;	  
 	}
     }
 
-  //  processRxOperation( pRxTransferOp);
-  packetReceived = STAR_getTransferItemCount(pRxTransferOp);
-  if (packetReceived != 0 )
+  //Only the descriptor moves; the consumer prints at its own pace.
+  descriptor.pOp = pRxTransferOp;
+  descriptor.link = params.link;
+  while (!SPSC_Push(&rxRing, &descriptor))
+    sched_yield();
+  wakeConsumer();
+
+  endReception();
+}
+
+
+//Processes what the RX job received, until it ends and the ring is empty.
+void consumer_job(void *arg)
+{
+  RX_DESCRIPTOR descriptor;
+
+  (void) arg;
+  for (;;)
     {
-      for(i=0; i< packetReceived; ++i)
+      if (!SPSC_Pop(&rxRing, &descriptor))
 	{
-	  //Get element index i on the STREAM ITEM.
-	  pRxStreamItem = STAR_getTransferItem (pRxTransferOp, i);
-	  if (pRxStreamItem != NULL && pRxStreamItem->item != NULL &&
-	      pRxStreamItem->itemType == STAR_STREAM_ITEM_TYPE_SPACEWIRE_PACKET)
-	    {
-	      processPacket( pRxStreamItem->item);
-	    }
+	  //Checked under the lock, so a wake up cannot slip in between.
+	  pthread_mutex_lock(&rxLock);
+	  while (SPSC_Readable(&rxRing) == 0 &&
+		 !__atomic_load_n(&rxDone, __ATOMIC_ACQUIRE))
+	    pthread_cond_wait(&rxReady, &rxLock);
+	  pthread_mutex_unlock(&rxLock);
+	  if (SPSC_Readable(&rxRing) == 0)
+	    break;
+	  continue;
 	}
-    }
 
-  if (pRxTransferOp != NULL)
-    STAR_disposeTransferOperation(pRxTransferOp);
+      //Every item to the handler of its type (rx_dispatch.h).
+      processRxOperation(descriptor.pOp, descriptor.link);
+      STAR_disposeTransferOperation(descriptor.pOp);
+    }
 
-  //  pthread_exit(0);
   printf("End of thread RX.\n");
-  
-  return 0;
 }
 
 
 
+/* Command buffers, sized once for the commands GR718_ReadRegister builds */
+static PKTPOOL readPool;
+
+/* Handlers of what the receive operations bring (rx_dispatch.h) */
+static RXDISP rxDispatch;
+static int initDispatch(void);
+
 int __cdecl  main(int argc, char * argv[]){
   STAR_DEVICE_ID* devices;
   STAR_DEVICE_ID deviceId;
   unsigned int deviceCount;
+  int opt, pin = 0;
 
-  const uint32_t threads_nr = 0;
-  const uint32_t max_threads_nr = 16;
-  pthread_t threads[max_threads_nr];
-
+  while ((opt = getopt(argc, argv, "p")) != -1){
+    if (opt == 'p')
+      pin = 1;
+    else
+      optind = argc;
+  }
 
-  if (argc < 2)
+  if (optind != argc - 1)
     {
-      printf ("Usage: ./%s reg_address.\n", argv[0]);
+      printf ("Usage: ./%s [-p] reg_address.\n", argv[0]);
       printf ("reg_address: Address to read in hexadecimal, beginning with 0x.\n");
+      printf ("-p: pin the workers to CPUs.\n");
       return 0;
   }
 
   char address[] = {0x00, 0x00, 0x00, 0x00};    
   //Use "0x" to define the base of the number.
-  if (strncmp(argv[1], "0x",2) != 0)
+  if (strncmp(argv[optind], "0x",2) != 0)
     {
-      printf("Usage: ./%s address.\n", argv[1]);
+      printf("Usage: ./%s address.\n", argv[optind]);
       printf("The address should be in hexadecimal. 0xFFFFFFFF.");
       return 0;
     }
-  uint32_t reg_address = strtoul(argv[1], NULL, 16);
+  uint32_t reg_address = strtoul(argv[optind], NULL, 16);
   printf ("Proceed to read 0x%x : .\n", reg_address);
 	    
   //Initialize
@@ -330,6 +417,11 @@ int __cdecl  main(int argc, char * argv[]){
     return 0;    
   }
 
+  if (!PKTPOOL_InitReadCommand(&readPool, 1, 2, 1) || !initDispatch()){
+    puts("\nError: Could not allocate memory for the command buffers.");
+    return 0;
+  }
+
   uint32_t status;
   status =  GR718_ReadRegister(vTxStreamItem, reg_address);
   if (status != 0){
@@ -338,42 +430,44 @@ int __cdecl  main(int argc, char * argv[]){
   }
 
   struct thread_info tx_params, tinfo;
-  pthread_attr_t attr;
-  uint32_t thread_status;
 
-  //main should wait for threads before free resources, closing channel.
-  pthread_attr_init(&attr);
-  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+  //A worker per link; the transfers of a link run in order on its worker.
+  //A third one consumes what the RX job receives.
+  if (WPOOL_Open(&workPool, 3, pin) == 0 ||
+      !SPSC_Init(&rxRing, _RX_RING_LENGTH, sizeof(RX_DESCRIPTOR))){
+    printf("Error creating the workers.\n");
+    return 0;
+  }
 
-  //Lets create a Treat to manage the RX operations of the TestPortchannel.
+  //The RX job of the TestPortchannel queues the TX job once it is posted.
   tinfo.channelId = testPortChannel;
+  tinfo.link = _SPW1_INTERFACE;
+  tinfo.next = &tx_params;
   strcpy(tinfo.threadName, "RxThread");
   
   tx_params.channelId = testPortChannel2;
+  tx_params.link = _SPW2_INTERFACE;
+  tx_params.next = NULL;
   tx_params.item = vTxStreamItem;
   strcpy (tx_params.threadName, "TxThread");
 
-  thread_status = pthread_create(& (tinfo.threadId), &attr, 
-				  rx_thread, (void *) & tinfo);
-  if (thread_status){
-    printf("Error createing the RX thread.\n");
+  if (!WPOOL_Submit(&workPool, _CONSUMER_KEY, consumer_job, NULL) ||
+      !WPOOL_Submit(&workPool, tinfo.link, rx_job, (void *) & tinfo)){
+    printf("Error queueing the RX job.\n");
     return 0;
   }
 
-  thread_status = pthread_create(& tx_params.threadId, &attr, 
-				 tx_thread,(void *) &tx_params);
-  if (thread_status)
-    {
-      printf("Error creating TX thread.\n");
-    }
+  printf ("Jobs queued.\n");
 
-  printf ("Threads create.\n");
+  WPOOL_Wait(&workPool);
 
-  void *st;
-  pthread_join(tx_params.threadId, NULL);
-  pthread_join(tinfo.threadId, NULL);
+  printf("End of jobs.\n\n");
+  WPOOL_PrintReport(&workPool);
+  WPOOL_Close(&workPool);
+  SPSC_Free(&rxRing);
 
-  printf("End of threads.\n\n");
+  PKTPOOL_Destroy(&readPool);
+  RXDISP_Free(&rxDispatch);
 
   /* Close the channels */
   if (testPortChannel != 0U) {
@@ -389,25 +483,10 @@ int __cdecl  main(int argc, char * argv[]){
 
 }
 
-uint32_t processPacket( STAR_SPACEWIRE_PACKET * streamItemPacket){
-  uint8_t *pStreamData = NULL;
-  STAR_SPACEWIRE_ADDRESS *pStreamItemAddress = NULL;
-  uint32_t streamDataSize = 0;
+uint32_t processPacket(const uint8_t * pStreamData, uint32_t streamDataSize){
   uint32_t i;
 
-  pStreamData = STAR_getPacketData( (STAR_SPACEWIRE_PACKET *) streamItemPacket,
-				     &streamDataSize);	
-
-  
-  pStreamItemAddress = STAR_getPacketAddress ( (STAR_SPACEWIRE_PACKET *) streamItemPacket);
-  /* if ( pStreamItemAddress != NULL){
-    printf("Addres PATH: ");
-    for(i=0; i<pStreamItemAddress->address->pathLen; ++i)
-      printf( "\t0x%x", (*pStreamItemAddress->address->pPath + i) );
-    printf("\n");
-  }
-*/
-  //  if (
+  //Received packets do not carry an address path, only the data is printed.
   for (i=0; i<streamDataSize; ++i)
     {
       printf( "\t0x%x" ,pStreamData[i]);
@@ -416,24 +495,26 @@ uint32_t processPacket( STAR_SPACEWIRE_PACKET * streamItemPacket){
 	  printf("\n");
 	}
     }
-  STAR_destroyAddress(pStreamItemAddress);
-  STAR_destroyPacketData(pStreamData);
   
   return 0;
 }
 
 
-uint32_t processRegister(STAR_SPACEWIRE_PACKET * streamItemPacket){
-  uint8_t *pStreamData = NULL;
-  STAR_SPACEWIRE_ADDRESS * pStreamItemAddress = NULL;
-  uint32_t streamDataSize = 0;
-  
+uint32_t processRegister(const uint8_t * pStreamData, uint32_t streamDataSize){
   uint32_t reg_value  = 0xA5A5A5A5;
-  uint8_t *pReg_value = &reg_value;
-  uint8_t *pRplyData;
+  uint8_t *pReg_value = (uint8_t *) &reg_value;
+  const uint8_t *pRplyData;
 
-  pStreamData = STAR_getPacketData( (STAR_SPACEWIRE_PACKET *) streamItemPacket, 
-				    & streamDataSize);
+  //The reply carries 4 data bytes followed by the data CRC.
+  if (streamDataSize < 5){
+    printf ("Reply too short to hold a register: %u bytes.\n", streamDataSize);
+    return reg_value;
+  }
+
+  //The CRC of the data followed by its CRC is 0.
+  if (RMAPCRC_Calculate(pStreamData + (streamDataSize - 5), 5) != 0){
+    printf ("Data CRC error in the reply.\n");
+  }
 
   //  memcpy (& reg_value, pStreamData+(streamDataSize - (4 +1)), 4);
  
@@ -452,43 +533,62 @@ uint32_t processRegister(STAR_SPACEWIRE_PACKET * streamItemPacket){
 }
 
 
-uint32_t processRxOperation(STAR_TRANSFER_OPERATION * const pTransferOp)
+//Handlers of the items of a receive operation, by type.
+static void onPacket(const RXDISP_EVENT * const pEvent, void * const pContext)
 {
-  uint32_t i, j, k;
-  STAR_STREAM_ITEM *pRxStreamItem;
-  
-  uint32_t rxPacketCount;
-  rxPacketCount = STAR_getTransferItemCount(pTransferOp);
-  if (rxPacketCount != 0 )
+  (void) pContext;
+  if (pEvent->pData != NULL)
     {
-      for(i=0; i< rxPacketCount; ++i)
-	{
-	  //Get element index i on the STREAM ITEM.
-	  pRxStreamItem = STAR_getTransferItem (pTransferOp, i);
-	  if (pRxStreamItem != NULL && pRxStreamItem->item != NULL )
-	    {
-	      switch ( pRxStreamItem->itemType )
-		{
-		case STAR_STREAM_ITEM_TYPE_SPACEWIRE_PACKET:
-		  printf("SpaceWire Packet Received.\n");
-		  //processPacket((STAR_SPACEWIRE_PACKET *) pRxStreamItem->item);		  
-		  processRegister( pRxStreamItem->item);
-		  break;
-		case STAR_STREAM_ITEM_TYPE_TIMECODE:
-		  printf("Time Code Received.\n");
-		  break;
-		case STAR_STREAM_ITEM_TYPE_LINK_STATE_EVENT:
-		  printf("Link State Event Received.\n");
-		  break;
-		case STAR_STREAM_ITEM_TYPE_DATA_CHUNK: 
-		  printf("Spacewire Data Chunk Received.\n");
-		  break;
-		deafult:
-		  printf("Unrecognized packet type.\n");
-		}
-	    }
-	}
+      printf("SpaceWire Packet Received.\n");
+      processPacket(pEvent->pData, pEvent->length);
+      processRegister(pEvent->pData, pEvent->length);
     }
+}
+
+static void onTimeCode(const RXDISP_EVENT * const pEvent, void * const pContext)
+{
+  (void) pContext;
+  printf("Time Code %u Received.\n", pEvent->timeCode);
+}
+
+static void onOther(const RXDISP_EVENT * const pEvent, void * const pContext)
+{
+  (void) pContext;
+  if (pEvent->type == RXDISP_LINK_EVENT)
+    printf("Link %u State Event Received, state %u.\n", pEvent->link,
+           pEvent->linkState);
+  else if (pEvent->type == RXDISP_DATA_CHUNK)
+    printf("Spacewire Data Chunk Received.\n");
+  else
+    printf("Unrecognized packet type.\n");
+}
+
+static int initDispatch(void)
+{
+  int type;
+
+  RXDISP_Init(&rxDispatch);
+  if (!RXDISP_Register(&rxDispatch, RXDISP_PACKET, onPacket, NULL,
+                       _RX_QUEUE_ITEMS, _RX_SLOT_LENGTH) ||
+      !RXDISP_Register(&rxDispatch, RXDISP_TIMECODE, onTimeCode, NULL,
+                       _RX_QUEUE_ITEMS, 0))
+    return 0;
+  for (type = RXDISP_LINK_EVENT; type < RXDISP_TYPES; ++type)
+    if (!RXDISP_Register(&rxDispatch, type, onOther, NULL, _RX_QUEUE_ITEMS, 0))
+      return 0;
+
+  return 1;
+}
+
+
+uint32_t processRxOperation(STAR_TRANSFER_OPERATION * const pTransferOp,
+                            const uint32_t link)
+{
+  uint32_t rxPacketCount;
+
+  //Every item to the handler of its type, in this same thread.
+  rxPacketCount = RXDISP_Route(&rxDispatch, pTransferOp, (U8) link);
+  RXDISP_PollAll(&rxDispatch);
 
   return rxPacketCount;
 }
@@ -497,19 +597,15 @@ uint32_t GR718_ReadRegister(STAR_STREAM_ITEM **pTxStreamItem, uint32_t reg_addr)
 {				       
   
 
-  void *pFillPacket;
-  unsigned long fillPacketLenCalculated, fillPacketLen;  
+  U8 *pFillPacket;
+  unsigned long fillPacketLen;
   
   U8 pTarget[] = {0,254};
   U8 pReply[] = {254};
   char status;  
   
-  /* Calculate the length of a write command packet, with 4 bytes of data */
-  fillPacketLenCalculated = RMAP_CalculateReadCommandPacketLength(2, 1,1);
-  printf("The Read command packet will have a length of %ld bytes\n",
-	 fillPacketLenCalculated);
-  /* Allocate memory for the packet */
-  pFillPacket = malloc(fillPacketLenCalculated);
+  /* Take a buffer for the read command packet */
+  pFillPacket = PKTPOOL_Get(&readPool);
   if (!pFillPacket)
     {
       puts("Couldn't allocate the memory for the command packet");
@@ -517,18 +613,19 @@ uint32_t GR718_ReadRegister(STAR_STREAM_ITEM **pTxStreamItem, uint32_t reg_addr)
     }
   
   status = RMAP_FillReadCommandPacket(pTarget, 2, pReply, 1, 0, 0x00,
-				      0, reg_addr, 0, 4, &fillPacketLen, NULL, 1, (U8 *)pFillPacket,
-				       fillPacketLenCalculated);
+				      0, reg_addr, 0, 4, &fillPacketLen, NULL, 1, pFillPacket,
+				       readPool.bufferSize);
   if (!status)
     {
       puts("Couldn't fill the write command packet");
-      free(pFillPacket);
+      PKTPOOL_Put(&readPool, pFillPacket);
       return 1;
     }
   
   /* Create the packet to be transmitted */
-  (*pTxStreamItem) = STAR_createPacket(NULL, (U8 *)pFillPacket, fillPacketLen,
+  (*pTxStreamItem) = STAR_createPacket(NULL, pFillPacket, fillPacketLen,
 				    STAR_EOP_TYPE_EOP);
+  PKTPOOL_Put(&readPool, pFillPacket);
 
   if ( (*pTxStreamItem) == NULL )
     {
@@ -0,0 +1,251 @@
+/*
+  @file bench_compare.c
+  @author Juan Manuel Gómez
+  @brief Check and benchmark of the packet comparison of the programs.
+  @details Checks the count, first and last mismatch of BufferCompare()
+           against a byte loop for every length up to 300 bytes, every
+           alignment and a few corruption patterns. Then reports GB/s of
+           the byte loop and of BufferCompare() on equal packets of 64 B,
+           4 KB and 64 KB, and the time of a verification run of 64 KB
+           packets with one of them fully corrupted, with the byte loop
+           that printed one line per byte and with BufferCompareChar().
+           The output of both is sent to /dev/null while they run.
+  @param -m megabytes compared per size and per verification run
+  @example ./bench_compare -m 256
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "utility.h"
+#include "star-dundee_types.h"
+
+#define _CHECK_LENGTH 300
+#define _PACKET_SIZE 65536
+
+
+/* The comparison as it was, one line per byte that differs */
+static unsigned long byteLoopPrint(const char * const pBuffer1,
+				   const char * const pBuffer2,
+				   const unsigned long size)
+{
+  unsigned long errorCount = 0, i;
+
+  for (i = 0; i < size; ++i)
+    if (pBuffer1[i] != pBuffer2[i])
+      {
+	errorCount++;
+	printf("Error in byte %8lu, should be 0x%2x actually 0x%2x\n", i,
+	       pBuffer1[i], pBuffer2[i]);
+      }
+
+  return errorCount;
+}
+
+
+static unsigned long byteLoop(const U8 * const p1, const U8 * const p2,
+			      const unsigned long size,
+			      BUFFER_MISMATCH * const pMismatch)
+{
+  unsigned long i;
+
+  pMismatch->count = 0;
+  pMismatch->first = pMismatch->last = size;
+  for (i = 0; i < size; ++i)
+    if (p1[i] != p2[i])
+      {
+	if (pMismatch->count++ == 0)
+	  pMismatch->first = i;
+	pMismatch->last = i;
+      }
+
+  return pMismatch->count;
+}
+
+
+static int check(void)
+{
+  U8 expected[_CHECK_LENGTH + 8], actual[_CHECK_LENGTH + 8];
+  BUFFER_MISMATCH reference, mismatch;
+  U32 i, length, offset, pattern;
+  unsigned int seed = 1;
+  int errors = 0;
+
+  for (i = 0; i < sizeof(expected); ++i)
+    expected[i] = (U8) (i * 29 + 7);
+
+  for (pattern = 0; pattern < 5; ++pattern)
+    for (offset = 0; offset < 8; ++offset)
+      for (length = 0; length <= _CHECK_LENGTH; ++length)
+	{
+	  memcpy(actual, expected, sizeof(actual));
+	  for (i = 0; i < length; ++i)
+	    {
+	      seed = seed * 1103515245U + 12345U;
+	      /* none, one byte in 64, the first, the last, all */
+	      if ((pattern == 1 && (seed >> 16) % 64 == 0) ||
+		  (pattern == 2 && i == 0) ||
+		  (pattern == 3 && i == length - 1) || pattern == 4)
+		actual[offset + i] ^= (U8) (1 + ((seed >> 8) % 255));
+	    }
+
+	  byteLoop(expected + offset, actual + offset, length, &reference);
+	  if (BufferCompare(expected + offset, actual + offset, length,
+			    &mismatch) != reference.count ||
+	      mismatch.count != reference.count ||
+	      mismatch.first != reference.first ||
+	      mismatch.last != reference.last)
+	    {
+	      printf("ERROR: %lu mismatches %lu-%lu, not %lu %lu-%lu, for %u"
+		     " bytes at offset %u, pattern %u.\n", mismatch.count,
+		     mismatch.first, mismatch.last, reference.count,
+		     reference.first, reference.last, length, offset, pattern);
+	      errors++;
+	    }
+	}
+
+  return errors;
+}
+
+
+/* GB/s of BufferCompare(), or of the byte loop, on equal `size` packets */
+static double throughput(const int fast, const U8 *pData, const U8 *pCopy,
+			 const U32 size, const unsigned long long total,
+			 unsigned long * const pSink)
+{
+  BUFFER_MISMATCH mismatch;
+  unsigned long long start, ns, done = 0;
+  U32 packet = 0, packets = _PACKET_SIZE / size;
+
+  start = MonotonicTimeNs();
+  while (done < total)
+    {
+      if (fast)
+	*pSink += BufferCompare(pData + (size_t) packet * size,
+				pCopy + (size_t) packet * size, size,
+				&mismatch);
+      else
+	*pSink += byteLoop(pData + (size_t) packet * size,
+			   pCopy + (size_t) packet * size, size, &mismatch);
+      packet = (packet + 1 < packets) ? packet + 1 : 0;
+      done += size;
+    }
+  ns = MonotonicTimeNs() - start;
+
+  return (double) done / (double) ns;
+}
+
+
+/* Milliseconds to check `packets` packets, the last one corrupted */
+static double verificationRun(const int fast, const char *pData,
+			      const char *pCopy, const char *pCorrupted,
+			      const unsigned long packets,
+			      unsigned long * const pErrors)
+{
+  unsigned long long start;
+  unsigned long i;
+  const char *pReceived;
+
+  *pErrors = 0;
+  start = MonotonicTimeNs();
+  for (i = 0; i < packets; ++i)
+    {
+      pReceived = (i == packets - 1) ? pCorrupted : pCopy;
+      *pErrors += fast ? BufferCompareChar(pData, pReceived, _PACKET_SIZE) :
+	byteLoopPrint(pData, pReceived, _PACKET_SIZE);
+    }
+  fflush(stdout);
+
+  return (MonotonicTimeNs() - start) / 1e6;
+}
+
+
+int __cdecl main(int argc, char *argv[])
+{
+  const U32 sizes[] = {64, 4096, 65536};
+  unsigned long long total = 256ULL << 20;
+  unsigned long sink = 0, packets, oldErrors, newErrors;
+  char *pData, *pCopy, *pCorrupted;
+  double oldMs, newMs;
+  int opt, errors, savedStdout, devNull;
+  U32 i, s;
+
+  while ((opt = getopt(argc, argv, "m:")) != -1)
+    {
+      switch (opt)
+	{
+	case 'm':
+	  total = strtoull(optarg, NULL, 0) << 20;
+	  break;
+	default:
+	  printf("Usage: %s [-m megabytes]\n", argv[0]);
+	  return 0;
+	}
+    }
+  if (total < _PACKET_SIZE)
+    total = _PACKET_SIZE;
+
+  errors = check();
+  printf("Self-test: %s.\n", errors ? "FAILED" : "passed");
+  if (errors)
+    return 1;
+
+  pData = (char *) malloc(_PACKET_SIZE);
+  pCopy = (char *) malloc(_PACKET_SIZE);
+  pCorrupted = (char *) malloc(_PACKET_SIZE);
+  if (pData == NULL || pCopy == NULL || pCorrupted == NULL)
+    {
+      puts("ERROR: Unable to allocate the packet buffers");
+      return 1;
+    }
+  for (i = 0; i < _PACKET_SIZE; ++i)
+    {
+      pData[i] = (char) (i * 131 + 17);
+      pCorrupted[i] = (char) ~pData[i];
+    }
+  memcpy(pCopy, pData, _PACKET_SIZE);
+
+  printf("size_bytes,byte_loop_gbps,compare_gbps,speedup\n");
+  for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+      double slow = throughput(0, (U8 *) pData, (U8 *) pCopy, sizes[s],
+			       total, &sink);
+      double fast = throughput(1, (U8 *) pData, (U8 *) pCopy, sizes[s],
+			       total, &sink);
+
+      printf("%u,%.3f,%.3f,%.2f\n", sizes[s], slow, fast, fast / slow);
+    }
+
+  /* The reports go to /dev/null, a terminal would only be slower */
+  packets = (unsigned long) (total / _PACKET_SIZE);
+  fflush(stdout);
+  savedStdout = dup(STDOUT_FILENO);
+  devNull = open("/dev/null", O_WRONLY);
+  if (savedStdout < 0 || devNull < 0)
+    {
+      puts("ERROR: Unable to redirect the output");
+      return 1;
+    }
+  dup2(devNull, STDOUT_FILENO);
+  oldMs = verificationRun(0, pData, pCopy, pCorrupted, packets, &oldErrors);
+  newMs = verificationRun(1, pData, pCopy, pCorrupted, packets, &newErrors);
+  dup2(savedStdout, STDOUT_FILENO);
+  close(devNull);
+  close(savedStdout);
+
+  printf("packets,errors,byte_loop_ms,compare_ms,speedup\n");
+  printf("%lu,%lu,%.3f,%.3f,%.2f\n", packets, newErrors, oldMs, newMs,
+	 oldMs / newMs);
+  if (oldErrors != newErrors)
+    printf("ERROR: the byte loop found %lu errors.\n", oldErrors);
+  printf("(checksum %lu)\n", sink);
+
+  free(pData);
+  free(pCopy);
+  free(pCorrupted);
+
+  return oldErrors != newErrors;
+}
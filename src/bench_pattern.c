@@ -0,0 +1,248 @@
+/*
+  @file bench_pattern.c
+  @author Juan Manuel Gómez
+  @brief Check and benchmark of the payload generator.
+  @details Checks xoshiro256** and its splitmix64 seeding against known
+           answers, that filling in pieces of 8 bytes gives the bytes of a
+           single fill, that PATGEN_CheckPacket() accepts every payload of
+           PATGEN_FillPacket() and finds the first and last byte of the
+           corruptions of a few hundred of them, and that two threads with
+           the same seed get the same numbers. Then reports MB/s of the
+           rand() based fill the programs used and of PATGEN_Fill(), and
+           of PATGEN_CheckPacket().
+  @param -m megabytes per measure
+  @example ./bench_pattern -m 256
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "utility.h"
+#include "star-dundee_types.h"
+#include "pattern.h"
+
+#define _CHECK_LENGTH 300
+#define _PACKET_SIZE 65536
+
+
+/* The fill as it was: four rand() calls per byte */
+static unsigned int oldRandom16(void)
+{
+  unsigned int value = rand();
+
+  if ((unsigned int) rand() > (RAND_MAX / 2))
+    value += RAND_MAX;
+
+  return value;
+}
+
+
+static void oldFillRandom(char * const pBuffer, const unsigned long size)
+{
+  unsigned long n;
+
+  for (n = 0; n < size; ++n)
+    pBuffer[n] = (char) (oldRandom16() * 0x10000U + oldRandom16());
+}
+
+
+static void *threadNumbers(void *arg)
+{
+  unsigned int *pNumbers = (unsigned int *) arg;
+  int i;
+
+  random_seed(42);
+  for (i = 0; i < 64; ++i)
+    pNumbers[i] = random32();
+
+  return NULL;
+}
+
+
+static int check(void)
+{
+  const uint64_t xoshiro[] = {11520ULL, 0ULL, 1509978240ULL,
+			      1215971899390074240ULL};
+  const int types[] = {DATA_TYPE_0, DATA_TYPE_1, DATA_TYPE_RANDOM,
+		       DATA_TYPE_COUNT, DATA_TYPE_NOT_COUNT};
+  U8 whole[_CHECK_LENGTH], pieces[_CHECK_LENGTH], other[_CHECK_LENGTH];
+  unsigned int numbers[2][64];
+  BUFFER_MISMATCH mismatch;
+  pthread_t threads[2];
+  PATGEN generator;
+  U32 i, length, t, at;
+  int errors = 0;
+
+  generator.s[0] = 1;
+  generator.s[1] = 2;
+  generator.s[2] = 3;
+  generator.s[3] = 4;
+  for (i = 0; i < 4; ++i)
+    if (PATGEN_Next(&generator) != xoshiro[i])
+      {
+	printf("ERROR: xoshiro256** output %u is wrong.\n", i);
+	errors++;
+      }
+  PATGEN_Seed(&generator, 0);
+  if (generator.s[0] != 0xE220A8397B1DCDAFULL ||
+      generator.s[1] != 0x6E789E6AA1B965F4ULL)
+    {
+      puts("ERROR: splitmix64 seeding is wrong.");
+      errors++;
+    }
+
+  /* Pieces of 8 bytes, then the rest, give the bytes of one fill */
+  PATGEN_Seed(&generator, 7);
+  PATGEN_Fill(&generator, whole, _CHECK_LENGTH, DATA_TYPE_RANDOM);
+  PATGEN_Seed(&generator, 7);
+  for (i = 0; i + 8 <= _CHECK_LENGTH; i += (i % 3 + 1) * 8)
+    PATGEN_Fill(&generator, pieces + i,
+		(i + (i % 3 + 1) * 8 <= _CHECK_LENGTH) ? (i % 3 + 1) * 8 : 8,
+		DATA_TYPE_RANDOM);
+  PATGEN_Fill(&generator, pieces + i, _CHECK_LENGTH - i, DATA_TYPE_RANDOM);
+  if (memcmp(whole, pieces, _CHECK_LENGTH) != 0)
+    {
+      puts("ERROR: a fill in pieces differs from a single fill.");
+      errors++;
+    }
+
+  for (t = 0; t < sizeof(types) / sizeof(types[0]); ++t)
+    for (length = 0; length <= _CHECK_LENGTH; ++length)
+      {
+	PATGEN_FillPacket(whole, length, types[t], 99, length * 1000003ULL);
+	if (PATGEN_CheckPacket(whole, length, types[t], 99,
+			       length * 1000003ULL, &mismatch) != 0)
+	  {
+	    printf("ERROR: packet of %u bytes, pattern %d, not accepted.\n",
+		   length, types[t]);
+	    errors++;
+	  }
+	if (length < 2)
+	  continue;
+
+	/* Corrupt two bytes, the check must find both */
+	at = (length * 7) % length;
+	whole[at / 2] ^= 0x40;
+	whole[length - 1 - at / 3] ^= 0x02;
+	PATGEN_CheckPacket(whole, length, types[t], 99, length * 1000003ULL,
+			   &mismatch);
+	if (mismatch.first != at / 2 || mismatch.last != length - 1 - at / 3 ||
+	    mismatch.count != ((at / 2 == length - 1 - at / 3) ? 1U : 2U))
+	  {
+	    printf("ERROR: corruption of a packet of %u bytes, pattern %d,"
+		   " not found.\n", length, types[t]);
+	    errors++;
+	  }
+
+	/* The next packet has another payload */
+	PATGEN_FillPacket(whole, length, types[t], 99, length * 1000003ULL);
+	PATGEN_FillPacket(other, length, types[t], 99,
+			  length * 1000003ULL + 1);
+	if (types[t] != DATA_TYPE_0 && types[t] != DATA_TYPE_1 &&
+	    memcmp(whole, other, length) == 0)
+	  {
+	    printf("ERROR: packets %u and %u have the same payload.\n",
+		   length * 1000003, length * 1000003 + 1);
+	    errors++;
+	  }
+      }
+
+  for (i = 0; i < 2; ++i)
+    pthread_create(&threads[i], NULL, threadNumbers, numbers[i]);
+  for (i = 0; i < 2; ++i)
+    pthread_join(threads[i], NULL);
+  if (memcmp(numbers[0], numbers[1], sizeof(numbers[0])) != 0)
+    {
+      puts("ERROR: two threads with the same seed differ.");
+      errors++;
+    }
+
+  return errors;
+}
+
+
+int __cdecl main(int argc, char *argv[])
+{
+  unsigned long long total = 64ULL << 20, done, start, ns;
+  double oldMbps, fillMbps, countMbps, checkMbps;
+  unsigned long sink = 0;
+  PATGEN generator;
+  char *pBuffer;
+  uint64_t sequence;
+  int opt, errors;
+
+  while ((opt = getopt(argc, argv, "m:")) != -1)
+    {
+      switch (opt)
+	{
+	case 'm':
+	  total = strtoull(optarg, NULL, 0) << 20;
+	  break;
+	default:
+	  printf("Usage: %s [-m megabytes]\n", argv[0]);
+	  return 0;
+	}
+    }
+
+  errors = check();
+  printf("Self-test: %s.\n", errors ? "FAILED" : "passed");
+  if (errors)
+    return 1;
+
+  pBuffer = (char *) malloc(_PACKET_SIZE);
+  if (pBuffer == NULL)
+    {
+      puts("ERROR: Unable to allocate the packet buffer");
+      return 1;
+    }
+
+  /* rand() is slow enough for a sixteenth of the data to do */
+  start = MonotonicTimeNs();
+  for (done = 0; done < total / 16; done += _PACKET_SIZE)
+    {
+      oldFillRandom(pBuffer, _PACKET_SIZE);
+      sink += (U8) pBuffer[done % _PACKET_SIZE];
+    }
+  ns = MonotonicTimeNs() - start;
+  oldMbps = done * 1e3 / ns;
+
+  PATGEN_Seed(&generator, PATGEN_DEFAULT_SEED);
+  start = MonotonicTimeNs();
+  for (done = 0; done < total; done += _PACKET_SIZE)
+    {
+      PATGEN_Fill(&generator, pBuffer, _PACKET_SIZE, DATA_TYPE_RANDOM);
+      sink += (U8) pBuffer[done % _PACKET_SIZE];
+    }
+  ns = MonotonicTimeNs() - start;
+  fillMbps = done * 1e3 / ns;
+
+  start = MonotonicTimeNs();
+  for (done = 0, sequence = 0; done < total; done += _PACKET_SIZE, ++sequence)
+    {
+      PATGEN_FillPacket(pBuffer, _PACKET_SIZE, DATA_TYPE_COUNT, 1, sequence);
+      sink += (U8) pBuffer[done % _PACKET_SIZE];
+    }
+  ns = MonotonicTimeNs() - start;
+  countMbps = done * 1e3 / ns;
+
+  PATGEN_FillPacket(pBuffer, _PACKET_SIZE, DATA_TYPE_RANDOM, 1, 0);
+  start = MonotonicTimeNs();
+  for (done = 0; done < total; done += _PACKET_SIZE)
+    sink += PATGEN_CheckPacket(pBuffer, _PACKET_SIZE, DATA_TYPE_RANDOM, 1, 0,
+			       NULL);
+  ns = MonotonicTimeNs() - start;
+  checkMbps = done * 1e3 / ns;
+
+  printf("rand_fill_mbps,random_fill_mbps,count_fill_mbps,check_mbps,"
+	 "speedup\n");
+  printf("%.1f,%.1f,%.1f,%.1f,%.1f\n", oldMbps, fillMbps, countMbps,
+	 checkMbps, fillMbps / oldMbps);
+  printf("(checksum %lu)\n", sink);
+
+  free(pBuffer);
+
+  return 0;
+}
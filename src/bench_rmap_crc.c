@@ -0,0 +1,180 @@
+/*
+  @file bench_rmap_crc.c
+  @author Juan Manuel Gómez
+  @brief Check and benchmark of the RMAP CRC-8 methods.
+  @details Checks the byte table against the bitwise definition of the
+           CRC in the standard and its test pattern, then the slice-by-8
+           method against the byte table for every length up to 300 bytes
+           and every alignment. The CRC of a message followed by its CRC
+           must be 0. Then reports GB/s of both methods on data fields of
+           4 B, 256 B and 64 KB.
+  @param -m megabytes run through each method per size
+  @example ./bench_rmap_crc -m 256
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "utility.h"
+#include "star-dundee_types.h"
+#include "rmap_crc.h"
+
+#define _CHECK_LENGTH 300
+#define _POLYNOMIAL 0xE0
+
+
+/* One byte through the shift register of the standard, LSB first */
+static U8 bitwiseCrc(U8 crc, const U8 data)
+{
+  int bit;
+
+  crc ^= data;
+  for (bit = 0; bit < 8; ++bit)
+    crc = (crc & 1) ? (U8) ((crc >> 1) ^ _POLYNOMIAL) : (U8) (crc >> 1);
+
+  return crc;
+}
+
+
+static int check(void)
+{
+  const U8 pattern[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
+  U8 buffer[_CHECK_LENGTH + 8 + 1];
+  U8 crc;
+  U32 i, length, offset;
+  int errors = 0;
+
+  for (i = 0; i < 256; ++i)
+    if (RMAPCRC_Table[i] != bitwiseCrc(0, (U8) i))
+      {
+	printf("ERROR: table entry 0x%02x is 0x%02x, not 0x%02x.\n", i,
+	       RMAPCRC_Table[i], bitwiseCrc(0, (U8) i));
+	errors++;
+      }
+
+  if (RMAPCRC_UpdateTable(0, pattern, sizeof(pattern)) != 0xB0 ||
+      RMAPCRC_UpdateSlice8(0, pattern, sizeof(pattern)) != 0xB0)
+    {
+      puts("ERROR: wrong CRC of the test pattern 01..08.");
+      errors++;
+    }
+
+  for (i = 0; i < sizeof(buffer); ++i)
+    buffer[i] = (U8) (i * 29 + 7);
+
+  for (offset = 0; offset < 8; ++offset)
+    for (length = 0; length <= _CHECK_LENGTH; ++length)
+      {
+	crc = RMAPCRC_UpdateTable(0, buffer + offset, length);
+	if (RMAPCRC_UpdateSlice8(0, buffer + offset, length) != crc)
+	  {
+	    printf("ERROR: slice8 differs for %u bytes at offset %u.\n",
+		   length, offset);
+	    errors++;
+	  }
+	if (RMAPCRC_UpdateSlice8(RMAPCRC_UpdateSlice8(0, buffer + offset,
+						      length / 3),
+				 buffer + offset + length / 3,
+				 length - length / 3) != crc)
+	  {
+	    printf("ERROR: split slice8 differs for %u bytes at offset %u.\n",
+		   length, offset);
+	    errors++;
+	  }
+      }
+
+  for (length = 1; length <= 64; ++length)
+    {
+      crc = RMAPCRC_Calculate(buffer, length);
+      buffer[length] = crc;
+      if (RMAPCRC_Calculate(buffer, length + 1) != 0)
+	{
+	  printf("ERROR: a message and its CRC do not give 0 (%u bytes).\n",
+		 length);
+	  errors++;
+	}
+    }
+
+  return errors;
+}
+
+
+/* GB/s of one method on `size` byte fields, `total` bytes in all */
+static double throughput(U8 (*update)(U8, const U8 * const, const U32),
+			 const U8 *pData, const U32 size,
+			 const unsigned long long total, U8 * const pSink)
+{
+  unsigned long long start, ns, done = 0;
+  U8 crc = 0;
+  U32 field = 0, fields = (U32) (65536 / size);
+
+  start = MonotonicTimeNs();
+  while (done < total)
+    {
+      /* Walk the buffer so small fields are not always the same bytes */
+      crc = update(crc, pData + (size_t) field * size, size);
+      field = (field + 1 < fields) ? field + 1 : 0;
+      done += size;
+    }
+  ns = MonotonicTimeNs() - start;
+  *pSink ^= crc;
+
+  return (double) done / (double) ns;
+}
+
+
+int __cdecl main(int argc, char *argv[])
+{
+  const U32 sizes[] = {4, 256, 65536};
+  unsigned long long total = 256ULL << 20;
+  U8 *pData, sink = 0;
+  U32 i, s;
+  int opt, errors;
+
+  while ((opt = getopt(argc, argv, "m:")) != -1)
+    {
+      switch (opt)
+	{
+	case 'm':
+	  total = strtoull(optarg, NULL, 0) << 20;
+	  break;
+	default:
+	  printf("Usage: %s [-m megabytes]\n", argv[0]);
+	  return 0;
+	}
+    }
+
+  errors = check();
+  printf("Self-test: %s (default method %s).\n",
+	 errors ? "FAILED" : "passed",
+	 RMAPCRC_MethodString(RMAPCRC_GetMethod()));
+  if (errors)
+    return 1;
+
+  pData = (U8 *) malloc(65536);
+  if (pData == NULL)
+    {
+      puts("ERROR: Unable to allocate the data buffer");
+      return 1;
+    }
+  for (i = 0; i < 65536; ++i)
+    pData[i] = (U8) (i * 131 + 17);
+
+  printf("size_bytes,table_gbps,slice8_gbps,speedup\n");
+  for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+      double table = throughput(RMAPCRC_UpdateTable, pData, sizes[s], total,
+				&sink);
+      double slice = throughput(RMAPCRC_UpdateSlice8, pData, sizes[s], total,
+				&sink);
+
+      printf("%u,%.3f,%.3f,%.2f\n", sizes[s], table, slice, slice / table);
+    }
+  printf("(checksum %02x)\n", sink);
+
+  free(pData);
+
+  return 0;
+}
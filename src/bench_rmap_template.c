@@ -0,0 +1,153 @@
+/*
+  @file bench_rmap_template.c
+  @author Juan Manuel Gómez
+  @brief Benchmark of RMAP write command construction.
+  @details Builds the write commands of a routing table update to the GR718
+           configuration port (target {0,254}, reply {254}) through
+           RMAP_FillWriteCommandPacket() and through a command template
+           (rmap_template.h). A plain copy of the commands gives the bound.
+           The commands of both paths are compared byte by byte first.
+  @param -n commands per update, -r repetitions
+  @example ./bench_rmap_template -n 1024 -r 1000
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "utility.h"
+#include "star-dundee_types.h"
+#include "rmap_packet_library.h"
+#include "rmap_template.h"
+
+#define _RTPMAP_BASE 0x04
+
+
+static unsigned long libraryPath(U8 *pTarget, U8 *pReply, const U32 count,
+				 const U8 *pValues, U8 *pCommands,
+				 const unsigned long stride)
+{
+  unsigned long length, total = 0;
+  U32 i;
+
+  for (i = 0; i < count; ++i)
+    {
+      RMAP_FillWriteCommandPacket(pTarget, 2, pReply, 1, 1, 1, 0, 0x00,
+				  (U16) i, _RTPMAP_BASE + 4 * i, 0,
+				  (U8 *) pValues + 4 * i, 4, &length, NULL, 1,
+				  pCommands + stride * i, stride);
+      total += length;
+    }
+
+  return total;
+}
+
+
+static unsigned long templatePath(const RMAPTPL *pTemplate, const U32 count,
+				  const U8 *pValues, U8 *pCommands,
+				  const unsigned long stride)
+{
+  unsigned long total = 0;
+  U32 i;
+
+  for (i = 0; i < count; ++i)
+    total += RMAPTPL_Fill(pTemplate, (U16) i, _RTPMAP_BASE + 4 * i,
+			  pValues + 4 * i, pCommands + stride * i);
+
+  return total;
+}
+
+
+int __cdecl main(int argc, char *argv[])
+{
+  U8 pTarget[] = {0, 254};
+  U8 pReply[] = {254};
+  U32 commandCount = 1024, repetitions = 1000, i, r;
+  unsigned long stride, libraryBytes = 0, templateBytes = 0;
+  unsigned long long start, libraryNs, templateNs, copyNs;
+  U8 *pValues, *pLibrary, *pTemplated;
+  RMAPTPL commandTemplate;
+  double commands;
+  int opt, status = 0;
+
+  while ((opt = getopt(argc, argv, "n:r:")) != -1)
+    {
+      switch (opt)
+	{
+	case 'n':
+	  commandCount = strtoul(optarg, NULL, 0);
+	  break;
+	case 'r':
+	  repetitions = strtoul(optarg, NULL, 0);
+	  break;
+	default:
+	  printf("Usage: %s [-n commands] [-r repetitions]\n", argv[0]);
+	  return 0;
+	}
+    }
+
+  if (commandCount == 0 || repetitions == 0 ||
+      !RMAPTPL_InitWrite(&commandTemplate, pTarget, sizeof(pTarget), pReply,
+			 sizeof(pReply), 1, 1, 0, 0x00, 4))
+    return 1;
+
+  stride = commandTemplate.length;
+  pValues = (U8 *) malloc(4 * commandCount);
+  pLibrary = (U8 *) malloc(stride * commandCount);
+  pTemplated = (U8 *) malloc(stride * commandCount);
+  if (pValues == NULL || pLibrary == NULL || pTemplated == NULL)
+    {
+      puts("ERROR: Unable to allocate the command buffers");
+      return 1;
+    }
+  for (i = 0; i < 4 * commandCount; ++i)
+    pValues[i] = (U8) (i * 7);
+
+  /* Both paths must build the same commands */
+  libraryPath(pTarget, pReply, commandCount, pValues, pLibrary, stride);
+  templatePath(&commandTemplate, commandCount, pValues, pTemplated, stride);
+  if (memcmp(pLibrary, pTemplated, stride * commandCount) != 0)
+    {
+      puts("ERROR: the template and the library build different commands.");
+      status = 1;
+    }
+
+  start = MonotonicTimeNs();
+  for (r = 0; r < repetitions; ++r)
+    libraryBytes += libraryPath(pTarget, pReply, commandCount, pValues,
+				pLibrary, stride);
+  libraryNs = MonotonicTimeNs() - start;
+
+  start = MonotonicTimeNs();
+  for (r = 0; r < repetitions; ++r)
+    templateBytes += templatePath(&commandTemplate, commandCount, pValues,
+				  pTemplated, stride);
+  templateNs = MonotonicTimeNs() - start;
+
+  /* Each copy changes its source, so none of them can be left out */
+  start = MonotonicTimeNs();
+  for (r = 0; r < repetitions; ++r)
+    {
+      memcpy(pLibrary, pTemplated, stride * commandCount);
+      pTemplated[r % (stride * commandCount)] ^= pLibrary[0];
+    }
+  copyNs = MonotonicTimeNs() - start;
+
+  if (libraryBytes != templateBytes)
+    status = 1;
+
+  commands = (double) commandCount * repetitions;
+  printf("commands,command_bytes,library_cps,template_cps,copy_cps,speedup\n");
+  printf("%u,%lu,%.0f,%.0f,%.0f,%.2f\n", commandCount, stride,
+	 commands * 1e9 / (double) libraryNs,
+	 commands * 1e9 / (double) templateNs,
+	 commands * 1e9 / (double) copyNs,
+	 (double) libraryNs / (double) templateNs);
+
+  free(pValues);
+  free(pLibrary);
+  free(pTemplated);
+
+  return status;
+}
@@ -0,0 +1,330 @@
+/*
+  @file capture.c
+  @author Juan Manuel Gómez
+  @brief Binary packet capture kept in a memory-mapped ring file.
+  @details See capture.h.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.h"
+#include "utility.h"
+
+#define CAPTURE_ALIGN_UP(x) \
+    (((x) + (CAPTURE_ALIGN - 1U)) & ~((uint64_t)CAPTURE_ALIGN - 1U))
+
+
+/* Size taken in the ring by the item starting at offset */
+static uint64_t CAPTURE_itemSize(const CAPTURE * const pCapture,
+    const uint64_t offset)
+{
+    const CAPTURE_RECORD *pRecord;
+    uint64_t left = pCapture->pHeader->ringSize - offset;
+
+    if (left < sizeof(CAPTURE_RECORD))
+    {
+        return left;
+    }
+
+    pRecord = (const CAPTURE_RECORD *)(pCapture->pRing + offset);
+    return pRecord->recordSize;
+}
+
+
+/* Overwrite the oldest records until `size` contiguous bytes are free at head */
+static void CAPTURE_makeRoom(CAPTURE * const pCapture, const uint64_t size)
+{
+    CAPTURE_FILE_HEADER *pHeader = pCapture->pHeader;
+    const CAPTURE_RECORD *pRecord;
+    uint64_t itemSize;
+
+    while (pHeader->ringSize - pHeader->used < size)
+    {
+        itemSize = CAPTURE_itemSize(pCapture, pHeader->tail);
+        if (itemSize >= sizeof(CAPTURE_RECORD))
+        {
+            pRecord = (const CAPTURE_RECORD *)(pCapture->pRing + pHeader->tail);
+            if ((pRecord->flags & CAPTURE_FLAG_PAD) == 0U)
+            {
+                pHeader->overwritten++;
+            }
+        }
+
+        pHeader->tail += itemSize;
+        if (pHeader->tail >= pHeader->ringSize)
+        {
+            pHeader->tail = 0U;
+        }
+        pHeader->used -= itemSize;
+    }
+}
+
+
+/* Close the lap: cover the end of the ring and continue from offset 0 */
+static void CAPTURE_wrap(CAPTURE * const pCapture)
+{
+    CAPTURE_FILE_HEADER *pHeader = pCapture->pHeader;
+    CAPTURE_RECORD *pPad;
+    uint64_t left = pHeader->ringSize - pHeader->head;
+
+    CAPTURE_makeRoom(pCapture, left);
+    if (left >= sizeof(CAPTURE_RECORD))
+    {
+        pPad = (CAPTURE_RECORD *)(pCapture->pRing + pHeader->head);
+        memset(pPad, 0, sizeof(CAPTURE_RECORD));
+        pPad->sync = CAPTURE_RECORD_SYNC;
+        pPad->recordSize = (uint32_t)left;
+        pPad->flags = CAPTURE_FLAG_PAD;
+    }
+    pHeader->used += left;
+    pHeader->head = 0U;
+    pHeader->wrapCount++;
+}
+
+
+
+/**
+ * Create the capture file at its final size and map it.
+ *
+ * @param pCapture the capture to initialise
+ * @param fname the file to create; an existing file is truncated
+ * @param ringSize the bytes reserved for records, excluding the header
+ *
+ * @return 1 on success, 0 on error
+ */
+int CAPTURE_Create(CAPTURE * const pCapture, const char fname[],
+    const unsigned long ringSize)
+{
+    CAPTURE_FILE_HEADER *pHeader;
+    uint64_t size = ringSize & ~((uint64_t)CAPTURE_ALIGN - 1U);
+    uint8_t *pMap;
+
+    memset(pCapture, 0, sizeof(CAPTURE));
+    pCapture->fd = -1;
+
+    if (size < 2U * sizeof(CAPTURE_RECORD))
+    {
+        printf("CAPTURE_Create: Ring of %lu bytes is too small\n", ringSize);
+        return 0;
+    }
+
+    pCapture->mapSize = (unsigned long)(sizeof(CAPTURE_FILE_HEADER) + size);
+    pMap = (uint8_t *)file_map_create(fname, pCapture->mapSize, &pCapture->fd);
+    if (pMap == NULL)
+    {
+        pCapture->fd = -1;
+        return 0;
+    }
+
+    pHeader = (CAPTURE_FILE_HEADER *)pMap;
+    memset(pHeader, 0, sizeof(CAPTURE_FILE_HEADER));
+    memcpy(pHeader->magic, CAPTURE_MAGIC, sizeof(pHeader->magic));
+    pHeader->version = CAPTURE_VERSION;
+    pHeader->headerSize = sizeof(CAPTURE_FILE_HEADER);
+    pHeader->ringSize = size;
+
+    pCapture->pHeader = pHeader;
+    pCapture->pRing = pMap + sizeof(CAPTURE_FILE_HEADER);
+
+    return 1;
+}
+
+
+
+/**
+ * Append one packet to the ring, overwriting the oldest records if needed.
+ *
+ * @param pCapture an open capture
+ * @param timeNs the time stamp of the packet
+ * @param port the port (channel) the packet was received on
+ * @param eop one of CAPTURE_EOP_*
+ * @param pData the packet data
+ * @param length the packet length
+ *
+ * @return 1 if the packet was recorded, 0 if it does not fit in the ring
+ */
+int CAPTURE_Write(CAPTURE * const pCapture, const uint64_t timeNs,
+    const uint8_t port, const uint8_t eop, const uint8_t * const pData,
+    const uint32_t length)
+{
+    CAPTURE_FILE_HEADER *pHeader = pCapture->pHeader;
+    CAPTURE_RECORD *pRecord;
+    uint64_t recordSize;
+
+    recordSize = CAPTURE_ALIGN_UP(sizeof(CAPTURE_RECORD) + (uint64_t)length);
+    if (recordSize > pHeader->ringSize)
+    {
+        pHeader->rejected++;
+        return 0;
+    }
+
+    if (pHeader->used == 0U)
+    {
+        pHeader->head = 0U;
+        pHeader->tail = 0U;
+    }
+    else if (pHeader->head + recordSize > pHeader->ringSize)
+    {
+        CAPTURE_wrap(pCapture);
+    }
+    CAPTURE_makeRoom(pCapture, recordSize);
+
+    pRecord = (CAPTURE_RECORD *)(pCapture->pRing + pHeader->head);
+    pRecord->sync = CAPTURE_RECORD_SYNC;
+    pRecord->recordSize = (uint32_t)recordSize;
+    pRecord->timeNs = timeNs;
+    pRecord->length = length;
+    pRecord->port = port;
+    pRecord->eop = eop;
+    pRecord->flags = 0U;
+    memcpy(pRecord + 1, pData, length);
+
+    /* Publish the record once it is complete */
+    pHeader->head += recordSize;
+    if (pHeader->head == pHeader->ringSize)
+    {
+        pHeader->head = 0U;
+        pHeader->wrapCount++;
+    }
+    pHeader->used += recordSize;
+
+    if (pHeader->recordCount == 0U)
+    {
+        pHeader->firstTimeNs = timeNs;
+    }
+    pHeader->lastTimeNs = timeNs;
+    pHeader->recordCount++;
+
+    return 1;
+}
+
+
+
+/**
+ * Map an existing capture file for reading.
+ *
+ * @return 1 on success, 0 if the file is missing or is not a capture
+ */
+int CAPTURE_Open(CAPTURE * const pCapture, const char fname[])
+{
+    CAPTURE_FILE_HEADER *pHeader;
+    uint8_t *pMap;
+
+    memset(pCapture, 0, sizeof(CAPTURE));
+    pMap = (uint8_t *)file_map_open(fname, &pCapture->mapSize, &pCapture->fd);
+    if (pMap == NULL)
+    {
+        pCapture->fd = -1;
+        return 0;
+    }
+
+    pHeader = (CAPTURE_FILE_HEADER *)pMap;
+    if ((pCapture->mapSize < sizeof(CAPTURE_FILE_HEADER)) ||
+        (memcmp(pHeader->magic, CAPTURE_MAGIC, sizeof(pHeader->magic)) != 0) ||
+        (pHeader->version != CAPTURE_VERSION) ||
+        (pHeader->headerSize != sizeof(CAPTURE_FILE_HEADER)) ||
+        (pHeader->ringSize > pCapture->mapSize - sizeof(CAPTURE_FILE_HEADER)) ||
+        (pHeader->used > pHeader->ringSize) ||
+        (pHeader->tail >= pHeader->ringSize))
+    {
+        printf("CAPTURE_Open: %s is not a capture file\n", fname);
+        file_unmap(pMap, pCapture->mapSize, pCapture->fd);
+        memset(pCapture, 0, sizeof(CAPTURE));
+        pCapture->fd = -1;
+        return 0;
+    }
+
+    pCapture->pHeader = pHeader;
+    pCapture->pRing = pMap + sizeof(CAPTURE_FILE_HEADER);
+
+    return 1;
+}
+
+
+
+/* Position the cursor on the oldest record */
+void CAPTURE_Rewind(const CAPTURE * const pCapture,
+    CAPTURE_CURSOR * const pCursor)
+{
+    pCursor->offset = pCapture->pHeader->tail;
+    pCursor->remaining = pCapture->pHeader->used;
+}
+
+
+
+/**
+ * Step to the next record, oldest first.
+ *
+ * @param pCapture an open capture
+ * @param pCursor a cursor set by CAPTURE_Rewind()
+ * @param ppData updated with the payload of the record
+ *
+ * @return the record, or NULL at the end of the capture or on a damaged
+ *         record
+ */
+const CAPTURE_RECORD *CAPTURE_Next(const CAPTURE * const pCapture,
+    CAPTURE_CURSOR * const pCursor, const uint8_t ** const ppData)
+{
+    const uint64_t ringSize = pCapture->pHeader->ringSize;
+    const CAPTURE_RECORD *pRecord;
+    uint64_t left;
+
+    while (pCursor->remaining > 0U)
+    {
+        left = ringSize - pCursor->offset;
+        if (left < sizeof(CAPTURE_RECORD))
+        {
+            if (left > pCursor->remaining)
+            {
+                break;
+            }
+            pCursor->remaining -= left;
+            pCursor->offset = 0U;
+            continue;
+        }
+
+        pRecord = (const CAPTURE_RECORD *)(pCapture->pRing + pCursor->offset);
+        if ((pRecord->sync != CAPTURE_RECORD_SYNC) ||
+            (pRecord->recordSize < sizeof(CAPTURE_RECORD)) ||
+            ((pRecord->recordSize % CAPTURE_ALIGN) != 0U) ||
+            (pRecord->recordSize > left) ||
+            (pRecord->recordSize > pCursor->remaining) ||
+            (sizeof(CAPTURE_RECORD) + (uint64_t)pRecord->length >
+                pRecord->recordSize))
+        {
+            printf("CAPTURE_Next: Damaged record at offset %llu\n",
+                (unsigned long long)pCursor->offset);
+            break;
+        }
+
+        pCursor->offset += pRecord->recordSize;
+        if (pCursor->offset == ringSize)
+        {
+            pCursor->offset = 0U;
+        }
+        pCursor->remaining -= pRecord->recordSize;
+
+        if ((pRecord->flags & CAPTURE_FLAG_PAD) == 0U)
+        {
+            *ppData = (const uint8_t *)(pRecord + 1);
+            return pRecord;
+        }
+    }
+
+    pCursor->remaining = 0U;
+    *ppData = NULL;
+    return NULL;
+}
+
+
+
+/* Flush the map to the file and release it */
+void CAPTURE_Close(CAPTURE * const pCapture)
+{
+    file_unmap(pCapture->pHeader, pCapture->mapSize, pCapture->fd);
+    memset(pCapture, 0, sizeof(CAPTURE));
+    pCapture->fd = -1;
+}
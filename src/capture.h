@@ -0,0 +1,101 @@
+/*
+  @file capture.h
+  @author Juan Manuel Gómez
+  @brief Binary packet capture kept in a memory-mapped ring file.
+  @details The capture file is created once at its final size and mapped.
+           Each received packet is appended as a compact record (time stamp,
+           port, EOP/EEP marker and payload) with plain stores into the map,
+           so capturing neither opens the file nor issues a system call per
+           packet. When the ring is full the oldest records are overwritten
+           and counted.
+
+           Layout: a CAPTURE_FILE_HEADER followed by the ring. Records are
+           8-byte aligned and never straddle the end of the ring; the unused
+           tail before a wrap is covered by a pad record, or left as is when
+           it is shorter than a record header. The header keeps the offsets
+           of the oldest record (tail) and of the next write (head), so the
+           reader walks the records in order from tail without searching.
+
+           Fields are stored in host byte order.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+
+#define CAPTURE_MAGIC "SPWCAP01"
+#define CAPTURE_VERSION 1U
+#define CAPTURE_RECORD_SYNC 0x52575053U /* "SPWR" */
+#define CAPTURE_ALIGN 8U
+#define CAPTURE_DEFAULT_SIZE (64UL * 1024UL * 1024UL)
+
+/* End of packet marker of a record */
+#define CAPTURE_EOP_NONE 0U
+#define CAPTURE_EOP_EOP 1U
+#define CAPTURE_EOP_EEP 2U
+
+/* Record flags */
+#define CAPTURE_FLAG_PAD 0x0001U
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t ringSize;
+    uint64_t head;
+    uint64_t tail;
+    uint64_t used;
+    uint64_t wrapCount;
+    uint64_t recordCount;
+    uint64_t overwritten;
+    uint64_t rejected;
+    uint64_t firstTimeNs;
+    uint64_t lastTimeNs;
+} CAPTURE_FILE_HEADER;
+
+typedef struct
+{
+    uint32_t sync;
+    uint32_t recordSize;
+    uint64_t timeNs;
+    uint32_t length;
+    uint8_t port;
+    uint8_t eop;
+    uint16_t flags;
+} CAPTURE_RECORD;
+
+typedef struct
+{
+    int fd;
+    unsigned long mapSize;
+    CAPTURE_FILE_HEADER *pHeader;
+    uint8_t *pRing;
+} CAPTURE;
+
+typedef struct
+{
+    uint64_t offset;
+    uint64_t remaining;
+} CAPTURE_CURSOR;
+
+int CAPTURE_Create(CAPTURE * const pCapture, const char fname[],
+    const unsigned long ringSize);
+
+int CAPTURE_Write(CAPTURE * const pCapture, const uint64_t timeNs,
+    const uint8_t port, const uint8_t eop, const uint8_t * const pData,
+    const uint32_t length);
+
+int CAPTURE_Open(CAPTURE * const pCapture, const char fname[]);
+
+void CAPTURE_Rewind(const CAPTURE * const pCapture,
+    CAPTURE_CURSOR * const pCursor);
+
+const CAPTURE_RECORD *CAPTURE_Next(const CAPTURE * const pCapture,
+    CAPTURE_CURSOR * const pCursor, const uint8_t ** const ppData);
+
+void CAPTURE_Close(CAPTURE * const pCapture);
+
+#endif
@@ -0,0 +1,195 @@
+/*
+  @file capture_read.c
+  @author Juan Manuel Gómez
+  @brief Summarise or replay a capture written by receiv -w.
+  @details Walks the records of the ring from the oldest one. By default
+           prints a summary: records kept and lost, time span, rates,
+           packet sizes and end markers per port. With -p every record is
+           replayed to the standard output in order, with -x including the
+           payload in the format receiv used to print it.
+  @param -p replay the records, -x also dump the payload, -c maximum records
+  @example ./capread -p -x -c 10 rx.cap
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "capture.h"
+
+#define MAX_PORTS 256
+
+
+typedef struct
+{
+  unsigned long long packets;
+  unsigned long long bytes;
+  unsigned long long eop;
+  unsigned long long eep;
+  unsigned long long none;
+  uint32_t minLength;
+  uint32_t maxLength;
+} port_stats;
+
+
+static const char *eopName(const uint8_t eop)
+{
+  switch (eop)
+    {
+    case CAPTURE_EOP_EOP:
+      return "EOP";
+    case CAPTURE_EOP_EEP:
+      return "EEP";
+    default:
+      return "NONE";
+    }
+}
+
+
+static void printRecord(const unsigned long long index,
+			const CAPTURE_RECORD * const pRecord,
+			const uint64_t firstTimeNs,
+			const uint8_t * const pData, const int dump)
+{
+  uint32_t i;
+
+  printf("%llu\t%.9f\tport %u\t%u bytes\t%s\n", index,
+	 (double) (pRecord->timeNs - firstTimeNs) / 1e9,
+	 pRecord->port, pRecord->length, eopName(pRecord->eop));
+  if (!dump)
+    return;
+
+  for (i = 0; i < pRecord->length; ++i)
+    {
+      printf("\t0x%x", pData[i]);
+      if (!((i + 1) % 8))
+	printf("\n");
+    }
+  if (pRecord->length % 8)
+    printf("\n");
+}
+
+
+static void printSummary(const CAPTURE * const pCapture,
+			 const port_stats * const pStats,
+			 const unsigned long long kept,
+			 const uint64_t firstNs, const uint64_t lastNs,
+			 const uint64_t maxGapNs)
+{
+  const CAPTURE_FILE_HEADER *pHeader = pCapture->pHeader;
+  unsigned long long bytes = 0;
+  double span;
+  unsigned int p;
+
+  for (p = 0; p < MAX_PORTS; ++p)
+    bytes += pStats[p].bytes;
+  span = (kept > 1) ? (double) (lastNs - firstNs) / 1e9 : 0.0;
+
+  printf("Ring size:\t\t%llu bytes, %llu in use, %llu wraps\n",
+	 (unsigned long long) pHeader->ringSize,
+	 (unsigned long long) pHeader->used,
+	 (unsigned long long) pHeader->wrapCount);
+  printf("Records written:\t%llu\n", (unsigned long long) pHeader->recordCount);
+  printf("Records kept:\t\t%llu\n", kept);
+  printf("Records overwritten:\t%llu\n", (unsigned long long) pHeader->overwritten);
+  printf("Records rejected:\t%llu (larger than the ring)\n",
+	 (unsigned long long) pHeader->rejected);
+  printf("Time span kept:\t\t%.6f s\n", span);
+  printf("Largest gap:\t\t%.6f s\n", (double) maxGapNs / 1e9);
+  if (span > 0.0)
+    printf("Rate:\t\t\t%.1f packets/s, %.3f Mbit/s\n", kept / span,
+	   bytes * 8.0 / span / 1e6);
+
+  printf("\nport\tpackets\tbytes\tmin\tmax\tmean\tEOP\tEEP\tnone\n");
+  for (p = 0; p < MAX_PORTS; ++p)
+    {
+      if (pStats[p].packets == 0)
+	continue;
+      printf("%u\t%llu\t%llu\t%u\t%u\t%.1f\t%llu\t%llu\t%llu\n", p,
+	     pStats[p].packets, pStats[p].bytes, pStats[p].minLength,
+	     pStats[p].maxLength,
+	     (double) pStats[p].bytes / (double) pStats[p].packets,
+	     pStats[p].eop, pStats[p].eep, pStats[p].none);
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+  static port_stats stats[MAX_PORTS];
+  const CAPTURE_RECORD *pRecord;
+  const uint8_t *pData;
+  CAPTURE_CURSOR cursor;
+  CAPTURE capture;
+  unsigned long long kept = 0, maxRecords = 0;
+  uint64_t firstNs = 0, lastNs = 0, maxGapNs = 0;
+  int replay = 0, dump = 0, opt;
+  port_stats *pPort;
+
+  while ((opt = getopt(argc, argv, "pxc:")) != -1)
+    {
+      switch (opt)
+	{
+	case 'p':
+	  replay = 1;
+	  break;
+	case 'x':
+	  replay = 1;
+	  dump = 1;
+	  break;
+	case 'c':
+	  maxRecords = strtoull(optarg, NULL, 0);
+	  break;
+	default:
+	  printf("Usage: %s [-p] [-x] [-c records] file\n", argv[0]);
+	  return 1;
+	}
+    }
+  if (optind >= argc)
+    {
+      printf("Usage: %s [-p] [-x] [-c records] file\n", argv[0]);
+      return 1;
+    }
+
+  if (!CAPTURE_Open(&capture, argv[optind]))
+    return 1;
+
+  CAPTURE_Rewind(&capture, &cursor);
+  while ((pRecord = CAPTURE_Next(&capture, &cursor, &pData)) != NULL)
+    {
+      if (kept == 0)
+	firstNs = pRecord->timeNs;
+      else if (pRecord->timeNs > lastNs && pRecord->timeNs - lastNs > maxGapNs)
+	maxGapNs = pRecord->timeNs - lastNs;
+      lastNs = pRecord->timeNs;
+
+      pPort = &stats[pRecord->port];
+      if (pPort->packets == 0 || pRecord->length < pPort->minLength)
+	pPort->minLength = pRecord->length;
+      if (pRecord->length > pPort->maxLength)
+	pPort->maxLength = pRecord->length;
+      pPort->packets++;
+      pPort->bytes += pRecord->length;
+      if (pRecord->eop == CAPTURE_EOP_EOP)
+	pPort->eop++;
+      else if (pRecord->eop == CAPTURE_EOP_EEP)
+	pPort->eep++;
+      else
+	pPort->none++;
+
+      if (replay)
+	printRecord(kept, pRecord, firstNs, pData, dump);
+
+      kept++;
+      if (maxRecords != 0 && kept >= maxRecords)
+	break;
+    }
+
+  if (!replay)
+    printSummary(&capture, stats, kept, firstNs, lastNs, maxGapNs);
+
+  CAPTURE_Close(&capture);
+
+  return 0;
+}
@@ -0,0 +1,283 @@
+/*
+  @file dev_manager.c
+  @author Juan Manuel Gómez
+  @brief One worker thread per STAR device and channel.
+  @details See dev_manager.h.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include "dev_manager.h"
+#include "utility.h"
+
+
+static void *DEVMGR_thread(void *arg)
+{
+    DEVMGR_WORKER * const pWorker = (DEVMGR_WORKER *)arg;
+    unsigned long long startNs;
+
+    startNs = MonotonicTimeNs();
+    pWorker->status = pWorker->job(pWorker, pWorker->pArgument);
+    if (pWorker->durationNs == 0ULL)
+    {
+        pWorker->durationNs = MonotonicTimeNs() - startNs;
+    }
+
+    return NULL;
+}
+
+
+
+/**
+ * Take the devices of a type and give a worker to each device/channel
+ * pair.
+ *
+ * @param pManager the manager
+ * @param deviceType the devices to take
+ * @param channels the channels wanted on each device, bit n for channel n
+ * @param pin pin each worker to its own CPU, round robin
+ *
+ * @return the number of workers, 0 if no device has the channels
+ */
+unsigned int DEVMGR_Open(DEVMGR * const pManager,
+    const STAR_DEVICE_TYPE deviceType, const STAR_CHANNEL_MASK channels,
+    const int pin)
+{
+    DEVMGR_WORKER *pWorker;
+    STAR_CHANNEL_MASK available;
+    long cpuCount;
+    unsigned int d;
+    U8 channel;
+
+    memset(pManager, 0, sizeof(DEVMGR));
+    pManager->pin = pin;
+    cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpuCount < 1)
+    {
+        cpuCount = 1;
+    }
+
+    pManager->pDeviceList = STAR_getDeviceListForType(deviceType,
+        &pManager->deviceCount);
+    if (pManager->pDeviceList == NULL)
+    {
+        pManager->deviceCount = 0U;
+        return 0U;
+    }
+
+    for (d = 0U; d < pManager->deviceCount; d++)
+    {
+        if (pManager->pDeviceList[d] == STAR_DEVICE_UNKNOWN)
+        {
+            continue;
+        }
+
+        available = STAR_getDeviceChannels(pManager->pDeviceList[d]);
+        for (channel = 1U; channel < 32U; channel++)
+        {
+            if (!(channels & available & (1U << channel)))
+            {
+                continue;
+            }
+            if (pManager->workerCount == DEVMGR_MAX_WORKERS)
+            {
+                puts("DEVMGR_Open: Too many device channels, some are left out");
+                return pManager->workerCount;
+            }
+
+            pWorker = &pManager->workers[pManager->workerCount];
+            pWorker->deviceId = pManager->pDeviceList[d];
+            pWorker->deviceIndex = d;
+            pWorker->channelNumber = channel;
+            pWorker->cpu = pin ?
+                (int)(pManager->workerCount % (unsigned long)cpuCount) : -1;
+            pManager->workerCount++;
+        }
+    }
+
+    return pManager->workerCount;
+}
+
+
+
+/**
+ * Give every device/channel pair `roles` workers, with roles 0 to
+ * roles - 1, next to each other in the list. The CPUs are dealt again.
+ *
+ * @param pManager the manager, after DEVMGR_Open()
+ * @param roles the workers per device/channel pair
+ *
+ * @return the number of workers, 0 if they would be too many
+ */
+unsigned int DEVMGR_SetRoles(DEVMGR * const pManager,
+    const unsigned int roles)
+{
+    DEVMGR_WORKER *pWorker;
+    long cpuCount;
+    unsigned int i, r;
+
+    if ((roles == 0U) ||
+        (pManager->workerCount * roles > DEVMGR_MAX_WORKERS))
+    {
+        puts("DEVMGR_SetRoles: Too many workers");
+        return 0U;
+    }
+    cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpuCount < 1)
+    {
+        cpuCount = 1;
+    }
+
+    /* From the last pair, so that none is overwritten before it is copied */
+    for (i = pManager->workerCount; i-- > 0U; )
+    {
+        for (r = roles; r-- > 0U; )
+        {
+            pWorker = &pManager->workers[i * roles + r];
+            *pWorker = pManager->workers[i];
+            pWorker->role = r;
+        }
+    }
+    pManager->workerCount *= roles;
+
+    for (i = 0U; pManager->pin && (i < pManager->workerCount); i++)
+    {
+        pManager->workers[i].cpu = (int)(i % (unsigned long)cpuCount);
+    }
+
+    return pManager->workerCount;
+}
+
+
+
+/**
+ * Run a job on every worker, concurrently, and wait for all of them.
+ *
+ * @param pManager the manager, after DEVMGR_Open()
+ * @param job the job
+ * @param pArgument passed to every instance of the job, shared
+ *
+ * @return the number of workers whose job failed
+ */
+unsigned int DEVMGR_Run(DEVMGR * const pManager, const DEVMGR_JOB job,
+    void * const pArgument)
+{
+    DEVMGR_WORKER *pWorker;
+    pthread_attr_t attr;
+    unsigned int i, failed = 0U;
+#ifdef __linux__
+    cpu_set_t cpus;
+#endif
+
+    for (i = 0U; i < pManager->workerCount; i++)
+    {
+        pWorker = &pManager->workers[i];
+        pWorker->job = job;
+        pWorker->pArgument = pArgument;
+        pWorker->status = -1;
+        pWorker->packets = pWorker->bytes = pWorker->errors = 0ULL;
+        pWorker->durationNs = 0ULL;
+        pWorker->summary[0] = '\0';
+
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+#ifdef __linux__
+        if (pWorker->cpu >= 0)
+        {
+            CPU_ZERO(&cpus);
+            CPU_SET(pWorker->cpu, &cpus);
+            pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+        }
+#endif
+        if (pthread_create(&pWorker->thread, &attr, DEVMGR_thread,
+            pWorker) != 0)
+        {
+            snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH,
+                "Unable to start the worker");
+            pWorker->job = NULL;
+        }
+        pthread_attr_destroy(&attr);
+    }
+
+    for (i = 0U; i < pManager->workerCount; i++)
+    {
+        pWorker = &pManager->workers[i];
+        if (pWorker->job != NULL)
+        {
+            pthread_join(pWorker->thread, NULL);
+        }
+        if (pWorker->status != 0)
+        {
+            failed++;
+        }
+    }
+
+    return failed;
+}
+
+
+
+/* One line per worker, then the totals. With several roles, the packets,
+   bytes and rate of the totals are those of role 0 only: the traffic of a
+   transmitter and its receiver is the same traffic */
+void DEVMGR_PrintReport(const DEVMGR * const pManager)
+{
+    const DEVMGR_WORKER *pWorker;
+    unsigned long long packets = 0ULL, bytes = 0ULL, errors = 0ULL;
+    unsigned long long longestNs = 0ULL;
+    unsigned int i, failed = 0U;
+
+    printf("%-6s %-7s %-4s %-6s %12s %14s %8s %10s  %s\n", "device",
+        "channel", "cpu", "result", "packets", "bytes", "errors", "ms",
+        "summary");
+    for (i = 0U; i < pManager->workerCount; i++)
+    {
+        pWorker = &pManager->workers[i];
+        printf("%-6u %-7u %-4d %-6s %12llu %14llu %8llu %10.3f  %s\n",
+            pWorker->deviceIndex, pWorker->channelNumber, pWorker->cpu,
+            pWorker->status == 0 ? "ok" : "FAIL", pWorker->packets,
+            pWorker->bytes, pWorker->errors, pWorker->durationNs / 1e6,
+            pWorker->summary);
+
+        errors += pWorker->errors;
+        if (pWorker->role == 0U)
+        {
+            packets += pWorker->packets;
+            bytes += pWorker->bytes;
+            if (pWorker->durationNs > longestNs)
+            {
+                longestNs = pWorker->durationNs;
+            }
+        }
+        if (pWorker->status != 0)
+        {
+            failed++;
+        }
+    }
+
+    printf("%u devices, %u workers, %u failed: %llu packets, %llu bytes, "
+        "%llu errors", pManager->deviceCount, pManager->workerCount, failed,
+        packets, bytes, errors);
+    if (longestNs > 0ULL)
+    {
+        printf(", %.1f Mbit/s aggregate", (bytes * 8.0 * 1e3) / longestNs);
+    }
+    printf(".\n");
+}
+
+
+
+void DEVMGR_Close(DEVMGR * const pManager)
+{
+    if (pManager->pDeviceList != NULL)
+    {
+        STAR_destroyDeviceList(pManager->pDeviceList);
+    }
+    memset(pManager, 0, sizeof(DEVMGR));
+}
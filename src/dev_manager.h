@@ -0,0 +1,90 @@
+/*
+  @file dev_manager.h
+  @author Juan Manuel Gómez
+  @brief One worker thread per STAR device and channel.
+  @details The programs of the collection work on the first device of
+           the list. The manager takes every device of a type and, for
+           each of them, every channel asked for that the device has, and
+           gives each device/channel pair a worker. DEVMGR_Run() starts
+           one thread per worker running the same job, optionally pinned
+           to its own CPU, waits for all of them and keeps the result of
+           each one for a single report.
+
+           A job opens the channels it needs from the device and channel
+           of its worker, and accounts its traffic in the counters of the
+           worker. The time of the worker is the time the job ran, unless
+           the job sets durationNs itself to the time it carried traffic.
+           Jobs run concurrently, so they should not print: the summary
+           line of the worker is printed in the report.
+
+           DEVMGR_SetRoles() gives each device/channel pair several
+           workers instead of one, told apart by their role, for jobs that
+           need more than one thread per channel, such as a transmitter
+           and a receiver. The totals of the report then count the traffic
+           of role 0 only, once.
+
+           With --enable-star-sim the device list is the one simulated by
+           star_sim.c, sized by STAR_SIM_DEVICES.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef DEV_MANAGER_H
+#define DEV_MANAGER_H
+
+#include <pthread.h>
+#include "star-dundee_types.h"
+#include "star-api.h"
+
+#define DEVMGR_MAX_WORKERS 64
+#define DEVMGR_SUMMARY_LENGTH 128
+
+typedef struct DEVMGR_WORKER DEVMGR_WORKER;
+
+/* A job returns 0 on success */
+typedef int (*DEVMGR_JOB)(DEVMGR_WORKER * const pWorker,
+    void * const pArgument);
+
+struct DEVMGR_WORKER
+{
+    STAR_DEVICE_ID deviceId;
+    unsigned int deviceIndex;
+    U8 channelNumber;
+    unsigned int role;       /* 0 to the roles of DEVMGR_SetRoles() - 1 */
+    int cpu;                 /* CPU the worker is pinned to, or -1 */
+
+    pthread_t thread;
+    DEVMGR_JOB job;
+    void *pArgument;
+
+    int status;              /* result of the job */
+    unsigned long long packets;
+    unsigned long long bytes;
+    unsigned long long errors;
+    unsigned long long durationNs;
+    char summary[DEVMGR_SUMMARY_LENGTH];
+};
+
+typedef struct
+{
+    STAR_DEVICE_ID *pDeviceList;
+    unsigned int deviceCount;
+    DEVMGR_WORKER workers[DEVMGR_MAX_WORKERS];
+    unsigned int workerCount;
+    int pin;
+} DEVMGR;
+
+unsigned int DEVMGR_Open(DEVMGR * const pManager,
+    const STAR_DEVICE_TYPE deviceType, const STAR_CHANNEL_MASK channels,
+    const int pin);
+
+unsigned int DEVMGR_SetRoles(DEVMGR * const pManager,
+    const unsigned int roles);
+
+unsigned int DEVMGR_Run(DEVMGR * const pManager, const DEVMGR_JOB job,
+    void * const pArgument);
+
+void DEVMGR_PrintReport(const DEVMGR * const pManager);
+
+void DEVMGR_Close(DEVMGR * const pManager);
+
+#endif
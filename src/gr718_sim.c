@@ -0,0 +1,785 @@
+/*
+  @file gr718_sim.c
+  @author Juan Manuel Gómez
+  @brief Software model of the GR718B router behind the simulated Bricks.
+  @details See gr718_sim.h. The model has no lock of its own: star_sim.c
+           calls it with its lock held, and the model calls back into
+           star_sim.c to deliver what leaves the Brick ports.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "gr718_sim.h"
+#include "star_sim.h"
+#include "system_config.h"
+
+#define GR718SIM_BRICK_LINKS 2U        /* links 1 and 2 of the Brick */
+#define GR718SIM_MAX_HOPS 8U           /* through cables between ports */
+#define GR718SIM_MAX_REPLY 64U
+#define GR718SIM_CLOCK_MBPS 200U
+
+#define GR718SIM_RTACTRL_HD 0x01U      /* header deletion */
+#define GR718SIM_RTACTRL_EN 0x04U      /* enable */
+
+/* RMAP instruction and status */
+#define GR718SIM_PROTOCOL_ID 0x01U
+#define GR718SIM_COMMAND 0x40U
+#define GR718SIM_WRITE 0x20U
+#define GR718SIM_VERIFY 0x10U
+#define GR718SIM_ACKNOWLEDGE 0x08U
+#define GR718SIM_INCREMENT 0x04U
+#define GR718SIM_STATUS_INVALID_KEY 3U
+#define GR718SIM_STATUS_DATA_CRC 4U
+#define GR718SIM_STATUS_EARLY_EOP 5U
+#define GR718SIM_STATUS_TOO_MUCH_DATA 6U
+#define GR718SIM_STATUS_VERIFY_OVERRUN 9U
+#define GR718SIM_STATUS_NOT_AUTHORISED 10U
+#define GR718SIM_STATUS_INVALID_TLA 12U
+#define GR718SIM_STATUS_UNUSED_TYPE 2U
+
+/* A packet waiting for its turn on the link of an output port */
+typedef struct GR718SIM_QUEUED
+{
+    struct GR718SIM_QUEUED *pNext;
+    unsigned long long dueNs;          /* when its last character is out */
+    void *pSender;                     /* transmit operation it stalls */
+    U32 length;
+    STAR_EOP_TYPE eop;
+    U8 data[];
+} GR718SIM_QUEUED;
+
+typedef struct
+{
+    GR718SIM_QUEUED *pHead;
+    GR718SIM_QUEUED *pTail;
+} GR718SIM_QUEUE;
+
+typedef struct
+{
+    U32 registers[GR718SIM_REGISTER_COUNT];
+    U8 cable[GR718SIM_PORT_COUNT];         /* 0 if the port has no cable */
+    U8 link[GR718SIM_PORT_COUNT];          /* Brick link on the port, or 0 */
+    U8 linkPort[GR718SIM_BRICK_LINKS + 1U];
+    U32 fixedRateMbps[GR718SIM_PORT_COUNT];
+    GR718SIM_PORT_STATS stats[GR718SIM_PORT_COUNT];
+    unsigned long long busyUntilNs[GR718SIM_PORT_COUNT];
+    GR718SIM_QUEUE queues[GR718SIM_PORT_COUNT];
+    unsigned long long discarded;
+    U8 timeCode;
+} GR718SIM_ROUTER;
+
+
+static int gr718Enabled = 0;
+static U32 gr718Count = 0U;
+static GR718SIM_ROUTER gr718Routers[SIM_MAX_DEVICES];
+static pthread_t gr718WireThread;
+
+
+
+/* The RMAP CRC, bit by bit: the model does not share code with the
+   programs it checks */
+static U8 GR718SIM_crc(const U8 * const pData, const U32 length)
+{
+    U8 crc = 0U;
+    U32 i;
+    int bit;
+
+    for (i = 0U; i < length; i++)
+    {
+        crc ^= pData[i];
+        for (bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 1U) ? (U8)((crc >> 1) ^ 0xE0U) : (U8)(crc >> 1);
+        }
+    }
+
+    return crc;
+}
+
+
+
+static GR718SIM_ROUTER *GR718SIM_router(const STAR_DEVICE_ID deviceId)
+{
+    if (!gr718Enabled || (deviceId == 0U) || (deviceId > gr718Count))
+    {
+        return NULL;
+    }
+
+    return &gr718Routers[deviceId - 1U];
+}
+
+
+
+static U32 GR718SIM_rate(const GR718SIM_ROUTER * const pRouter, const U8 port)
+{
+    U32 divisor;
+
+    if (pRouter->fixedRateMbps[port] != 0U)
+    {
+        return pRouter->fixedRateMbps[port];
+    }
+    divisor = pRouter->registers[(RTR_PCTRL0_BASE / 4U) + port] >> 24;
+
+    return GR718SIM_CLOCK_MBPS / (divisor + 1U);
+}
+
+
+
+static unsigned long long GR718SIM_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (unsigned long long)now.tv_sec * 1000000000ULL +
+        (unsigned long long)now.tv_nsec;
+}
+
+
+
+/* Deliver the queued packets whose time has come, then sleep until the
+ * next one is due or a new one is queued. Runs with the lock held, which
+ * the waits let go of. */
+static void *GR718SIM_wireThread(void *arg)
+{
+    GR718SIM_ROUTER *pRouter;
+    GR718SIM_QUEUE *pQueue;
+    GR718SIM_QUEUED *pQueued;
+    unsigned long long nowNs, nextNs;
+    U32 d, port;
+
+    (void)arg;
+    SIM_Lock();
+    for (;;)
+    {
+        nowNs = GR718SIM_now();
+        nextNs = 0ULL;
+        for (d = 0U; d < gr718Count; d++)
+        {
+            pRouter = &gr718Routers[d];
+            for (port = 1U; port < GR718SIM_PORT_COUNT; port++)
+            {
+                pQueue = &pRouter->queues[port];
+                while ((pQueue->pHead != NULL) &&
+                    (pQueue->pHead->dueNs <= nowNs))
+                {
+                    pQueued = pQueue->pHead;
+                    pQueue->pHead = pQueued->pNext;
+                    if (pQueue->pHead == NULL)
+                    {
+                        pQueue->pTail = NULL;
+                    }
+                    SIM_deliverPacketLocked(d + 1U, pRouter->link[port],
+                        pQueued->data, pQueued->length, pQueued->eop,
+                        pQueued->pSender);
+                    SIM_releaseSenderLocked(pQueued->pSender);
+                    free(pQueued);
+                }
+                if ((pQueue->pHead != NULL) &&
+                    ((nextNs == 0ULL) || (pQueue->pHead->dueNs < nextNs)))
+                {
+                    nextNs = pQueue->pHead->dueNs;
+                }
+            }
+        }
+        SIM_waitLocked(nextNs);
+    }
+
+    return NULL;
+}
+
+
+
+static void GR718SIM_reset(GR718SIM_ROUTER * const pRouter)
+{
+    U32 port;
+
+    memset(pRouter->registers, 0, sizeof(pRouter->registers));
+    for (port = 1U; port < GR718SIM_PORT_COUNT; port++)
+    {
+        pRouter->registers[(RTR_RTPMAP_PH_BASE / 4U) + port - 1U] = 1U << port;
+    }
+    pRouter->registers[(RTR_RTPMAP_PH_BASE / 4U) +
+        GR718SIM_LOGICAL_ADDRESS - 1U] = 1U << pRouter->linkPort[1];
+    pRouter->registers[(RTR_RTACTRL_PH_BASE / 4U) +
+        GR718SIM_LOGICAL_ADDRESS - 1U] = GR718SIM_RTACTRL_EN;
+    pRouter->timeCode = 0U;
+}
+
+
+
+/* Parse STAR_SIM_ROUTER into the first router, then copy it to the rest */
+void GR718SIM_Init(const U32 deviceCount)
+{
+    GR718SIM_ROUTER * const pRouter = &gr718Routers[0];
+    const char *pEnv;
+    const char *pToken;
+    unsigned int a, b;
+    U32 d;
+
+    pEnv = getenv("STAR_SIM_ROUTER");
+    gr718Enabled = (pEnv != NULL) && (*pEnv != '\0') &&
+        (strcmp(pEnv, "0") != 0);
+    gr718Count = (deviceCount < SIM_MAX_DEVICES) ? deviceCount :
+        SIM_MAX_DEVICES;
+    memset(gr718Routers, 0, sizeof(gr718Routers));
+    if (!gr718Enabled)
+    {
+        return;
+    }
+
+    /* The cabling of the bench: link 1 on port 2, link 2 on port 1 */
+    pRouter->linkPort[1] = 2U;
+    pRouter->linkPort[2] = 1U;
+    for (pToken = pEnv; pToken != NULL; pToken = strchr(pToken, ','))
+    {
+        if (*pToken == ',')
+        {
+            pToken++;
+        }
+        if ((sscanf(pToken, "L%u=%u", &a, &b) == 2) &&
+            (a >= 1U) && (a <= GR718SIM_BRICK_LINKS) &&
+            (b >= 1U) && (b < GR718SIM_PORT_COUNT))
+        {
+            pRouter->linkPort[a] = (U8)b;
+        }
+        else if ((sscanf(pToken, "%u:%u", &a, &b) == 2) &&
+            (a >= 1U) && (a < GR718SIM_PORT_COUNT) &&
+            (b >= 1U) && (b < GR718SIM_PORT_COUNT))
+        {
+            pRouter->cable[a] = (U8)b;
+            pRouter->cable[b] = (U8)a;
+        }
+        else if ((sscanf(pToken, "%u@%u", &a, &b) == 2) &&
+            (a < GR718SIM_PORT_COUNT) && (b > 0U))
+        {
+            pRouter->fixedRateMbps[a] = b;
+        }
+    }
+
+    /* A Brick link takes the port over from any cable */
+    for (a = 1U; a <= GR718SIM_BRICK_LINKS; a++)
+    {
+        b = pRouter->linkPort[a];
+        if (pRouter->cable[b] != 0U)
+        {
+            pRouter->cable[pRouter->cable[b]] = 0U;
+            pRouter->cable[b] = 0U;
+        }
+        pRouter->link[b] = (U8)a;
+    }
+    GR718SIM_reset(pRouter);
+
+    for (d = 1U; d < gr718Count; d++)
+    {
+        gr718Routers[d] = gr718Routers[0];
+    }
+
+    if (pthread_create(&gr718WireThread, NULL, GR718SIM_wireThread,
+        NULL) == 0)
+    {
+        pthread_detach(gr718WireThread);
+    }
+}
+
+
+
+int GR718SIM_Enabled(void)
+{
+    return gr718Enabled;
+}
+
+
+
+static void GR718SIM_route(const STAR_DEVICE_ID deviceId,
+    GR718SIM_ROUTER * const pRouter, const U8 * const pData, const U32 length,
+    const STAR_EOP_TYPE eop, const U32 hops, const unsigned long long arrivalNs);
+
+
+
+/* Hold a packet until the link of a port has sent it, at dueNs */
+static int GR718SIM_queue(GR718SIM_ROUTER * const pRouter, const U8 port,
+    const U8 * const pData, const U32 length, const STAR_EOP_TYPE eop,
+    const unsigned long long dueNs)
+{
+    GR718SIM_QUEUE * const pQueue = &pRouter->queues[port];
+    GR718SIM_QUEUED *pQueued;
+
+    pQueued = (GR718SIM_QUEUED *)malloc(sizeof(GR718SIM_QUEUED) + length);
+    if (pQueued == NULL)
+    {
+        return 0;
+    }
+    pQueued->pNext = NULL;
+    pQueued->dueNs = dueNs;
+    pQueued->length = length;
+    pQueued->eop = eop;
+    memcpy(pQueued->data, pData, length);
+    pQueued->pSender = SIM_holdSenderLocked();
+
+    if (pQueue->pTail == NULL)
+    {
+        pQueue->pHead = pQueued;
+    }
+    else
+    {
+        pQueue->pTail->pNext = pQueued;
+    }
+    pQueue->pTail = pQueued;
+    SIM_wakeLocked();
+
+    return 1;
+}
+
+
+
+/* A packet leaving the router through a port, once the packets before it
+ * have, at the rate of the port */
+static void GR718SIM_transmit(const STAR_DEVICE_ID deviceId,
+    GR718SIM_ROUTER * const pRouter, const U8 port, const U8 * const pData,
+    const U32 length, const STAR_EOP_TYPE eop, const U32 hops,
+    const unsigned long long arrivalNs)
+{
+    GR718SIM_PORT_STATS * const pStats = &pRouter->stats[port];
+    U32 rate = GR718SIM_rate(pRouter, port);
+    unsigned long long wireNs, sentNs;
+
+    if ((pRouter->link[port] == 0U) && (pRouter->cable[port] == 0U))
+    {
+        pStats->dropped++;
+        return;
+    }
+
+    /* 10 bits per data character on the link */
+    wireNs = ((unsigned long long)(length + 1U) * 10ULL * 1000ULL) / rate;
+    sentNs = ((pRouter->busyUntilNs[port] > arrivalNs) ?
+        pRouter->busyUntilNs[port] : arrivalNs) + wireNs;
+    pRouter->busyUntilNs[port] = sentNs;
+    pStats->packets++;
+    pStats->bytes += length;
+    pStats->wireNs += wireNs;
+
+    if (pRouter->link[port] != 0U)
+    {
+        if ((sentNs <= GR718SIM_now()) ||
+            !GR718SIM_queue(pRouter, port, pData, length, eop, sentNs))
+        {
+            SIM_deliverPacketLocked(deviceId, pRouter->link[port], pData,
+                length, eop, NULL);
+        }
+    }
+    else if (hops < GR718SIM_MAX_HOPS)
+    {
+        GR718SIM_route(deviceId, pRouter, pData, length, eop, hops + 1U,
+            sentNs);
+    }
+    else
+    {
+        pStats->dropped++;
+    }
+}
+
+
+
+/**
+ * Packets of a transmit operation cancelled or disposed of no longer stall
+ * it. Returns how many did.
+ */
+U32 GR718SIM_DetachSenderLocked(const void * const pSender)
+{
+    GR718SIM_QUEUED *pQueued;
+    U32 d, port, detached = 0U;
+
+    for (d = 0U; d < gr718Count; d++)
+    {
+        for (port = 1U; port < GR718SIM_PORT_COUNT; port++)
+        {
+            for (pQueued = gr718Routers[d].queues[port].pHead;
+                pQueued != NULL; pQueued = pQueued->pNext)
+            {
+                if (pQueued->pSender == pSender)
+                {
+                    pQueued->pSender = NULL;
+                    detached++;
+                }
+            }
+        }
+    }
+
+    return detached;
+}
+
+
+
+/* Lowest port of a routing table port mapping, 0 if none */
+static U8 GR718SIM_lowestPort(const U32 portMap)
+{
+    U8 port;
+
+    for (port = 1U; port < GR718SIM_PORT_COUNT; port++)
+    {
+        if (portMap & (1U << port))
+        {
+            return port;
+        }
+    }
+
+    return 0U;
+}
+
+
+
+static U32 GR718SIM_get32(const U8 * const pData)
+{
+    return ((U32)pData[0] << 24) | ((U32)pData[1] << 16) |
+        ((U32)pData[2] << 8) | (U32)pData[3];
+}
+
+
+
+/* Word aligned, inside the register space, incrementing if several words */
+static int GR718SIM_validAccess(const U32 address, const U32 dataLength,
+    const U8 instruction)
+{
+    if (((address % 4U) != 0U) || ((dataLength % 4U) != 0U) ||
+        (dataLength == 0U))
+    {
+        return 0;
+    }
+    if ((dataLength > 4U) && !(instruction & GR718SIM_INCREMENT))
+    {
+        return 0;
+    }
+
+    return ((address / 4U) + (dataLength / 4U)) <= GR718SIM_REGISTER_COUNT;
+}
+
+
+
+/* An RMAP command arriving on the configuration port */
+static void GR718SIM_rmap(const STAR_DEVICE_ID deviceId,
+    GR718SIM_ROUTER * const pRouter, const U8 * const pCommand,
+    const U32 length, const STAR_EOP_TYPE eop, const U32 hops,
+    const unsigned long long arrivalNs)
+{
+    U8 reply[GR718SIM_MAX_REPLY + (4U * GR718SIM_REGISTER_COUNT)];
+    U32 replyPathLength, headerLength, address, dataLength, n = 0U, i;
+    U8 instruction, status = 0U;
+    const U8 *pData;
+
+    /* Packets the target cannot make sense of are discarded silently */
+    if ((eop != STAR_EOP_TYPE_EOP) || (length < 4U) ||
+        (pCommand[1] != GR718SIM_PROTOCOL_ID) ||
+        ((pCommand[2] & 0xC0U) != GR718SIM_COMMAND))
+    {
+        pRouter->discarded++;
+        return;
+    }
+
+    instruction = pCommand[2];
+    replyPathLength = (instruction & 0x03U) * 4U;
+    headerLength = 16U + replyPathLength;
+    if ((length < headerLength) ||
+        (GR718SIM_crc(pCommand, headerLength) != 0U))
+    {
+        pRouter->discarded++;
+        return;
+    }
+
+    address = GR718SIM_get32(pCommand + 8U + replyPathLength);
+    dataLength = GR718SIM_get32(pCommand + 11U + replyPathLength) & 0xFFFFFFU;
+    pData = pCommand + headerLength;
+
+    if (pCommand[0] != GR718SIM_LOGICAL_ADDRESS)
+    {
+        status = GR718SIM_STATUS_INVALID_TLA;
+    }
+    else if (pCommand[3] != GR718SIM_KEY)
+    {
+        status = GR718SIM_STATUS_INVALID_KEY;
+    }
+    else if (!(instruction & GR718SIM_WRITE) &&
+        ((instruction & GR718SIM_VERIFY) || !(instruction & GR718SIM_ACKNOWLEDGE)))
+    {
+        /* Read-modify-write, or a read without a reply */
+        status = GR718SIM_STATUS_UNUSED_TYPE;
+    }
+    else if (instruction & GR718SIM_WRITE)
+    {
+        if (length < headerLength + dataLength + 1U)
+        {
+            status = GR718SIM_STATUS_EARLY_EOP;
+        }
+        else if (length > headerLength + dataLength + 1U)
+        {
+            status = GR718SIM_STATUS_TOO_MUCH_DATA;
+        }
+        else if (GR718SIM_crc(pData, dataLength + 1U) != 0U)
+        {
+            status = GR718SIM_STATUS_DATA_CRC;
+        }
+        else if ((instruction & GR718SIM_VERIFY) && (dataLength > 4U))
+        {
+            status = GR718SIM_STATUS_VERIFY_OVERRUN;
+        }
+        else if (!GR718SIM_validAccess(address, dataLength, instruction))
+        {
+            status = GR718SIM_STATUS_NOT_AUTHORISED;
+        }
+        else
+        {
+            for (i = 0U; i < dataLength / 4U; i++)
+            {
+                pRouter->registers[(address / 4U) + i] =
+                    GR718SIM_get32(pData + (4U * i));
+            }
+        }
+    }
+    else if ((length != headerLength) ||
+        !GR718SIM_validAccess(address, dataLength, instruction))
+    {
+        status = GR718SIM_STATUS_NOT_AUTHORISED;
+    }
+
+    if ((instruction & GR718SIM_WRITE) && !(instruction & GR718SIM_ACKNOWLEDGE))
+    {
+        return;
+    }
+
+    /* Reply address, without its leading zeros, then the reply */
+    for (i = 0U; i < replyPathLength; i++)
+    {
+        if ((n > 0U) || (pCommand[4U + i] != 0U))
+        {
+            reply[n++] = pCommand[4U + i];
+        }
+    }
+    headerLength = n;
+    reply[n++] = pCommand[4U + replyPathLength];              /* initiator */
+    reply[n++] = GR718SIM_PROTOCOL_ID;
+    reply[n++] = instruction & 0x3FU;
+    reply[n++] = status;
+    reply[n++] = pCommand[0];
+    reply[n++] = pCommand[5U + replyPathLength];              /* TID */
+    reply[n++] = pCommand[6U + replyPathLength];
+
+    if (instruction & GR718SIM_WRITE)
+    {
+        reply[n] = GR718SIM_crc(reply + headerLength, n - headerLength);
+        n++;
+    }
+    else
+    {
+        if (status != 0U)
+        {
+            dataLength = 0U;
+        }
+        reply[n++] = 0U;
+        reply[n++] = (U8)(dataLength >> 16);
+        reply[n++] = (U8)(dataLength >> 8);
+        reply[n++] = (U8)dataLength;
+        reply[n] = GR718SIM_crc(reply + headerLength, n - headerLength);
+        n++;
+        for (i = 0U; i < dataLength / 4U; i++)
+        {
+            U32 value = pRouter->registers[(address / 4U) + i];
+
+            reply[n++] = (U8)(value >> 24);
+            reply[n++] = (U8)(value >> 16);
+            reply[n++] = (U8)(value >> 8);
+            reply[n++] = (U8)value;
+        }
+        reply[n] = GR718SIM_crc(reply + n - dataLength, dataLength);
+        n++;
+    }
+
+    GR718SIM_route(deviceId, pRouter, reply, n, STAR_EOP_TYPE_EOP, hops,
+        arrivalNs);
+}
+
+
+
+/* A packet entering the router, whatever the port */
+static void GR718SIM_route(const STAR_DEVICE_ID deviceId,
+    GR718SIM_ROUTER * const pRouter, const U8 * const pData, const U32 length,
+    const STAR_EOP_TYPE eop, const U32 hops, const unsigned long long arrivalNs)
+{
+    U32 address, control, deleted = 1U;
+    U8 port;
+
+    if (length == 0U)
+    {
+        pRouter->discarded++;
+        return;
+    }
+
+    address = pData[0];
+    if (address == 0U)
+    {
+        GR718SIM_rmap(deviceId, pRouter, pData + 1, length - 1U, eop, hops,
+            arrivalNs);
+        return;
+    }
+
+    if ((address >= GR718SIM_PORT_COUNT) && (address < 32U))
+    {
+        pRouter->discarded++;
+        return;
+    }
+
+    if (address >= 32U)
+    {
+        control = pRouter->registers[(RTR_RTACTRL_PH_BASE / 4U) + address - 1U];
+        if (!(control & GR718SIM_RTACTRL_EN))
+        {
+            pRouter->discarded++;
+            return;
+        }
+        deleted = (control & GR718SIM_RTACTRL_HD) ? 1U : 0U;
+    }
+
+    port = GR718SIM_lowestPort(
+        pRouter->registers[(RTR_RTPMAP_PH_BASE / 4U) + address - 1U]);
+    if (port == 0U)
+    {
+        pRouter->discarded++;
+        return;
+    }
+
+    GR718SIM_transmit(deviceId, pRouter, port, pData + deleted,
+        length - deleted, eop, hops, arrivalNs);
+}
+
+
+
+/**
+ * A packet sent by a Brick link. Returns 0 if the link is not cabled to
+ * the router, so the caller delivers it as before.
+ */
+int GR718SIM_ReceivePacketLocked(const STAR_DEVICE_ID deviceId,
+    const U8 channelNumber, const U8 * const pData, const U32 length,
+    const STAR_EOP_TYPE eop)
+{
+    GR718SIM_ROUTER * const pRouter = GR718SIM_router(deviceId);
+
+    if ((pRouter == NULL) || (channelNumber == 0U) ||
+        (channelNumber > GR718SIM_BRICK_LINKS))
+    {
+        return 0;
+    }
+
+    GR718SIM_route(deviceId, pRouter, pData, length, eop, 0U,
+        GR718SIM_now());
+
+    return 1;
+}
+
+
+
+/* A time-code sent by a Brick link, see GR718SIM_ReceivePacketLocked() */
+int GR718SIM_ReceiveTimeCodeLocked(const STAR_DEVICE_ID deviceId,
+    const U8 channelNumber, const U8 value)
+{
+    GR718SIM_ROUTER * const pRouter = GR718SIM_router(deviceId);
+    U8 port;
+
+    if ((pRouter == NULL) || (channelNumber == 0U) ||
+        (channelNumber > GR718SIM_BRICK_LINKS))
+    {
+        return 0;
+    }
+
+    if ((value & 0x3FU) == ((pRouter->timeCode + 1U) & 0x3FU))
+    {
+        for (port = 1U; port < GR718SIM_PORT_COUNT; port++)
+        {
+            if (port == pRouter->linkPort[channelNumber])
+            {
+                continue;
+            }
+            if (pRouter->link[port] != 0U)
+            {
+                pRouter->stats[port].timeCodes++;
+                SIM_deliverTimeCodeLocked(deviceId, pRouter->link[port],
+                    value);
+            }
+            else if (pRouter->cable[port] != 0U)
+            {
+                pRouter->stats[port].timeCodes++;
+            }
+        }
+    }
+    pRouter->timeCode = value & 0x3FU;
+
+    return 1;
+}
+
+
+
+/**
+ * Statistics of a port of the router of a simulated device.
+ *
+ * @return 1 on success, 0 if the router is not enabled or the port does
+ *         not exist
+ */
+int GR718SIM_GetPortStatistics(const STAR_DEVICE_ID deviceId, const U8 port,
+    GR718SIM_PORT_STATS * const pStats)
+{
+    GR718SIM_ROUTER *pRouter;
+
+    SIM_Lock();
+    pRouter = GR718SIM_router(deviceId);
+    if ((pRouter == NULL) || (port >= GR718SIM_PORT_COUNT))
+    {
+        SIM_Unlock();
+        return 0;
+    }
+    *pStats = pRouter->stats[port];
+    pStats->rateMbps = GR718SIM_rate(pRouter, port);
+    SIM_Unlock();
+
+    return 1;
+}
+
+
+
+/* Packets discarded by the router: bad address, disabled route, bad RMAP */
+unsigned long long GR718SIM_GetDiscarded(const STAR_DEVICE_ID deviceId)
+{
+    GR718SIM_ROUTER *pRouter;
+    unsigned long long discarded = 0ULL;
+
+    SIM_Lock();
+    pRouter = GR718SIM_router(deviceId);
+    if (pRouter != NULL)
+    {
+        discarded = pRouter->discarded;
+    }
+    SIM_Unlock();
+
+    return discarded;
+}
+
+
+
+/* A register of the router, as an RMAP read would return it */
+U32 GR718SIM_GetRegister(const STAR_DEVICE_ID deviceId, const U32 address)
+{
+    GR718SIM_ROUTER *pRouter;
+    U32 value = 0U;
+
+    SIM_Lock();
+    pRouter = GR718SIM_router(deviceId);
+    if ((pRouter != NULL) && ((address / 4U) < GR718SIM_REGISTER_COUNT))
+    {
+        value = pRouter->registers[address / 4U];
+    }
+    SIM_Unlock();
+
+    return value;
+}
@@ -0,0 +1,113 @@
+/*
+  @file gr718_sim.h
+  @author Juan Manuel Gómez
+  @brief Software model of the GR718B router behind the simulated Bricks.
+  @details Part of the STAR-API stand-in (star_sim.h). When STAR_SIM_ROUTER
+           is set, links 1 and 2 of every simulated Brick are cabled to a
+           GR718B of its own instead of to each other, link 1 to port 2
+           and link 2 to port 1 as on the bench. The router lives as long
+           as the process, from its reset state:
+
+           - Packets are routed on their first byte. Path addresses 1-18
+             go to the ports of their RTPMAP entry and the address byte is
+             deleted; logical addresses 32-255 go to the lowest port of
+             their RTPMAP entry if their RTACTRL entry is enabled (bit 2),
+             and the address byte is deleted if header deletion (bit 0) is
+             set. Other packets are discarded and counted.
+           - Path address 0 is the configuration port: an RMAP target with
+             logical address 0xFE and key 0 answering writes and reads of
+             the 32-bit registers at 0x000-0xFFC. The reply is routed from
+             port 0 like any other packet. Every register holds what was
+             written to it; only the routing table and the link rate
+             divisor of the port control registers (bits 31:24) change
+             the behaviour of the model.
+           - Time-codes whose value is one more than the last one are
+             sent out of every other port.
+           - Each port transmits at its rate, 200 Mbit/s / (divisor + 1),
+             10 bits per character. A packet leaves a port once the ones
+             routed to it before have, and reaches a Brick link, or the
+             port cabled to it, when its last character is out; until
+             then the transmit operation that sent it does not complete.
+             The router stores and forwards whole packets, and the rate of
+             the Brick links into it is not modelled, so an output shared
+             by several inputs, or slower than them, sets the pace.
+
+           At reset path addresses n map to port n, and logical address
+           0xFE, the initiator address of the programs, maps to the port
+           of Brick link 1.
+
+           STAR_SIM_ROUTER is a comma separated list of:
+           Ln=p    Brick link n on router port p
+           a:b     router ports a and b cabled to each other (a:a loops a
+                   port back to itself)
+           p@mbps  link rate of port p, fixed whatever its divisor
+           Any other value, such as 1, just enables the router.
+           For example, la_routing routes its test packets to port 10:
+               STAR_SIM_ROUTER=L2=10 ./la_routing
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef GR718_SIM_H
+#define GR718_SIM_H
+
+#include "star-dundee_types.h"
+#include "star-api.h"
+
+#define GR718SIM_PORT_COUNT 19
+#define GR718SIM_REGISTER_COUNT 1024
+#define GR718SIM_LOGICAL_ADDRESS 0xFE
+#define GR718SIM_KEY 0x00
+
+typedef struct
+{
+    unsigned long long packets;     /* transmitted by the port */
+    unsigned long long bytes;
+    unsigned long long timeCodes;
+    unsigned long long dropped;     /* routed to a port with no link */
+    unsigned long long wireNs;      /* time to transmit them at the rate */
+    U32 rateMbps;
+} GR718SIM_PORT_STATS;
+
+int GR718SIM_Enabled(void);
+
+int GR718SIM_GetPortStatistics(const STAR_DEVICE_ID deviceId, const U8 port,
+    GR718SIM_PORT_STATS * const pStats);
+
+unsigned long long GR718SIM_GetDiscarded(const STAR_DEVICE_ID deviceId);
+
+U32 GR718SIM_GetRegister(const STAR_DEVICE_ID deviceId, const U32 address);
+
+
+/* Used by star_sim.c, with its lock held */
+void GR718SIM_Init(const U32 deviceCount);
+
+int GR718SIM_ReceivePacketLocked(const STAR_DEVICE_ID deviceId,
+    const U8 channelNumber, const U8 * const pData, const U32 length,
+    const STAR_EOP_TYPE eop);
+
+int GR718SIM_ReceiveTimeCodeLocked(const STAR_DEVICE_ID deviceId,
+    const U8 channelNumber, const U8 value);
+
+U32 GR718SIM_DetachSenderLocked(const void * const pSender);
+
+/* Provided by star_sim.c */
+void SIM_Lock(void);
+
+void SIM_Unlock(void);
+
+void SIM_deliverPacketLocked(const STAR_DEVICE_ID deviceId,
+    const U8 channelNumber, const U8 * const pData, const U32 length,
+    const STAR_EOP_TYPE eop, void * const pSender);
+
+void *SIM_holdSenderLocked(void);
+
+void SIM_releaseSenderLocked(void * const pSender);
+
+void SIM_waitLocked(const unsigned long long untilNs);
+
+void SIM_wakeLocked(void);
+
+void SIM_deliverTimeCodeLocked(const STAR_DEVICE_ID deviceId,
+    const U8 channelNumber, const U8 value);
+
+#endif
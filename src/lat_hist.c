@@ -0,0 +1,179 @@
+/*
+  @file lat_hist.c
+  @author Juan Manuel Gómez
+  @brief Lock-free latency histogram with a bounded relative error.
+  @details See lat_hist.h.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <string.h>
+
+#include "lat_hist.h"
+
+#define LATHIST_SUB_COUNT (1U << LATHIST_SUB_BITS)
+#define LATHIST_HALF_COUNT (1U << (LATHIST_SUB_BITS - 1))
+
+
+static unsigned int LATHIST_index(unsigned long long valueNs)
+{
+    unsigned int msb, shift;
+
+    if (valueNs < LATHIST_SUB_COUNT)
+    {
+        return (unsigned int)valueNs;
+    }
+    if (valueNs > LATHIST_MAX_NS)
+    {
+        valueNs = LATHIST_MAX_NS;
+    }
+
+    msb = 63U - (unsigned int)__builtin_clzll(valueNs);
+    shift = msb - (LATHIST_SUB_BITS - 1U);
+    return (shift * LATHIST_HALF_COUNT) + (unsigned int)(valueNs >> shift);
+}
+
+
+/* Highest value counted in a bucket */
+static unsigned long long LATHIST_highest(const unsigned int index)
+{
+    unsigned int shift;
+    unsigned long long sub;
+
+    if (index < LATHIST_SUB_COUNT)
+    {
+        return index;
+    }
+
+    shift = (index / LATHIST_HALF_COUNT) - 1U;
+    sub = index - (shift * LATHIST_HALF_COUNT);
+    return ((sub + 1ULL) << shift) - 1ULL;
+}
+
+
+
+void LATHIST_Reset(LATHIST * const pHist)
+{
+    memset(pHist, 0, sizeof(LATHIST));
+}
+
+
+
+/**
+ * Count a value. Safe to call from several threads at once.
+ *
+ * @param pHist the histogram
+ * @param valueNs the value, in nanoseconds
+ */
+void LATHIST_Record(LATHIST * const pHist, const unsigned long long valueNs)
+{
+    unsigned long long seen;
+
+    __atomic_fetch_add(&pHist->counts[LATHIST_index(valueNs)], 1ULL,
+        __ATOMIC_RELAXED);
+    __atomic_fetch_add(&pHist->sumNs, valueNs, __ATOMIC_RELAXED);
+
+    seen = __atomic_load_n(&pHist->minNs, __ATOMIC_RELAXED);
+    while ((~valueNs > seen) &&
+        !__atomic_compare_exchange_n(&pHist->minNs, &seen, ~valueNs, 1,
+            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+    seen = __atomic_load_n(&pHist->maxNs, __ATOMIC_RELAXED);
+    while ((valueNs > seen) &&
+        !__atomic_compare_exchange_n(&pHist->maxNs, &seen, valueNs, 1,
+            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+
+    /* Last, so that a reader never sees more values than buckets hold */
+    __atomic_fetch_add(&pHist->count, 1ULL, __ATOMIC_RELEASE);
+}
+
+
+
+unsigned long long LATHIST_Count(const LATHIST * const pHist)
+{
+    return __atomic_load_n(&pHist->count, __ATOMIC_ACQUIRE);
+}
+
+
+
+/**
+ * Value below which a fraction of the values counted lie.
+ *
+ * @param pHist the histogram
+ * @param fraction 0.5 for the median, 0.99 for the 99th percentile...
+ *
+ * @return the highest value of the bucket of the percentile, never more
+ *         than the maximum; 0 if the histogram is empty
+ */
+unsigned long long LATHIST_Percentile(const LATHIST * const pHist,
+    const double fraction)
+{
+    unsigned long long count, rank, seen = 0ULL, highest, maxNs;
+    unsigned int i;
+
+    count = LATHIST_Count(pHist);
+    if (count == 0ULL)
+    {
+        return 0ULL;
+    }
+
+    rank = (unsigned long long)((fraction * (double)count) + 0.999999);
+    if (rank < 1ULL)
+    {
+        rank = 1ULL;
+    }
+    if (rank > count)
+    {
+        rank = count;
+    }
+
+    maxNs = __atomic_load_n(&pHist->maxNs, __ATOMIC_RELAXED);
+    for (i = 0U; i < LATHIST_BUCKETS; i++)
+    {
+        seen += __atomic_load_n(&pHist->counts[i], __ATOMIC_RELAXED);
+        if (seen >= rank)
+        {
+            highest = LATHIST_highest(i);
+            return (highest < maxNs) ? highest : maxNs;
+        }
+    }
+
+    return maxNs;
+}
+
+
+
+/* Column titles of LATHIST_Print(), all times in microseconds */
+void LATHIST_PrintHeader(FILE * const pFile, const char * const pTitle)
+{
+    fprintf(pFile, "%-32s %10s %10s %10s %10s %10s %10s %10s %10s\n",
+        pTitle, "count", "min us", "mean us", "p50 us", "p90 us", "p99 us",
+        "p999 us", "max us");
+}
+
+
+
+void LATHIST_Print(FILE * const pFile, const LATHIST * const pHist,
+    const char * const pName)
+{
+    unsigned long long count = LATHIST_Count(pHist);
+
+    if (count == 0ULL)
+    {
+        fprintf(pFile, "%-32s %10llu\n", pName, count);
+        return;
+    }
+
+    fprintf(pFile, "%-32s %10llu %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f "
+        "%10.2f\n", pName, count,
+        (~__atomic_load_n(&pHist->minNs, __ATOMIC_RELAXED)) / 1e3,
+        (__atomic_load_n(&pHist->sumNs, __ATOMIC_RELAXED) / (double)count) /
+            1e3,
+        LATHIST_Percentile(pHist, 0.50) / 1e3,
+        LATHIST_Percentile(pHist, 0.90) / 1e3,
+        LATHIST_Percentile(pHist, 0.99) / 1e3,
+        LATHIST_Percentile(pHist, 0.999) / 1e3,
+        __atomic_load_n(&pHist->maxNs, __ATOMIC_RELAXED) / 1e3);
+}
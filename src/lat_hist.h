@@ -0,0 +1,53 @@
+/*
+  @file lat_hist.h
+  @author Juan Manuel Gómez
+  @brief Lock-free latency histogram with a bounded relative error.
+  @details Values in nanoseconds are counted in log-linear buckets, in the
+           manner of an HDR histogram: below 2^LATHIST_SUB_BITS every value
+           has a bucket of its own, above it every power of two is split
+           in 2^(LATHIST_SUB_BITS - 1) buckets. A percentile is thus known
+           within 1/2^(LATHIST_SUB_BITS - 1) of its value, about 3 %, for
+           any value up to LATHIST_MAX_NS; larger values are counted in
+           the last bucket, and the exact minimum and maximum are kept.
+
+           LATHIST_Record() only uses relaxed atomic operations, so any
+           number of threads may record in the same histogram while
+           another one reads it. A zeroed histogram is empty.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef LAT_HIST_H
+#define LAT_HIST_H
+
+#include <stdio.h>
+
+#define LATHIST_SUB_BITS 6
+#define LATHIST_MAX_BITS 40                  /* ~1100 s */
+#define LATHIST_MAX_NS ((1ULL << LATHIST_MAX_BITS) - 1ULL)
+#define LATHIST_BUCKETS (((LATHIST_MAX_BITS - LATHIST_SUB_BITS + 1) << \
+    (LATHIST_SUB_BITS - 1)) + (1 << (LATHIST_SUB_BITS - 1)))
+
+typedef struct
+{
+    unsigned long long counts[LATHIST_BUCKETS];
+    unsigned long long count;
+    unsigned long long sumNs;
+    unsigned long long minNs;      /* one's complement, so that 0 is empty */
+    unsigned long long maxNs;
+} LATHIST;
+
+void LATHIST_Reset(LATHIST * const pHist);
+
+void LATHIST_Record(LATHIST * const pHist, const unsigned long long valueNs);
+
+unsigned long long LATHIST_Count(const LATHIST * const pHist);
+
+unsigned long long LATHIST_Percentile(const LATHIST * const pHist,
+    const double fraction);
+
+void LATHIST_PrintHeader(FILE * const pFile, const char * const pTitle);
+
+void LATHIST_Print(FILE * const pFile, const LATHIST * const pHist,
+    const char * const pName);
+
+#endif
@@ -0,0 +1,362 @@
+/*
+  @file multi_dev.c
+  @author Juan Manuel Gómez
+  @brief Run a test job on every STAR device at once.
+  @details Takes every device that can transmit and receive and runs the
+  job on one worker thread per device and channel (see dev_manager.h),
+  then prints one report for all of them.
+  Jobs:
+    loopback  sends -n packets of -s bytes in batches of -b from the
+              channel of the worker to the next one (1 to 2, 3 to 4) and
+              checks them. The first byte of every packet is the logical
+              address -a, so the GR718 routes it back.
+    audit     reads the register space of the GR718 on the channel
+              (stipa -a) into <prefix>-<device>-<channel>.snap, -f prefix.
+    config    brings the GR718 on the channel to the configuration file
+              -f (rtr_apply).
+  @param -j job, -c channels (1,3), -n packets, -s packet size, -b batch,
+  -a logical address, -f file, -p pin the workers to CPUs.
+  @example ./multi_dev -j loopback -n 10000 -s 1024 -p ; ./multi_dev -j config -f la_routing.cfg
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "system_config.h"
+#include "utility.h"
+#include "star-dundee_types.h"
+#include "star-api.h"
+#include "dev_manager.h"
+#include "rx_view.h"
+#include "rmap_engine.h"
+#include "rtr_config.h"
+#include "rtr_snapshot.h"
+
+#define VERSION_INFO "Multi Device v1.0"
+
+#define _TIMEOUT 5000
+#define _ENGINE_WINDOW 64
+
+typedef struct{
+  unsigned long packetCount;
+  U32 packetSize;
+  U32 batch;
+  U8 address;
+  const char *fname;
+  RTRCFG config;
+} JOB_ARGS;
+
+int loopbackJob(DEVMGR_WORKER * const pWorker, void * const pArgument);
+int auditJob(DEVMGR_WORKER * const pWorker, void * const pArgument);
+int configJob(DEVMGR_WORKER * const pWorker, void * const pArgument);
+
+
+int __cdecl  main(int argc, char * argv[]){
+  DEVMGR manager;
+  DEVMGR_JOB job = loopbackJob;
+  JOB_ARGS args;
+  STAR_CHANNEL_MASK channels = 0;
+  const char *pChannel;
+  char *pEnd;
+  unsigned int failed;
+  int opt, pin = 0;
+
+  memset(&args, 0, sizeof(args));
+  args.packetCount = 1000;
+  args.packetSize = 64;
+  args.batch = 16;
+  args.address = 0x20;
+
+  while ((opt = getopt(argc, argv, "j:c:n:s:b:a:f:p")) != -1){
+    switch (opt){
+    case 'j':
+      if (strcmp(optarg, "loopback") == 0)
+        job = loopbackJob;
+      else if (strcmp(optarg, "audit") == 0)
+        job = auditJob;
+      else if (strcmp(optarg, "config") == 0)
+        job = configJob;
+      else{
+        printf("Unknown job %s.\n", optarg);
+        return 1;
+      }
+      break;
+    case 'c':
+      for (pChannel = optarg; *pChannel != '\0'; pChannel = pEnd){
+        unsigned long channel = strtoul(pChannel, &pEnd, 0);
+        if (pEnd == pChannel || channel < 1 || channel > 31){
+          printf("Invalid channel list %s.\n", optarg);
+          return 1;
+        }
+        channels |= 1U << channel;
+        if (*pEnd == ',')
+          pEnd++;
+      }
+      break;
+    case 'n':
+      args.packetCount = strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      args.packetSize = strtoul(optarg, NULL, 0);
+      break;
+    case 'b':
+      args.batch = strtoul(optarg, NULL, 0);
+      break;
+    case 'a':
+      args.address = (U8) strtoul(optarg, NULL, 0);
+      break;
+    case 'f':
+      args.fname = optarg;
+      break;
+    case 'p':
+      pin = 1;
+      break;
+    default:
+      printf("Usage: %s [-j loopback|audit|config] [-c channels] [-n packets]"
+             " [-s size] [-b batch] [-a address] [-f file] [-p]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (channels == 0)
+    channels = 1U << 1;
+  if (args.packetSize < 1 || args.batch < 1){
+    puts("Error: The packet size and the batch must be at least 1.");
+    return 1;
+  }
+  if (job != loopbackJob && args.fname == NULL){
+    puts("Error: The audit and config jobs need -f.");
+    return 1;
+  }
+  if (job == configJob && !RTRCFG_Load(&args.config, args.fname)){
+    return 1;
+  }
+
+  if (DEVMGR_Open(&manager, STAR_DEVICE_TXRX_SUPPORTED, channels, pin) == 0){
+    puts("Error: No compatible device found.");
+    RTRCFG_Free(&args.config);
+    return 1;
+  }
+  printf("%u devices, %u workers.\n", manager.deviceCount,
+         manager.workerCount);
+
+  failed = DEVMGR_Run(&manager, job, &args);
+  DEVMGR_PrintReport(&manager);
+
+  DEVMGR_Close(&manager);
+  RTRCFG_Free(&args.config);
+
+  return failed != 0;
+}
+
+
+//Packets from the channel of the worker to the next one, checked.
+int loopbackJob(DEVMGR_WORKER * const pWorker, void * const pArgument){
+  const JOB_ARGS *pArgs = (const JOB_ARGS *) pArgument;
+  STAR_CHANNEL_ID txChannelId, rxChannelId;
+  STAR_TRANSFER_OPERATION *pTxOp, *pRxOp;
+  STAR_STREAM_ITEM **vItems;
+  RXVIEW rxView;
+  const U8 *pRxData;
+  U8 *pTxBuffer;
+  U32 i, count, rxCount, rxLength;
+  unsigned long sent = 0;
+  int status = 0;
+
+  txChannelId = STAR_openChannelToLocalDevice(pWorker->deviceId, STAR_CHANNEL_DIRECTION_OUT,
+                                              pWorker->channelNumber, TRUE);
+  rxChannelId = STAR_openChannelToLocalDevice(pWorker->deviceId, STAR_CHANNEL_DIRECTION_IN,
+                                              pWorker->channelNumber + 1, TRUE);
+  pTxBuffer = malloc((size_t) pArgs->batch * pArgs->packetSize);
+  vItems = calloc(pArgs->batch, sizeof(STAR_STREAM_ITEM *));
+  if (txChannelId == 0 || rxChannelId == 0 || !pTxBuffer || !vItems){
+    snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH,
+             "Unable to open channels %u and %u", pWorker->channelNumber,
+             pWorker->channelNumber + 1);
+    status = 1;
+  }
+
+  //Every worker has its own pattern, so crossed links are detected.
+  for (i = 0; !status && i < pArgs->batch * pArgs->packetSize; ++i)
+    pTxBuffer[i] = (U8) (i + pWorker->deviceIndex * 31 + pWorker->channelNumber * 7);
+  for (i = 0; !status && i < pArgs->batch; ++i)
+    pTxBuffer[(size_t) i * pArgs->packetSize] = pArgs->address;
+
+  RXVIEW_Init(&rxView);
+  while (!status && sent < pArgs->packetCount){
+    count = pArgs->packetCount - sent < pArgs->batch ?
+      (U32) (pArgs->packetCount - sent) : pArgs->batch;
+
+    for (i = 0; i < count; ++i)
+      vItems[i] = STAR_createPacket(NULL, pTxBuffer + (size_t) i * pArgs->packetSize,
+                                    pArgs->packetSize, STAR_EOP_TYPE_EOP);
+    pRxOp = STAR_createRxOperation(count, STAR_RECEIVE_PACKETS);
+    pTxOp = STAR_createTxOperation(vItems, count);
+
+    //Receive posted first, so no packet finds the channel without a buffer.
+    if (!pRxOp || !pTxOp ||
+        !STAR_submitTransferOperation(rxChannelId, pRxOp) ||
+        !STAR_submitTransferOperation(txChannelId, pTxOp) ||
+        STAR_waitOnTransferOperationCompletion(pTxOp, _TIMEOUT) != STAR_TRANSFER_STATUS_COMPLETE ||
+        STAR_waitOnTransferOperationCompletion(pRxOp, _TIMEOUT) != STAR_TRANSFER_STATUS_COMPLETE){
+      snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH,
+               "Transfer failed after %lu packets", sent);
+      pWorker->errors += count;
+      status = 1;
+    }
+    else{
+      rxCount = RXVIEW_Map(&rxView, pRxOp);
+      if (rxCount != count)
+        pWorker->errors += count;
+      for (i = 0; i < rxCount && rxCount == count; ++i){
+        pRxData = RXVIEW_Packet(&rxView, i, &rxLength);
+        if (pRxData == NULL || rxLength != pArgs->packetSize ||
+            memcmp(pRxData, pTxBuffer + (size_t) i * pArgs->packetSize, rxLength) != 0)
+          pWorker->errors++;
+        else{
+          pWorker->packets++;
+          pWorker->bytes += rxLength;
+        }
+      }
+      RXVIEW_Release(&rxView);
+    }
+
+    if (pRxOp){
+      if (status)
+        STAR_cancelTransferOperation(pRxOp);
+      STAR_disposeTransferOperation(pRxOp);
+    }
+    if (pTxOp)
+      STAR_disposeTransferOperation(pTxOp);
+    for (i = 0; i < count; ++i)
+      STAR_destroyStreamItem(vItems[i]);
+    sent += count;
+  }
+  RXVIEW_Free(&rxView);
+
+  if (!status){
+    status = pWorker->errors != 0;
+    snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH, "%lu packets of %u B",
+             sent, pArgs->packetSize);
+  }
+
+  if (txChannelId != 0)
+    STAR_closeChannel(txChannelId);
+  if (rxChannelId != 0)
+    STAR_closeChannel(rxChannelId);
+  free(pTxBuffer);
+  free(vItems);
+  return status;
+}
+
+
+//Engine on the channel of the worker, replies on the same channel.
+static STAR_CHANNEL_ID openEngine(DEVMGR_WORKER * const pWorker,
+                                  RMAPENG * const pEngine){
+  U8 pTarget[]= {0,254};
+  U8 pReply[] = {254};
+  STAR_CHANNEL_ID channelId;
+
+  channelId = STAR_openChannelToLocalDevice(pWorker->deviceId, STAR_CHANNEL_DIRECTION_INOUT,
+                                            pWorker->channelNumber, TRUE);
+  if (channelId == 0){
+    snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH,
+             "Unable to open channel %u", pWorker->channelNumber);
+    return 0;
+  }
+
+  if (!RMAPENG_Init(pEngine, channelId, channelId, pTarget, sizeof(pTarget),
+                    pReply, sizeof(pReply))){
+    snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH,
+             "Unable to start the RMAP engine");
+    STAR_closeChannel(channelId);
+    return 0;
+  }
+  pEngine->window = _ENGINE_WINDOW;
+
+  return channelId;
+}
+
+
+//Register snapshot of the router on the channel of the worker.
+int auditJob(DEVMGR_WORKER * const pWorker, void * const pArgument){
+  const JOB_ARGS *pArgs = (const JOB_ARGS *) pArgument;
+  uint32_t readCount = RTRSNAP_RegisterCount();
+  RMAPENG_ACCESS *vReads;
+  RMAPENG engine;
+  STAR_CHANNEL_ID channelId;
+  unsigned long long startNs, timeNs;
+  char fname[256];
+
+  channelId = openEngine(pWorker, &engine);
+  if (channelId == 0)
+    return 1;
+
+  vReads = malloc(readCount * sizeof(RMAPENG_ACCESS));
+  if (!vReads){
+    snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH, "Out of memory");
+    STAR_closeChannel(channelId);
+    return 1;
+  }
+
+  RTRSNAP_SetReads(vReads);
+  timeNs = RealTimeNs();
+  startNs = MonotonicTimeNs();
+  pWorker->errors = RMAPENG_Transfer(&engine, vReads, readCount);
+  pWorker->packets = readCount - pWorker->errors;
+  pWorker->bytes = pWorker->packets * 4;
+
+  snprintf(fname, sizeof(fname), "%s-%u-%u.snap", pArgs->fname,
+           pWorker->deviceIndex, pWorker->channelNumber);
+  if (!RTRSNAP_Save(fname, vReads, readCount, timeNs, MonotonicTimeNs() - startNs))
+    snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH, "Unable to write %.100s", fname);
+  else
+    snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH, "%u registers to %.100s",
+             readCount, fname);
+
+  free(vReads);
+  STAR_closeChannel(channelId);
+  return pWorker->errors != 0;
+}
+
+
+//Bring the router on the channel of the worker to the configuration.
+int configJob(DEVMGR_WORKER * const pWorker, void * const pArgument){
+  const JOB_ARGS *pArgs = (const JOB_ARGS *) pArgument;
+  const RTRCFG *pConfig = &pArgs->config;
+  RMAPENG_ACCESS *vReads, *vWrites;
+  RMAPENG engine;
+  STAR_CHANNEL_ID channelId;
+  uint32_t writeCount = 0;
+  unsigned long unread;
+
+  channelId = openEngine(pWorker, &engine);
+  if (channelId == 0)
+    return 1;
+
+  vReads = malloc((pConfig->count + 1) * sizeof(RMAPENG_ACCESS));
+  vWrites = malloc((pConfig->count + 1) * sizeof(RMAPENG_ACCESS));
+  if (!vReads || !vWrites){
+    snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH, "Out of memory");
+    pWorker->errors = 1;
+  }
+  else{
+    RTRCFG_SetReads(pConfig, vReads);
+    unread = RMAPENG_Transfer(&engine, vReads, pConfig->count);
+    writeCount = RTRCFG_SetWrites(pConfig, vReads, vWrites);
+    pWorker->errors = RMAPENG_Transfer(&engine, vWrites, writeCount);
+    pWorker->packets = pConfig->count + writeCount;
+    pWorker->bytes = pWorker->packets * 4;
+    snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH,
+             "%u of %u registers written (%lu unread)", writeCount,
+             pConfig->count, unread);
+  }
+
+  free(vReads);
+  free(vWrites);
+  STAR_closeChannel(channelId);
+  return pWorker->errors != 0;
+}
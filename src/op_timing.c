@@ -0,0 +1,334 @@
+/*
+  @file op_timing.c
+  @author Juan Manuel Gómez
+  @brief Submit, complete and consume times of the transfer operations.
+  @details See op_timing.h.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include "op_timing.h"
+#include "utility.h"
+
+static OPTIME_CHANNEL optimeChannels[OPTIME_MAX_CHANNELS];
+static int optimeEnabled;
+static volatile sig_atomic_t optimeDumpRequested;
+
+
+#define OPTIME_KEY(channelId, direction) \
+    ((1ULL << 63) | ((unsigned long long)(channelId) << 1) | \
+    (unsigned long long)((direction) != OPTIME_TX))
+
+
+/* The entry of a channel and direction, taken on first use; NULL if the
+ * table is full */
+static OPTIME_CHANNEL *OPTIME_channel(const STAR_CHANNEL_ID channelId,
+    const int direction)
+{
+    const unsigned long long key = OPTIME_KEY(channelId, direction);
+    unsigned long long seen;
+    unsigned int i;
+
+    for (i = 0U; i < OPTIME_MAX_CHANNELS; i++)
+    {
+        seen = __atomic_load_n(&optimeChannels[i].key, __ATOMIC_ACQUIRE);
+        if ((seen == 0ULL) &&
+            !__atomic_compare_exchange_n(&optimeChannels[i].key, &seen, key,
+                0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            /* Taken meanwhile, seen holds the key of the one that took it */
+        }
+        if ((seen == 0ULL) || (seen == key))
+        {
+            return &optimeChannels[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+/* Dump asked for with SIGUSR1, from a thread that is not in a handler */
+static void OPTIME_poll(void)
+{
+    if (optimeDumpRequested)
+    {
+        optimeDumpRequested = 0;
+        OPTIME_Dump(stdout);
+    }
+}
+
+
+static void OPTIME_requestDump(int signalNumber)
+{
+    (void)signalNumber;
+    optimeDumpRequested = 1;
+}
+
+
+static void OPTIME_atExit(void)
+{
+    OPTIME_Dump(stdout);
+}
+
+
+
+/**
+ * Start stamping the operations. The histograms are printed at exit and
+ * when the process receives SIGUSR1.
+ */
+void OPTIME_Enable(void)
+{
+    struct sigaction action;
+
+    if (optimeEnabled)
+    {
+        return;
+    }
+    optimeEnabled = 1;
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = OPTIME_requestDump;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, NULL);
+
+    atexit(OPTIME_atExit);
+}
+
+
+
+int OPTIME_Enabled(void)
+{
+    return optimeEnabled;
+}
+
+
+
+/**
+ * Name a channel in the dump, "channel <id>" otherwise.
+ */
+void OPTIME_Label(const STAR_CHANNEL_ID channelId, const char * const pLabel)
+{
+    OPTIME_CHANNEL *pChannel;
+    int direction;
+
+    for (direction = OPTIME_TX; direction <= OPTIME_RX; direction++)
+    {
+        pChannel = OPTIME_channel(channelId, direction);
+        if (pChannel != NULL)
+        {
+            snprintf(pChannel->label, OPTIME_LABEL_LENGTH, "%s", pLabel);
+        }
+    }
+}
+
+
+
+/**
+ * Stamp an operation and submit it.
+ *
+ * @param pStamp the stamps of the operation
+ * @param channelId the channel to submit the operation to
+ * @param direction OPTIME_TX or OPTIME_RX, the kind of operation
+ * @param pOp the operation
+ *
+ * @return the result of STAR_submitTransferOperation()
+ */
+int OPTIME_Submit(OPTIME_STAMP * const pStamp,
+    const STAR_CHANNEL_ID channelId, const int direction,
+    STAR_TRANSFER_OPERATION * const pOp)
+{
+    OPTIME_CHANNEL *pChannel;
+    int submitted;
+
+    if (!optimeEnabled)
+    {
+        return STAR_submitTransferOperation(channelId, pOp);
+    }
+
+    OPTIME_poll();
+    pStamp->channelId = channelId;
+    pStamp->direction = direction;
+    pStamp->completeNs = 0ULL;
+    pStamp->consumeNs = 0ULL;
+    pStamp->submitNs = MonotonicTimeNs();
+    submitted = STAR_submitTransferOperation(channelId, pOp);
+    if (!submitted)
+    {
+        pStamp->submitNs = 0ULL;
+        pChannel = OPTIME_channel(channelId, direction);
+        if (pChannel != NULL)
+        {
+            __atomic_fetch_add(&pChannel->failures, 1ULL, __ATOMIC_RELAXED);
+        }
+    }
+
+    return submitted;
+}
+
+
+
+/**
+ * Wait for an operation stamped by OPTIME_Submit() and stamp its
+ * completion. While enabled, a wait longer than OPTIME_POLL_MS is split in
+ * slices so that a dump asked for meanwhile is printed.
+ *
+ * @return the result of STAR_waitOnTransferOperationCompletion()
+ */
+STAR_TRANSFER_STATUS OPTIME_Wait(OPTIME_STAMP * const pStamp,
+    STAR_TRANSFER_OPERATION * const pOp, const int timeout)
+{
+    OPTIME_CHANNEL *pChannel;
+    STAR_TRANSFER_STATUS status;
+    int remaining = timeout, slice;
+
+    if (!optimeEnabled || (pStamp->submitNs == 0ULL))
+    {
+        return STAR_waitOnTransferOperationCompletion(pOp, timeout);
+    }
+
+    do
+    {
+        slice = ((remaining < 0) || (remaining > OPTIME_POLL_MS)) ?
+            OPTIME_POLL_MS : remaining;
+        status = STAR_waitOnTransferOperationCompletion(pOp, slice);
+        if (remaining > 0)
+        {
+            remaining -= slice;
+        }
+        OPTIME_poll();
+    }
+    while ((status == STAR_TRANSFER_STATUS_STARTED) && (remaining != 0));
+
+    if (status == STAR_TRANSFER_STATUS_COMPLETE)
+    {
+        OPTIME_Complete(pStamp);
+    }
+    else if ((pChannel = OPTIME_channel(pStamp->channelId,
+        pStamp->direction)) != NULL)
+    {
+        __atomic_fetch_add((status == STAR_TRANSFER_STATUS_STARTED) ?
+            &pChannel->timeouts : &pChannel->failures, 1ULL,
+            __ATOMIC_RELAXED);
+    }
+
+    return status;
+}
+
+
+
+/**
+ * Stamp the completion of an operation found complete without waiting,
+ * with STAR_getTransferStatus() for instance. Only the first completion
+ * after a submission is counted.
+ */
+void OPTIME_Complete(OPTIME_STAMP * const pStamp)
+{
+    OPTIME_CHANNEL *pChannel;
+
+    if (!optimeEnabled || (pStamp->submitNs == 0ULL) ||
+        (pStamp->completeNs != 0ULL))
+    {
+        return;
+    }
+
+    pStamp->completeNs = MonotonicTimeNs();
+    pChannel = OPTIME_channel(pStamp->channelId, pStamp->direction);
+    if (pChannel != NULL)
+    {
+        LATHIST_Record(&pChannel->complete,
+            pStamp->completeNs - pStamp->submitNs);
+    }
+}
+
+
+
+/**
+ * Stamp the end of the processing of a completed operation.
+ */
+void OPTIME_Consumed(OPTIME_STAMP * const pStamp)
+{
+    OPTIME_CHANNEL *pChannel;
+
+    if (!optimeEnabled || (pStamp->completeNs == 0ULL) ||
+        (pStamp->consumeNs != 0ULL))
+    {
+        return;
+    }
+
+    pStamp->consumeNs = MonotonicTimeNs();
+    pChannel = OPTIME_channel(pStamp->channelId, pStamp->direction);
+    if (pChannel != NULL)
+    {
+        LATHIST_Record(&pChannel->consume,
+            pStamp->consumeNs - pStamp->completeNs);
+    }
+    OPTIME_poll();
+}
+
+
+
+/* Two lines per channel and direction used, then its failures and
+ * timeouts if any */
+void OPTIME_Dump(FILE * const pFile)
+{
+    const OPTIME_CHANNEL *pChannel;
+    char name[OPTIME_LABEL_LENGTH + 32];
+    unsigned long long key, failures, timeouts;
+    const char *pDirection;
+    unsigned int i;
+
+    if (!optimeEnabled)
+    {
+        return;
+    }
+
+    fprintf(pFile, "\n");
+    LATHIST_PrintHeader(pFile, "Operation timing");
+    for (i = 0U; i < OPTIME_MAX_CHANNELS; i++)
+    {
+        pChannel = &optimeChannels[i];
+        key = __atomic_load_n(&pChannel->key, __ATOMIC_ACQUIRE);
+        if (key == 0ULL)
+        {
+            break;
+        }
+
+        failures = __atomic_load_n(&pChannel->failures, __ATOMIC_RELAXED);
+        timeouts = __atomic_load_n(&pChannel->timeouts, __ATOMIC_RELAXED);
+        if ((LATHIST_Count(&pChannel->complete) == 0ULL) &&
+            (failures == 0ULL) && (timeouts == 0ULL))
+        {
+            continue;
+        }
+
+        pDirection = (key & 1ULL) ? "rx" : "tx";
+        if (pChannel->label[0] != '\0')
+        {
+            snprintf(name, sizeof(name), "%s %s submit->complete",
+                pChannel->label, pDirection);
+        }
+        else
+        {
+            snprintf(name, sizeof(name), "channel %u %s submit->complete",
+                (unsigned int)((key >> 1) & 0xFFFFFFFFULL), pDirection);
+        }
+        LATHIST_Print(pFile, &pChannel->complete, name);
+        if (key & 1ULL)
+        {
+            LATHIST_Print(pFile, &pChannel->consume, "  complete->consume");
+        }
+
+        if ((failures != 0ULL) || (timeouts != 0ULL))
+        {
+            fprintf(pFile, "  %llu failed, %llu timed out\n", failures,
+                timeouts);
+        }
+    }
+    fflush(pFile);
+}
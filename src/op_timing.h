@@ -0,0 +1,89 @@
+/*
+  @file op_timing.h
+  @author Juan Manuel Gómez
+  @brief Submit, complete and consume times of the transfer operations.
+  @details STAR_waitOnTransferOperationCompletion() only says whether an
+           operation completed. The timing layer stamps each operation
+           with the monotonic clock when it is submitted, when it is seen
+           complete and when its data has been consumed, and counts the
+           two intervals in latency histograms (lat_hist.h) per channel
+           and direction:
+
+           submit->complete   time on the link: for a receive operation
+                              posted in advance it includes the time the
+                              channel waited for traffic, so a link that
+                              stalls shows up in its tail
+           complete->consume  time the consumer took to process the
+                              operation and give it back
+
+           Operations that fail, and waits that time out, are counted with
+           them.
+
+           The layer does nothing until OPTIME_Enable() is called. Once
+           enabled, the histograms can be printed at any time with
+           OPTIME_Dump(), are printed at exit, and are printed on demand
+           when the process receives SIGUSR1 (by the next thread to stamp
+           or wait for an operation, not by the signal handler; long waits
+           are split in slices of OPTIME_POLL_MS for that). Recording is
+           lock-free, so any thread may stamp operations.
+
+           The stamps of an operation live in an OPTIME_STAMP kept by the
+           code that owns the operation, next to it.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef OP_TIMING_H
+#define OP_TIMING_H
+
+#include <stdio.h>
+#include "star-dundee_types.h"
+#include "star-api.h"
+#include "lat_hist.h"
+
+#define OPTIME_MAX_CHANNELS 16
+#define OPTIME_LABEL_LENGTH 24
+#define OPTIME_POLL_MS 200
+
+/* Direction of an operation */
+#define OPTIME_TX 0
+#define OPTIME_RX 1
+
+typedef struct
+{
+    STAR_CHANNEL_ID channelId;
+    int direction;
+    unsigned long long submitNs;
+    unsigned long long completeNs;
+    unsigned long long consumeNs;
+} OPTIME_STAMP;
+
+typedef struct
+{
+    unsigned long long key;        /* channel and direction, 0 if free */
+    char label[OPTIME_LABEL_LENGTH];
+    unsigned long long failures;
+    unsigned long long timeouts;
+    LATHIST complete;              /* submit->complete */
+    LATHIST consume;               /* complete->consume */
+} OPTIME_CHANNEL;
+
+void OPTIME_Enable(void);
+
+int OPTIME_Enabled(void);
+
+void OPTIME_Label(const STAR_CHANNEL_ID channelId, const char * const pLabel);
+
+int OPTIME_Submit(OPTIME_STAMP * const pStamp,
+    const STAR_CHANNEL_ID channelId, const int direction,
+    STAR_TRANSFER_OPERATION * const pOp);
+
+STAR_TRANSFER_STATUS OPTIME_Wait(OPTIME_STAMP * const pStamp,
+    STAR_TRANSFER_OPERATION * const pOp, const int timeout);
+
+void OPTIME_Complete(OPTIME_STAMP * const pStamp);
+
+void OPTIME_Consumed(OPTIME_STAMP * const pStamp);
+
+void OPTIME_Dump(FILE * const pFile);
+
+#endif
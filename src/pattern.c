@@ -0,0 +1,221 @@
+/*
+  @file pattern.c
+  @author Juan Manuel Gómez
+  @brief Seedable payload generator for the test packets.
+  @details See pattern.h.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <string.h>
+
+#include "pattern.h"
+
+/* Bytes made again at once by PATGEN_CheckPacket(), a multiple of 8 */
+#define PATGEN_CHECK_CHUNK 512U
+
+
+static uint64_t PATGEN_rotl(const uint64_t x, const int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+
+static uint64_t PATGEN_splitmix64(uint64_t * const pState)
+{
+    uint64_t z = (*pState += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+
+/* Fill with a pattern, the count patterns starting at `start` */
+static void PATGEN_fill(PATGEN * const pGenerator, U8 * const pBuffer,
+    const unsigned long size, const int dataType, const uint64_t start)
+{
+    const U8 first = (U8)start;
+    uint64_t word;
+    unsigned long n;
+
+    switch (dataType)
+    {
+    case DATA_TYPE_0:
+        memset(pBuffer, 0, size);
+        break;
+
+    case DATA_TYPE_1:
+        memset(pBuffer, 1, size);
+        break;
+
+    case DATA_TYPE_RANDOM:
+        for (n = 0U; n + 8U <= size; n += 8U)
+        {
+            word = PATGEN_Next(pGenerator);
+            memcpy(pBuffer + n, &word, 8U);
+        }
+        if (n < size)
+        {
+            word = PATGEN_Next(pGenerator);
+            memcpy(pBuffer + n, &word, size - n);
+        }
+        break;
+
+    case DATA_TYPE_COUNT:
+        for (n = 0U; n < size; n++)
+        {
+            pBuffer[n] = (U8)(first + n);
+        }
+        break;
+
+    case DATA_TYPE_NOT_COUNT:
+        for (n = 0U; n < size; n++)
+        {
+            pBuffer[n] = (U8)(0xFFU - (U8)(first + n));
+        }
+        break;
+    }
+}
+
+
+
+/**
+ * Seed a generator. Any seed, 0 included, gives a valid state.
+ */
+void PATGEN_Seed(PATGEN * const pGenerator, const uint64_t seed)
+{
+    uint64_t state = seed;
+
+    pGenerator->s[0] = PATGEN_splitmix64(&state);
+    pGenerator->s[1] = PATGEN_splitmix64(&state);
+    pGenerator->s[2] = PATGEN_splitmix64(&state);
+    pGenerator->s[3] = PATGEN_splitmix64(&state);
+}
+
+
+
+/* Next 64 bits of xoshiro256** */
+uint64_t PATGEN_Next(PATGEN * const pGenerator)
+{
+    uint64_t * const s = pGenerator->s;
+    const uint64_t result = PATGEN_rotl(s[1] * 5U, 7) * 9U;
+    const uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = PATGEN_rotl(s[3], 45);
+
+    return result;
+}
+
+
+
+/**
+ * Fill a buffer with one of the DATA_TYPE_* patterns. The random pattern
+ * takes 8 bytes from the generator per 8 bytes of buffer, so filling a
+ * buffer in pieces that are multiples of 8 bytes gives the same bytes as
+ * filling it at once.
+ *
+ * @param pGenerator the generator, only used by DATA_TYPE_RANDOM
+ * @param pBuffer the buffer
+ * @param size its size in bytes
+ * @param dataType DATA_TYPE_0, _1, _RANDOM, _COUNT or _NOT_COUNT
+ */
+void PATGEN_Fill(PATGEN * const pGenerator, void * const pBuffer,
+    const unsigned long size, const int dataType)
+{
+    PATGEN_fill(pGenerator, (U8 *)pBuffer, size, dataType, 0U);
+}
+
+
+
+/**
+ * Seed a generator for the payload of one packet.
+ */
+void PATGEN_SeedPacket(PATGEN * const pGenerator, const uint64_t seed,
+    const uint64_t sequence)
+{
+    uint64_t state = seed ^ (sequence * 0xD1342543DE82EF95ULL);
+
+    PATGEN_Seed(pGenerator, PATGEN_splitmix64(&state));
+}
+
+
+
+/**
+ * Make the payload of a packet.
+ *
+ * @param pBuffer the payload
+ * @param size its size in bytes
+ * @param dataType the DATA_TYPE_* pattern
+ * @param seed the seed of the run, the same for every packet
+ * @param sequence the sequence number of the packet
+ */
+void PATGEN_FillPacket(void * const pBuffer, const unsigned long size,
+    const int dataType, const uint64_t seed, const uint64_t sequence)
+{
+    PATGEN generator;
+
+    PATGEN_SeedPacket(&generator, seed, sequence);
+    PATGEN_fill(&generator, (U8 *)pBuffer, size, dataType, sequence);
+}
+
+
+
+/**
+ * Check a received payload against the one PATGEN_FillPacket() makes for
+ * the same seed and sequence number, without a copy of it.
+ *
+ * @param pData the payload received
+ * @param size its size in bytes, the size sent
+ * @param dataType the DATA_TYPE_* pattern
+ * @param seed the seed of the run
+ * @param sequence the sequence number of the packet
+ * @param pMismatch updated as BufferCompare() does, may be NULL
+ *
+ * @return the number of bytes that differ
+ */
+unsigned long PATGEN_CheckPacket(const void * const pData,
+    const unsigned long size, const int dataType, const uint64_t seed,
+    const uint64_t sequence, BUFFER_MISMATCH * const pMismatch)
+{
+    const U8 * const pReceived = (const U8 *)pData;
+    U8 expected[PATGEN_CHECK_CHUNK];
+    BUFFER_MISMATCH total, chunk;
+    PATGEN generator;
+    unsigned long offset, length;
+
+    total.count = 0U;
+    total.first = size;
+    total.last = size;
+
+    PATGEN_SeedPacket(&generator, seed, sequence);
+    for (offset = 0U; offset < size; offset += length)
+    {
+        length = size - offset;
+        if (length > PATGEN_CHECK_CHUNK)
+        {
+            length = PATGEN_CHECK_CHUNK;
+        }
+
+        PATGEN_fill(&generator, expected, length, dataType, sequence + offset);
+        if (BufferCompare(expected, pReceived + offset, length, &chunk) != 0U)
+        {
+            if (total.count == 0U)
+            {
+                total.first = offset + chunk.first;
+            }
+            total.count += chunk.count;
+            total.last = offset + chunk.last;
+        }
+    }
+
+    if (pMismatch != NULL)
+    {
+        *pMismatch = total;
+    }
+    return total.count;
+}
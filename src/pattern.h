@@ -0,0 +1,55 @@
+/*
+  @file pattern.h
+  @author Juan Manuel Gómez
+  @brief Seedable payload generator for the test packets.
+  @details The random payloads were made one byte at a time from rand(),
+           whose state is shared by the whole process: slow, and not
+           reproducible once several threads fill buffers. The generator
+           is xoshiro256** (Blackman and Vigna), 8 bytes per step, seeded
+           through splitmix64. Its state lives in a PATGEN owned by the
+           caller, so threads do not share it.
+
+           PATGEN_Fill() fills a buffer with any of the DATA_TYPE_*
+           patterns of utility.h, the random one from the generator.
+
+           A packet payload is a function of (seed, sequence number):
+           PATGEN_FillPacket() makes it and PATGEN_CheckPacket() checks a
+           received one by making it again in small pieces, so a receiver
+           needs neither the transmitted buffers nor a buffer of its own.
+           The count patterns of a packet start at its sequence number, so
+           that packets of the same size differ with every pattern but
+           zeros and ones.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stdint.h>
+#include "utility.h"
+
+#define PATGEN_DEFAULT_SEED 0x535057495245ULL    /* "SPWIRE" */
+
+typedef struct
+{
+    uint64_t s[4];
+} PATGEN;
+
+void PATGEN_Seed(PATGEN * const pGenerator, const uint64_t seed);
+
+uint64_t PATGEN_Next(PATGEN * const pGenerator);
+
+void PATGEN_Fill(PATGEN * const pGenerator, void * const pBuffer,
+    const unsigned long size, const int dataType);
+
+void PATGEN_SeedPacket(PATGEN * const pGenerator, const uint64_t seed,
+    const uint64_t sequence);
+
+void PATGEN_FillPacket(void * const pBuffer, const unsigned long size,
+    const int dataType, const uint64_t seed, const uint64_t sequence);
+
+unsigned long PATGEN_CheckPacket(const void * const pData,
+    const unsigned long size, const int dataType, const uint64_t seed,
+    const uint64_t sequence, BUFFER_MISMATCH * const pMismatch);
+
+#endif
@@ -0,0 +1,167 @@
+/*
+  @file pkt_pool.c
+  @author Juan Manuel Gómez
+  @brief Fixed-size buffer pool for RMAP command packets.
+  @details See pkt_pool.h.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pkt_pool.h"
+#include "rmap_packet_library.h"
+
+
+/* Does the buffer belong to the slab, or was it a fallback allocation? */
+static int PKTPOOL_owns(const PKTPOOL * const pPool, const U8 * const pBuffer)
+{
+    return (pPool->pSlab != NULL) && (pBuffer >= pPool->pSlab) &&
+        (pBuffer < pPool->pSlab + (pPool->stride * pPool->bufferCount));
+}
+
+
+
+/**
+ * Allocate the slab of a pool.
+ *
+ * @param pPool the pool to initialise
+ * @param bufferSize the size of every buffer in bytes
+ * @param bufferCount the number of buffers in the slab
+ *
+ * @return 1 on success, 0 if the slab could not be allocated
+ */
+int PKTPOOL_Init(PKTPOOL * const pPool, const unsigned long bufferSize,
+    const U32 bufferCount)
+{
+    U32 i;
+
+    memset(pPool, 0, sizeof(PKTPOOL));
+    if ((bufferSize == 0UL) || (bufferCount == 0U))
+    {
+        puts("PKTPOOL_Init: Empty pool");
+        return 0;
+    }
+
+    pPool->bufferSize = bufferSize;
+    pPool->stride = (bufferSize + (PKTPOOL_ALIGN - 1U)) &
+        ~((unsigned long)PKTPOOL_ALIGN - 1U);
+    pPool->bufferCount = bufferCount;
+    pPool->pSlab = (U8 *)malloc(pPool->stride * bufferCount);
+    pPool->ppFree = (U8 **)malloc(bufferCount * sizeof(U8 *));
+    if ((pPool->pSlab == NULL) || (pPool->ppFree == NULL))
+    {
+        puts("PKTPOOL_Init: Unable to allocate the slab");
+        PKTPOOL_Destroy(pPool);
+        return 0;
+    }
+
+    /* Hand out the first buffers first */
+    for (i = 0U; i < bufferCount; i++)
+    {
+        pPool->ppFree[i] = pPool->pSlab + (pPool->stride * (bufferCount - 1U - i));
+    }
+    pPool->freeCount = bufferCount;
+
+    return 1;
+}
+
+
+
+/* Pool of write commands carrying dataLength bytes */
+int PKTPOOL_InitWriteCommand(PKTPOOL * const pPool, const U32 bufferCount,
+    const unsigned long targetLength, const unsigned long replyLength,
+    const unsigned long dataLength)
+{
+    return PKTPOOL_Init(pPool, RMAP_CalculateWriteCommandPacketLength(
+        targetLength, replyLength, dataLength, 1), bufferCount);
+}
+
+
+
+/* Pool of read commands */
+int PKTPOOL_InitReadCommand(PKTPOOL * const pPool, const U32 bufferCount,
+    const unsigned long targetLength, const unsigned long replyLength)
+{
+    return PKTPOOL_Init(pPool, RMAP_CalculateReadCommandPacketLength(
+        targetLength, replyLength, 1), bufferCount);
+}
+
+
+
+/**
+ * Take a buffer of pPool->bufferSize bytes.
+ *
+ * @return the buffer, or NULL if the slab is exhausted and the fallback
+ *         allocation failed
+ */
+U8 *PKTPOOL_Get(PKTPOOL * const pPool)
+{
+    U8 *pBuffer;
+
+    if (pPool->freeCount > 0U)
+    {
+        pPool->freeCount--;
+        pBuffer = pPool->ppFree[pPool->freeCount];
+        pPool->hits++;
+    }
+    else
+    {
+        pBuffer = (U8 *)malloc(pPool->bufferSize);
+        if (pBuffer == NULL)
+        {
+            return NULL;
+        }
+        pPool->misses++;
+    }
+
+    pPool->inUse++;
+    if (pPool->inUse > pPool->peakInUse)
+    {
+        pPool->peakInUse = pPool->inUse;
+    }
+
+    return pBuffer;
+}
+
+
+
+/* Give a buffer back. NULL is ignored. */
+void PKTPOOL_Put(PKTPOOL * const pPool, U8 * const pBuffer)
+{
+    if (pBuffer == NULL)
+    {
+        return;
+    }
+
+    if (PKTPOOL_owns(pPool, pBuffer))
+    {
+        pPool->ppFree[pPool->freeCount++] = pBuffer;
+    }
+    else
+    {
+        free(pBuffer);
+    }
+    pPool->inUse--;
+}
+
+
+
+void PKTPOOL_PrintStats(const PKTPOOL * const pPool, const char * const name)
+{
+    printf("Pool %s: %u buffers of %lu bytes, %lu hits, %lu misses, "
+        "peak %lu in use, %lu still in use.\n", name, pPool->bufferCount,
+        pPool->bufferSize, pPool->hits, pPool->misses, pPool->peakInUse,
+        pPool->inUse);
+}
+
+
+
+/* Release the slab. Fallback buffers still in use must be returned first. */
+void PKTPOOL_Destroy(PKTPOOL * const pPool)
+{
+    free(pPool->pSlab);
+    free(pPool->ppFree);
+    memset(pPool, 0, sizeof(PKTPOOL));
+}
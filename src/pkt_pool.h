@@ -0,0 +1,63 @@
+/*
+  @file pkt_pool.h
+  @author Juan Manuel Gómez
+  @brief Fixed-size buffer pool for RMAP command packets.
+  @details A pool holds one slab of equally sized buffers, sized once for a
+           command shape (address lengths and data length), so the packet
+           length is calculated once rather than for every command. Getting
+           and returning a buffer is a push or a pop on a free stack.
+
+           When the slab is exhausted the pool falls back to malloc() and
+           counts a miss; such buffers are freed when they are returned.
+           A pool is not locked: use one pool per thread.
+
+           STAR_createPacket() copies the data it is given, so a command
+           buffer can be returned as soon as its packet has been created,
+           and a thread that builds one command at a time needs a single
+           buffer. The pool spares the malloc() and the length calculation
+           of every fill buffer; the copy of STAR_createPacket() and the
+           reply buffers of the receive operations are the STAR-API's.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef PKT_POOL_H
+#define PKT_POOL_H
+
+#include "star-dundee_types.h"
+
+#define PKTPOOL_ALIGN 8U
+
+typedef struct
+{
+    unsigned long bufferSize;
+    unsigned long stride;
+    U32 bufferCount;
+    U8 *pSlab;
+    U8 **ppFree;
+    U32 freeCount;
+
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long inUse;
+    unsigned long peakInUse;
+} PKTPOOL;
+
+int PKTPOOL_Init(PKTPOOL * const pPool, const unsigned long bufferSize,
+    const U32 bufferCount);
+
+int PKTPOOL_InitWriteCommand(PKTPOOL * const pPool, const U32 bufferCount,
+    const unsigned long targetLength, const unsigned long replyLength,
+    const unsigned long dataLength);
+
+int PKTPOOL_InitReadCommand(PKTPOOL * const pPool, const U32 bufferCount,
+    const unsigned long targetLength, const unsigned long replyLength);
+
+U8 *PKTPOOL_Get(PKTPOOL * const pPool);
+
+void PKTPOOL_Put(PKTPOOL * const pPool, U8 * const pBuffer);
+
+void PKTPOOL_PrintStats(const PKTPOOL * const pPool, const char * const name);
+
+void PKTPOOL_Destroy(PKTPOOL * const pPool);
+
+#endif
@@ -0,0 +1,287 @@
+/*
+  @file ring.c
+  @author Juan Manuel Gómez
+  @brief Lock-free rings of fixed-size descriptors between threads.
+  @details See ring.h.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ring.h"
+
+
+/* Capacity rounded up to a power of two, 0 if too large */
+static unsigned long RING_powerOfTwo(const unsigned long capacity)
+{
+    unsigned long size = 1UL;
+
+    while ((size < capacity) && (size != 0UL))
+    {
+        size <<= 1;
+    }
+
+    return size;
+}
+
+
+
+/**
+ * Make an empty ring.
+ *
+ * @param pRing the ring
+ * @param capacity the elements it holds, rounded up to a power of two
+ * @param elementSize the bytes of an element
+ *
+ * @return 1 on success, 0 on error
+ */
+int SPSC_Init(SPSC_RING * const pRing, const unsigned long capacity,
+    const size_t elementSize)
+{
+    void *pElements = NULL;
+
+    memset(pRing, 0, sizeof(SPSC_RING));
+    pRing->capacity = RING_powerOfTwo(capacity);
+    pRing->elementSize = elementSize;
+    pRing->slotSize = (elementSize + 7U) & ~(size_t)7U;
+    if ((capacity == 0UL) || (elementSize == 0U) || (pRing->capacity == 0UL))
+    {
+        puts("SPSC_Init: Invalid capacity or element size");
+        return 0;
+    }
+
+    if (posix_memalign(&pElements, RING_CACHE_LINE,
+        pRing->capacity * pRing->slotSize) != 0)
+    {
+        puts("SPSC_Init: Unable to allocate the ring");
+        return 0;
+    }
+    pRing->pElements = (unsigned char *)pElements;
+
+    return 1;
+}
+
+
+
+/* The slot of the next element, NULL while the ring is full. The producer
+ * fills it, then SPSC_Publish() */
+void *SPSC_Reserve(SPSC_RING * const pRing)
+{
+    if (pRing->tail - pRing->cachedHead == pRing->capacity)
+    {
+        /* Full as last seen: look at the consumer again */
+        pRing->cachedHead = __atomic_load_n(&pRing->head, __ATOMIC_ACQUIRE);
+        if (pRing->tail - pRing->cachedHead == pRing->capacity)
+        {
+            return NULL;
+        }
+    }
+
+    return pRing->pElements +
+        (pRing->tail & (pRing->capacity - 1UL)) * pRing->slotSize;
+}
+
+
+
+/* Hand the slot of SPSC_Reserve() to the consumer */
+void SPSC_Publish(SPSC_RING * const pRing)
+{
+    __atomic_store_n(&pRing->tail, pRing->tail + 1UL, __ATOMIC_RELEASE);
+}
+
+
+
+/* Copy an element in, 0 if the ring is full */
+int SPSC_Push(SPSC_RING * const pRing, const void * const pElement)
+{
+    void * const pSlot = SPSC_Reserve(pRing);
+
+    if (pSlot == NULL)
+    {
+        return 0;
+    }
+    memcpy(pSlot, pElement, pRing->elementSize);
+    SPSC_Publish(pRing);
+
+    return 1;
+}
+
+
+
+/* The elements the consumer can read, from SPSC_Slot(pRing, 0) on */
+unsigned long SPSC_Readable(SPSC_RING * const pRing)
+{
+    if (pRing->cachedTail == pRing->head)
+    {
+        /* Empty as last seen: look at the producer again */
+        pRing->cachedTail = __atomic_load_n(&pRing->tail, __ATOMIC_ACQUIRE);
+    }
+
+    return pRing->cachedTail - pRing->head;
+}
+
+
+
+/* The index-th readable element, below SPSC_Readable() */
+void *SPSC_Slot(const SPSC_RING * const pRing, const unsigned long index)
+{
+    return pRing->pElements + ((pRing->head + index) &
+        (pRing->capacity - 1UL)) * pRing->slotSize;
+}
+
+
+
+/* Give the first count readable slots back to the producer */
+void SPSC_Consume(SPSC_RING * const pRing, const unsigned long count)
+{
+    __atomic_store_n(&pRing->head, pRing->head + count, __ATOMIC_RELEASE);
+}
+
+
+
+/* Copy an element out, 0 if the ring is empty */
+int SPSC_Pop(SPSC_RING * const pRing, void * const pElement)
+{
+    if (SPSC_Readable(pRing) == 0UL)
+    {
+        return 0;
+    }
+    memcpy(pElement, SPSC_Slot(pRing, 0UL), pRing->elementSize);
+    SPSC_Consume(pRing, 1UL);
+
+    return 1;
+}
+
+
+
+void SPSC_Free(SPSC_RING * const pRing)
+{
+    free(pRing->pElements);
+    memset(pRing, 0, sizeof(SPSC_RING));
+}
+
+
+
+/* The sequence number at the start of a slot: equal to the position when
+ * the slot is free for the producer of that position, position + 1 when it
+ * holds the element of that position */
+static unsigned long *MPSC_sequence(const MPSC_RING * const pRing,
+    const unsigned long position)
+{
+    return (unsigned long *)(pRing->pSlots +
+        (position & (pRing->capacity - 1UL)) * pRing->slotSize);
+}
+
+
+
+/**
+ * Make an empty ring for several producers and one consumer.
+ *
+ * @param pRing the ring
+ * @param capacity the elements it holds, rounded up to a power of two
+ * @param elementSize the bytes of an element
+ *
+ * @return 1 on success, 0 on error
+ */
+int MPSC_Init(MPSC_RING * const pRing, const unsigned long capacity,
+    const size_t elementSize)
+{
+    void *pSlots = NULL;
+    unsigned long i;
+
+    memset(pRing, 0, sizeof(MPSC_RING));
+    pRing->capacity = RING_powerOfTwo(capacity);
+    pRing->elementSize = elementSize;
+    pRing->slotSize = (sizeof(unsigned long) + elementSize + 7U) &
+        ~(size_t)7U;
+    if ((capacity == 0UL) || (elementSize == 0U) || (pRing->capacity == 0UL))
+    {
+        puts("MPSC_Init: Invalid capacity or element size");
+        return 0;
+    }
+
+    if (posix_memalign(&pSlots, RING_CACHE_LINE,
+        pRing->capacity * pRing->slotSize) != 0)
+    {
+        puts("MPSC_Init: Unable to allocate the ring");
+        return 0;
+    }
+    pRing->pSlots = (unsigned char *)pSlots;
+    for (i = 0UL; i < pRing->capacity; i++)
+    {
+        *MPSC_sequence(pRing, i) = i;
+    }
+
+    return 1;
+}
+
+
+
+/* Copy an element in from any thread, 0 if the ring is full */
+int MPSC_Push(MPSC_RING * const pRing, const void * const pElement)
+{
+    unsigned long position, sequence, *pSequence;
+
+    position = __atomic_load_n(&pRing->tail, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        pSequence = MPSC_sequence(pRing, position);
+        sequence = __atomic_load_n(pSequence, __ATOMIC_ACQUIRE);
+        if (sequence == position)
+        {
+            /* Free: claim it, or see which position another producer
+             * left us */
+            if (__atomic_compare_exchange_n(&pRing->tail, &position,
+                position + 1UL, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if ((long)(sequence - position) < 0L)
+        {
+            /* Still holds the element of a lap ago */
+            return 0;
+        }
+        else
+        {
+            position = __atomic_load_n(&pRing->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(pSequence + 1, pElement, pRing->elementSize);
+    __atomic_store_n(pSequence, position + 1UL, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+
+
+/* Copy the oldest element out, 0 if the ring is empty or the oldest is
+ * still being written */
+int MPSC_Pop(MPSC_RING * const pRing, void * const pElement)
+{
+    unsigned long * const pSequence = MPSC_sequence(pRing, pRing->head);
+
+    if (__atomic_load_n(pSequence, __ATOMIC_ACQUIRE) != pRing->head + 1UL)
+    {
+        return 0;
+    }
+
+    memcpy(pElement, pSequence + 1, pRing->elementSize);
+    /* Free for the producer of the next lap */
+    __atomic_store_n(pSequence, pRing->head + pRing->capacity,
+        __ATOMIC_RELEASE);
+    pRing->head++;
+
+    return 1;
+}
+
+
+
+void MPSC_Free(MPSC_RING * const pRing)
+{
+    free(pRing->pSlots);
+    memset(pRing, 0, sizeof(MPSC_RING));
+}
@@ -0,0 +1,104 @@
+/*
+  @file ring.h
+  @author Juan Manuel Gómez
+  @brief Lock-free rings of fixed-size descriptors between threads.
+  @details A receive thread that also processes what it receives stops
+           receiving while it prints or checks. With a ring it only moves
+           descriptors of what arrived, an operation, a packet or an
+           event, and a consumer thread does the processing at its own
+           pace.
+
+           SPSC_RING has a single producer and a single consumer. Each
+           index is on a cache line of its own, next to the copy the
+           thread keeps of the other index, so that the threads only touch
+           each other's line when the ring looks full or empty to them.
+           The producer can fill a slot in place, SPSC_Reserve() then
+           SPSC_Publish(); the consumer can look at several slots in
+           place, SPSC_Readable() and SPSC_Slot(), and give them back
+           together with SPSC_Consume(). SPSC_Push() and SPSC_Pop() copy
+           one element.
+
+           MPSC_RING lets several producers, such as the receive threads
+           of several channels, feed a single consumer, such as a writer.
+           Producers claim a slot with a compare-and-swap of the tail and
+           each slot carries a sequence number telling whether it is free
+           or full, so a producer never waits on a lock held by another.
+
+           Neither ring waits: a push returns 0 when the ring is full and
+           a pop when it is empty, and the caller decides whether to retry,
+           drop or count.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef RING_H
+#define RING_H
+
+#include <stddef.h>
+
+#define RING_CACHE_LINE 64
+
+typedef struct
+{
+    /* Producer line: the next slot to fill and the head last seen */
+    unsigned long tail;
+    unsigned long cachedHead;
+    char producerPad[RING_CACHE_LINE - 2 * sizeof(unsigned long)];
+
+    /* Consumer line: the next slot to read and the tail last seen */
+    unsigned long head;
+    unsigned long cachedTail;
+    char consumerPad[RING_CACHE_LINE - 2 * sizeof(unsigned long)];
+
+    /* Read only once made */
+    unsigned char *pElements;
+    size_t elementSize;
+    size_t slotSize;            /* elementSize rounded up to 8 bytes */
+    unsigned long capacity;     /* a power of two */
+} SPSC_RING;
+
+typedef struct
+{
+    /* Producers' line */
+    unsigned long tail;
+    char producerPad[RING_CACHE_LINE - sizeof(unsigned long)];
+
+    /* Consumer line */
+    unsigned long head;
+    char consumerPad[RING_CACHE_LINE - sizeof(unsigned long)];
+
+    /* Read only once made; each slot is a sequence number and an element */
+    unsigned char *pSlots;
+    size_t elementSize;
+    size_t slotSize;
+    unsigned long capacity;     /* a power of two */
+} MPSC_RING;
+
+int SPSC_Init(SPSC_RING * const pRing, const unsigned long capacity,
+    const size_t elementSize);
+
+void *SPSC_Reserve(SPSC_RING * const pRing);
+
+void SPSC_Publish(SPSC_RING * const pRing);
+
+int SPSC_Push(SPSC_RING * const pRing, const void * const pElement);
+
+unsigned long SPSC_Readable(SPSC_RING * const pRing);
+
+void *SPSC_Slot(const SPSC_RING * const pRing, const unsigned long index);
+
+void SPSC_Consume(SPSC_RING * const pRing, const unsigned long count);
+
+int SPSC_Pop(SPSC_RING * const pRing, void * const pElement);
+
+void SPSC_Free(SPSC_RING * const pRing);
+
+int MPSC_Init(MPSC_RING * const pRing, const unsigned long capacity,
+    const size_t elementSize);
+
+int MPSC_Push(MPSC_RING * const pRing, const void * const pElement);
+
+int MPSC_Pop(MPSC_RING * const pRing, void * const pElement);
+
+void MPSC_Free(MPSC_RING * const pRing);
+
+#endif
@@ -0,0 +1,420 @@
+/*
+  @file rmap_crc.c
+  @author Juan Manuel Gómez
+  @brief CRC-8 of the RMAP protocol.
+  @details See rmap_crc.h. The byte table is the one given in the
+           standard; the slice tables are derived from it.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+
+#include "rmap_crc.h"
+
+
+const U8 RMAPCRC_Table[256] =
+{
+    0x00, 0x91, 0xe3, 0x72, 0x07, 0x96, 0xe4, 0x75,
+    0x0e, 0x9f, 0xed, 0x7c, 0x09, 0x98, 0xea, 0x7b,
+    0x1c, 0x8d, 0xff, 0x6e, 0x1b, 0x8a, 0xf8, 0x69,
+    0x12, 0x83, 0xf1, 0x60, 0x15, 0x84, 0xf6, 0x67,
+    0x38, 0xa9, 0xdb, 0x4a, 0x3f, 0xae, 0xdc, 0x4d,
+    0x36, 0xa7, 0xd5, 0x44, 0x31, 0xa0, 0xd2, 0x43,
+    0x24, 0xb5, 0xc7, 0x56, 0x23, 0xb2, 0xc0, 0x51,
+    0x2a, 0xbb, 0xc9, 0x58, 0x2d, 0xbc, 0xce, 0x5f,
+    0x70, 0xe1, 0x93, 0x02, 0x77, 0xe6, 0x94, 0x05,
+    0x7e, 0xef, 0x9d, 0x0c, 0x79, 0xe8, 0x9a, 0x0b,
+    0x6c, 0xfd, 0x8f, 0x1e, 0x6b, 0xfa, 0x88, 0x19,
+    0x62, 0xf3, 0x81, 0x10, 0x65, 0xf4, 0x86, 0x17,
+    0x48, 0xd9, 0xab, 0x3a, 0x4f, 0xde, 0xac, 0x3d,
+    0x46, 0xd7, 0xa5, 0x34, 0x41, 0xd0, 0xa2, 0x33,
+    0x54, 0xc5, 0xb7, 0x26, 0x53, 0xc2, 0xb0, 0x21,
+    0x5a, 0xcb, 0xb9, 0x28, 0x5d, 0xcc, 0xbe, 0x2f,
+    0xe0, 0x71, 0x03, 0x92, 0xe7, 0x76, 0x04, 0x95,
+    0xee, 0x7f, 0x0d, 0x9c, 0xe9, 0x78, 0x0a, 0x9b,
+    0xfc, 0x6d, 0x1f, 0x8e, 0xfb, 0x6a, 0x18, 0x89,
+    0xf2, 0x63, 0x11, 0x80, 0xf5, 0x64, 0x16, 0x87,
+    0xd8, 0x49, 0x3b, 0xaa, 0xdf, 0x4e, 0x3c, 0xad,
+    0xd6, 0x47, 0x35, 0xa4, 0xd1, 0x40, 0x32, 0xa3,
+    0xc4, 0x55, 0x27, 0xb6, 0xc3, 0x52, 0x20, 0xb1,
+    0xca, 0x5b, 0x29, 0xb8, 0xcd, 0x5c, 0x2e, 0xbf,
+    0x90, 0x01, 0x73, 0xe2, 0x97, 0x06, 0x74, 0xe5,
+    0x9e, 0x0f, 0x7d, 0xec, 0x99, 0x08, 0x7a, 0xeb,
+    0x8c, 0x1d, 0x6f, 0xfe, 0x8b, 0x1a, 0x68, 0xf9,
+    0x82, 0x13, 0x61, 0xf0, 0x85, 0x14, 0x66, 0xf7,
+    0xa8, 0x39, 0x4b, 0xda, 0xaf, 0x3e, 0x4c, 0xdd,
+    0xa6, 0x37, 0x45, 0xd4, 0xa1, 0x30, 0x42, 0xd3,
+    0xb4, 0x25, 0x57, 0xc6, 0xb3, 0x22, 0x50, 0xc1,
+    0xba, 0x2b, 0x59, 0xc8, 0xbd, 0x2c, 0x5e, 0xcf
+};
+
+
+
+/* RMAPCRC_Slice[k][b] is the CRC of byte b followed by k + 1 zero bytes */
+static const U8 RMAPCRC_Slice[RMAPCRC_SLICE - 1][256] =
+{
+    {
+        0x00, 0x6d, 0xda, 0xb7, 0x75, 0x18, 0xaf, 0xc2,
+        0xea, 0x87, 0x30, 0x5d, 0x9f, 0xf2, 0x45, 0x28,
+        0x15, 0x78, 0xcf, 0xa2, 0x60, 0x0d, 0xba, 0xd7,
+        0xff, 0x92, 0x25, 0x48, 0x8a, 0xe7, 0x50, 0x3d,
+        0x2a, 0x47, 0xf0, 0x9d, 0x5f, 0x32, 0x85, 0xe8,
+        0xc0, 0xad, 0x1a, 0x77, 0xb5, 0xd8, 0x6f, 0x02,
+        0x3f, 0x52, 0xe5, 0x88, 0x4a, 0x27, 0x90, 0xfd,
+        0xd5, 0xb8, 0x0f, 0x62, 0xa0, 0xcd, 0x7a, 0x17,
+        0x54, 0x39, 0x8e, 0xe3, 0x21, 0x4c, 0xfb, 0x96,
+        0xbe, 0xd3, 0x64, 0x09, 0xcb, 0xa6, 0x11, 0x7c,
+        0x41, 0x2c, 0x9b, 0xf6, 0x34, 0x59, 0xee, 0x83,
+        0xab, 0xc6, 0x71, 0x1c, 0xde, 0xb3, 0x04, 0x69,
+        0x7e, 0x13, 0xa4, 0xc9, 0x0b, 0x66, 0xd1, 0xbc,
+        0x94, 0xf9, 0x4e, 0x23, 0xe1, 0x8c, 0x3b, 0x56,
+        0x6b, 0x06, 0xb1, 0xdc, 0x1e, 0x73, 0xc4, 0xa9,
+        0x81, 0xec, 0x5b, 0x36, 0xf4, 0x99, 0x2e, 0x43,
+        0xa8, 0xc5, 0x72, 0x1f, 0xdd, 0xb0, 0x07, 0x6a,
+        0x42, 0x2f, 0x98, 0xf5, 0x37, 0x5a, 0xed, 0x80,
+        0xbd, 0xd0, 0x67, 0x0a, 0xc8, 0xa5, 0x12, 0x7f,
+        0x57, 0x3a, 0x8d, 0xe0, 0x22, 0x4f, 0xf8, 0x95,
+        0x82, 0xef, 0x58, 0x35, 0xf7, 0x9a, 0x2d, 0x40,
+        0x68, 0x05, 0xb2, 0xdf, 0x1d, 0x70, 0xc7, 0xaa,
+        0x97, 0xfa, 0x4d, 0x20, 0xe2, 0x8f, 0x38, 0x55,
+        0x7d, 0x10, 0xa7, 0xca, 0x08, 0x65, 0xd2, 0xbf,
+        0xfc, 0x91, 0x26, 0x4b, 0x89, 0xe4, 0x53, 0x3e,
+        0x16, 0x7b, 0xcc, 0xa1, 0x63, 0x0e, 0xb9, 0xd4,
+        0xe9, 0x84, 0x33, 0x5e, 0x9c, 0xf1, 0x46, 0x2b,
+        0x03, 0x6e, 0xd9, 0xb4, 0x76, 0x1b, 0xac, 0xc1,
+        0xd6, 0xbb, 0x0c, 0x61, 0xa3, 0xce, 0x79, 0x14,
+        0x3c, 0x51, 0xe6, 0x8b, 0x49, 0x24, 0x93, 0xfe,
+        0xc3, 0xae, 0x19, 0x74, 0xb6, 0xdb, 0x6c, 0x01,
+        0x29, 0x44, 0xf3, 0x9e, 0x5c, 0x31, 0x86, 0xeb
+    },
+    {
+        0x00, 0xd0, 0x61, 0xb1, 0xc2, 0x12, 0xa3, 0x73,
+        0x45, 0x95, 0x24, 0xf4, 0x87, 0x57, 0xe6, 0x36,
+        0x8a, 0x5a, 0xeb, 0x3b, 0x48, 0x98, 0x29, 0xf9,
+        0xcf, 0x1f, 0xae, 0x7e, 0x0d, 0xdd, 0x6c, 0xbc,
+        0xd5, 0x05, 0xb4, 0x64, 0x17, 0xc7, 0x76, 0xa6,
+        0x90, 0x40, 0xf1, 0x21, 0x52, 0x82, 0x33, 0xe3,
+        0x5f, 0x8f, 0x3e, 0xee, 0x9d, 0x4d, 0xfc, 0x2c,
+        0x1a, 0xca, 0x7b, 0xab, 0xd8, 0x08, 0xb9, 0x69,
+        0x6b, 0xbb, 0x0a, 0xda, 0xa9, 0x79, 0xc8, 0x18,
+        0x2e, 0xfe, 0x4f, 0x9f, 0xec, 0x3c, 0x8d, 0x5d,
+        0xe1, 0x31, 0x80, 0x50, 0x23, 0xf3, 0x42, 0x92,
+        0xa4, 0x74, 0xc5, 0x15, 0x66, 0xb6, 0x07, 0xd7,
+        0xbe, 0x6e, 0xdf, 0x0f, 0x7c, 0xac, 0x1d, 0xcd,
+        0xfb, 0x2b, 0x9a, 0x4a, 0x39, 0xe9, 0x58, 0x88,
+        0x34, 0xe4, 0x55, 0x85, 0xf6, 0x26, 0x97, 0x47,
+        0x71, 0xa1, 0x10, 0xc0, 0xb3, 0x63, 0xd2, 0x02,
+        0xd6, 0x06, 0xb7, 0x67, 0x14, 0xc4, 0x75, 0xa5,
+        0x93, 0x43, 0xf2, 0x22, 0x51, 0x81, 0x30, 0xe0,
+        0x5c, 0x8c, 0x3d, 0xed, 0x9e, 0x4e, 0xff, 0x2f,
+        0x19, 0xc9, 0x78, 0xa8, 0xdb, 0x0b, 0xba, 0x6a,
+        0x03, 0xd3, 0x62, 0xb2, 0xc1, 0x11, 0xa0, 0x70,
+        0x46, 0x96, 0x27, 0xf7, 0x84, 0x54, 0xe5, 0x35,
+        0x89, 0x59, 0xe8, 0x38, 0x4b, 0x9b, 0x2a, 0xfa,
+        0xcc, 0x1c, 0xad, 0x7d, 0x0e, 0xde, 0x6f, 0xbf,
+        0xbd, 0x6d, 0xdc, 0x0c, 0x7f, 0xaf, 0x1e, 0xce,
+        0xf8, 0x28, 0x99, 0x49, 0x3a, 0xea, 0x5b, 0x8b,
+        0x37, 0xe7, 0x56, 0x86, 0xf5, 0x25, 0x94, 0x44,
+        0x72, 0xa2, 0x13, 0xc3, 0xb0, 0x60, 0xd1, 0x01,
+        0x68, 0xb8, 0x09, 0xd9, 0xaa, 0x7a, 0xcb, 0x1b,
+        0x2d, 0xfd, 0x4c, 0x9c, 0xef, 0x3f, 0x8e, 0x5e,
+        0xe2, 0x32, 0x83, 0x53, 0x20, 0xf0, 0x41, 0x91,
+        0xa7, 0x77, 0xc6, 0x16, 0x65, 0xb5, 0x04, 0xd4
+    },
+    {
+        0x00, 0x8c, 0xd9, 0x55, 0x73, 0xff, 0xaa, 0x26,
+        0xe6, 0x6a, 0x3f, 0xb3, 0x95, 0x19, 0x4c, 0xc0,
+        0x0d, 0x81, 0xd4, 0x58, 0x7e, 0xf2, 0xa7, 0x2b,
+        0xeb, 0x67, 0x32, 0xbe, 0x98, 0x14, 0x41, 0xcd,
+        0x1a, 0x96, 0xc3, 0x4f, 0x69, 0xe5, 0xb0, 0x3c,
+        0xfc, 0x70, 0x25, 0xa9, 0x8f, 0x03, 0x56, 0xda,
+        0x17, 0x9b, 0xce, 0x42, 0x64, 0xe8, 0xbd, 0x31,
+        0xf1, 0x7d, 0x28, 0xa4, 0x82, 0x0e, 0x5b, 0xd7,
+        0x34, 0xb8, 0xed, 0x61, 0x47, 0xcb, 0x9e, 0x12,
+        0xd2, 0x5e, 0x0b, 0x87, 0xa1, 0x2d, 0x78, 0xf4,
+        0x39, 0xb5, 0xe0, 0x6c, 0x4a, 0xc6, 0x93, 0x1f,
+        0xdf, 0x53, 0x06, 0x8a, 0xac, 0x20, 0x75, 0xf9,
+        0x2e, 0xa2, 0xf7, 0x7b, 0x5d, 0xd1, 0x84, 0x08,
+        0xc8, 0x44, 0x11, 0x9d, 0xbb, 0x37, 0x62, 0xee,
+        0x23, 0xaf, 0xfa, 0x76, 0x50, 0xdc, 0x89, 0x05,
+        0xc5, 0x49, 0x1c, 0x90, 0xb6, 0x3a, 0x6f, 0xe3,
+        0x68, 0xe4, 0xb1, 0x3d, 0x1b, 0x97, 0xc2, 0x4e,
+        0x8e, 0x02, 0x57, 0xdb, 0xfd, 0x71, 0x24, 0xa8,
+        0x65, 0xe9, 0xbc, 0x30, 0x16, 0x9a, 0xcf, 0x43,
+        0x83, 0x0f, 0x5a, 0xd6, 0xf0, 0x7c, 0x29, 0xa5,
+        0x72, 0xfe, 0xab, 0x27, 0x01, 0x8d, 0xd8, 0x54,
+        0x94, 0x18, 0x4d, 0xc1, 0xe7, 0x6b, 0x3e, 0xb2,
+        0x7f, 0xf3, 0xa6, 0x2a, 0x0c, 0x80, 0xd5, 0x59,
+        0x99, 0x15, 0x40, 0xcc, 0xea, 0x66, 0x33, 0xbf,
+        0x5c, 0xd0, 0x85, 0x09, 0x2f, 0xa3, 0xf6, 0x7a,
+        0xba, 0x36, 0x63, 0xef, 0xc9, 0x45, 0x10, 0x9c,
+        0x51, 0xdd, 0x88, 0x04, 0x22, 0xae, 0xfb, 0x77,
+        0xb7, 0x3b, 0x6e, 0xe2, 0xc4, 0x48, 0x1d, 0x91,
+        0x46, 0xca, 0x9f, 0x13, 0x35, 0xb9, 0xec, 0x60,
+        0xa0, 0x2c, 0x79, 0xf5, 0xd3, 0x5f, 0x0a, 0x86,
+        0x4b, 0xc7, 0x92, 0x1e, 0x38, 0xb4, 0xe1, 0x6d,
+        0xad, 0x21, 0x74, 0xf8, 0xde, 0x52, 0x07, 0x8b
+    },
+    {
+        0x00, 0xe9, 0x13, 0xfa, 0x26, 0xcf, 0x35, 0xdc,
+        0x4c, 0xa5, 0x5f, 0xb6, 0x6a, 0x83, 0x79, 0x90,
+        0x98, 0x71, 0x8b, 0x62, 0xbe, 0x57, 0xad, 0x44,
+        0xd4, 0x3d, 0xc7, 0x2e, 0xf2, 0x1b, 0xe1, 0x08,
+        0xf1, 0x18, 0xe2, 0x0b, 0xd7, 0x3e, 0xc4, 0x2d,
+        0xbd, 0x54, 0xae, 0x47, 0x9b, 0x72, 0x88, 0x61,
+        0x69, 0x80, 0x7a, 0x93, 0x4f, 0xa6, 0x5c, 0xb5,
+        0x25, 0xcc, 0x36, 0xdf, 0x03, 0xea, 0x10, 0xf9,
+        0x23, 0xca, 0x30, 0xd9, 0x05, 0xec, 0x16, 0xff,
+        0x6f, 0x86, 0x7c, 0x95, 0x49, 0xa0, 0x5a, 0xb3,
+        0xbb, 0x52, 0xa8, 0x41, 0x9d, 0x74, 0x8e, 0x67,
+        0xf7, 0x1e, 0xe4, 0x0d, 0xd1, 0x38, 0xc2, 0x2b,
+        0xd2, 0x3b, 0xc1, 0x28, 0xf4, 0x1d, 0xe7, 0x0e,
+        0x9e, 0x77, 0x8d, 0x64, 0xb8, 0x51, 0xab, 0x42,
+        0x4a, 0xa3, 0x59, 0xb0, 0x6c, 0x85, 0x7f, 0x96,
+        0x06, 0xef, 0x15, 0xfc, 0x20, 0xc9, 0x33, 0xda,
+        0x46, 0xaf, 0x55, 0xbc, 0x60, 0x89, 0x73, 0x9a,
+        0x0a, 0xe3, 0x19, 0xf0, 0x2c, 0xc5, 0x3f, 0xd6,
+        0xde, 0x37, 0xcd, 0x24, 0xf8, 0x11, 0xeb, 0x02,
+        0x92, 0x7b, 0x81, 0x68, 0xb4, 0x5d, 0xa7, 0x4e,
+        0xb7, 0x5e, 0xa4, 0x4d, 0x91, 0x78, 0x82, 0x6b,
+        0xfb, 0x12, 0xe8, 0x01, 0xdd, 0x34, 0xce, 0x27,
+        0x2f, 0xc6, 0x3c, 0xd5, 0x09, 0xe0, 0x1a, 0xf3,
+        0x63, 0x8a, 0x70, 0x99, 0x45, 0xac, 0x56, 0xbf,
+        0x65, 0x8c, 0x76, 0x9f, 0x43, 0xaa, 0x50, 0xb9,
+        0x29, 0xc0, 0x3a, 0xd3, 0x0f, 0xe6, 0x1c, 0xf5,
+        0xfd, 0x14, 0xee, 0x07, 0xdb, 0x32, 0xc8, 0x21,
+        0xb1, 0x58, 0xa2, 0x4b, 0x97, 0x7e, 0x84, 0x6d,
+        0x94, 0x7d, 0x87, 0x6e, 0xb2, 0x5b, 0xa1, 0x48,
+        0xd8, 0x31, 0xcb, 0x22, 0xfe, 0x17, 0xed, 0x04,
+        0x0c, 0xe5, 0x1f, 0xf6, 0x2a, 0xc3, 0x39, 0xd0,
+        0x40, 0xa9, 0x53, 0xba, 0x66, 0x8f, 0x75, 0x9c
+    },
+    {
+        0x00, 0x37, 0x6e, 0x59, 0xdc, 0xeb, 0xb2, 0x85,
+        0x79, 0x4e, 0x17, 0x20, 0xa5, 0x92, 0xcb, 0xfc,
+        0xf2, 0xc5, 0x9c, 0xab, 0x2e, 0x19, 0x40, 0x77,
+        0x8b, 0xbc, 0xe5, 0xd2, 0x57, 0x60, 0x39, 0x0e,
+        0x25, 0x12, 0x4b, 0x7c, 0xf9, 0xce, 0x97, 0xa0,
+        0x5c, 0x6b, 0x32, 0x05, 0x80, 0xb7, 0xee, 0xd9,
+        0xd7, 0xe0, 0xb9, 0x8e, 0x0b, 0x3c, 0x65, 0x52,
+        0xae, 0x99, 0xc0, 0xf7, 0x72, 0x45, 0x1c, 0x2b,
+        0x4a, 0x7d, 0x24, 0x13, 0x96, 0xa1, 0xf8, 0xcf,
+        0x33, 0x04, 0x5d, 0x6a, 0xef, 0xd8, 0x81, 0xb6,
+        0xb8, 0x8f, 0xd6, 0xe1, 0x64, 0x53, 0x0a, 0x3d,
+        0xc1, 0xf6, 0xaf, 0x98, 0x1d, 0x2a, 0x73, 0x44,
+        0x6f, 0x58, 0x01, 0x36, 0xb3, 0x84, 0xdd, 0xea,
+        0x16, 0x21, 0x78, 0x4f, 0xca, 0xfd, 0xa4, 0x93,
+        0x9d, 0xaa, 0xf3, 0xc4, 0x41, 0x76, 0x2f, 0x18,
+        0xe4, 0xd3, 0x8a, 0xbd, 0x38, 0x0f, 0x56, 0x61,
+        0x94, 0xa3, 0xfa, 0xcd, 0x48, 0x7f, 0x26, 0x11,
+        0xed, 0xda, 0x83, 0xb4, 0x31, 0x06, 0x5f, 0x68,
+        0x66, 0x51, 0x08, 0x3f, 0xba, 0x8d, 0xd4, 0xe3,
+        0x1f, 0x28, 0x71, 0x46, 0xc3, 0xf4, 0xad, 0x9a,
+        0xb1, 0x86, 0xdf, 0xe8, 0x6d, 0x5a, 0x03, 0x34,
+        0xc8, 0xff, 0xa6, 0x91, 0x14, 0x23, 0x7a, 0x4d,
+        0x43, 0x74, 0x2d, 0x1a, 0x9f, 0xa8, 0xf1, 0xc6,
+        0x3a, 0x0d, 0x54, 0x63, 0xe6, 0xd1, 0x88, 0xbf,
+        0xde, 0xe9, 0xb0, 0x87, 0x02, 0x35, 0x6c, 0x5b,
+        0xa7, 0x90, 0xc9, 0xfe, 0x7b, 0x4c, 0x15, 0x22,
+        0x2c, 0x1b, 0x42, 0x75, 0xf0, 0xc7, 0x9e, 0xa9,
+        0x55, 0x62, 0x3b, 0x0c, 0x89, 0xbe, 0xe7, 0xd0,
+        0xfb, 0xcc, 0x95, 0xa2, 0x27, 0x10, 0x49, 0x7e,
+        0x82, 0xb5, 0xec, 0xdb, 0x5e, 0x69, 0x30, 0x07,
+        0x09, 0x3e, 0x67, 0x50, 0xd5, 0xe2, 0xbb, 0x8c,
+        0x70, 0x47, 0x1e, 0x29, 0xac, 0x9b, 0xc2, 0xf5
+    },
+    {
+        0x00, 0x51, 0xa2, 0xf3, 0x85, 0xd4, 0x27, 0x76,
+        0xcb, 0x9a, 0x69, 0x38, 0x4e, 0x1f, 0xec, 0xbd,
+        0x57, 0x06, 0xf5, 0xa4, 0xd2, 0x83, 0x70, 0x21,
+        0x9c, 0xcd, 0x3e, 0x6f, 0x19, 0x48, 0xbb, 0xea,
+        0xae, 0xff, 0x0c, 0x5d, 0x2b, 0x7a, 0x89, 0xd8,
+        0x65, 0x34, 0xc7, 0x96, 0xe0, 0xb1, 0x42, 0x13,
+        0xf9, 0xa8, 0x5b, 0x0a, 0x7c, 0x2d, 0xde, 0x8f,
+        0x32, 0x63, 0x90, 0xc1, 0xb7, 0xe6, 0x15, 0x44,
+        0x9d, 0xcc, 0x3f, 0x6e, 0x18, 0x49, 0xba, 0xeb,
+        0x56, 0x07, 0xf4, 0xa5, 0xd3, 0x82, 0x71, 0x20,
+        0xca, 0x9b, 0x68, 0x39, 0x4f, 0x1e, 0xed, 0xbc,
+        0x01, 0x50, 0xa3, 0xf2, 0x84, 0xd5, 0x26, 0x77,
+        0x33, 0x62, 0x91, 0xc0, 0xb6, 0xe7, 0x14, 0x45,
+        0xf8, 0xa9, 0x5a, 0x0b, 0x7d, 0x2c, 0xdf, 0x8e,
+        0x64, 0x35, 0xc6, 0x97, 0xe1, 0xb0, 0x43, 0x12,
+        0xaf, 0xfe, 0x0d, 0x5c, 0x2a, 0x7b, 0x88, 0xd9,
+        0xfb, 0xaa, 0x59, 0x08, 0x7e, 0x2f, 0xdc, 0x8d,
+        0x30, 0x61, 0x92, 0xc3, 0xb5, 0xe4, 0x17, 0x46,
+        0xac, 0xfd, 0x0e, 0x5f, 0x29, 0x78, 0x8b, 0xda,
+        0x67, 0x36, 0xc5, 0x94, 0xe2, 0xb3, 0x40, 0x11,
+        0x55, 0x04, 0xf7, 0xa6, 0xd0, 0x81, 0x72, 0x23,
+        0x9e, 0xcf, 0x3c, 0x6d, 0x1b, 0x4a, 0xb9, 0xe8,
+        0x02, 0x53, 0xa0, 0xf1, 0x87, 0xd6, 0x25, 0x74,
+        0xc9, 0x98, 0x6b, 0x3a, 0x4c, 0x1d, 0xee, 0xbf,
+        0x66, 0x37, 0xc4, 0x95, 0xe3, 0xb2, 0x41, 0x10,
+        0xad, 0xfc, 0x0f, 0x5e, 0x28, 0x79, 0x8a, 0xdb,
+        0x31, 0x60, 0x93, 0xc2, 0xb4, 0xe5, 0x16, 0x47,
+        0xfa, 0xab, 0x58, 0x09, 0x7f, 0x2e, 0xdd, 0x8c,
+        0xc8, 0x99, 0x6a, 0x3b, 0x4d, 0x1c, 0xef, 0xbe,
+        0x03, 0x52, 0xa1, 0xf0, 0x86, 0xd7, 0x24, 0x75,
+        0x9f, 0xce, 0x3d, 0x6c, 0x1a, 0x4b, 0xb8, 0xe9,
+        0x54, 0x05, 0xf6, 0xa7, 0xd1, 0x80, 0x73, 0x22
+    },
+    {
+        0x00, 0xfd, 0x3b, 0xc6, 0x76, 0x8b, 0x4d, 0xb0,
+        0xec, 0x11, 0xd7, 0x2a, 0x9a, 0x67, 0xa1, 0x5c,
+        0x19, 0xe4, 0x22, 0xdf, 0x6f, 0x92, 0x54, 0xa9,
+        0xf5, 0x08, 0xce, 0x33, 0x83, 0x7e, 0xb8, 0x45,
+        0x32, 0xcf, 0x09, 0xf4, 0x44, 0xb9, 0x7f, 0x82,
+        0xde, 0x23, 0xe5, 0x18, 0xa8, 0x55, 0x93, 0x6e,
+        0x2b, 0xd6, 0x10, 0xed, 0x5d, 0xa0, 0x66, 0x9b,
+        0xc7, 0x3a, 0xfc, 0x01, 0xb1, 0x4c, 0x8a, 0x77,
+        0x64, 0x99, 0x5f, 0xa2, 0x12, 0xef, 0x29, 0xd4,
+        0x88, 0x75, 0xb3, 0x4e, 0xfe, 0x03, 0xc5, 0x38,
+        0x7d, 0x80, 0x46, 0xbb, 0x0b, 0xf6, 0x30, 0xcd,
+        0x91, 0x6c, 0xaa, 0x57, 0xe7, 0x1a, 0xdc, 0x21,
+        0x56, 0xab, 0x6d, 0x90, 0x20, 0xdd, 0x1b, 0xe6,
+        0xba, 0x47, 0x81, 0x7c, 0xcc, 0x31, 0xf7, 0x0a,
+        0x4f, 0xb2, 0x74, 0x89, 0x39, 0xc4, 0x02, 0xff,
+        0xa3, 0x5e, 0x98, 0x65, 0xd5, 0x28, 0xee, 0x13,
+        0xc8, 0x35, 0xf3, 0x0e, 0xbe, 0x43, 0x85, 0x78,
+        0x24, 0xd9, 0x1f, 0xe2, 0x52, 0xaf, 0x69, 0x94,
+        0xd1, 0x2c, 0xea, 0x17, 0xa7, 0x5a, 0x9c, 0x61,
+        0x3d, 0xc0, 0x06, 0xfb, 0x4b, 0xb6, 0x70, 0x8d,
+        0xfa, 0x07, 0xc1, 0x3c, 0x8c, 0x71, 0xb7, 0x4a,
+        0x16, 0xeb, 0x2d, 0xd0, 0x60, 0x9d, 0x5b, 0xa6,
+        0xe3, 0x1e, 0xd8, 0x25, 0x95, 0x68, 0xae, 0x53,
+        0x0f, 0xf2, 0x34, 0xc9, 0x79, 0x84, 0x42, 0xbf,
+        0xac, 0x51, 0x97, 0x6a, 0xda, 0x27, 0xe1, 0x1c,
+        0x40, 0xbd, 0x7b, 0x86, 0x36, 0xcb, 0x0d, 0xf0,
+        0xb5, 0x48, 0x8e, 0x73, 0xc3, 0x3e, 0xf8, 0x05,
+        0x59, 0xa4, 0x62, 0x9f, 0x2f, 0xd2, 0x14, 0xe9,
+        0x9e, 0x63, 0xa5, 0x58, 0xe8, 0x15, 0xd3, 0x2e,
+        0x72, 0x8f, 0x49, 0xb4, 0x04, 0xf9, 0x3f, 0xc2,
+        0x87, 0x7a, 0xbc, 0x41, 0xf1, 0x0c, 0xca, 0x37,
+        0x6b, 0x96, 0x50, 0xad, 0x1d, 0xe0, 0x26, 0xdb
+    }
+};
+
+
+
+/* The method of RMAPCRC_Update() */
+static int RMAPCRC_method = RMAPCRC_DEFAULT_METHOD;
+#if RMAPCRC_DEFAULT_METHOD == RMAPCRC_METHOD_TABLE
+static U8 (*RMAPCRC_update)(U8, const U8 * const, const U32) =
+    RMAPCRC_UpdateTable;
+#else
+static U8 (*RMAPCRC_update)(U8, const U8 * const, const U32) =
+    RMAPCRC_UpdateSlice8;
+#endif
+
+
+
+/* Continue a CRC a byte at a time */
+U8 RMAPCRC_UpdateTable(U8 crc, const U8 * const pData, const U32 length)
+{
+    U32 i;
+
+    for (i = 0U; i < length; i++)
+    {
+        crc = RMAPCRC_Table[crc ^ pData[i]];
+    }
+
+    return crc;
+}
+
+
+
+/* Continue a CRC 8 bytes at a time, the rest a byte at a time */
+U8 RMAPCRC_UpdateSlice8(U8 crc, const U8 * const pData, const U32 length)
+{
+    const U8 *p = pData;
+    const U8 * const pEnd = pData + length;
+
+    while (pEnd - p >= RMAPCRC_SLICE)
+    {
+        crc = RMAPCRC_Slice[6][crc ^ p[0]] ^ RMAPCRC_Slice[5][p[1]] ^
+            RMAPCRC_Slice[4][p[2]] ^ RMAPCRC_Slice[3][p[3]] ^
+            RMAPCRC_Slice[2][p[4]] ^ RMAPCRC_Slice[1][p[5]] ^
+            RMAPCRC_Slice[0][p[6]] ^ RMAPCRC_Table[p[7]];
+        p += RMAPCRC_SLICE;
+    }
+
+    while (p < pEnd)
+    {
+        crc = RMAPCRC_Table[crc ^ *p++];
+    }
+
+    return crc;
+}
+
+
+
+/**
+ * Choose the method of RMAPCRC_Update(). Not thread safe: call it before
+ * any thread computes a CRC.
+ *
+ * @param method RMAPCRC_METHOD_TABLE or RMAPCRC_METHOD_SLICE8
+ *
+ * @return 1 on success, 0 if the method is unknown
+ */
+int RMAPCRC_SetMethod(const int method)
+{
+    switch (method)
+    {
+    case RMAPCRC_METHOD_TABLE:
+        RMAPCRC_update = RMAPCRC_UpdateTable;
+        break;
+    case RMAPCRC_METHOD_SLICE8:
+        RMAPCRC_update = RMAPCRC_UpdateSlice8;
+        break;
+    default:
+        puts("RMAPCRC_SetMethod: Unknown method");
+        return 0;
+    }
+
+    RMAPCRC_method = method;
+    return 1;
+}
+
+
+
+int RMAPCRC_GetMethod(void)
+{
+    return RMAPCRC_method;
+}
+
+
+
+const char *RMAPCRC_MethodString(const int method)
+{
+    switch (method)
+    {
+    case RMAPCRC_METHOD_TABLE:
+        return "table";
+    case RMAPCRC_METHOD_SLICE8:
+        return "slice8";
+    default:
+        return "unknown";
+    }
+}
+
+
+
+/**
+ * Continue a CRC over more bytes.
+ *
+ * @param crc the CRC of the bytes before, 0 to start
+ * @param pData the bytes
+ * @param length the number of bytes
+ *
+ * @return the updated CRC
+ */
+U8 RMAPCRC_Update(U8 crc, const U8 * const pData, const U32 length)
+{
+    return RMAPCRC_update(crc, pData, length);
+}
+
+
+
+U8 RMAPCRC_Calculate(const U8 * const pData, const U32 length)
+{
+    return RMAPCRC_update(0U, pData, length);
+}
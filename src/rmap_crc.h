@@ -0,0 +1,51 @@
+/*
+  @file rmap_crc.h
+  @author Juan Manuel Gómez
+  @brief CRC-8 of the RMAP protocol (ECSS-E-ST-50-52C, section 5.2).
+  @details Polynomial x^8 + x^2 + x + 1, bit-reversed (0xE0), initial
+           value 0. Computing the CRC of a header or data field followed
+           by its CRC byte gives 0, which is how received packets are
+           checked.
+
+           RMAPCRC_Update() runs one of two methods: the byte table of the
+           standard, or slice-by-8, which looks up 8 bytes in 8 tables at
+           once and is the faster one on data fields past a few dozen
+           bytes. Both give the same CRC. The method is chosen at build
+           time with RMAPCRC_DEFAULT_METHOD and can be changed at run time
+           with RMAPCRC_SetMethod(), before any thread computes a CRC.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef RMAP_CRC_H
+#define RMAP_CRC_H
+
+#include "star-dundee_types.h"
+
+/* Methods of RMAPCRC_Update() */
+#define RMAPCRC_METHOD_TABLE 0
+#define RMAPCRC_METHOD_SLICE8 1
+
+#ifndef RMAPCRC_DEFAULT_METHOD
+#define RMAPCRC_DEFAULT_METHOD RMAPCRC_METHOD_SLICE8
+#endif
+
+/* Bytes looked up at once by the slice-by-8 method */
+#define RMAPCRC_SLICE 8
+
+extern const U8 RMAPCRC_Table[256];
+
+U8 RMAPCRC_UpdateTable(U8 crc, const U8 * const pData, const U32 length);
+
+U8 RMAPCRC_UpdateSlice8(U8 crc, const U8 * const pData, const U32 length);
+
+int RMAPCRC_SetMethod(const int method);
+
+int RMAPCRC_GetMethod(void);
+
+const char *RMAPCRC_MethodString(const int method);
+
+U8 RMAPCRC_Update(U8 crc, const U8 * const pData, const U32 length);
+
+U8 RMAPCRC_Calculate(const U8 * const pData, const U32 length);
+
+#endif
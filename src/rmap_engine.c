@@ -0,0 +1,804 @@
+/*
+  @file rmap_engine.c
+  @author Juan Manuel Gómez
+  @brief Batched RMAP register writes and reads with verified replies.
+  @details See rmap_engine.h.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rmap_engine.h"
+#include "rmap_crc.h"
+#include "rx_view.h"
+#include "op_timing.h"
+#include "utility.h"
+
+#define RMAPENG_PROTOCOL_ID 0x01U
+#define RMAPENG_WRITE_REPLY_LENGTH 8U
+/* Read reply header: the write reply fields, reserved byte, data length */
+#define RMAPENG_READ_REPLY_HEADER 12U
+#define RMAPENG_READ_LENGTH 4U
+
+/* Instruction field of a reply: packet type 00 (reply), write bit */
+#define RMAPENG_INSTRUCTION_TYPE_MASK 0xC0U
+#define RMAPENG_INSTRUCTION_WRITE 0x20U
+
+typedef struct
+{
+    STAR_TRANSFER_OPERATION *pOp;
+    STAR_STREAM_ITEM **pItems;
+    U32 itemCount;
+    OPTIME_STAMP stamp;
+} RMAPENG_TX;
+
+typedef struct
+{
+    STAR_TRANSFER_OPERATION *pOp;
+    U32 slots;
+    OPTIME_STAMP stamp;
+} RMAPENG_RX;
+
+typedef struct
+{
+    RMAPENG_TX *pTx;
+    RMAPENG_RX *pRx;
+    U32 capacity;
+    U32 txHead;
+    U32 txCount;
+    U32 rxHead;
+    U32 rxCount;
+    U32 posted;
+    U32 pending;
+    U16 firstTransactionId;
+    RXVIEW view;
+} RMAPENG_STATE;
+
+
+/* Status byte of a reply, ECSS-E-ST-50-52C table 5-4 */
+static const char *RMAPENG_statusString(const U8 status)
+{
+    switch (status)
+    {
+    case 0:
+        return "Command executed successfully";
+    case 1:
+        return "General error code";
+    case 2:
+        return "Unused RMAP packet type or command code";
+    case 3:
+        return "Invalid key";
+    case 4:
+        return "Invalid data CRC";
+    case 5:
+        return "Early EOP";
+    case 6:
+        return "Too much data";
+    case 7:
+        return "EEP";
+    case 9:
+        return "Verify buffer overrun";
+    case 10:
+        return "RMAP command not implemented or not authorised";
+    case 11:
+        return "RMW data length error";
+    case 12:
+        return "Invalid target logical address";
+    default:
+        return "Reserved status code";
+    }
+}
+
+
+/**
+ * Check a write reply, or a read reply of RMAPENG_READ_LENGTH bytes, and
+ * extract its transaction ID, status and type. The data of a read reply is
+ * copied to pValue. Path bytes left ahead of the initiator logical address
+ * are skipped.
+ *
+ * @return 1 if the packet is a valid reply, 0 otherwise
+ */
+static int RMAPENG_parseReply(const U8 *pData, U32 length,
+    U16 * const pTransactionId, U8 * const pStatus, int * const pRead,
+    U8 * const pValue)
+{
+    U32 dataLength;
+
+    while ((length > RMAPENG_WRITE_REPLY_LENGTH) && (pData[0] < 32U))
+    {
+        pData++;
+        length--;
+    }
+
+    if ((length < RMAPENG_WRITE_REPLY_LENGTH) ||
+        (pData[1] != RMAPENG_PROTOCOL_ID) ||
+        ((pData[2] & RMAPENG_INSTRUCTION_TYPE_MASK) != 0U))
+    {
+        return 0;
+    }
+
+    *pRead = ((pData[2] & RMAPENG_INSTRUCTION_WRITE) == 0U);
+    if (!*pRead)
+    {
+        if ((length != RMAPENG_WRITE_REPLY_LENGTH) ||
+            (RMAPCRC_Calculate(pData, RMAPENG_WRITE_REPLY_LENGTH) != 0U))
+        {
+            return 0;
+        }
+    }
+    else
+    {
+        if ((length < RMAPENG_READ_REPLY_HEADER) ||
+            (RMAPCRC_Calculate(pData, RMAPENG_READ_REPLY_HEADER) != 0U))
+        {
+            return 0;
+        }
+
+        /* A failed read may carry no data */
+        dataLength = ((U32)pData[8] << 16) | ((U32)pData[9] << 8) | pData[10];
+        if ((pData[3] == 0U) && ((dataLength != RMAPENG_READ_LENGTH) ||
+            (length != RMAPENG_READ_REPLY_HEADER + RMAPENG_READ_LENGTH + 1U) ||
+            (RMAPCRC_Calculate(pData + RMAPENG_READ_REPLY_HEADER,
+                RMAPENG_READ_LENGTH + 1U) != 0U)))
+        {
+            return 0;
+        }
+        if (pData[3] == 0U)
+        {
+            memcpy(pValue, pData + RMAPENG_READ_REPLY_HEADER,
+                RMAPENG_READ_LENGTH);
+        }
+    }
+
+    *pStatus = pData[3];
+    *pTransactionId = (U16)((pData[5] << 8) | pData[6]);
+    return 1;
+}
+
+
+/* Find the pending access of a transaction ID */
+static RMAPENG_ACCESS *RMAPENG_find(RMAPENG_ACCESS * const pAccesses,
+    const U32 count, const U16 firstTransactionId, const U16 transactionId)
+{
+    U32 i;
+
+    for (i = (U16)(transactionId - firstTransactionId); i < count;
+        i += 0x10000U)
+    {
+        if ((pAccesses[i].transactionId == transactionId) &&
+            (pAccesses[i].result == RMAPENG_PENDING))
+        {
+            return &pAccesses[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+/* Match the replies held by a receive operation, return the accesses matched */
+static U32 RMAPENG_harvest(RMAPENG * const pEngine, RMAPENG_STATE * const pState,
+    RMAPENG_ACCESS * const pAccesses, const U32 count,
+    STAR_TRANSFER_OPERATION * const pOp, const unsigned long long nowNs)
+{
+    RMAPENG_ACCESS *pAccess;
+    const U8 *pData;
+    U32 itemCount, length, matched = 0U, i;
+    U16 transactionId;
+    U8 status, value[RMAPENG_READ_LENGTH];
+    int read;
+
+    memset(value, 0, sizeof(value));
+    itemCount = RXVIEW_Map(&pState->view, pOp);
+    for (i = 0U; i < itemCount; i++)
+    {
+        pData = RXVIEW_Packet(&pState->view, i, &length);
+        if ((pData == NULL) ||
+            !RMAPENG_parseReply(pData, length, &transactionId, &status,
+                &read, value))
+        {
+            pEngine->repliesUnmatched++;
+            continue;
+        }
+
+        pAccess = RMAPENG_find(pAccesses, count, pState->firstTransactionId,
+            transactionId);
+        if ((pAccess == NULL) || (pAccess->read != read))
+        {
+            pEngine->repliesUnmatched++;
+            continue;
+        }
+
+        pAccess->replyStatus = status;
+        if (read && (status == 0U))
+        {
+            memcpy(pAccess->value, value, RMAPENG_READ_LENGTH);
+        }
+        pAccess->result = (status == 0U) ? RMAPENG_OK : RMAPENG_REPLY_ERROR;
+        pAccess->latencyNs = nowNs - pAccess->sentNs;
+        matched++;
+    }
+    RXVIEW_Release(&pState->view);
+
+    return matched;
+}
+
+
+/* Post a receive operation for `slots` more replies */
+static int RMAPENG_postReplies(RMAPENG * const pEngine,
+    RMAPENG_STATE * const pState, const U32 slots)
+{
+    RMAPENG_RX *pRx;
+
+    if (pState->rxCount == pState->capacity)
+    {
+        return 0;
+    }
+
+    pRx = &pState->pRx[(pState->rxHead + pState->rxCount) % pState->capacity];
+    pRx->pOp = STAR_createRxOperation(slots, STAR_RECEIVE_PACKETS);
+    if (pRx->pOp == NULL)
+    {
+        return 0;
+    }
+    if (OPTIME_Submit(&pRx->stamp, pEngine->rxChannelId, OPTIME_RX,
+        pRx->pOp) == 0)
+    {
+        STAR_disposeTransferOperation(pRx->pOp);
+        pRx->pOp = NULL;
+        return 0;
+    }
+
+    pRx->slots = slots;
+    pState->rxCount++;
+    pState->posted += slots;
+    return 1;
+}
+
+
+/* Release the items and the operation of a transmitted chunk */
+static void RMAPENG_disposeTx(RMAPENG_TX * const pTx)
+{
+    U32 i;
+
+    if (pTx->pOp != NULL)
+    {
+        STAR_disposeTransferOperation(pTx->pOp);
+        pTx->pOp = NULL;
+    }
+    for (i = 0U; i < pTx->itemCount; i++)
+    {
+        if (pTx->pItems[i] != NULL)
+        {
+            STAR_destroyStreamItem(pTx->pItems[i]);
+            pTx->pItems[i] = NULL;
+        }
+    }
+    pTx->itemCount = 0U;
+}
+
+
+/* Build and submit the commands of pAccesses[0..n) as one transmit operation */
+static int RMAPENG_sendChunk(RMAPENG * const pEngine,
+    RMAPENG_STATE * const pState, RMAPENG_ACCESS * const pAccesses, const U32 n)
+{
+    RMAPENG_TX *pTx;
+    unsigned long length;
+    unsigned long long nowNs;
+    U32 i;
+
+    pTx = &pState->pTx[(pState->txHead + pState->txCount) % pState->capacity];
+    for (i = 0U; i < n; i++)
+    {
+        length = RMAPTPL_Fill(pAccesses[i].read ? &pEngine->readTemplate :
+            &pEngine->writeTemplate, pAccesses[i].transactionId,
+            pAccesses[i].address, pAccesses[i].value, pEngine->command);
+        pTx->pItems[i] = STAR_createPacket(NULL, pEngine->command, (U32)length,
+            STAR_EOP_TYPE_EOP);
+        if (pTx->pItems[i] == NULL)
+        {
+            break;
+        }
+    }
+    pTx->itemCount = i;
+
+    if (i == n)
+    {
+        pTx->pOp = STAR_createTxOperation(pTx->pItems, n);
+    }
+    if ((pTx->pOp == NULL) ||
+        (OPTIME_Submit(&pTx->stamp, pEngine->txChannelId, OPTIME_TX,
+            pTx->pOp) == 0))
+    {
+        RMAPENG_disposeTx(pTx);
+        return 0;
+    }
+
+    nowNs = MonotonicTimeNs();
+    for (i = 0U; i < n; i++)
+    {
+        pAccesses[i].sentNs = nowNs;
+    }
+    pState->txCount++;
+    return 1;
+}
+
+
+/* Dispose of the transmit operations that are done, or all of them */
+static void RMAPENG_reapTx(RMAPENG * const pEngine,
+    RMAPENG_STATE * const pState, const int all)
+{
+    RMAPENG_TX *pTx;
+
+    while (pState->txCount > 0U)
+    {
+        pTx = &pState->pTx[pState->txHead];
+        if (all)
+        {
+            OPTIME_Wait(&pTx->stamp, pTx->pOp, pEngine->timeout);
+        }
+        else if (STAR_getTransferStatus(pTx->pOp) ==
+            STAR_TRANSFER_STATUS_STARTED)
+        {
+            break;
+        }
+        else
+        {
+            OPTIME_Complete(&pTx->stamp);
+        }
+
+        RMAPENG_disposeTx(pTx);
+        pState->txHead = (pState->txHead + 1U) % pState->capacity;
+        pState->txCount--;
+    }
+}
+
+
+static void RMAPENG_freeState(RMAPENG_STATE * const pState)
+{
+    U32 i;
+
+    RXVIEW_Free(&pState->view);
+    if (pState->pTx != NULL)
+    {
+        for (i = 0U; i < pState->capacity; i++)
+        {
+            free(pState->pTx[i].pItems);
+        }
+    }
+    free(pState->pTx);
+    free(pState->pRx);
+    memset(pState, 0, sizeof(RMAPENG_STATE));
+}
+
+
+/* Allocate the operation rings, each transmit slot holding up to chunk items */
+static int RMAPENG_allocState(RMAPENG_STATE * const pState,
+    const U32 capacity, const U32 chunk)
+{
+    U32 i;
+
+    memset(pState, 0, sizeof(RMAPENG_STATE));
+    RXVIEW_Init(&pState->view);
+    pState->capacity = capacity;
+    pState->pTx = (RMAPENG_TX *)calloc(capacity, sizeof(RMAPENG_TX));
+    pState->pRx = (RMAPENG_RX *)calloc(capacity, sizeof(RMAPENG_RX));
+    if ((pState->pTx == NULL) || (pState->pRx == NULL))
+    {
+        RMAPENG_freeState(pState);
+        return 0;
+    }
+
+    for (i = 0U; i < capacity; i++)
+    {
+        pState->pTx[i].pItems = (STAR_STREAM_ITEM **)calloc(chunk,
+            sizeof(STAR_STREAM_ITEM *));
+        if (pState->pTx[i].pItems == NULL)
+        {
+            RMAPENG_freeState(pState);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/**
+ * Give up on the replies still outstanding. The receive operations are
+ * cancelled, the replies they already hold are matched and the accesses still
+ * pending are marked as timed out.
+ */
+static void RMAPENG_abortReplies(RMAPENG * const pEngine,
+    RMAPENG_STATE * const pState, RMAPENG_ACCESS * const pAccesses,
+    const U32 count, const U32 sent)
+{
+    RMAPENG_RX *pRx;
+    unsigned long long nowNs = MonotonicTimeNs();
+    U32 i;
+
+    while (pState->rxCount > 0U)
+    {
+        pRx = &pState->pRx[pState->rxHead];
+        STAR_cancelTransferOperation(pRx->pOp);
+        RMAPENG_harvest(pEngine, pState, pAccesses, count, pRx->pOp, nowNs);
+        STAR_disposeTransferOperation(pRx->pOp);
+        pRx->pOp = NULL;
+        pState->rxHead = (pState->rxHead + 1U) % pState->capacity;
+        pState->rxCount--;
+    }
+    pState->posted = 0U;
+
+    for (i = 0U; i < sent; i++)
+    {
+        if (pAccesses[i].result == RMAPENG_PENDING)
+        {
+            pAccesses[i].result = RMAPENG_TIMEOUT;
+        }
+    }
+    pState->pending = 0U;
+}
+
+
+
+/* Build the command templates for the addresses and key of the engine */
+static int RMAPENG_makeTemplates(RMAPENG * const pEngine)
+{
+    return RMAPTPL_InitWrite(&pEngine->writeTemplate, pEngine->target,
+            pEngine->targetLength, pEngine->reply, pEngine->replyLength,
+            1, 1, 0, pEngine->key, 4) &&
+        RMAPTPL_InitRead(&pEngine->readTemplate, pEngine->target,
+            pEngine->targetLength, pEngine->reply, pEngine->replyLength,
+            1, pEngine->key, RMAPENG_READ_LENGTH);
+}
+
+
+
+/**
+ * Prepare an engine for the GR718 configuration port or any RMAP target.
+ *
+ * @param pEngine the engine to initialise
+ * @param txChannelId the channel the commands are sent on
+ * @param rxChannelId the channel the replies come back on
+ * @param pTarget the target address: path bytes then the target logical
+ *        address
+ * @param targetLength the length of pTarget
+ * @param pReply the reply address: path bytes then the initiator logical
+ *        address
+ * @param replyLength the length of pReply
+ *
+ * @return 1 on success, 0 if an address is too long
+ */
+int RMAPENG_Init(RMAPENG * const pEngine, const STAR_CHANNEL_ID txChannelId,
+    const STAR_CHANNEL_ID rxChannelId, const U8 * const pTarget,
+    const U32 targetLength, const U8 * const pReply, const U32 replyLength)
+{
+    memset(pEngine, 0, sizeof(RMAPENG));
+    if ((targetLength == 0U) || (targetLength > RMAPENG_MAX_ADDRESS) ||
+        (replyLength == 0U) || (replyLength > RMAPENG_MAX_ADDRESS))
+    {
+        puts("RMAPENG_Init: Invalid target or reply address length");
+        return 0;
+    }
+
+    pEngine->txChannelId = txChannelId;
+    pEngine->rxChannelId = rxChannelId;
+    memcpy(pEngine->target, pTarget, targetLength);
+    pEngine->targetLength = targetLength;
+    memcpy(pEngine->reply, pReply, replyLength);
+    pEngine->replyLength = replyLength;
+    if (!RMAPENG_makeTemplates(pEngine))
+    {
+        puts("RMAPENG_Init: Invalid target or reply address");
+        return 0;
+    }
+    pEngine->window = RMAPENG_DEFAULT_WINDOW;
+    pEngine->chunk = RMAPENG_DEFAULT_CHUNK;
+    pEngine->timeout = RMAPENG_DEFAULT_TIMEOUT;
+
+    return 1;
+}
+
+
+
+/* Set a write of the 4 bytes at pValue (big endian, as sent) to address */
+void RMAPENG_SetWrite(RMAPENG_ACCESS * const pAccess, const U32 address,
+    const U8 * const pValue)
+{
+    memset(pAccess, 0, sizeof(RMAPENG_ACCESS));
+    pAccess->address = address;
+    memcpy(pAccess->value, pValue, sizeof(pAccess->value));
+}
+
+
+
+/* Set a read of the register at address */
+void RMAPENG_SetRead(RMAPENG_ACCESS * const pAccess, const U32 address)
+{
+    memset(pAccess, 0, sizeof(RMAPENG_ACCESS));
+    pAccess->address = address;
+    pAccess->read = 1U;
+}
+
+
+
+/**
+ * Perform a list of register writes and reads and wait for all their
+ * replies.
+ *
+ * @param pEngine an initialised engine
+ * @param pAccesses the accesses; their result, reply status and latency
+ *        are updated, and the value of the reads that succeed
+ * @param count the number of accesses
+ *
+ * @return the number of accesses that did not succeed
+ */
+unsigned long RMAPENG_Transfer(RMAPENG * const pEngine,
+    RMAPENG_ACCESS * const pAccesses, const U32 count)
+{
+    RMAPENG_STATE state;
+    RMAPENG_RX *pRx;
+    STAR_TRANSFER_STATUS status;
+    unsigned long failed = 0UL;
+    unsigned int window, chunk;
+    U32 next = 0U, n, i;
+
+    if (count == 0U)
+    {
+        return 0UL;
+    }
+
+    window = (pEngine->window > 0U) ? pEngine->window : RMAPENG_DEFAULT_WINDOW;
+    chunk = (pEngine->chunk > 0U) ? pEngine->chunk : RMAPENG_DEFAULT_CHUNK;
+    if (chunk > window)
+    {
+        chunk = window;
+    }
+
+    if ((pEngine->writeTemplate.key != pEngine->key) &&
+        !RMAPENG_makeTemplates(pEngine))
+    {
+        return count;
+    }
+
+    /* Room for the chunks a full window holds, one more being sent and a
+     * receive operation posted again for slots taken by other packets */
+    if (!RMAPENG_allocState(&state, (window + chunk - 1U) / chunk + 2U,
+        chunk))
+    {
+        puts("RMAPENG_Transfer: Unable to allocate the engine state");
+        return count;
+    }
+
+    state.firstTransactionId = pEngine->nextTransactionId;
+    for (i = 0U; i < count; i++)
+    {
+        pAccesses[i].transactionId = pEngine->nextTransactionId++;
+        pAccesses[i].result = RMAPENG_PENDING;
+        pAccesses[i].replyStatus = 0U;
+        pAccesses[i].latencyNs = 0ULL;
+    }
+
+    while ((next < count) || (state.pending > 0U))
+    {
+        /* Fill the window, replies buffer first */
+        while ((next < count) && (state.pending < window) &&
+            (state.txCount < state.capacity))
+        {
+            n = count - next;
+            if (n > chunk)
+            {
+                n = chunk;
+            }
+            if (n > window - state.pending)
+            {
+                n = window - state.pending;
+            }
+            /* Chunks cut short by the window may take more receive
+             * operations than the ring holds: send what the slots already
+             * posted take, or wait for the oldest operation */
+            if ((state.posted < state.pending + n) &&
+                (state.rxCount == state.capacity))
+            {
+                if (state.posted <= state.pending)
+                {
+                    break;
+                }
+                n = state.posted - state.pending;
+            }
+
+            if (((state.posted >= state.pending + n) ||
+                RMAPENG_postReplies(pEngine, &state,
+                    state.pending + n - state.posted)) &&
+                RMAPENG_sendChunk(pEngine, &state, pAccesses + next, n))
+            {
+                state.pending += n;
+            }
+            else
+            {
+                for (i = next; i < next + n; i++)
+                {
+                    pAccesses[i].result = RMAPENG_TX_ERROR;
+                }
+            }
+            next += n;
+        }
+
+        RMAPENG_reapTx(pEngine, &state, 0);
+        if (state.pending == 0U)
+        {
+            continue;
+        }
+
+        /* Unrelated packets took slots meant for replies */
+        if ((state.posted < state.pending) &&
+            !RMAPENG_postReplies(pEngine, &state,
+                state.pending - state.posted))
+        {
+            RMAPENG_abortReplies(pEngine, &state, pAccesses, count, next);
+            continue;
+        }
+
+        /* Wait for the oldest receive operation */
+        pRx = &state.pRx[state.rxHead];
+        status = OPTIME_Wait(&pRx->stamp, pRx->pOp, pEngine->timeout);
+        if (status != STAR_TRANSFER_STATUS_COMPLETE)
+        {
+            RMAPENG_abortReplies(pEngine, &state, pAccesses, count, next);
+            continue;
+        }
+
+        state.pending -= RMAPENG_harvest(pEngine, &state, pAccesses, count,
+            pRx->pOp, MonotonicTimeNs());
+        OPTIME_Consumed(&pRx->stamp);
+        state.posted -= pRx->slots;
+        STAR_disposeTransferOperation(pRx->pOp);
+        pRx->pOp = NULL;
+        state.rxHead = (state.rxHead + 1U) % state.capacity;
+        state.rxCount--;
+    }
+
+    /* Slots left over by chunks that failed to transmit */
+    RMAPENG_abortReplies(pEngine, &state, pAccesses, count, count);
+    RMAPENG_reapTx(pEngine, &state, 1);
+
+    for (i = 0U; i < count; i++)
+    {
+        if (pAccesses[i].result == RMAPENG_OK)
+        {
+            pEngine->accessesOk++;
+        }
+        else
+        {
+            pEngine->accessesFailed++;
+            failed++;
+        }
+    }
+
+    RMAPENG_freeState(&state);
+
+    return failed;
+}
+
+
+
+/**
+ * Read a list of registers with one transmit operation holding all the read
+ * commands and one receive operation for all the replies, posted before it.
+ *
+ * @param pEngine an initialised engine
+ * @param pAddresses the registers to read
+ * @param count the number of registers
+ * @param pAccesses room for count accesses, which get the result, reply
+ *        status and latency of every read
+ * @param pValues the value of every register, in the order of pAddresses,
+ *        0 for those that could not be read
+ *
+ * @return the number of registers that could not be read
+ */
+unsigned long RMAPENG_ReadRegisters(RMAPENG * const pEngine,
+    const U32 * const pAddresses, const U32 count,
+    RMAPENG_ACCESS * const pAccesses, U32 * const pValues)
+{
+    const unsigned int window = pEngine->window;
+    const unsigned int chunk = pEngine->chunk;
+    unsigned long failed;
+    U32 i;
+
+    for (i = 0U; i < count; i++)
+    {
+        RMAPENG_SetRead(&pAccesses[i], pAddresses[i]);
+    }
+
+    /* The whole list is one chunk, and the window holds it */
+    pEngine->window = count;
+    pEngine->chunk = count;
+    failed = RMAPENG_Transfer(pEngine, pAccesses, count);
+    pEngine->window = window;
+    pEngine->chunk = chunk;
+
+    for (i = 0U; i < count; i++)
+    {
+        pValues[i] = 0U;
+        if (pAccesses[i].result == RMAPENG_OK)
+        {
+            pValues[i] = ((U32)pAccesses[i].value[0] << 24) |
+                ((U32)pAccesses[i].value[1] << 16) |
+                ((U32)pAccesses[i].value[2] << 8) |
+                (U32)pAccesses[i].value[3];
+        }
+    }
+
+    return failed;
+}
+
+
+
+const char *RMAPENG_ResultString(const RMAPENG_ACCESS * const pAccess)
+{
+    switch (pAccess->result)
+    {
+    case RMAPENG_PENDING:
+        return "Pending";
+    case RMAPENG_OK:
+        return "OK";
+    case RMAPENG_REPLY_ERROR:
+        return RMAPENG_statusString(pAccess->replyStatus);
+    case RMAPENG_TIMEOUT:
+        return "No reply";
+    case RMAPENG_TX_ERROR:
+        return "Not transmitted";
+    default:
+        return "Unknown";
+    }
+}
+
+
+
+/**
+ * Print the accesses that failed and the latency of the ones that succeeded.
+ */
+void RMAPENG_PrintReport(const RMAPENG_ACCESS * const pAccesses, const U32 count)
+{
+    unsigned long long minNs = 0ULL, maxNs = 0ULL, sumNs = 0ULL;
+    U32 ok = 0U, i;
+
+    for (i = 0U; i < count; i++)
+    {
+        if ((pAccesses[i].result != RMAPENG_OK) && pAccesses[i].read)
+        {
+            printf("Read  0x%08x (TID %u): %s\n", pAccesses[i].address,
+                pAccesses[i].transactionId, RMAPENG_ResultString(&pAccesses[i]));
+            continue;
+        }
+        if (pAccesses[i].result != RMAPENG_OK)
+        {
+            printf("Write 0x%08x <- %02x%02x%02x%02x (TID %u): %s\n",
+                pAccesses[i].address, pAccesses[i].value[0], pAccesses[i].value[1],
+                pAccesses[i].value[2], pAccesses[i].value[3],
+                pAccesses[i].transactionId, RMAPENG_ResultString(&pAccesses[i]));
+            continue;
+        }
+
+        if ((ok == 0U) || (pAccesses[i].latencyNs < minNs))
+        {
+            minNs = pAccesses[i].latencyNs;
+        }
+        if (pAccesses[i].latencyNs > maxNs)
+        {
+            maxNs = pAccesses[i].latencyNs;
+        }
+        sumNs += pAccesses[i].latencyNs;
+        ok++;
+    }
+
+    printf("RMAP accesses: %u verified, %u failed", ok, count - ok);
+    if (ok > 0U)
+    {
+        printf(", latency min %.1f us, mean %.1f us, max %.1f us",
+            minNs / 1e3, (sumNs / (double)ok) / 1e3, maxNs / 1e3);
+    }
+    printf(".\n");
+}
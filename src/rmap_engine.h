@@ -0,0 +1,115 @@
+/*
+  @file rmap_engine.h
+  @author Juan Manuel Gómez
+  @brief Batched RMAP register writes and reads with verified replies.
+  @details The configuration programs used to send their writes as one
+           transmit operation with the acknowledge bit clear, so a write
+           rejected by the GR718 went unnoticed. The engine takes a list of
+           writes of one register each, gives every write its own
+           transaction ID and sends them with acknowledge and
+           verify-before-write set. Reads of one register each go through
+           the same pipeline, mixed with the writes or on their own.
+
+           Accesses are pipelined: at most `window` of them are on the link
+           without a reply, sent in chunks of one transmit operation each.
+           The receive operation for the replies of a chunk is posted
+           before the chunk is transmitted, so no reply finds the channel
+           without a buffer. Replies are matched to the accesses by
+           transaction ID, whatever the order or the receive operation
+           they arrive in, and each access gets its result, the status
+           byte of its reply and its round-trip latency; a read also gets
+           the register value.
+
+           RMAPENG_ReadRegisters() reads a list of registers as a single
+           chunk: one transmit operation with every read command, after one
+           receive operation for every reply, so reading many registers
+           costs about one round trip plus the time on the wire. The values
+           come back in the order of the addresses.
+
+           The commands are built one after the other in a buffer of the
+           engine, from templates (rmap_template.h) made by RMAPENG_Init()
+           for the addresses given and made again if the key changes.
+
+           Latency is measured from the submission of the chunk to the
+           completion of the receive operation holding the reply, so it is
+           an upper bound with the granularity of one chunk. The transmit
+           and receive operations are also stamped by the timing layer
+           (op_timing.h) when it is enabled.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef RMAP_ENGINE_H
+#define RMAP_ENGINE_H
+
+#include "star-dundee_types.h"
+#include "star-api.h"
+#include "rmap_template.h"
+
+#define RMAPENG_MAX_ADDRESS 16
+#define RMAPENG_DEFAULT_WINDOW 16
+#define RMAPENG_DEFAULT_CHUNK 8
+#define RMAPENG_DEFAULT_TIMEOUT 1000
+
+/* Result of one access */
+#define RMAPENG_PENDING 0
+#define RMAPENG_OK 1
+#define RMAPENG_REPLY_ERROR 2
+#define RMAPENG_TIMEOUT 3
+#define RMAPENG_TX_ERROR 4
+
+typedef struct
+{
+    U32 address;
+    U8 value[4];          /* written, or read back */
+    U8 read;
+    U16 transactionId;
+    int result;
+    U8 replyStatus;
+    unsigned long long sentNs;
+    unsigned long long latencyNs;
+} RMAPENG_ACCESS;
+
+typedef struct
+{
+    STAR_CHANNEL_ID txChannelId;
+    STAR_CHANNEL_ID rxChannelId;
+    U8 target[RMAPENG_MAX_ADDRESS];
+    U32 targetLength;
+    U8 reply[RMAPENG_MAX_ADDRESS];
+    U32 replyLength;
+    U8 key;
+    unsigned int window;
+    unsigned int chunk;
+    int timeout;
+    U16 nextTransactionId;
+    RMAPTPL writeTemplate;
+    RMAPTPL readTemplate;
+    U8 command[RMAPTPL_MAX_LENGTH];
+
+    unsigned long accessesOk;
+    unsigned long accessesFailed;
+    unsigned long repliesUnmatched;
+} RMAPENG;
+
+int RMAPENG_Init(RMAPENG * const pEngine, const STAR_CHANNEL_ID txChannelId,
+    const STAR_CHANNEL_ID rxChannelId, const U8 * const pTarget,
+    const U32 targetLength, const U8 * const pReply, const U32 replyLength);
+
+void RMAPENG_SetWrite(RMAPENG_ACCESS * const pAccess, const U32 address,
+    const U8 * const pValue);
+
+void RMAPENG_SetRead(RMAPENG_ACCESS * const pAccess, const U32 address);
+
+unsigned long RMAPENG_Transfer(RMAPENG * const pEngine,
+    RMAPENG_ACCESS * const pAccesses, const U32 count);
+
+unsigned long RMAPENG_ReadRegisters(RMAPENG * const pEngine,
+    const U32 * const pAddresses, const U32 count,
+    RMAPENG_ACCESS * const pAccesses, U32 * const pValues);
+
+const char *RMAPENG_ResultString(const RMAPENG_ACCESS * const pAccess);
+
+void RMAPENG_PrintReport(const RMAPENG_ACCESS * const pAccesses,
+    const U32 count);
+
+#endif
@@ -0,0 +1,208 @@
+/*
+  @file rmap_template.c
+  @author Juan Manuel Gómez
+  @brief Precompiled RMAP write and read commands.
+  @details See rmap_template.h.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "rmap_template.h"
+#include "rmap_crc.h"
+#include "rmap_packet_library.h"
+
+#define RMAPTPL_PROTOCOL_ID 0x01U
+
+/* Header fields between the transaction ID and the header CRC:
+   transaction ID (2), extended address, address (4), data length (3) */
+#define RMAPTPL_PATCHED_HEADER 10U
+#define RMAPTPL_ADDRESS_FIELD 3U
+
+
+/**
+ * Locate the patched fields of the command built in pTemplate->packet, from
+ * its end: data CRC, data and header CRC. The target logical address,
+ * protocol, instruction, key and initiator logical address come before the
+ * transaction ID.
+ */
+static int RMAPTPL_locate(RMAPTPL * const pTemplate, const U8 * const pTarget,
+    const U32 targetLength, const U32 dataLength)
+{
+    const U32 headerOffset = targetLength - 1U;
+    const U32 dataFields = (dataLength > 0U) ? dataLength + 1U : 0U;
+
+    if (pTemplate->length < headerOffset + 5U + RMAPTPL_PATCHED_HEADER + 1U +
+        dataFields)
+    {
+        return 0;
+    }
+
+    pTemplate->dataLength = dataLength;
+    pTemplate->dataOffset = (U32)pTemplate->length - dataFields;
+    pTemplate->headerCrcOffset = pTemplate->dataOffset - 1U;
+    pTemplate->transactionIdOffset = pTemplate->headerCrcOffset -
+        RMAPTPL_PATCHED_HEADER;
+
+    if ((pTemplate->packet[headerOffset] != pTarget[targetLength - 1U]) ||
+        (pTemplate->packet[headerOffset + 1U] != RMAPTPL_PROTOCOL_ID) ||
+        (RMAPCRC_Calculate(pTemplate->packet + headerOffset,
+            pTemplate->dataOffset - headerOffset) != 0U))
+    {
+        return 0;
+    }
+
+    pTemplate->prefixCrc = RMAPCRC_Calculate(pTemplate->packet + headerOffset,
+        pTemplate->transactionIdOffset - headerOffset);
+    return 1;
+}
+
+
+
+/**
+ * Build the template of a write command.
+ *
+ * @param pTemplate the template to initialise
+ * @param pTarget the target address: path bytes then the target logical
+ *        address
+ * @param targetLength the length of pTarget
+ * @param pReply the reply address: path bytes then the initiator logical
+ *        address
+ * @param replyLength the length of pReply
+ * @param verify set the verify-before-write bit
+ * @param acknowledge set the acknowledge bit
+ * @param increment set the increment address bit
+ * @param key the destination key
+ * @param dataLength the number of data bytes of every command
+ *
+ * @return 1 on success, 0 if the command does not fit in a template
+ */
+int RMAPTPL_InitWrite(RMAPTPL * const pTemplate, const U8 * const pTarget,
+    const U32 targetLength, const U8 * const pReply, const U32 replyLength,
+    const int verify, const int acknowledge, const int increment,
+    const U8 key, const U32 dataLength)
+{
+    U8 data[RMAPTPL_MAX_LENGTH];
+
+    memset(pTemplate, 0, sizeof(RMAPTPL));
+    if ((targetLength == 0U) || (dataLength == 0U) ||
+        (RMAP_CalculateWriteCommandPacketLength(targetLength, replyLength,
+            dataLength, 1) > RMAPTPL_MAX_LENGTH))
+    {
+        puts("RMAPTPL_InitWrite: The command does not fit in a template");
+        return 0;
+    }
+
+    memset(data, 0, sizeof(data));
+    if (!RMAP_FillWriteCommandPacket((U8 *)pTarget, targetLength,
+        (U8 *)pReply, replyLength, (char)(verify != 0),
+        (char)(acknowledge != 0), (char)(increment != 0), key, 0, 0, 0,
+        data, dataLength, &pTemplate->length, NULL, 1, pTemplate->packet,
+        RMAPTPL_MAX_LENGTH))
+    {
+        puts("RMAPTPL_InitWrite: Unable to build the command");
+        return 0;
+    }
+
+    if (!RMAPTPL_locate(pTemplate, pTarget, targetLength, dataLength))
+    {
+        puts("RMAPTPL_InitWrite: Unexpected command layout");
+        memset(pTemplate, 0, sizeof(RMAPTPL));
+        return 0;
+    }
+    pTemplate->key = key;
+
+    return 1;
+}
+
+
+
+/**
+ * Build the template of a read command. The read length is part of the
+ * template; filling it takes no data.
+ *
+ * @param pTemplate the template to initialise
+ * @param pTarget the target address, as for RMAPTPL_InitWrite()
+ * @param targetLength the length of pTarget
+ * @param pReply the reply address, as for RMAPTPL_InitWrite()
+ * @param replyLength the length of pReply
+ * @param increment set the increment address bit
+ * @param key the destination key
+ * @param readLength the number of bytes read by every command
+ *
+ * @return 1 on success, 0 if the command does not fit in a template
+ */
+int RMAPTPL_InitRead(RMAPTPL * const pTemplate, const U8 * const pTarget,
+    const U32 targetLength, const U8 * const pReply, const U32 replyLength,
+    const int increment, const U8 key, const U32 readLength)
+{
+    memset(pTemplate, 0, sizeof(RMAPTPL));
+    if ((targetLength == 0U) || (readLength == 0U) ||
+        (RMAP_CalculateReadCommandPacketLength(targetLength, replyLength, 1) >
+            RMAPTPL_MAX_LENGTH))
+    {
+        puts("RMAPTPL_InitRead: The command does not fit in a template");
+        return 0;
+    }
+
+    if (!RMAP_FillReadCommandPacket((U8 *)pTarget, targetLength,
+        (U8 *)pReply, replyLength, (char)(increment != 0), key, 0, 0, 0,
+        readLength, &pTemplate->length, NULL, 1, pTemplate->packet,
+        RMAPTPL_MAX_LENGTH))
+    {
+        puts("RMAPTPL_InitRead: Unable to build the command");
+        return 0;
+    }
+
+    if (!RMAPTPL_locate(pTemplate, pTarget, targetLength, 0U))
+    {
+        puts("RMAPTPL_InitRead: Unexpected command layout");
+        memset(pTemplate, 0, sizeof(RMAPTPL));
+        return 0;
+    }
+    pTemplate->key = key;
+
+    return 1;
+}
+
+
+
+/**
+ * Build a command from a template.
+ *
+ * @param pTemplate a template built by RMAPTPL_InitWrite()
+ * @param transactionId the transaction ID of the command
+ * @param address the address written
+ * @param pData pTemplate->dataLength bytes of data, NULL for a read
+ * @param pBuffer at least pTemplate->length bytes
+ *
+ * @return the length of the command
+ */
+unsigned long RMAPTPL_Fill(const RMAPTPL * const pTemplate,
+    const U16 transactionId, const U32 address, const U8 * const pData,
+    U8 * const pBuffer)
+{
+    U8 * const pField = pBuffer + pTemplate->transactionIdOffset;
+    U8 * const pAddress = pField + RMAPTPL_ADDRESS_FIELD;
+
+    memcpy(pBuffer, pTemplate->packet, pTemplate->dataOffset);
+
+    pField[0] = (U8)(transactionId >> 8);
+    pField[1] = (U8)transactionId;
+    pAddress[0] = (U8)(address >> 24);
+    pAddress[1] = (U8)(address >> 16);
+    pAddress[2] = (U8)(address >> 8);
+    pAddress[3] = (U8)address;
+    pBuffer[pTemplate->headerCrcOffset] = RMAPCRC_Update(pTemplate->prefixCrc,
+        pField, RMAPTPL_PATCHED_HEADER);
+
+    if (pTemplate->dataLength > 0U)
+    {
+        memcpy(pBuffer + pTemplate->dataOffset, pData, pTemplate->dataLength);
+        pBuffer[pTemplate->dataOffset + pTemplate->dataLength] =
+            RMAPCRC_Calculate(pData, pTemplate->dataLength);
+    }
+
+    return pTemplate->length;
+}
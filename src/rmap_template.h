@@ -0,0 +1,52 @@
+/*
+  @file rmap_template.h
+  @author Juan Manuel Gómez
+  @brief Precompiled RMAP write and read commands.
+  @details The register accesses sent to one target differ only in their
+           transaction ID, address and data. A template is a command built
+           once by the RMAP packet library for a target address, reply
+           address, key, instruction and data length; filling it copies the
+           template and patches those fields.
+
+           The header CRC is resumed from the CRC of the fixed part of the
+           header (target logical address to initiator logical address),
+           stored with the template, so only the last 10 header bytes and
+           the data are run through the CRC for each command.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef RMAP_TEMPLATE_H
+#define RMAP_TEMPLATE_H
+
+#include "star-dundee_types.h"
+
+/* Longest command a template holds, header and data */
+#define RMAPTPL_MAX_LENGTH 128
+
+typedef struct
+{
+    U8 packet[RMAPTPL_MAX_LENGTH];
+    unsigned long length;
+    U32 dataLength;   /* data carried by the command, 0 for a read */
+    U8 key;
+
+    U32 transactionIdOffset;
+    U32 headerCrcOffset;
+    U32 dataOffset;
+    U8 prefixCrc;
+} RMAPTPL;
+
+int RMAPTPL_InitWrite(RMAPTPL * const pTemplate, const U8 * const pTarget,
+    const U32 targetLength, const U8 * const pReply, const U32 replyLength,
+    const int verify, const int acknowledge, const int increment,
+    const U8 key, const U32 dataLength);
+
+int RMAPTPL_InitRead(RMAPTPL * const pTemplate, const U8 * const pTarget,
+    const U32 targetLength, const U8 * const pReply, const U32 replyLength,
+    const int increment, const U8 key, const U32 readLength);
+
+unsigned long RMAPTPL_Fill(const RMAPTPL * const pTemplate,
+    const U16 transactionId, const U32 address, const U8 * const pData,
+    U8 * const pBuffer);
+
+#endif
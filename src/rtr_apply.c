@@ -0,0 +1,263 @@
+/*
+  @file rtr_apply.c
+  @author Juan Manuel Gómez
+  @brief Bring the GR718B to a desired configuration.
+  @details Reads the registers listed in a configuration file (see
+  rtr_config.h) back from the router with pipelined RMAP reads, prints
+  the registers that differ and writes only those. A register that
+  could not be read is written. With -v the registers are read again
+  after the writes to check the router converged.
+  With -s the configuration is compared with a stipa snapshot instead
+  of the router; nothing is written and no device is needed.
+  @param -f configuration file, -n only print the differences,
+  -v read back after writing, -s snapshot file to compare with.
+  @example ./rtr_apply -f la_routing.cfg -v ; ./rtr_apply -f la_routing.cfg -s gr718.snap
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "system_config.h"
+#include "utility.h"
+#include "star-dundee_types.h"
+#include "star-api.h"
+#include "cfg_api_mk2.h"
+#include "cfg_api_mk2_types.h"
+#include "cfg_api_brick_mk3.h"
+#include "rmap_engine.h"
+#include "rtr_config.h"
+#include "rtr_snapshot.h"
+
+#define VERSION_INFO "Router Apply v1.0"
+
+#define _SPW1_INTERFACE 1
+
+#define _TX_BAUDRATE_MUL 2
+#define _TX_BAUDRATE_DIV 4
+
+#define _APPLY_WINDOW 64
+
+int compareSnapshot(const RTRCFG *pConfig, const char *fname);
+int applyConfig(RMAPENG *pEngine, const RTRCFG *pConfig, int dryRun,
+                int verify);
+
+int __cdecl  main(int argc, char * argv[]){
+  STAR_DEVICE_ID* devices;
+  STAR_DEVICE_ID deviceId;
+  unsigned int deviceCount;
+  const char *configFile = NULL, *snapshotFile = NULL;
+  int opt, dryRun = 0, verify = 0, status;
+  RTRCFG config;
+
+  while ((opt = getopt(argc, argv, "f:nvs:")) != -1){
+    switch (opt){
+    case 'f':
+      configFile = optarg;
+      break;
+    case 'n':
+      dryRun = 1;
+      break;
+    case 'v':
+      verify = 1;
+      break;
+    case 's':
+      snapshotFile = optarg;
+      break;
+    default:
+      configFile = NULL;
+      break;
+    }
+  }
+
+  if (configFile == NULL){
+    printf("Usage: %s -f config [-n] [-v] [-s snapshot]\n", argv[0]);
+    return 1;
+  }
+
+  if (!RTRCFG_Load(&config, configFile)){
+    return 1;
+  }
+  printf("%s: %u registers configured.\n", configFile, config.count);
+
+  if (snapshotFile != NULL){
+    status = compareSnapshot(&config, snapshotFile);
+    RTRCFG_Free(&config);
+    return status;
+  }
+
+  //Initialize
+  devices = STAR_getDeviceListForType(STAR_DEVICE_TXRX_SUPPORTED, & deviceCount);
+  if (devices == NULL){
+    puts("Error: No compatible device found.\n");
+    return 1;
+  }
+
+  deviceId = devices[0];
+  if (deviceId == STAR_DEVICE_UNKNOWN){
+    puts("Error: Unknown device.\n");
+    return 1;
+  }
+
+  /***************************************************************/
+  /*        Configurate Baudrate                                 */
+  /*                                                             */
+  /* Channel 1 = Configuration port of the router                */
+  /* BaudRate  = 100 Mbps (100*2/4)*2                            */
+  /***************************************************************/
+  STAR_CHANNEL_ID testPortChannel;
+  STAR_CFG_MK2_BASE_TRANSMIT_CLOCK clockRateParams;
+
+  clockRateParams.multiplier = _TX_BAUDRATE_MUL;
+  clockRateParams.divisor = _TX_BAUDRATE_DIV;
+
+  if (CFG_BRICK_MK3_setBaseTransmitClock(deviceId, _SPW1_INTERFACE, clockRateParams) == 0){
+    puts("\nError: Could not configure baudrate.");
+    return 1;
+  }
+
+  testPortChannel = STAR_openChannelToLocalDevice(deviceId, STAR_CHANNEL_DIRECTION_INOUT, _SPW1_INTERFACE, TRUE);
+  if(testPortChannel == 0){
+    puts("\nError : Unable to open the Channel.");
+    return 1;
+  }
+
+  /*****************************************************************/
+  /*       Read back, write the differences. Every access is       */
+  /*       matched to its reply, see rmap_engine.h.                */
+  /*****************************************************************/
+  U8 pTarget[]= {0,254};
+  U8 pReply[] = {254};
+  RMAPENG rmapEngine;
+
+  if (!RMAPENG_Init(&rmapEngine, testPortChannel, testPortChannel,
+                    pTarget, sizeof(pTarget), pReply, sizeof(pReply))){
+    STAR_closeChannel(testPortChannel);
+    return 1;
+  }
+  rmapEngine.window = _APPLY_WINDOW;
+
+  status = applyConfig(&rmapEngine, &config, dryRun, verify);
+
+  STAR_closeChannel(testPortChannel);
+  RTRCFG_Free(&config);
+
+  return status;
+}
+
+
+//Read the configured registers, write those that differ.
+//0 when the router holds the configuration.
+int applyConfig(RMAPENG *pEngine, const RTRCFG *pConfig, int dryRun,
+                int verify){
+  RMAPENG_ACCESS *vReads, *vWrites;
+  uint32_t writeCount;
+  unsigned long failed;
+  unsigned long long startNs, readNs, writeNs = 0;
+  int status = 0;
+
+  vReads = malloc((pConfig->count + 1) * sizeof(RMAPENG_ACCESS));
+  vWrites = malloc((pConfig->count + 1) * sizeof(RMAPENG_ACCESS));
+  if (!vReads || !vWrites){
+    puts("\nError: Could not allocate memory for the register accesses.");
+    free(vReads);
+    free(vWrites);
+    return 1;
+  }
+
+  RTRCFG_SetReads(pConfig, vReads);
+  startNs = MonotonicTimeNs();
+  failed = RMAPENG_Transfer(pEngine, vReads, pConfig->count);
+  readNs = MonotonicTimeNs() - startNs;
+  if (failed != 0){
+    RMAPENG_PrintReport(vReads, pConfig->count);
+  }
+
+  writeCount = RTRCFG_SetWrites(pConfig, vReads, vWrites);
+  RTRCFG_PrintDiff(pConfig, vReads);
+  printf("%u of %u registers to write (%lu unread), read in %.3f ms.\n",
+         writeCount, pConfig->count, failed, readNs / 1e6);
+
+  if (dryRun || writeCount == 0){
+    status = dryRun && writeCount != 0;
+  }
+  else{
+    startNs = MonotonicTimeNs();
+    failed = RMAPENG_Transfer(pEngine, vWrites, writeCount);
+    writeNs = MonotonicTimeNs() - startNs;
+    RMAPENG_PrintReport(vWrites, writeCount);
+    printf("Written in %.3f ms.\n", writeNs / 1e6);
+    status = failed != 0;
+
+    if (verify && !status){
+      RTRCFG_SetReads(pConfig, vReads);
+      RMAPENG_Transfer(pEngine, vReads, pConfig->count);
+      writeCount = RTRCFG_SetWrites(pConfig, vReads, vWrites);
+      if (writeCount != 0){
+        RTRCFG_PrintDiff(pConfig, vReads);
+        printf("Error: %u registers do not hold the configuration.\n",
+               writeCount);
+        status = 1;
+      }
+      else{
+        puts("Router configuration verified.");
+      }
+    }
+  }
+
+  free(vReads);
+  free(vWrites);
+  return status;
+}
+
+
+//Compare the configuration with a snapshot written by stipa -a.
+//0 when the snapshot holds the configuration.
+int compareSnapshot(const RTRCFG *pConfig, const char *fname){
+  RTRSNAP_FILE_HEADER header;
+  RTRSNAP_RECORD *vRecords;
+  RMAPENG_ACCESS *vCurrent, *vWrites;
+  uint32_t i, r, writeCount;
+
+  vRecords = RTRSNAP_Load(fname, &header);
+  if (vRecords == NULL){
+    return 1;
+  }
+
+  vCurrent = calloc(pConfig->count + 1, sizeof(RMAPENG_ACCESS));
+  vWrites = calloc(pConfig->count + 1, sizeof(RMAPENG_ACCESS));
+  if (!vCurrent || !vWrites){
+    puts("\nError: Could not allocate memory for the register accesses.");
+    free(vRecords);
+    free(vCurrent);
+    free(vWrites);
+    return 1;
+  }
+
+  //Registers missing from the snapshot stay unknown (RMAPENG_PENDING).
+  for (i = 0; i < pConfig->count; ++i){
+    for (r = 0; r < header.count; ++r){
+      if (vRecords[r].address == pConfig->pEntries[i].address){
+        vCurrent[i].address = vRecords[r].address;
+        vCurrent[i].result = vRecords[r].result;
+        vCurrent[i].value[0] = (U8) (vRecords[r].value >> 24);
+        vCurrent[i].value[1] = (U8) (vRecords[r].value >> 16);
+        vCurrent[i].value[2] = (U8) (vRecords[r].value >> 8);
+        vCurrent[i].value[3] = (U8) vRecords[r].value;
+        break;
+      }
+    }
+  }
+
+  writeCount = RTRCFG_SetWrites(pConfig, vCurrent, vWrites);
+  RTRCFG_PrintDiff(pConfig, vCurrent);
+  printf("%u of %u registers differ from %s.\n", writeCount,
+         pConfig->count, fname);
+
+  free(vRecords);
+  free(vCurrent);
+  free(vWrites);
+  return writeCount != 0;
+}
@@ -0,0 +1,351 @@
+/*
+  @file rtr_config.c
+  @author Juan Manuel Gómez
+  @brief Desired state of the GR718B configuration.
+  @details See rtr_config.h.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rtr_config.h"
+#include "rtr_snapshot.h"
+#include "system_config.h"
+
+#define RTRCFG_LINE_LENGTH 256
+#define RTRCFG_REGISTER_SIZE 4U
+
+
+static U32 RTRCFG_value(const RMAPENG_ACCESS * const pAccess)
+{
+    return ((U32)pAccess->value[0] << 24) | ((U32)pAccess->value[1] << 16) |
+        ((U32)pAccess->value[2] << 8) | (U32)pAccess->value[3];
+}
+
+
+
+/* Add a register, or replace its value if the file already set it */
+static int RTRCFG_set(RTRCFG * const pConfig, const U32 address,
+    const U32 value, const unsigned int line)
+{
+    RTRCFG_ENTRY *pEntries;
+    U32 i;
+
+    for (i = 0U; i < pConfig->count; i++)
+    {
+        if (pConfig->pEntries[i].address == address)
+        {
+            pConfig->pEntries[i].value = value;
+            pConfig->pEntries[i].line = line;
+            return 1;
+        }
+    }
+
+    if (pConfig->count == pConfig->capacity)
+    {
+        pEntries = (RTRCFG_ENTRY *)realloc(pConfig->pEntries,
+            (pConfig->capacity + 64U) * sizeof(RTRCFG_ENTRY));
+        if (pEntries == NULL)
+        {
+            puts("RTRCFG_Load: Unable to allocate the configuration");
+            return 0;
+        }
+        pConfig->pEntries = pEntries;
+        pConfig->capacity += 64U;
+    }
+
+    pConfig->pEntries[pConfig->count].address = address;
+    pConfig->pEntries[pConfig->count].value = value;
+    pConfig->pEntries[pConfig->count].line = line;
+    pConfig->count++;
+
+    return 1;
+}
+
+
+
+/* "n" or "n-m" */
+static int RTRCFG_parseRange(const char * const pText, U32 * const pFirst,
+    U32 * const pLast)
+{
+    const char *pNext;
+    char *pEnd;
+
+    *pFirst = (U32)strtoul(pText, &pEnd, 0);
+    if (pEnd == pText)
+    {
+        return 0;
+    }
+    if (*pEnd == '\0')
+    {
+        *pLast = *pFirst;
+        return 1;
+    }
+    if (*pEnd != '-')
+    {
+        return 0;
+    }
+
+    pNext = pEnd + 1;
+    *pLast = (U32)strtoul(pNext, &pEnd, 0);
+
+    return (pEnd != pNext) && (*pEnd == '\0') && (*pFirst <= *pLast);
+}
+
+
+
+static int RTRCFG_parseValue(const char * const pText, U32 * const pValue)
+{
+    char *pEnd;
+
+    if (pText == NULL)
+    {
+        return 0;
+    }
+    *pValue = (U32)strtoul(pText, &pEnd, 0);
+
+    return (pEnd != pText) && (*pEnd == '\0');
+}
+
+
+
+/* One line of the file, without its comment; 1 if valid */
+static int RTRCFG_parseLine(RTRCFG * const pConfig, char * const pLine,
+    const unsigned int line)
+{
+    const char * const separators = " \t\r\n";
+    char *pDirective, *pTarget, *pExtra;
+    U32 first, last, value, control, i;
+
+    pDirective = strtok(pLine, separators);
+    if (pDirective == NULL)
+    {
+        return 1;
+    }
+    pTarget = strtok(NULL, separators);
+    if (pTarget == NULL)
+    {
+        return 0;
+    }
+
+    if (strcmp(pDirective, "port") == 0)
+    {
+        if (!RTRCFG_parseRange(pTarget, &first, &last) ||
+            (last >= RTR_PORT_COUNT) ||
+            !RTRCFG_parseValue(strtok(NULL, separators), &value))
+        {
+            return 0;
+        }
+        for (i = first; i <= last; i++)
+        {
+            if (!RTRCFG_set(pConfig, RTR_PCTRL0_BASE +
+                (RTRCFG_REGISTER_SIZE * i), value, line))
+            {
+                return 0;
+            }
+        }
+    }
+    else if (strcmp(pDirective, "route") == 0)
+    {
+        if (!RTRCFG_parseRange(pTarget, &first, &last) || (first < 1U) ||
+            (last > RTR_ADDRESS_COUNT) ||
+            !RTRCFG_parseValue(strtok(NULL, separators), &value) ||
+            !RTRCFG_parseValue(strtok(NULL, separators), &control))
+        {
+            return 0;
+        }
+        for (i = first; i <= last; i++)
+        {
+            if (!RTRCFG_set(pConfig, RTR_RTPMAP_PH_BASE +
+                    (RTRCFG_REGISTER_SIZE * (i - 1U)), value, line) ||
+                !RTRCFG_set(pConfig, RTR_RTACTRL_PH_BASE +
+                    (RTRCFG_REGISTER_SIZE * (i - 1U)), control, line))
+            {
+                return 0;
+            }
+        }
+    }
+    else if (strcmp(pDirective, "reg") == 0)
+    {
+        if (!RTRCFG_parseValue(pTarget, &first) ||
+            ((first % RTRCFG_REGISTER_SIZE) != 0U) ||
+            !RTRCFG_parseValue(strtok(NULL, separators), &value) ||
+            !RTRCFG_set(pConfig, first, value, line))
+        {
+            return 0;
+        }
+    }
+    else
+    {
+        return 0;
+    }
+
+    pExtra = strtok(NULL, separators);
+
+    return pExtra == NULL;
+}
+
+
+
+/**
+ * Read a configuration file.
+ *
+ * @param pConfig the configuration, released with RTRCFG_Free()
+ * @param fname the configuration file
+ *
+ * @return 1 on success, 0 on error
+ */
+int RTRCFG_Load(RTRCFG * const pConfig, const char * const fname)
+{
+    char text[RTRCFG_LINE_LENGTH];
+    char *pComment;
+    unsigned int line = 0U;
+    FILE *pFile;
+    int ok = 1;
+
+    memset(pConfig, 0, sizeof(RTRCFG));
+
+    pFile = fopen(fname, "r");
+    if (pFile == NULL)
+    {
+        perror("RTRCFG_Load: fopen");
+        return 0;
+    }
+
+    while (ok && (fgets(text, sizeof(text), pFile) != NULL))
+    {
+        line++;
+        pComment = strchr(text, '#');
+        if (pComment != NULL)
+        {
+            *pComment = '\0';
+        }
+        ok = RTRCFG_parseLine(pConfig, text, line);
+        if (!ok)
+        {
+            printf("RTRCFG_Load: %s:%u: Invalid directive\n", fname, line);
+        }
+    }
+
+    fclose(pFile);
+    if (!ok)
+    {
+        RTRCFG_Free(pConfig);
+    }
+
+    return ok;
+}
+
+
+
+void RTRCFG_Free(RTRCFG * const pConfig)
+{
+    free(pConfig->pEntries);
+    memset(pConfig, 0, sizeof(RTRCFG));
+}
+
+
+
+/**
+ * Set a read of every configured register, to learn the current state.
+ *
+ * @param pConfig the configuration
+ * @param pReads room for pConfig->count accesses
+ *
+ * @return the number of reads set
+ */
+U32 RTRCFG_SetReads(const RTRCFG * const pConfig,
+    RMAPENG_ACCESS * const pReads)
+{
+    U32 i;
+
+    for (i = 0U; i < pConfig->count; i++)
+    {
+        RMAPENG_SetRead(&pReads[i], pConfig->pEntries[i].address);
+    }
+
+    return pConfig->count;
+}
+
+
+
+/**
+ * Set the writes that bring the router to the configuration. A register
+ * whose current value is unknown, its read failed, is written.
+ *
+ * @param pConfig the configuration
+ * @param pCurrent the current state, one access per entry, in the order
+ *                 set by RTRCFG_SetReads()
+ * @param pWrites room for pConfig->count accesses
+ *
+ * @return the number of writes set
+ */
+U32 RTRCFG_SetWrites(const RTRCFG * const pConfig,
+    const RMAPENG_ACCESS * const pCurrent, RMAPENG_ACCESS * const pWrites)
+{
+    const RTRCFG_ENTRY *pEntry;
+    U8 value[4];
+    U32 i, count = 0U;
+
+    for (i = 0U; i < pConfig->count; i++)
+    {
+        pEntry = &pConfig->pEntries[i];
+        if ((pCurrent[i].result == RMAPENG_OK) &&
+            (RTRCFG_value(&pCurrent[i]) == pEntry->value))
+        {
+            continue;
+        }
+
+        value[0] = (U8)(pEntry->value >> 24);
+        value[1] = (U8)(pEntry->value >> 16);
+        value[2] = (U8)(pEntry->value >> 8);
+        value[3] = (U8)pEntry->value;
+        RMAPENG_SetWrite(&pWrites[count++], pEntry->address, value);
+    }
+
+    return count;
+}
+
+
+
+/* One line per register to be written: current value and desired value */
+void RTRCFG_PrintDiff(const RTRCFG * const pConfig,
+    const RMAPENG_ACCESS * const pCurrent)
+{
+    const RTRSNAP_REGION *pRegion;
+    const RTRCFG_ENTRY *pEntry;
+    U32 i, index;
+
+    for (i = 0U; i < pConfig->count; i++)
+    {
+        pEntry = &pConfig->pEntries[i];
+        if ((pCurrent[i].result == RMAPENG_OK) &&
+            (RTRCFG_value(&pCurrent[i]) == pEntry->value))
+        {
+            continue;
+        }
+
+        pRegion = RTRSNAP_FindRegion(pEntry->address, &index);
+        if (pRegion != NULL)
+        {
+            printf("%-8s %3u  ", pRegion->name, index);
+        }
+        else
+        {
+            printf("%-8s %3s  ", "-", "-");
+        }
+
+        if (pCurrent[i].result == RMAPENG_OK)
+        {
+            printf("0x%08x  0x%08x -> 0x%08x  (line %u)\n", pEntry->address,
+                RTRCFG_value(&pCurrent[i]), pEntry->value, pEntry->line);
+        }
+        else
+        {
+            printf("0x%08x  %-10s -> 0x%08x  (line %u)\n", pEntry->address,
+                "unknown", pEntry->value, pEntry->line);
+        }
+    }
+}
@@ -0,0 +1,60 @@
+/*
+  @file rtr_config.h
+  @author Juan Manuel Gómez
+  @brief Desired state of the GR718B configuration.
+  @details A configuration file lists the value every configured register
+           of the router should hold. The router is read back and only the
+           registers that differ are written, instead of writing the whole
+           configuration on every run.
+
+           One directive per line, '#' starts a comment, numbers in C
+           notation:
+
+               port    <n>[-<m>] <value>
+                   port control register of ports n to m,
+                   RTR_PCTRL0_BASE + 4 * n
+               route   <a>[-<b>] <portmap> <control>
+                   routing table entries of addresses a to b (1-255):
+                   port mapping at RTR_RTPMAP_PH_BASE and address control
+                   at RTR_RTACTRL_PH_BASE
+               reg     <address> <value>
+                   any other register
+
+           A register set twice keeps the last value.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef RTR_CONFIG_H
+#define RTR_CONFIG_H
+
+#include "star-dundee_types.h"
+#include "rmap_engine.h"
+
+typedef struct
+{
+    U32 address;
+    U32 value;
+    unsigned int line;    /* line of the file that set the value */
+} RTRCFG_ENTRY;
+
+typedef struct
+{
+    RTRCFG_ENTRY *pEntries;
+    U32 count;
+    U32 capacity;
+} RTRCFG;
+
+int RTRCFG_Load(RTRCFG * const pConfig, const char * const fname);
+
+void RTRCFG_Free(RTRCFG * const pConfig);
+
+U32 RTRCFG_SetReads(const RTRCFG * const pConfig,
+    RMAPENG_ACCESS * const pReads);
+
+U32 RTRCFG_SetWrites(const RTRCFG * const pConfig,
+    const RMAPENG_ACCESS * const pCurrent, RMAPENG_ACCESS * const pWrites);
+
+void RTRCFG_PrintDiff(const RTRCFG * const pConfig,
+    const RMAPENG_ACCESS * const pCurrent);
+
+#endif
@@ -0,0 +1,278 @@
+/*
+  @file rtr_snapshot.c
+  @author Juan Manuel Gómez
+  @brief Snapshot of the GR718B register space.
+  @details See rtr_snapshot.h.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rtr_snapshot.h"
+#include "system_config.h"
+
+#define RTRSNAP_REGISTER_SIZE 4U
+
+
+const RTRSNAP_REGION RTRSNAP_Regions[] =
+{
+    { "RTPMAP",   RTR_RTPMAP_PH_BASE,  RTR_ADDRESS_COUNT, 1U },
+    { "RTACTRL",  RTR_RTACTRL_PH_BASE, RTR_ADDRESS_COUNT, 1U },
+    { "PCTRL",    RTR_PCTRL0_BASE,     RTR_PORT_COUNT,    0U },
+    { "PCTRLCFG", RTR_PCTRLCFG_BASE,   RTR_PORT_COUNT,    0U },
+    { "PTIMER",   RTR_PTIMER_BASE,     RTR_PORT_COUNT,    0U },
+    { "PCTRL2",   RTR_PCTRL2_BASE,     RTR_PORT_COUNT,    0U },
+    { "RTRCFG",   RTR_RTRCFG_BASE,     RTR_RTRCFG_COUNT,  0U }
+};
+
+const uint32_t RTRSNAP_RegionCount =
+    sizeof(RTRSNAP_Regions) / sizeof(RTRSNAP_Regions[0]);
+
+
+
+uint32_t RTRSNAP_RegisterCount(void)
+{
+    uint32_t count = 0U, r;
+
+    for (r = 0U; r < RTRSNAP_RegionCount; r++)
+    {
+        count += RTRSNAP_Regions[r].count;
+    }
+
+    return count;
+}
+
+
+
+/**
+ * Set a read for every register of the snapshot.
+ *
+ * @param pAccesses room for RTRSNAP_RegisterCount() accesses
+ *
+ * @return the number of accesses set
+ */
+uint32_t RTRSNAP_SetReads(RMAPENG_ACCESS * const pAccesses)
+{
+    uint32_t count = 0U, r, i;
+
+    for (r = 0U; r < RTRSNAP_RegionCount; r++)
+    {
+        for (i = 0U; i < RTRSNAP_Regions[r].count; i++)
+        {
+            RMAPENG_SetRead(&pAccesses[count++], RTRSNAP_Regions[r].base +
+                (RTRSNAP_REGISTER_SIZE * i));
+        }
+    }
+
+    return count;
+}
+
+
+
+/**
+ * Find the region of a register.
+ *
+ * @param address the address of the register
+ * @param pIndex set to the number of the register in its region: the
+ *        routing address for the routing table, the port otherwise
+ *
+ * @return the region, or NULL if the register is not part of a snapshot
+ */
+const RTRSNAP_REGION *RTRSNAP_FindRegion(const uint32_t address,
+    uint32_t * const pIndex)
+{
+    const RTRSNAP_REGION *pRegion;
+    uint32_t r;
+
+    for (r = 0U; r < RTRSNAP_RegionCount; r++)
+    {
+        pRegion = &RTRSNAP_Regions[r];
+        if ((address >= pRegion->base) &&
+            (address < pRegion->base + (RTRSNAP_REGISTER_SIZE * pRegion->count)) &&
+            (((address - pRegion->base) % RTRSNAP_REGISTER_SIZE) == 0U))
+        {
+            *pIndex = pRegion->first +
+                (address - pRegion->base) / RTRSNAP_REGISTER_SIZE;
+            return pRegion;
+        }
+    }
+
+    return NULL;
+}
+
+
+
+/**
+ * Write the result of the snapshot reads to a file.
+ *
+ * @param fname the snapshot file, replaced if it exists
+ * @param pAccesses the reads, after RMAPENG_Transfer()
+ * @param count the number of reads
+ * @param timeNs wall clock time of the start of the reads
+ * @param durationNs the time taken by the reads
+ *
+ * @return 1 on success, 0 on error
+ */
+int RTRSNAP_Save(const char * const fname,
+    const RMAPENG_ACCESS * const pAccesses, const uint32_t count,
+    const uint64_t timeNs, const uint64_t durationNs)
+{
+    RTRSNAP_FILE_HEADER header;
+    RTRSNAP_RECORD record;
+    FILE *pFile;
+    uint32_t i;
+    int ok;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RTRSNAP_MAGIC, sizeof(header.magic));
+    header.version = RTRSNAP_VERSION;
+    header.headerSize = sizeof(RTRSNAP_FILE_HEADER);
+    header.recordSize = sizeof(RTRSNAP_RECORD);
+    header.count = count;
+    header.timeNs = timeNs;
+    header.durationNs = durationNs;
+    for (i = 0U; i < count; i++)
+    {
+        if (pAccesses[i].result != RMAPENG_OK)
+        {
+            header.failed++;
+        }
+    }
+
+    pFile = fopen(fname, "wb");
+    if (pFile == NULL)
+    {
+        perror("RTRSNAP_Save: fopen");
+        return 0;
+    }
+
+    ok = (fwrite(&header, sizeof(header), 1, pFile) == 1);
+    for (i = 0U; ok && (i < count); i++)
+    {
+        memset(&record, 0, sizeof(record));
+        record.address = pAccesses[i].address;
+        record.value = ((uint32_t)pAccesses[i].value[0] << 24) |
+            ((uint32_t)pAccesses[i].value[1] << 16) |
+            ((uint32_t)pAccesses[i].value[2] << 8) |
+            (uint32_t)pAccesses[i].value[3];
+        record.result = (uint8_t)pAccesses[i].result;
+        record.replyStatus = pAccesses[i].replyStatus;
+        ok = (fwrite(&record, sizeof(record), 1, pFile) == 1);
+    }
+
+    if ((fclose(pFile) != 0) || !ok)
+    {
+        puts("RTRSNAP_Save: Unable to write the snapshot");
+        return 0;
+    }
+
+    return 1;
+}
+
+
+
+/**
+ * Read a snapshot file.
+ *
+ * @param fname the snapshot file
+ * @param pHeader set to the header of the file
+ *
+ * @return the records, to be released with free(), or NULL on error
+ */
+RTRSNAP_RECORD *RTRSNAP_Load(const char * const fname,
+    RTRSNAP_FILE_HEADER * const pHeader)
+{
+    RTRSNAP_RECORD *pRecords = NULL;
+    FILE *pFile;
+
+    pFile = fopen(fname, "rb");
+    if (pFile == NULL)
+    {
+        perror("RTRSNAP_Load: fopen");
+        return NULL;
+    }
+
+    if ((fread(pHeader, sizeof(RTRSNAP_FILE_HEADER), 1, pFile) != 1) ||
+        (memcmp(pHeader->magic, RTRSNAP_MAGIC, sizeof(pHeader->magic)) != 0) ||
+        (pHeader->version != RTRSNAP_VERSION) ||
+        (pHeader->headerSize != sizeof(RTRSNAP_FILE_HEADER)) ||
+        (pHeader->recordSize != sizeof(RTRSNAP_RECORD)))
+    {
+        puts("RTRSNAP_Load: Not a register snapshot");
+        fclose(pFile);
+        return NULL;
+    }
+
+    /* A count the register space or the file cannot hold is not trusted
+       with an allocation */
+    if ((pHeader->count > RTRSNAP_RegisterCount()) ||
+        (fseek(pFile, 0L, SEEK_END) != 0) ||
+        (ftell(pFile) < (long)(sizeof(RTRSNAP_FILE_HEADER) +
+            (size_t)pHeader->count * sizeof(RTRSNAP_RECORD))) ||
+        (fseek(pFile, (long)sizeof(RTRSNAP_FILE_HEADER), SEEK_SET) != 0))
+    {
+        printf("RTRSNAP_Load: Snapshot of %u registers does not fit the "
+            "file or the register space\n", pHeader->count);
+        fclose(pFile);
+        return NULL;
+    }
+
+    pRecords = (RTRSNAP_RECORD *)malloc(((size_t)pHeader->count + 1U) *
+        sizeof(RTRSNAP_RECORD));
+    if ((pRecords == NULL) ||
+        (fread(pRecords, sizeof(RTRSNAP_RECORD), pHeader->count, pFile) !=
+            pHeader->count))
+    {
+        puts("RTRSNAP_Load: Truncated snapshot");
+        free(pRecords);
+        pRecords = NULL;
+    }
+
+    fclose(pFile);
+    return pRecords;
+}
+
+
+
+/* One line per register: region and number, address, value or failure */
+void RTRSNAP_Print(const RTRSNAP_FILE_HEADER * const pHeader,
+    const RTRSNAP_RECORD * const pRecords)
+{
+    const RTRSNAP_REGION *pRegion;
+    RMAPENG_ACCESS access;
+    time_t seconds = (time_t)(pHeader->timeNs / 1000000000ULL);
+    uint32_t i, index;
+
+    printf("Snapshot of %u registers taken %s", pHeader->count,
+        ctime(&seconds));
+    printf("Read in %.3f ms, %u failed.\n", pHeader->durationNs / 1e6,
+        pHeader->failed);
+
+    for (i = 0U; i < pHeader->count; i++)
+    {
+        pRegion = RTRSNAP_FindRegion(pRecords[i].address, &index);
+        if (pRegion != NULL)
+        {
+            printf("%-8s %3u  ", pRegion->name, index);
+        }
+        else
+        {
+            printf("%-8s %3s  ", "-", "-");
+        }
+
+        if (pRecords[i].result == RMAPENG_OK)
+        {
+            printf("0x%08x  0x%08x\n", pRecords[i].address, pRecords[i].value);
+            continue;
+        }
+
+        memset(&access, 0, sizeof(access));
+        access.result = pRecords[i].result;
+        access.replyStatus = pRecords[i].replyStatus;
+        printf("0x%08x  %s\n", pRecords[i].address,
+            RMAPENG_ResultString(&access));
+    }
+}
@@ -0,0 +1,78 @@
+/*
+  @file rtr_snapshot.h
+  @author Juan Manuel Gómez
+  @brief Snapshot of the GR718B register space.
+  @details A snapshot holds the value of every register of the regions
+           listed in RTRSNAP_Regions: routing table port mapping and
+           address control for addresses 1-255, the per port control,
+           status, timer and control 2 registers, and the router
+           configuration block. The registers are read with one RMAP read
+           each through the RMAP engine, which keeps them pipelined.
+
+           File layout: an RTRSNAP_FILE_HEADER, then one RTRSNAP_RECORD per
+           register in the order of the regions. A register that could not
+           be read keeps its record, with the result of the read and the
+           status of its reply. Fields are stored in host byte order.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef RTR_SNAPSHOT_H
+#define RTR_SNAPSHOT_H
+
+#include <stdint.h>
+#include "rmap_engine.h"
+
+#define RTRSNAP_MAGIC "GR718SNP"
+#define RTRSNAP_VERSION 1U
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t recordSize;
+    uint32_t count;
+    uint32_t failed;
+    uint32_t reserved;
+    uint64_t timeNs;       /* wall clock at the start of the reads */
+    uint64_t durationNs;   /* time taken by the reads */
+} RTRSNAP_FILE_HEADER;
+
+typedef struct
+{
+    uint32_t address;
+    uint32_t value;
+    uint8_t result;        /* RMAPENG_OK, ... */
+    uint8_t replyStatus;
+    uint16_t reserved;
+} RTRSNAP_RECORD;
+
+typedef struct
+{
+    const char *name;
+    uint32_t base;
+    uint32_t count;
+    uint32_t first;        /* number of the register at base: address, port */
+} RTRSNAP_REGION;
+
+extern const RTRSNAP_REGION RTRSNAP_Regions[];
+extern const uint32_t RTRSNAP_RegionCount;
+
+uint32_t RTRSNAP_RegisterCount(void);
+
+uint32_t RTRSNAP_SetReads(RMAPENG_ACCESS * const pAccesses);
+
+const RTRSNAP_REGION *RTRSNAP_FindRegion(const uint32_t address,
+    uint32_t * const pIndex);
+
+int RTRSNAP_Save(const char * const fname,
+    const RMAPENG_ACCESS * const pAccesses, const uint32_t count,
+    const uint64_t timeNs, const uint64_t durationNs);
+
+RTRSNAP_RECORD *RTRSNAP_Load(const char * const fname,
+    RTRSNAP_FILE_HEADER * const pHeader);
+
+void RTRSNAP_Print(const RTRSNAP_FILE_HEADER * const pHeader,
+    const RTRSNAP_RECORD * const pRecords);
+
+#endif
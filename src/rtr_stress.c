@@ -0,0 +1,954 @@
+/*
+  @file rtr_stress.c
+  @author Juan Manuel Gómez
+  @brief Fan-in/fan-out stress test of the logical routes of the GR718.
+  @details Uses every channel of every device, or those of -c. If -f is
+  given the router is first brought to that configuration (rtr_apply).
+  Every logical address of -a, MEU1_NDPU1_LA to MEU1_NDPU6_LA by default,
+  is probed from the first channel to learn the channel the router
+  delivers it to, and whether it deletes the address byte.
+  Then every channel sends a verified stream (stream_verify.h) to every
+  address reached, round robin, in operations of -b packets with -d in
+  flight, so the transmitters cross in the router and fan in on the same
+  outputs. Each channel has a transmitter and a receiver worker thread
+  (dev_manager.h); the receivers take one packet per operation, so the
+  time every packet arrives is known.
+  Before the load every stream is sent alone, -w packets with the same -d
+  operations in flight, to know its latency without contention. The
+  latency of a packet runs from the submit of its operation to its
+  arrival. The report gives per stream (channel to address) the
+  throughput, the errors and the median and 99th percentile latency, and
+  how many times the median grew under load. On a stream to
+  an output with capacity to spare that growth is head-of-line blocking:
+  its packets wait behind others bound to a busy output. Each transmitter
+  also reports the time it was held waiting for the router to take its
+  packets. Last, the Jain fairness index of the throughput of the streams
+  of every output and of all of them: 1 when they share the capacity
+  evenly, 1/n when one stream takes it all.
+  @param -c channels, -a addresses, -s packet size, -b batch, -d depth,
+  -t seconds, -n packets per stream, -w calibration packets per stream,
+  -f router configuration, -S seed, -p pin the workers.
+  @example ./rtr_stress -t 30 -s 1024 ; ./rtr_stress -f flight.cfg -a 0x45-0x4A,0x4B -n 100000
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "system_config.h"
+#include "utility.h"
+#include "star-dundee_types.h"
+#include "star-api.h"
+#include "dev_manager.h"
+#include "rx_view.h"
+#include "rx_stream.h"
+#include "lat_hist.h"
+#include "pattern.h"
+#include "stream_verify.h"
+#include "rmap_engine.h"
+#include "rtr_config.h"
+
+#define VERSION_INFO "Router Stress v1.0"
+
+#define _TIMEOUT 5000
+#define _POLL_MS 100
+#define _DRAIN_POLLS 3
+#define _PROBE_MS 200
+#define _ENGINE_WINDOW 64
+#define _MAX_ROUTES 32
+#define _MAX_STREAMS 256
+#define _SEND_RING 4096
+
+#define _ROLE_TX 0
+#define _ROLE_RX 1
+
+typedef struct{
+  U8 address;
+  U8 channel;          /* channel the router delivers it to, 0 if none */
+  U8 keepsAddress;     /* the address byte arrives with the packet */
+} ROUTE;
+
+typedef struct{
+  U8 channel;
+  const ROUTE *pRoute;
+  SVERIFY_STREAM tx;           /* owned by the transmitter of the channel */
+  SVERIFY_STREAM rx;           /* owned by the receiver of the route */
+  uint64_t queued;             /* tx.next, for the receiver */
+  unsigned long long sendNs[_SEND_RING];
+  LATHIST solo, load;
+} STREAM;
+
+typedef struct{
+  STAR_DEVICE_ID deviceId;
+  U8 channels[32];
+  unsigned int channelCount;
+  ROUTE routes[_MAX_ROUTES];
+  unsigned int routeCount, reached;
+  STREAM *pStreams;            /* reached per channel, channel by channel */
+  unsigned int streamCount;
+  unsigned int txActive;
+  unsigned long long txEndNs[32];
+} PLAN;
+
+typedef struct{
+  U8 addresses[_MAX_ROUTES];
+  unsigned int addressCount;
+  U32 packetSize, batch, depth;
+  unsigned long packetCount, seconds, warmup;
+  uint64_t seed;
+  PLAN *pPlans;
+  pthread_barrier_t start, done;
+  unsigned long long startNs;
+} STRESS_ARGS;
+
+static volatile sig_atomic_t stopRequested;
+
+static void requestStop(int signalNumber){
+  (void) signalNumber;
+  stopRequested = 1;
+}
+
+static int configureRouter(const STAR_DEVICE_ID deviceId, const U8 channel,
+                           const RTRCFG * const pConfig);
+static int planRoutes(PLAN * const pPlan, const unsigned int index,
+                      const STRESS_ARGS * const pArgs);
+static void printPlan(const PLAN * const pPlan, const unsigned int index,
+                      const unsigned long long durationNs);
+int stressJob(DEVMGR_WORKER * const pWorker, void * const pArgument);
+
+
+/* Parse a comma separated list of addresses and address ranges */
+static int parseAddresses(const char *pList, STRESS_ARGS * const pArgs){
+  unsigned long first, last;
+  char *pEnd;
+
+  pArgs->addressCount = 0;
+  while (*pList != '\0'){
+    first = last = strtoul(pList, &pEnd, 0);
+    if (pEnd != pList && *pEnd == '-'){
+      pList = pEnd + 1;
+      last = strtoul(pList, &pEnd, 0);
+    }
+    if (pEnd == pList || first < 32 || last > 255 || first > last)
+      return 0;
+    for (; first <= last; ++first){
+      if (pArgs->addressCount == _MAX_ROUTES)
+        return 0;
+      pArgs->addresses[pArgs->addressCount++] = (U8) first;
+    }
+    pList = (*pEnd == ',') ? pEnd + 1 : pEnd;
+  }
+
+  return pArgs->addressCount > 0;
+}
+
+
+int __cdecl  main(int argc, char * argv[]){
+  DEVMGR manager;
+  STRESS_ARGS args;
+  RTRCFG config;
+  STAR_CHANNEL_MASK channels = 0;
+  struct sigaction action;
+  const char *pChannel, *fname = NULL;
+  char *pEnd;
+  PLAN *pPlan;
+  unsigned long long endNs, errors = 0;
+  unsigned int failed, d, i, streams = 0;
+  int opt, pin = 0;
+
+  memset(&args, 0, sizeof(args));
+  memset(&config, 0, sizeof(config));
+  for (i = 0; i <= MEU1_NDPU6_LA - MEU1_NDPU1_LA; ++i)
+    args.addresses[i] = (U8) (MEU1_NDPU1_LA + i);
+  args.addressCount = i;
+  args.packetSize = 1024;
+  args.batch = 8;
+  args.depth = 4;
+  args.seconds = 10;
+  args.warmup = 256;
+  args.seed = PATGEN_DEFAULT_SEED;
+
+  while ((opt = getopt(argc, argv, "c:a:s:b:d:t:n:w:f:S:p")) != -1){
+    switch (opt){
+    case 'c':
+      for (pChannel = optarg; *pChannel != '\0'; pChannel = pEnd){
+        unsigned long channel = strtoul(pChannel, &pEnd, 0);
+        if (pEnd == pChannel || channel < 1 || channel > 31){
+          printf("Invalid channel list %s.\n", optarg);
+          return 1;
+        }
+        channels |= 1U << channel;
+        if (*pEnd == ',')
+          pEnd++;
+      }
+      break;
+    case 'a':
+      if (!parseAddresses(optarg, &args)){
+        printf("Invalid address list %s, logical addresses are 32-255.\n", optarg);
+        return 1;
+      }
+      break;
+    case 's':
+      args.packetSize = strtoul(optarg, NULL, 0);
+      break;
+    case 'b':
+      args.batch = strtoul(optarg, NULL, 0);
+      break;
+    case 'd':
+      args.depth = strtoul(optarg, NULL, 0);
+      break;
+    case 't':
+      args.seconds = strtoul(optarg, NULL, 0);
+      break;
+    case 'n':
+      args.packetCount = strtoul(optarg, NULL, 0);
+      args.seconds = 0;
+      break;
+    case 'w':
+      args.warmup = strtoul(optarg, NULL, 0);
+      break;
+    case 'f':
+      fname = optarg;
+      break;
+    case 'S':
+      args.seed = strtoull(optarg, NULL, 0);
+      break;
+    case 'p':
+      pin = 1;
+      break;
+    default:
+      printf("Usage: %s [-c channels] [-a addresses] [-s size] [-b batch]"
+             " [-d depth] [-t seconds] [-n packets] [-w packets] [-f file]"
+             " [-S seed] [-p]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (channels == 0)
+    channels = ~1U;
+  if (args.packetSize < SVERIFY_HEADER_SIZE || args.batch < 1 || args.depth < 1 ||
+      (args.seconds == 0 && args.packetCount == 0)){
+    printf("Error: The packet size must be at least %u B, the batch, the depth"
+           " and the time or packets positive.\n", SVERIFY_HEADER_SIZE);
+    return 1;
+  }
+  //A packet is not reused before its send time is past the receivers.
+  if (args.batch * args.depth > _SEND_RING / 2){
+    printf("Error: At most %u packets in flight per channel.\n", _SEND_RING / 2);
+    return 1;
+  }
+  if (fname != NULL && !RTRCFG_Load(&config, fname))
+    return 1;
+
+  if (DEVMGR_Open(&manager, STAR_DEVICE_TXRX_SUPPORTED, channels, pin) == 0){
+    puts("Error: No compatible device found.");
+    RTRCFG_Free(&config);
+    return 1;
+  }
+  args.pPlans = calloc(manager.deviceCount, sizeof(PLAN));
+  if (args.pPlans == NULL){
+    puts("Error: Out of memory.");
+    DEVMGR_Close(&manager);
+    RTRCFG_Free(&config);
+    return 1;
+  }
+  for (i = 0; i < manager.workerCount; ++i){
+    pPlan = &args.pPlans[manager.workers[i].deviceIndex];
+    pPlan->deviceId = manager.workers[i].deviceId;
+    pPlan->channels[pPlan->channelCount++] = manager.workers[i].channelNumber;
+  }
+
+  //Routes and calibration, one device at a time, before any load.
+  failed = 0;
+  for (d = 0; d < manager.deviceCount; ++d){
+    pPlan = &args.pPlans[d];
+    if (pPlan->channelCount == 0)
+      continue;
+    if (fname != NULL &&
+        !configureRouter(pPlan->deviceId, pPlan->channels[0], &config)){
+      printf("\nERROR device %u: Unable to configure the router.\n", d);
+      failed++;
+      continue;
+    }
+    if (!planRoutes(pPlan, d, &args))
+      failed++;
+    streams += pPlan->streamCount;
+  }
+  RTRCFG_Free(&config);
+
+  //The channels stay open until every worker is done: with the simulator
+  //closing a channel cancels the receive operations of the other direction.
+  if (failed == 0 && streams > 0 && DEVMGR_SetRoles(&manager, 2) != 0 &&
+      pthread_barrier_init(&args.start, NULL, manager.workerCount) == 0 &&
+      pthread_barrier_init(&args.done, NULL, manager.workerCount) == 0){
+    printf("%u devices, %u workers: %u streams of %u B packets.\n",
+           manager.deviceCount, manager.workerCount, streams, args.packetSize);
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    failed = DEVMGR_Run(&manager, stressJob, &args);
+    DEVMGR_PrintReport(&manager);
+    pthread_barrier_destroy(&args.start);
+    pthread_barrier_destroy(&args.done);
+
+    for (d = 0; d < manager.deviceCount; ++d){
+      pPlan = &args.pPlans[d];
+      if (pPlan->streamCount == 0)
+        continue;
+      endNs = args.startNs;
+      for (i = 0; i < pPlan->channelCount; ++i)
+        if (pPlan->txEndNs[i] > endNs)
+          endNs = pPlan->txEndNs[i];
+      for (i = 0; i < pPlan->streamCount; ++i){
+        SVERIFY_Finish(&pPlan->pStreams[i].rx, pPlan->pStreams[i].tx.next);
+        errors += SVERIFY_Errors(&pPlan->pStreams[i].rx);
+      }
+      printPlan(pPlan, d, endNs - args.startNs);
+    }
+  }
+  else if (failed == 0){
+    puts("Error: No address reached, or unable to start the workers.");
+    failed = 1;
+  }
+
+  for (d = 0; d < manager.deviceCount; ++d)
+    free(args.pPlans[d].pStreams);
+  free(args.pPlans);
+  DEVMGR_Close(&manager);
+
+  return failed != 0 || errors != 0;
+}
+
+
+//Bring the router behind a channel to a configuration, as rtr_apply.
+static int configureRouter(const STAR_DEVICE_ID deviceId, const U8 channel,
+                           const RTRCFG * const pConfig){
+  U8 pTarget[]= {0,254};
+  U8 pReply[] = {254};
+  RMAPENG_ACCESS *vReads, *vWrites;
+  RMAPENG engine;
+  STAR_CHANNEL_ID channelId;
+  U32 writeCount;
+  int status = 0;
+
+  channelId = STAR_openChannelToLocalDevice(deviceId, STAR_CHANNEL_DIRECTION_INOUT,
+                                            channel, TRUE);
+  if (channelId == 0)
+    return 0;
+
+  vReads = malloc((pConfig->count + 1) * sizeof(RMAPENG_ACCESS));
+  vWrites = malloc((pConfig->count + 1) * sizeof(RMAPENG_ACCESS));
+  if (vReads && vWrites &&
+      RMAPENG_Init(&engine, channelId, channelId, pTarget, sizeof(pTarget),
+                   pReply, sizeof(pReply))){
+    engine.window = _ENGINE_WINDOW;
+    RTRCFG_SetReads(pConfig, vReads);
+    if (RMAPENG_Transfer(&engine, vReads, pConfig->count) == 0){
+      writeCount = RTRCFG_SetWrites(pConfig, vReads, vWrites);
+      status = RMAPENG_Transfer(&engine, vWrites, writeCount) == 0;
+      printf("Router configured: %u of %u registers written.\n", writeCount,
+             pConfig->count);
+    }
+  }
+
+  free(vReads);
+  free(vWrites);
+  STAR_closeChannel(channelId);
+  return status;
+}
+
+
+/* The next packet of a stream, the logical address in front */
+static void fillPacket(STREAM * const pStream, U8 * const pPacket,
+                       const U32 packetSize){
+  pPacket[0] = pStream->pRoute->address;
+  SVERIFY_Fill(&pStream->tx, pPacket + 1, packetSize);
+}
+
+
+/* The time the packets of an operation are submitted, for the receivers
+   to measure their latency. Taken just before the submit, once the
+   operation no longer waits for a slot. */
+static void stampPackets(PLAN * const pPlan, const U8 * const pPackets,
+                         const U32 count, const U32 packetSize){
+  const unsigned long long nowNs = MonotonicTimeNs();
+  const U8 *pData;
+  STREAM *pStream;
+  uint64_t sequence;
+  U32 i;
+
+  for (i = 0; i < count; ++i){
+    pData = pPackets + (size_t) i * (packetSize + 1) + 1;
+    pStream = &pPlan->pStreams[SVERIFY_StreamOf(pData, packetSize)];
+    sequence = SVERIFY_SequenceOf(pData);
+    __atomic_store_n(&pStream->sendNs[sequence % _SEND_RING], nowNs,
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&pStream->queued, sequence + 1, __ATOMIC_RELEASE);
+  }
+}
+
+
+/* A packet received on a channel, checked against its stream and its
+   latency recorded. 0 if it is not a valid packet of a stream routed to
+   the channel. */
+static int receivePacket(PLAN * const pPlan, const U8 channel,
+                         const RXVIEW_ITEM * const pItem,
+                         const unsigned long long nowNs, const int load){
+  const U8 *pData = pItem->pData;
+  U32 length = pItem->length;
+  STREAM *pStream;
+  uint64_t sequence, queued;
+  unsigned long long sentNs;
+  int id;
+
+  if (pItem->itemType != STAR_STREAM_ITEM_TYPE_SPACEWIRE_PACKET ||
+      pItem->eop != STAR_EOP_TYPE_EOP || pData == NULL)
+    return 0;
+
+  //Without header deletion the address byte is still in front.
+  id = SVERIFY_StreamOf(pData, length);
+  if (id < 0 && length > 1){
+    pData++;
+    length--;
+    id = SVERIFY_StreamOf(pData, length);
+  }
+  if (id < 0 || (unsigned int) id >= pPlan->streamCount)
+    return 0;
+  //Misrouted: the stream belongs to the receiver of its own channel.
+  pStream = &pPlan->pStreams[id];
+  if (pStream->pRoute->channel != channel)
+    return 0;
+  if (SVERIFY_Check(&pStream->rx, pData, length) != SVERIFY_OK)
+    return 0;
+
+  //The send time, unless the transmitter has already reused its place.
+  sequence = SVERIFY_SequenceOf(pData);
+  queued = __atomic_load_n(&pStream->queued, __ATOMIC_ACQUIRE);
+  if (sequence < queued && queued - sequence <= _SEND_RING){
+    sentNs = __atomic_load_n(&pStream->sendNs[sequence % _SEND_RING],
+                             __ATOMIC_RELAXED);
+    queued = __atomic_load_n(&pStream->queued, __ATOMIC_ACQUIRE);
+    if (queued - sequence <= _SEND_RING && nowNs > sentNs)
+      LATHIST_Record(load ? &pStream->load : &pStream->solo, nowNs - sentNs);
+  }
+
+  return 1;
+}
+
+
+/* Wait for a packet on one of the receive streams, up to a time.
+   Returns the index of the stream, -1 on timeout, -2 on error. */
+static int nextPacket(RXSTREAM * const vRx, const unsigned int count,
+                      const unsigned long long endNs,
+                      STAR_TRANSFER_OPERATION ** const ppOp){
+  STAR_TRANSFER_STATUS status;
+  unsigned int i;
+
+  do{
+    for (i = 0; i < count; ++i){
+      *ppOp = RXSTREAM_Next(&vRx[i], count == 1 ? _POLL_MS : 1, &status);
+      if (*ppOp != NULL)
+        return (int) i;
+      if (status != STAR_TRANSFER_STATUS_STARTED)
+        return -2;
+    }
+  } while (MonotonicTimeNs() < endNs);
+
+  return -1;
+}
+
+
+/* Learn where the router sends every address, then send every stream alone
+   to measure its latency without contention */
+static int planRoutes(PLAN * const pPlan, const unsigned int index,
+                      const STRESS_ARGS * const pArgs){
+  STAR_CHANNEL_ID vTx[32];
+  RXSTREAM vRx[32];
+  STAR_STREAM_ITEM **vItems = NULL;
+  STAR_TRANSFER_OPERATION *pTxOp, *pRxOp, **vOps;
+  STREAM *pStream;
+  RXVIEW view;
+  U8 *pBuffer;
+  U32 *vCounts;
+  U32 txSize = pArgs->packetSize + 1;
+  unsigned long long nowNs;
+  unsigned long sent, done;
+  unsigned int c, r, i, opened = 0, count, slot, submitted, retired;
+  int status = 1, k;
+
+  memset(vTx, 0, sizeof(vTx));
+  RXVIEW_Init(&view);
+  pBuffer = malloc((size_t) pArgs->depth * pArgs->batch * txSize);
+  vItems = calloc((size_t) pArgs->depth * pArgs->batch, sizeof(STAR_STREAM_ITEM *));
+  vOps = calloc(pArgs->depth, sizeof(STAR_TRANSFER_OPERATION *));
+  vCounts = calloc(pArgs->depth, sizeof(U32));
+  for (c = 0; pBuffer && vItems && vOps && vCounts && c < pPlan->channelCount;
+       ++c, ++opened){
+    vTx[c] = STAR_openChannelToLocalDevice(pPlan->deviceId, STAR_CHANNEL_DIRECTION_OUT,
+                                           pPlan->channels[c], TRUE);
+    if (vTx[c] == 0 ||
+        !RXSTREAM_Open(&vRx[c], STAR_openChannelToLocalDevice(pPlan->deviceId,
+                                                              STAR_CHANNEL_DIRECTION_IN,
+                                                              pPlan->channels[c], TRUE),
+                       pArgs->depth * pArgs->batch, 1))
+      break;
+  }
+  if (opened < pPlan->channelCount || pPlan->channelCount == 0){
+    printf("\nERROR: Unable to open the channels of device %u.\n", index);
+    status = 0;
+  }
+
+  //A bare header from the first channel to every address.
+  for (r = 0; status && r < pArgs->addressCount; ++r){
+    ROUTE *pRoute = &pPlan->routes[pPlan->routeCount++];
+    SVERIFY_STREAM probe;
+
+    memset(pRoute, 0, sizeof(ROUTE));
+    pRoute->address = pArgs->addresses[r];
+    pBuffer[0] = pRoute->address;
+    SVERIFY_Init(&probe, 0xFF, DATA_TYPE_RANDOM, pArgs->seed);
+    SVERIFY_Fill(&probe, pBuffer + 1, SVERIFY_HEADER_SIZE);
+    vItems[0] = STAR_createPacket(NULL, pBuffer, SVERIFY_HEADER_SIZE + 1,
+                                  STAR_EOP_TYPE_EOP);
+    pTxOp = STAR_createTxOperation(vItems, 1);
+    if (!pTxOp || !STAR_submitTransferOperation(vTx[0], pTxOp) ||
+        STAR_waitOnTransferOperationCompletion(pTxOp, _TIMEOUT) != STAR_TRANSFER_STATUS_COMPLETE){
+      printf("\nERROR: Unable to send the probe of address 0x%02X.\n", pRoute->address);
+      status = 0;
+    }
+    if (pTxOp)
+      STAR_disposeTransferOperation(pTxOp);
+    STAR_destroyStreamItem(vItems[0]);
+
+    k = status ? nextPacket(vRx, opened, MonotonicTimeNs() + _PROBE_MS * 1000000ULL,
+                            &pRxOp) : -1;
+    if (k >= 0){
+      RXVIEW_Map(&view, pRxOp);
+      if (view.count == 1 && view.pItems[0].pData != NULL &&
+          view.pItems[0].eop == STAR_EOP_TYPE_EOP){
+        pRoute->channel = pPlan->channels[k];
+        pRoute->keepsAddress = view.pItems[0].length == SVERIFY_HEADER_SIZE + 1;
+      }
+      RXVIEW_Release(&view);
+      RXSTREAM_Recycle(&vRx[k]);
+    }
+    else if (k == -2)
+      status = 0;
+
+    if (pRoute->channel != 0){
+      printf("Device %u: address 0x%02X to channel %u%s.\n",
+             index, pRoute->address, pRoute->channel,
+             pRoute->keepsAddress ? ", address kept" : "");
+      pPlan->reached++;
+    }
+    else
+      printf("Device %u: address 0x%02X reaches no channel.\n", index,
+             pRoute->address);
+  }
+
+  //Every channel to every address reached, the stream ID its index.
+  if (status && pPlan->reached > 0){
+    if (pPlan->channelCount * pPlan->reached > _MAX_STREAMS){
+      printf("\nERROR: %u channels to %u addresses are more than %u streams.\n",
+             pPlan->channelCount, pPlan->reached, _MAX_STREAMS);
+      status = 0;
+    }
+    else
+      pPlan->pStreams = calloc(pPlan->channelCount * pPlan->reached, sizeof(STREAM));
+    for (c = 0; pPlan->pStreams && c < pPlan->channelCount; ++c)
+      for (r = 0; r < pPlan->routeCount; ++r){
+        if (pPlan->routes[r].channel == 0)
+          continue;
+        pStream = &pPlan->pStreams[pPlan->streamCount];
+        pStream->channel = pPlan->channels[c];
+        pStream->pRoute = &pPlan->routes[r];
+        SVERIFY_Init(&pStream->tx, (U8) pPlan->streamCount, DATA_TYPE_RANDOM,
+                     pArgs->seed + pPlan->streamCount);
+        pStream->rx = pStream->tx;
+        pPlan->streamCount++;
+      }
+  }
+
+  //Calibration, one stream at a time, as many operations in flight as
+  //under load so that the packets queue the same way behind them.
+  for (i = 0; status && i < pPlan->streamCount; ++i){
+    pStream = &pPlan->pStreams[i];
+    for (c = 0; pPlan->channels[c] != pStream->channel; ++c)
+      ;
+    for (r = 0; pPlan->channels[r] != pStream->pRoute->channel; ++r)
+      ;
+    for (sent = done = 0, submitted = retired = 0; status && done < pArgs->warmup;
+         ++retired){
+      while (status && sent < pArgs->warmup && submitted - retired < pArgs->depth){
+        slot = submitted % pArgs->depth;
+        count = pArgs->warmup - sent < pArgs->batch ?
+          (unsigned int) (pArgs->warmup - sent) : pArgs->batch;
+        for (k = 0; k < (int) count; ++k){
+          U8 *pPacket = pBuffer + ((size_t) slot * pArgs->batch + k) * txSize;
+          fillPacket(pStream, pPacket, pArgs->packetSize);
+          vItems[slot * pArgs->batch + k] = STAR_createPacket(NULL, pPacket, txSize,
+                                                              STAR_EOP_TYPE_EOP);
+        }
+        vCounts[slot] = count;
+        vOps[slot] = STAR_createTxOperation(vItems + slot * pArgs->batch, count);
+        if (vOps[slot] != NULL)
+          stampPackets(pPlan, pBuffer + (size_t) slot * pArgs->batch * txSize,
+                       count, pArgs->packetSize);
+        if (!vOps[slot] || !STAR_submitTransferOperation(vTx[c], vOps[slot]))
+          status = 0;
+        submitted++;
+        sent += count;
+      }
+
+      //The packets of the oldest operation, then its completion.
+      slot = retired % pArgs->depth;
+      for (k = 0; status && k < (int) vCounts[slot]; ++k){
+        if (nextPacket(&vRx[r], 1, MonotonicTimeNs() + _TIMEOUT * 1000000ULL,
+                       &pRxOp) < 0){
+          status = 0;
+          break;
+        }
+        nowNs = MonotonicTimeNs();
+        RXVIEW_Map(&view, pRxOp);
+        if (view.count != 1 || !receivePacket(pPlan, pPlan->channels[r],
+                                               &view.pItems[0], nowNs, 0))
+          status = 0;
+        RXVIEW_Release(&view);
+        RXSTREAM_Recycle(&vRx[r]);
+      }
+      if (status){
+        if (STAR_waitOnTransferOperationCompletion(vOps[slot], _TIMEOUT) !=
+            STAR_TRANSFER_STATUS_COMPLETE)
+          status = 0;
+        STAR_disposeTransferOperation(vOps[slot]);
+        vOps[slot] = NULL;
+        for (k = 0; k < (int) vCounts[slot]; ++k)
+          STAR_destroyStreamItem(vItems[slot * pArgs->batch + k]);
+        done += vCounts[slot];
+        vCounts[slot] = 0;
+      }
+    }
+
+    //What a failure left in flight.
+    for (slot = 0; slot < pArgs->depth; ++slot){
+      if (vOps[slot]){
+        STAR_cancelTransferOperation(vOps[slot]);
+        STAR_disposeTransferOperation(vOps[slot]);
+        vOps[slot] = NULL;
+      }
+      for (k = 0; k < (int) vCounts[slot]; ++k)
+        STAR_destroyStreamItem(vItems[slot * pArgs->batch + k]);
+      vCounts[slot] = 0;
+    }
+    if (!status)
+      printf("\nERROR: Stream %u, channel %u to address 0x%02X, failed alone.\n",
+             i, pStream->channel, pStream->pRoute->address);
+
+    //The load starts the stream again.
+    SVERIFY_Init(&pStream->tx, (U8) i, DATA_TYPE_RANDOM, pArgs->seed + i);
+    pStream->rx = pStream->tx;
+    pStream->queued = 0;
+  }
+
+  for (c = 0; c < opened; ++c){
+    STAR_CHANNEL_ID rxChannelId = vRx[c].channelId;
+    RXSTREAM_Close(&vRx[c]);
+    STAR_closeChannel(rxChannelId);
+  }
+  for (c = 0; c < pPlan->channelCount; ++c)
+    if (vTx[c] != 0)
+      STAR_closeChannel(vTx[c]);
+  RXVIEW_Free(&view);
+  free(pBuffer);
+  free(vItems);
+  free(vOps);
+  free(vCounts);
+  return status;
+}
+
+
+/* Every worker at once, the receivers with their operations posted. The
+   first one through takes the start time of the load. */
+static void startTogether(STRESS_ARGS * const pArgs){
+  if (pthread_barrier_wait(&pArgs->start) == PTHREAD_BARRIER_SERIAL_THREAD)
+    __atomic_store_n(&pArgs->startNs, MonotonicTimeNs(), __ATOMIC_RELEASE);
+}
+
+
+//Streams of the channel round robin, until time, count or Ctrl-C.
+static int transmit(DEVMGR_WORKER * const pWorker, STRESS_ARGS * const pArgs,
+                    PLAN * const pPlan, const unsigned int index){
+  STREAM *pStreams = pPlan->pStreams + index * pPlan->reached;
+  STAR_CHANNEL_ID channelId;
+  STAR_TRANSFER_OPERATION **vOps;
+  STAR_STREAM_ITEM **vItems;
+  U32 *vCounts;
+  U8 *pBuffer;
+  U32 txSize = pArgs->packetSize + 1, i, slot, count;
+  unsigned long long startNs, nowNs, endNs, total, heldNs = 0, ops = 0;
+  unsigned int next = 0;
+  int status = 0;
+
+  channelId = STAR_openChannelToLocalDevice(pWorker->deviceId, STAR_CHANNEL_DIRECTION_OUT,
+                                            pWorker->channelNumber, TRUE);
+  pBuffer = malloc((size_t) pArgs->depth * pArgs->batch * txSize);
+  vItems = calloc((size_t) pArgs->depth * pArgs->batch, sizeof(STAR_STREAM_ITEM *));
+  vOps = calloc(pArgs->depth, sizeof(STAR_TRANSFER_OPERATION *));
+  vCounts = calloc(pArgs->depth, sizeof(U32));
+  if (channelId == 0 || !pBuffer || !vItems || !vOps || !vCounts){
+    snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH,
+             "tx: Unable to open channel %u", pWorker->channelNumber);
+    status = 1;
+  }
+
+  startTogether(pArgs);
+  startNs = MonotonicTimeNs();
+  endNs = pArgs->seconds ? startNs + pArgs->seconds * 1000000000ULL : 0;
+  total = (unsigned long long) pArgs->packetCount * pPlan->reached;
+
+  while (!status && !stopRequested){
+    nowNs = MonotonicTimeNs();
+    if ((endNs && nowNs >= endNs) || (total && pWorker->packets >= total))
+      break;
+    count = pArgs->batch;
+    if (total && total - pWorker->packets < count)
+      count = (U32) (total - pWorker->packets);
+
+    //The slot of the operation sent depth operations before, once done.
+    slot = (U32) (ops % pArgs->depth);
+    if (vOps[slot] != NULL){
+      if (STAR_waitOnTransferOperationCompletion(vOps[slot], _TIMEOUT) !=
+          STAR_TRANSFER_STATUS_COMPLETE){
+        snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH,
+                 "tx: Transmit failed after %llu packets", pWorker->packets);
+        status = 1;
+        break;
+      }
+      heldNs += MonotonicTimeNs() - nowNs;
+      STAR_disposeTransferOperation(vOps[slot]);
+      vOps[slot] = NULL;
+      for (i = 0; i < vCounts[slot]; ++i)
+        STAR_destroyStreamItem(vItems[slot * pArgs->batch + i]);
+    }
+
+    for (i = 0; i < count; ++i){
+      U8 *pPacket = pBuffer + ((size_t) slot * pArgs->batch + i) * txSize;
+      fillPacket(&pStreams[next], pPacket, pArgs->packetSize);
+      next = (next + 1) % pPlan->reached;
+      vItems[slot * pArgs->batch + i] = STAR_createPacket(NULL, pPacket, txSize,
+                                                          STAR_EOP_TYPE_EOP);
+    }
+    vCounts[slot] = count;
+    vOps[slot] = STAR_createTxOperation(vItems + slot * pArgs->batch, count);
+    if (vOps[slot] != NULL)
+      stampPackets(pPlan, pBuffer + (size_t) slot * pArgs->batch * txSize, count,
+                   pArgs->packetSize);
+    if (vOps[slot] == NULL ||
+        !STAR_submitTransferOperation(channelId, vOps[slot])){
+      snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH,
+               "tx: Unable to submit after %llu packets", pWorker->packets);
+      pWorker->errors += count;
+      if (vOps[slot] != NULL)
+        STAR_disposeTransferOperation(vOps[slot]);
+      vOps[slot] = NULL;
+      for (i = 0; i < count; ++i)
+        STAR_destroyStreamItem(vItems[slot * pArgs->batch + i]);
+      status = 1;
+      break;
+    }
+    ops++;
+    pWorker->packets += count;
+    pWorker->bytes += (unsigned long long) count * txSize;
+  }
+
+  for (slot = 0; vOps != NULL && slot < pArgs->depth; ++slot)
+    if (vOps[slot] != NULL){
+      if (STAR_waitOnTransferOperationCompletion(vOps[slot], _TIMEOUT) !=
+          STAR_TRANSFER_STATUS_COMPLETE){
+        STAR_cancelTransferOperation(vOps[slot]);
+        pWorker->errors += vCounts[slot];
+        status = 1;
+      }
+      STAR_disposeTransferOperation(vOps[slot]);
+      for (i = 0; i < vCounts[slot]; ++i)
+        STAR_destroyStreamItem(vItems[slot * pArgs->batch + i]);
+    }
+
+  nowNs = MonotonicTimeNs();
+  pPlan->txEndNs[index] = nowNs;
+  pWorker->durationNs = nowNs - startNs;
+  __atomic_sub_fetch(&pPlan->txActive, 1, __ATOMIC_RELEASE);
+  if (!status)
+    snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH,
+             "tx: %.2f Mbit/s to %u addresses, held %.1f%%",
+             pWorker->bytes * 8.0 * 1e3 / (nowNs - startNs), pPlan->reached,
+             heldNs * 100.0 / (nowNs - startNs));
+
+  pthread_barrier_wait(&pArgs->done);
+  if (channelId != 0)
+    STAR_closeChannel(channelId);
+  free(pBuffer);
+  free(vItems);
+  free(vOps);
+  free(vCounts);
+  return status;
+}
+
+
+//The streams routed to the channel, until the transmitters are done.
+static int receive(DEVMGR_WORKER * const pWorker, STRESS_ARGS * const pArgs,
+                   PLAN * const pPlan){
+  STAR_CHANNEL_ID channelId;
+  STAR_TRANSFER_OPERATION *pOp;
+  STAR_TRANSFER_STATUS result;
+  RXSTREAM rx;
+  RXVIEW view;
+  unsigned long long rejected = 0, nowNs, lastNs = 0;
+  unsigned int idle = 0;
+  U32 i;
+  int status = 0;
+
+  //One packet per operation, enough of them for a window of every source.
+  memset(&rx, 0, sizeof(rx));
+  channelId = STAR_openChannelToLocalDevice(pWorker->deviceId, STAR_CHANNEL_DIRECTION_IN,
+                                            pWorker->channelNumber, TRUE);
+  if (channelId == 0 ||
+      !RXSTREAM_Open(&rx, channelId,
+                     pArgs->depth * pArgs->batch * pPlan->channelCount, 1)){
+    snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH,
+             "rx: Unable to open channel %u", pWorker->channelNumber);
+    status = 1;
+  }
+  RXVIEW_Init(&view);
+
+  startTogether(pArgs);
+
+  while (!status){
+    pOp = RXSTREAM_Next(&rx, _POLL_MS, &result);
+    if (pOp == NULL){
+      if (result != STAR_TRANSFER_STATUS_STARTED){
+        snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH,
+                 "rx: Receive failed after %llu packets", pWorker->packets);
+        status = 1;
+      }
+      //Done once the transmitters are and the router is empty.
+      else if (__atomic_load_n(&pPlan->txActive, __ATOMIC_ACQUIRE) == 0 &&
+               ++idle >= _DRAIN_POLLS)
+        break;
+      continue;
+    }
+    idle = 0;
+    nowNs = lastNs = MonotonicTimeNs();
+    RXVIEW_Map(&view, pOp);
+    for (i = 0; i < view.count; ++i)
+      if (receivePacket(pPlan, pWorker->channelNumber, &view.pItems[i], nowNs, 1)){
+        pWorker->packets++;
+        pWorker->bytes += view.pItems[i].length;
+      }
+      else{
+        pWorker->errors++;
+        rejected++;
+      }
+    RXVIEW_Release(&view);
+    if (!RXSTREAM_Recycle(&rx))
+      status = 1;
+  }
+
+  pthread_barrier_wait(&pArgs->done);
+  if (channelId != 0){
+    RXSTREAM_Close(&rx);
+    STAR_closeChannel(channelId);
+  }
+  RXVIEW_Free(&view);
+  //Up to the last packet, without the idle polls of the drain.
+  nowNs = __atomic_load_n(&pArgs->startNs, __ATOMIC_ACQUIRE);
+  if (lastNs > nowNs)
+    pWorker->durationNs = lastNs - nowNs;
+  if (!status)
+    snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH,
+             "rx: %llu packets rejected", rejected);
+  return status;
+}
+
+
+int stressJob(DEVMGR_WORKER * const pWorker, void * const pArgument){
+  STRESS_ARGS *pArgs = (STRESS_ARGS *) pArgument;
+  PLAN *pPlan = &pArgs->pPlans[pWorker->deviceIndex];
+  unsigned int index;
+
+  if (pWorker->role == _ROLE_RX)
+    return receive(pWorker, pArgs, pPlan);
+
+  for (index = 0; pPlan->channels[index] != pWorker->channelNumber; ++index)
+    ;
+  __atomic_add_fetch(&pPlan->txActive, 1, __ATOMIC_RELAXED);
+  return transmit(pWorker, pArgs, pPlan, index);
+}
+
+
+/* Jain's fairness index of the throughput of the streams to a channel, or
+   of all of them if channel is 0 */
+static double jainIndex(const PLAN * const pPlan, const U8 channel,
+                        unsigned int * const pCount, double * const pMbps,
+                        const unsigned long long durationNs){
+  double mbps, sum = 0.0, squares = 0.0;
+  unsigned int i;
+
+  *pCount = 0;
+  for (i = 0; i < pPlan->streamCount; ++i){
+    if (channel != 0 && pPlan->pStreams[i].pRoute->channel != channel)
+      continue;
+    mbps = pPlan->pStreams[i].rx.bytes * 8.0 * 1e3 / durationNs;
+    sum += mbps;
+    squares += mbps * mbps;
+    (*pCount)++;
+  }
+  *pMbps = sum;
+
+  return squares > 0.0 ? sum * sum / (*pCount * squares) : 0.0;
+}
+
+
+static void printPlan(const PLAN * const pPlan, const unsigned int index,
+                      const unsigned long long durationNs){
+  const STREAM *pStream;
+  unsigned long long soloNs, loadNs;
+  unsigned int i, count;
+  double jain, mbps;
+
+  if (durationNs == 0)
+    return;
+  printf("\nDevice %u, %.3f s under load:\n", index, durationNs / 1e9);
+  printf("%-6s %-4s %-7s %-3s %12s %9s %8s %8s %10s %10s %10s %6s\n",
+         "stream", "from", "address", "to", "packets", "Mbit/s", "lost",
+         "errors", "solo p50", "load p50", "load p99", "growth");
+  for (i = 0; i < pPlan->streamCount; ++i){
+    pStream = &pPlan->pStreams[i];
+    soloNs = LATHIST_Percentile(&pStream->solo, 0.5);
+    loadNs = LATHIST_Percentile(&pStream->load, 0.5);
+    printf("%-6u %-4u 0x%02X    %-3u %12llu %9.2f %8llu %8llu %8.1fus %8.1fus"
+           " %8.1fus %5.1fx\n", i, pStream->channel, pStream->pRoute->address,
+           pStream->pRoute->channel, pStream->rx.packets,
+           pStream->rx.bytes * 8.0 * 1e3 / durationNs, pStream->rx.lost,
+           SVERIFY_Errors(&pStream->rx) - pStream->rx.lost, soloNs / 1e3,
+           loadNs / 1e3, LATHIST_Percentile(&pStream->load, 0.99) / 1e3,
+           soloNs ? (double) loadNs / soloNs : 0.0);
+  }
+
+  for (i = 0; i < pPlan->channelCount; ++i){
+    jain = jainIndex(pPlan, pPlan->channels[i], &count, &mbps, durationNs);
+    if (count > 0)
+      printf("Output channel %u: %u streams, %.2f Mbit/s, Jain fairness %.3f.\n",
+             pPlan->channels[i], count, mbps, jain);
+  }
+  jain = jainIndex(pPlan, 0, &count, &mbps, durationNs);
+  printf("All %u streams: %.2f Mbit/s, Jain fairness %.3f.\n", count, mbps, jain);
+}
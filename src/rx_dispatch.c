@@ -0,0 +1,299 @@
+/*
+  @file rx_dispatch.c
+  @author Juan Manuel Gómez
+  @brief Routing of the items of receive operations to handlers by type.
+  @details See rx_dispatch.h.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rx_dispatch.h"
+#include "utility.h"
+
+
+/* The queue of an item of a receive operation */
+static int RXDISP_typeOf(const STAR_STREAM_ITEM * const pItem)
+{
+    if ((pItem == NULL) || (pItem->item == NULL))
+    {
+        return RXDISP_UNKNOWN;
+    }
+
+    switch (pItem->itemType)
+    {
+    case STAR_STREAM_ITEM_TYPE_SPACEWIRE_PACKET:
+        return RXDISP_PACKET;
+    case STAR_STREAM_ITEM_TYPE_TIMECODE:
+        return RXDISP_TIMECODE;
+    case STAR_STREAM_ITEM_TYPE_LINK_STATE_EVENT:
+        return RXDISP_LINK_EVENT;
+    case STAR_STREAM_ITEM_TYPE_DATA_CHUNK:
+        return RXDISP_DATA_CHUNK;
+    default:
+        return RXDISP_UNKNOWN;
+    }
+}
+
+
+
+void RXDISP_Init(RXDISP * const pDispatch)
+{
+    memset(pDispatch, 0, sizeof(RXDISP));
+    RXVIEW_Init(&pDispatch->view);
+}
+
+
+
+/**
+ * Register the handler of a type of item and make its queue. All the
+ * handlers are registered before the first RXDISP_Route().
+ *
+ * @param pDispatch the dispatcher
+ * @param type RXDISP_PACKET to RXDISP_UNKNOWN
+ * @param handler called by RXDISP_Poll() for each item of the type
+ * @param pContext passed to the handler
+ * @param capacity the items the queue holds, rounded up to a power of two
+ * @param slotLength the bytes kept of each packet or data chunk
+ *
+ * @return 1 on success, 0 on error
+ */
+int RXDISP_Register(RXDISP * const pDispatch, const int type,
+    const RXDISP_HANDLER handler, void * const pContext,
+    const unsigned long capacity, const U32 slotLength)
+{
+    RXDISP_QUEUE *pQueue;
+    U32 dataLength = 0U;
+
+    if ((type < 0) || (type >= RXDISP_TYPES) || (handler == NULL) ||
+        (capacity == 0UL))
+    {
+        puts("RXDISP_Register: Invalid type, handler or capacity");
+        return 0;
+    }
+    pQueue = &pDispatch->queues[type];
+    if (pQueue->handler != NULL)
+    {
+        puts("RXDISP_Register: The type has a handler already");
+        return 0;
+    }
+
+    if ((type == RXDISP_PACKET) || (type == RXDISP_DATA_CHUNK))
+    {
+        dataLength = slotLength;
+    }
+    if (!SPSC_Init(&pQueue->ring, capacity,
+        sizeof(RXDISP_EVENT) + dataLength))
+    {
+        puts("RXDISP_Register: Unable to allocate the queue");
+        return 0;
+    }
+
+    pQueue->slotLength = dataLength;
+    pQueue->handler = handler;
+    pQueue->pContext = pContext;
+    return 1;
+}
+
+
+
+/**
+ * Put every item of a completed receive operation in the queue of its
+ * type. The producer side: one thread only. The operation may be recycled
+ * or disposed once it returns.
+ *
+ * @param pDispatch the dispatcher
+ * @param pOp a completed receive operation
+ * @param link the link the operation was received on, given to every event
+ *
+ * @return the number of items of the operation
+ */
+U32 RXDISP_Route(RXDISP * const pDispatch,
+    STAR_TRANSFER_OPERATION * const pOp, const U8 link)
+{
+    const unsigned long long nowNs = MonotonicTimeNs();
+    const RXVIEW_ITEM *pItem;
+    STAR_STREAM_ITEM *pStreamItem;
+    RXDISP_QUEUE *pQueue;
+    RXDISP_EVENT *pEvent;
+    U32 count, i;
+    int type;
+
+    count = RXVIEW_Map(&pDispatch->view, pOp);
+    for (i = 0U; i < count; i++)
+    {
+        pStreamItem = STAR_getTransferItem(pOp, i);
+        pItem = &pDispatch->view.pItems[i];
+        type = RXDISP_typeOf(pStreamItem);
+        pQueue = &pDispatch->queues[type];
+
+        if (pQueue->handler == NULL)
+        {
+            pQueue->unhandled++;
+            continue;
+        }
+
+        pEvent = (RXDISP_EVENT *)SPSC_Reserve(&pQueue->ring);
+        if (pEvent == NULL)
+        {
+            pQueue->dropped++;
+            continue;
+        }
+
+        pEvent->type = type;
+        pEvent->pData = NULL;
+        pEvent->length = 0U;
+        pEvent->fullLength = 0U;
+        pEvent->eop = pItem->eop;
+        pEvent->timeCode = 0U;
+        pEvent->link = link;
+        pEvent->linkState = 0U;
+        pEvent->routedNs = nowNs;
+
+        if (type == RXDISP_TIMECODE)
+        {
+            pEvent->timeCode = STAR_getTimeCodeValue(
+                (STAR_TIMECODE *)pStreamItem->item);
+        }
+        else if (type == RXDISP_LINK_EVENT)
+        {
+            pEvent->linkState = STAR_getLinkStateEventState(
+                (STAR_LINK_STATE_EVENT *)pStreamItem->item);
+        }
+        else if ((pQueue->slotLength > 0U) && (pItem->pData != NULL))
+        {
+            U8 * const pSlot = (U8 *)(pEvent + 1);
+
+            pEvent->fullLength = pItem->length;
+            pEvent->length = MIN(pItem->length, pQueue->slotLength);
+            if (pEvent->length < pItem->length)
+            {
+                pQueue->truncated++;
+            }
+            memcpy(pSlot, pItem->pData, pEvent->length);
+            pEvent->pData = pSlot;
+        }
+
+        pQueue->routed++;
+        SPSC_Publish(&pQueue->ring);
+    }
+    RXVIEW_Release(&pDispatch->view);
+
+    return count;
+}
+
+
+
+/**
+ * Hand the queued items of a type to its handler. The consumer side: one
+ * thread per type.
+ *
+ * @param pDispatch the dispatcher
+ * @param type the type
+ * @param most the most items to hand, 0 for all those queued
+ *
+ * @return the number of items handed
+ */
+unsigned long RXDISP_Poll(RXDISP * const pDispatch, const int type,
+    const unsigned long most)
+{
+    RXDISP_QUEUE * const pQueue = &pDispatch->queues[type];
+    unsigned long count, i;
+
+    if (pQueue->handler == NULL)
+    {
+        return 0UL;
+    }
+
+    count = SPSC_Readable(&pQueue->ring);
+    if ((most != 0UL) && (count > most))
+    {
+        count = most;
+    }
+
+    for (i = 0UL; i < count; i++)
+    {
+        pQueue->handler((const RXDISP_EVENT *)SPSC_Slot(&pQueue->ring, i),
+            pQueue->pContext);
+    }
+
+    /* The slots are given back once all of them are handled */
+    if (count > 0UL)
+    {
+        SPSC_Consume(&pQueue->ring, count);
+    }
+
+    return count;
+}
+
+
+
+/* Every type in turn, from a thread that both routes and polls */
+unsigned long RXDISP_PollAll(RXDISP * const pDispatch)
+{
+    unsigned long count = 0UL;
+    int type;
+
+    for (type = 0; type < RXDISP_TYPES; type++)
+    {
+        count += RXDISP_Poll(pDispatch, type, 0UL);
+    }
+
+    return count;
+}
+
+
+
+void RXDISP_PrintStatistics(FILE * const pFile,
+    const RXDISP * const pDispatch)
+{
+    const RXDISP_QUEUE *pQueue;
+    int type;
+
+    for (type = 0; type < RXDISP_TYPES; type++)
+    {
+        pQueue = &pDispatch->queues[type];
+        if ((pQueue->handler == NULL) && (pQueue->unhandled == 0ULL))
+        {
+            continue;
+        }
+        fprintf(pFile, "%-12s %llu routed, %llu dropped, %llu truncated, "
+            "%llu without handler\n", RXDISP_TypeString(type),
+            pQueue->routed, pQueue->dropped, pQueue->truncated,
+            pQueue->unhandled);
+    }
+}
+
+
+
+void RXDISP_Free(RXDISP * const pDispatch)
+{
+    int type;
+
+    for (type = 0; type < RXDISP_TYPES; type++)
+    {
+        SPSC_Free(&pDispatch->queues[type].ring);
+    }
+    RXVIEW_Free(&pDispatch->view);
+    RXDISP_Init(pDispatch);
+}
+
+
+
+const char *RXDISP_TypeString(const int type)
+{
+    switch (type)
+    {
+    case RXDISP_PACKET:
+        return "packet";
+    case RXDISP_TIMECODE:
+        return "time-code";
+    case RXDISP_LINK_EVENT:
+        return "link event";
+    case RXDISP_DATA_CHUNK:
+        return "data chunk";
+    default:
+        return "unknown";
+    }
+}
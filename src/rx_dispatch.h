@@ -0,0 +1,109 @@
+/*
+  @file rx_dispatch.h
+  @author Juan Manuel Gómez
+  @brief Routing of the items of receive operations to handlers by type.
+  @details A receive operation mixes packets, time-codes, link state
+           events and data chunks. RXDISP_Route() goes through the items of
+           a completed operation once and puts each one in the queue of its
+           type, RXDISP_PACKET to RXDISP_UNKNOWN, copying what it needs: the
+           operation may be recycled as soon as it returns. RXDISP_Poll()
+           hands the queued items of a type to the handler registered for
+           it.
+
+           Each queue is a lock-free ring (SPSC_RING, ring.h) with a single
+           producer, the thread that routes, and a single consumer, the
+           thread that polls that type. Routing and polling may thus run on
+           different threads, one consumer per type: time-codes can be
+           handled on
+           their own thread, with low latency, while bulk packets are
+           handled elsewhere. A single thread may also route and then poll
+           every type. A type with no handler is only counted; an item
+           that finds its queue full is dropped and counted, the producer
+           never waits for a consumer.
+
+           Packets and data chunks are copied into the slot of their event,
+           right after it, up to the length given when the handler is
+           registered; a longer one is truncated and counted.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef RX_DISPATCH_H
+#define RX_DISPATCH_H
+
+#include <stdio.h>
+#include "star-dundee_types.h"
+#include "star-api.h"
+#include "rx_view.h"
+#include "ring.h"
+
+/* Types of the items */
+#define RXDISP_PACKET 0
+#define RXDISP_TIMECODE 1
+#define RXDISP_LINK_EVENT 2
+#define RXDISP_DATA_CHUNK 3
+#define RXDISP_UNKNOWN 4
+#define RXDISP_TYPES 5
+
+typedef struct
+{
+    int type;
+    const U8 *pData;        /* packets and data chunks, NULL otherwise */
+    U32 length;             /* bytes at pData, at most the slot length */
+    U32 fullLength;         /* bytes received */
+    STAR_EOP_TYPE eop;
+    U8 timeCode;            /* RXDISP_TIMECODE */
+    U8 link;                /* link the operation was received on */
+    U8 linkState;           /* RXDISP_LINK_EVENT, the state entered */
+    unsigned long long routedNs;    /* MonotonicTimeNs() when routed */
+} RXDISP_EVENT;
+
+/* Called for each event, on the thread that polls; pEvent and its data
+ * are only valid during the call */
+typedef void (*RXDISP_HANDLER)(const RXDISP_EVENT * const pEvent,
+    void * const pContext);
+
+typedef struct
+{
+    /* Counts, written by the producer only */
+    unsigned long long routed;
+    unsigned long long dropped;
+    unsigned long long truncated;
+    unsigned long long unhandled;
+    char countsPad[RING_CACHE_LINE - 4 * sizeof(unsigned long long)];
+
+    SPSC_RING ring;             /* of events, each followed by its data */
+
+    /* Read only once registered */
+    U32 slotLength;
+    RXDISP_HANDLER handler;
+    void *pContext;
+} RXDISP_QUEUE;
+
+typedef struct
+{
+    RXDISP_QUEUE queues[RXDISP_TYPES];
+    RXVIEW view;                /* of the producer */
+} RXDISP;
+
+void RXDISP_Init(RXDISP * const pDispatch);
+
+int RXDISP_Register(RXDISP * const pDispatch, const int type,
+    const RXDISP_HANDLER handler, void * const pContext,
+    const unsigned long capacity, const U32 slotLength);
+
+U32 RXDISP_Route(RXDISP * const pDispatch,
+    STAR_TRANSFER_OPERATION * const pOp, const U8 link);
+
+unsigned long RXDISP_Poll(RXDISP * const pDispatch, const int type,
+    const unsigned long most);
+
+unsigned long RXDISP_PollAll(RXDISP * const pDispatch);
+
+void RXDISP_PrintStatistics(FILE * const pFile,
+    const RXDISP * const pDispatch);
+
+void RXDISP_Free(RXDISP * const pDispatch);
+
+const char *RXDISP_TypeString(const int type);
+
+#endif
@@ -0,0 +1,178 @@
+/*
+  @file rx_stream.c
+  @author Juan Manuel Gómez
+  @brief Continuous receive engine with several RX operations in flight.
+  @details See rx_stream.h.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rx_stream.h"
+
+
+/**
+ * Create and submit the receive operations of the stream.
+ *
+ * @param pStream the stream to initialise
+ * @param channelId an opened channel to receive from
+ * @param depth the number of operations kept in flight
+ * @param batchSize the number of packets held by each operation
+ *
+ * @return 1 on success, 0 on error. Nothing is left allocated on error.
+ */
+int RXSTREAM_Open(RXSTREAM * const pStream, const STAR_CHANNEL_ID channelId,
+    const unsigned int depth, const unsigned int batchSize)
+{
+    unsigned int i;
+
+    memset(pStream, 0, sizeof(RXSTREAM));
+    pStream->channelId = channelId;
+    pStream->depth = (depth > 0U) ? depth : RXSTREAM_DEFAULT_DEPTH;
+    pStream->batchSize = (batchSize > 0U) ? batchSize : RXSTREAM_DEFAULT_BATCH;
+
+    pStream->pOps = (STAR_TRANSFER_OPERATION **)calloc(pStream->depth,
+        sizeof(STAR_TRANSFER_OPERATION *));
+    pStream->pStamps = (OPTIME_STAMP *)calloc(pStream->depth,
+        sizeof(OPTIME_STAMP));
+    if ((pStream->pOps == NULL) || (pStream->pStamps == NULL))
+    {
+        puts("RXSTREAM_Open: Unable to allocate the operation ring");
+        free(pStream->pOps);
+        free(pStream->pStamps);
+        pStream->pOps = NULL;
+        pStream->pStamps = NULL;
+        return 0;
+    }
+
+    for (i = 0U; i < pStream->depth; i++)
+    {
+        pStream->pOps[i] = STAR_createRxOperation(pStream->batchSize,
+            STAR_RECEIVE_PACKETS);
+        if ((pStream->pOps[i] == NULL) ||
+            (OPTIME_Submit(&pStream->pStamps[i], channelId,
+                OPTIME_RX, pStream->pOps[i]) == 0))
+        {
+            printf("RXSTREAM_Open: Unable to post receive operation %u\n", i);
+            RXSTREAM_Close(pStream);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+
+/**
+ * Wait for the oldest operation in flight to complete. The operation is
+ * owned by the stream; it stays valid until RXSTREAM_Recycle() is called.
+ * An operation that failed or was cancelled is counted as an error and
+ * posted again at the tail of the queue, so the next call waits for the
+ * one after it.
+ *
+ * @param pStream the stream
+ * @param timeout the time to wait in milliseconds
+ * @param pStatus updated with the status of the operation, may be NULL
+ *
+ * @return the completed operation, or NULL if it did not complete
+ */
+STAR_TRANSFER_OPERATION *RXSTREAM_Next(RXSTREAM * const pStream,
+    const int timeout, STAR_TRANSFER_STATUS * const pStatus)
+{
+    STAR_TRANSFER_OPERATION *pOp = pStream->pOps[pStream->head];
+    OPTIME_STAMP *pStamp = &pStream->pStamps[pStream->head];
+    STAR_TRANSFER_STATUS status;
+
+    status = OPTIME_Wait(pStamp, pOp, timeout);
+    if (pStatus != NULL)
+    {
+        *pStatus = status;
+    }
+
+    if (status != STAR_TRANSFER_STATUS_COMPLETE)
+    {
+        if (status != STAR_TRANSFER_STATUS_STARTED)
+        {
+            pStream->errors++;
+            pStream->head = (pStream->head + 1U) % pStream->depth;
+            if (OPTIME_Submit(pStamp, pStream->channelId, OPTIME_RX,
+                pOp) == 0)
+            {
+                pStream->errors++;
+            }
+        }
+        return NULL;
+    }
+
+    pStream->holding = 1;
+    pStream->opsCompleted++;
+    pStream->itemsReceived += STAR_getTransferItemCount(pOp);
+
+    return pOp;
+}
+
+
+
+/**
+ * Post again the operation returned by RXSTREAM_Next(), at the tail of the
+ * channel queue, and move on to the next one.
+ *
+ * @return 1 on success, 0 if the operation could not be submitted
+ */
+int RXSTREAM_Recycle(RXSTREAM * const pStream)
+{
+    STAR_TRANSFER_OPERATION *pOp = pStream->pOps[pStream->head];
+    OPTIME_STAMP *pStamp = &pStream->pStamps[pStream->head];
+
+    if (!pStream->holding)
+    {
+        return 1;
+    }
+    pStream->holding = 0;
+
+    OPTIME_Consumed(pStamp);
+    pStream->head = (pStream->head + 1U) % pStream->depth;
+    if (OPTIME_Submit(pStamp, pStream->channelId, OPTIME_RX, pOp) == 0)
+    {
+        pStream->errors++;
+        return 0;
+    }
+
+    return 1;
+}
+
+
+
+/**
+ * Cancel the operations still in flight and dispose all of them.
+ */
+void RXSTREAM_Close(RXSTREAM * const pStream)
+{
+    unsigned int i;
+
+    if (pStream->pOps == NULL)
+    {
+        return;
+    }
+
+    for (i = 0U; i < pStream->depth; i++)
+    {
+        if (pStream->pOps[i] != NULL)
+        {
+            if (STAR_getTransferStatus(pStream->pOps[i]) ==
+                STAR_TRANSFER_STATUS_STARTED)
+            {
+                STAR_cancelTransferOperation(pStream->pOps[i]);
+            }
+            STAR_disposeTransferOperation(pStream->pOps[i]);
+        }
+    }
+
+    free(pStream->pOps);
+    free(pStream->pStamps);
+    pStream->pOps = NULL;
+    pStream->pStamps = NULL;
+}
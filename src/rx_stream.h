@@ -0,0 +1,53 @@
+/*
+  @file rx_stream.h
+  @author Juan Manuel Gómez
+  @brief Continuous receive engine with several RX operations in flight.
+  @details A single receive operation leaves the link without a posted
+           buffer between its completion and its re-submission. The engine
+           keeps `depth` operations of `batchSize` packets queued on the
+           channel and hands them back in submission order. The consumer
+           processes the oldest one while the rest stay posted, then
+           recycles it to the tail of the queue.
+
+           The operations are stamped by the timing layer (op_timing.h):
+           submit->complete is the time an operation was posted before it
+           filled, complete->consume the time the consumer held it.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef RX_STREAM_H
+#define RX_STREAM_H
+
+#include "star-dundee_types.h"
+#include "star-api.h"
+#include "op_timing.h"
+
+#define RXSTREAM_DEFAULT_DEPTH 4
+#define RXSTREAM_DEFAULT_BATCH 64
+
+typedef struct
+{
+    STAR_CHANNEL_ID channelId;
+    unsigned int depth;
+    unsigned int batchSize;
+    STAR_TRANSFER_OPERATION **pOps;
+    OPTIME_STAMP *pStamps;
+    unsigned int head;
+    int holding;
+
+    unsigned long opsCompleted;
+    unsigned long itemsReceived;
+    unsigned long errors;
+} RXSTREAM;
+
+int RXSTREAM_Open(RXSTREAM * const pStream, const STAR_CHANNEL_ID channelId,
+    const unsigned int depth, const unsigned int batchSize);
+
+STAR_TRANSFER_OPERATION *RXSTREAM_Next(RXSTREAM * const pStream,
+    const int timeout, STAR_TRANSFER_STATUS * const pStatus);
+
+int RXSTREAM_Recycle(RXSTREAM * const pStream);
+
+void RXSTREAM_Close(RXSTREAM * const pStream);
+
+#endif
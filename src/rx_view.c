@@ -0,0 +1,139 @@
+/*
+  @file rx_view.c
+  @author Juan Manuel Gómez
+  @brief Packets of a receive operation, mapped at once.
+  @details See rx_view.h.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rx_view.h"
+
+
+
+void RXVIEW_Init(RXVIEW * const pView)
+{
+    memset(pView, 0, sizeof(RXVIEW));
+}
+
+
+
+/**
+ * Map every item of a completed receive operation. A view still holding a
+ * previous operation releases it first.
+ *
+ * @param pView the view
+ * @param pOp a completed receive operation
+ *
+ * @return the number of items mapped. Items that are not packets, or that
+ *         could not be mapped, have a NULL data pointer.
+ */
+U32 RXVIEW_Map(RXVIEW * const pView, STAR_TRANSFER_OPERATION * const pOp)
+{
+    STAR_STREAM_ITEM *pStreamItem;
+    RXVIEW_ITEM *pItems;
+    U32 itemCount, i;
+
+    RXVIEW_Release(pView);
+
+    itemCount = STAR_getTransferItemCount(pOp);
+    if (itemCount > pView->capacity)
+    {
+        pItems = (RXVIEW_ITEM *)realloc(pView->pItems,
+            itemCount * sizeof(RXVIEW_ITEM));
+        if (pItems == NULL)
+        {
+            puts("RXVIEW_Map: Unable to grow the view table");
+            return 0U;
+        }
+        pView->pItems = pItems;
+        pView->capacity = itemCount;
+    }
+
+    pView->pOp = pOp;
+    for (i = 0U; i < itemCount; i++)
+    {
+        pView->pItems[i].pData = NULL;
+        pView->pItems[i].length = 0U;
+        pView->pItems[i].eop = STAR_EOP_TYPE_INVALID;
+
+        pStreamItem = STAR_getTransferItem(pOp, i);
+        if ((pStreamItem == NULL) || (pStreamItem->item == NULL))
+        {
+            pView->pItems[i].itemType = STAR_STREAM_ITEM_TYPE_DATA_CHUNK;
+            continue;
+        }
+
+        pView->pItems[i].itemType = pStreamItem->itemType;
+        if (pStreamItem->itemType == STAR_STREAM_ITEM_TYPE_SPACEWIRE_PACKET)
+        {
+            pView->pItems[i].pData = STAR_getPacketData(
+                (STAR_SPACEWIRE_PACKET *)pStreamItem->item,
+                &pView->pItems[i].length);
+            pView->pItems[i].eop = STAR_getPacketEOP(
+                (STAR_SPACEWIRE_PACKET *)pStreamItem->item);
+        }
+    }
+    pView->count = itemCount;
+
+    return itemCount;
+}
+
+
+
+/**
+ * The data of a mapped packet.
+ *
+ * @param pView the view
+ * @param index the index of the item in the operation
+ * @param pLength updated with the length of the packet data
+ *
+ * @return the packet data, or NULL if the item is not a packet
+ */
+const U8 *RXVIEW_Packet(const RXVIEW * const pView, const U32 index,
+    U32 * const pLength)
+{
+    if (index >= pView->count)
+    {
+        *pLength = 0U;
+        return NULL;
+    }
+
+    *pLength = pView->pItems[index].length;
+    return pView->pItems[index].pData;
+}
+
+
+
+/**
+ * Free the data of the packets mapped. The operation may be re-submitted
+ * or disposed afterwards.
+ * The view table is kept for the next operation.
+ */
+void RXVIEW_Release(RXVIEW * const pView)
+{
+    U32 i;
+
+    for (i = 0U; i < pView->count; i++)
+    {
+        if (pView->pItems[i].pData != NULL)
+        {
+            STAR_destroyPacketData((U8 *)pView->pItems[i].pData);
+        }
+    }
+
+    pView->pOp = NULL;
+    pView->count = 0U;
+}
+
+
+
+void RXVIEW_Free(RXVIEW * const pView)
+{
+    RXVIEW_Release(pView);
+    free(pView->pItems);
+    RXVIEW_Init(pView);
+}
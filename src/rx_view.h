@@ -0,0 +1,50 @@
+/*
+  @file rx_view.h
+  @author Juan Manuel Gómez
+  @brief Packets of a receive operation, mapped at once.
+  @details A view maps all the items of a completed receive operation at
+           once and hands out pointer/length pairs, so the consumers walk
+           an operation the same way whatever it holds. The data of each
+           packet is the copy STAR_getPacketData() allocates, the only
+           accessor of the STAR-API; RXVIEW_Release() frees them all. The
+           pointers stay valid until then.
+
+           The view table is kept between operations and only grows, so a
+           view reused in a receive loop does not allocate for the table.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef RX_VIEW_H
+#define RX_VIEW_H
+
+#include "star-dundee_types.h"
+#include "star-api.h"
+
+typedef struct
+{
+    const U8 *pData;
+    U32 length;
+    STAR_STREAM_ITEM_TYPE itemType;
+    STAR_EOP_TYPE eop;
+} RXVIEW_ITEM;
+
+typedef struct
+{
+    STAR_TRANSFER_OPERATION *pOp;
+    RXVIEW_ITEM *pItems;
+    U32 count;
+    U32 capacity;
+} RXVIEW;
+
+void RXVIEW_Init(RXVIEW * const pView);
+
+U32 RXVIEW_Map(RXVIEW * const pView, STAR_TRANSFER_OPERATION * const pOp);
+
+const U8 *RXVIEW_Packet(const RXVIEW * const pView, const U32 index,
+    U32 * const pLength);
+
+void RXVIEW_Release(RXVIEW * const pView);
+
+void RXVIEW_Free(RXVIEW * const pView);
+
+#endif
@@ -0,0 +1,1493 @@
+/*
+  @file star_sim.c
+  @author Juan Manuel Gómez
+  @brief Software stand-in for the subset of the STAR-API used by the
+         collection.
+  @details Implements devices, channels, transfer operations and stream
+           items in process memory. Transfer operations complete under a
+           single lock, and waiters are woken through one condition
+           variable. See star_sim.h for the configuration.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "star-dundee_types.h"
+#include "star-api.h"
+#include "cfg_api_mk2.h"
+#include "cfg_api_mk2_types.h"
+#include "star_sim.h"
+#include "gr718_sim.h"
+
+
+typedef struct SIM_PACKET
+{
+    U8 *pData;
+    U32 length;
+    STAR_EOP_TYPE eop;
+    STAR_SPACEWIRE_ADDRESS *pAddress;
+} SIM_PACKET;
+
+typedef struct SIM_TIMECODE
+{
+    U8 value;
+} SIM_TIMECODE;
+
+typedef struct SIM_LINK_EVENT
+{
+    U8 state;
+} SIM_LINK_EVENT;
+
+struct SIM_CHANNEL;
+
+typedef struct SIM_OPERATION
+{
+    int isRx;
+    U32 maxItems;
+    U32 itemCount;
+    STAR_STREAM_ITEM **pItems;
+    STAR_TRANSFER_STATUS status;
+    U32 stalled;                /* items sent that wait for buffer room */
+    struct SIM_CHANNEL *pChannel;
+    struct SIM_OPERATION *pNext;
+} SIM_OPERATION;
+
+/* An item that arrived before a receive operation to take it */
+typedef struct SIM_HELD
+{
+    STAR_STREAM_ITEM *pItem;
+    U32 length;
+    SIM_OPERATION *pTxOp;       /* the sender it stalls, if any */
+    struct SIM_HELD *pNext;
+} SIM_HELD;
+
+typedef struct SIM_CHANNEL
+{
+    int open;
+    STAR_DEVICE_ID deviceId;
+    U8 number;
+    SIM_OPERATION *pRxHead;
+    SIM_OPERATION *pRxTail;
+    SIM_HELD *pHeldHead;
+    SIM_HELD *pHeldTail;
+    U32 heldLength;
+    U32 receivers;              /* handles open for receiving */
+    unsigned long dropped;
+    unsigned long delivered;
+    STAR_CFG_MK2_BASE_TRANSMIT_CLOCK clock;
+} SIM_CHANNEL;
+
+typedef struct SIM_TRAFFIC
+{
+    pthread_t threadId;
+    U8 channelNumber;
+    U32 packetSize;
+    unsigned long packetsPerSecond;
+    unsigned long packetCount;
+    int started;
+} SIM_TRAFFIC;
+
+
+static pthread_mutex_t simLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t simCond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t simOnce = PTHREAD_ONCE_INIT;
+
+static STAR_DEVICE_ID simDevices[SIM_MAX_DEVICES];
+static U32 simDeviceCount = 0U;
+static SIM_CHANNEL simChannels[SIM_MAX_DEVICES][SIM_CHANNELS_PER_DEVICE];
+static SIM_TRAFFIC simTraffic;
+
+/* Added to the identifier of a channel opened only to transmit */
+#define SIM_SEND_ONLY_ID (SIM_MAX_DEVICES * SIM_CHANNELS_PER_DEVICE)
+/* The transmit operation being submitted, under simLock */
+static SIM_OPERATION *simSendingOp = NULL;
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*  Reads the environment configuration once per process.                     */
+/*                                                                            */
+/******************************************************************************/
+static void SIM_init(void)
+{
+    const char *pEnv;
+    unsigned int channel = 0U, size = 0U;
+    unsigned long pps = 0U, count = 0U;
+    U32 i;
+
+    simDeviceCount = 1U;
+    pEnv = getenv("STAR_SIM_DEVICES");
+    if (pEnv != NULL)
+    {
+        simDeviceCount = (U32)strtoul(pEnv, NULL, 0);
+        if (simDeviceCount > SIM_MAX_DEVICES)
+        {
+            simDeviceCount = SIM_MAX_DEVICES;
+        }
+    }
+
+    for (i = 0U; i < simDeviceCount; i++)
+    {
+        simDevices[i] = i + 1U;
+    }
+
+    memset(&simTraffic, 0, sizeof(simTraffic));
+    pEnv = getenv("STAR_SIM_TRAFFIC");
+    if ((pEnv != NULL) &&
+        (sscanf(pEnv, "%u:%u:%lu:%lu", &channel, &size, &pps, &count) >= 3) &&
+        (channel > 0U) && (channel < SIM_CHANNELS_PER_DEVICE) && (size > 0U))
+    {
+        simTraffic.channelNumber = (U8)channel;
+        simTraffic.packetSize = size;
+        simTraffic.packetsPerSecond = pps;
+        simTraffic.packetCount = count;
+    }
+
+    GR718SIM_Init(simDeviceCount);
+}
+
+
+
+static SIM_CHANNEL *SIM_findChannel(const STAR_DEVICE_ID deviceId,
+    const U8 channelNumber)
+{
+    pthread_once(&simOnce, SIM_init);
+
+    if ((deviceId == 0U) || (deviceId > simDeviceCount) ||
+        (channelNumber >= SIM_CHANNELS_PER_DEVICE))
+    {
+        return NULL;
+    }
+
+    return &simChannels[deviceId - 1U][channelNumber];
+}
+
+
+
+static SIM_CHANNEL *SIM_channelFromId(const STAR_CHANNEL_ID channelId)
+{
+    const STAR_CHANNEL_ID id = channelId % SIM_SEND_ONLY_ID;
+
+    if (id == 0U)
+    {
+        return NULL;
+    }
+
+    return SIM_findChannel((id / SIM_CHANNELS_PER_DEVICE) + 1U,
+        (U8)(id % SIM_CHANNELS_PER_DEVICE));
+}
+
+
+
+/* The two Brick links are looped to each other, every other link to itself */
+static U8 SIM_peerChannel(const U8 channelNumber)
+{
+    if (channelNumber == 1U)
+    {
+        return 2U;
+    }
+    if (channelNumber == 2U)
+    {
+        return 1U;
+    }
+
+    return channelNumber;
+}
+
+
+
+static STAR_STREAM_ITEM *SIM_newPacketItem(const U8 * const pData,
+    const U32 length, const STAR_EOP_TYPE eop)
+{
+    STAR_STREAM_ITEM *pItem;
+    SIM_PACKET *pPacket;
+
+    pItem = (STAR_STREAM_ITEM *)calloc(1U, sizeof(STAR_STREAM_ITEM));
+    pPacket = (SIM_PACKET *)calloc(1U, sizeof(SIM_PACKET));
+    if ((pItem == NULL) || (pPacket == NULL))
+    {
+        free(pItem);
+        free(pPacket);
+        return NULL;
+    }
+
+    pPacket->pData = (U8 *)malloc((length > 0U) ? length : 1U);
+    if (pPacket->pData == NULL)
+    {
+        free(pItem);
+        free(pPacket);
+        return NULL;
+    }
+    if ((pData != NULL) && (length > 0U))
+    {
+        memcpy(pPacket->pData, pData, length);
+    }
+    pPacket->length = length;
+    pPacket->eop = eop;
+
+    pItem->itemType = STAR_STREAM_ITEM_TYPE_SPACEWIRE_PACKET;
+    pItem->item = pPacket;
+
+    return pItem;
+}
+
+
+
+static STAR_STREAM_ITEM *SIM_copyItem(const STAR_STREAM_ITEM * const pSource)
+{
+    STAR_STREAM_ITEM *pItem = NULL;
+    SIM_PACKET *pPacket;
+
+    switch (pSource->itemType)
+    {
+    case STAR_STREAM_ITEM_TYPE_SPACEWIRE_PACKET:
+        pPacket = (SIM_PACKET *)pSource->item;
+        pItem = SIM_newPacketItem(pPacket->pData, pPacket->length,
+            pPacket->eop);
+        if ((pItem != NULL) && (pPacket->pAddress != NULL))
+        {
+            ((SIM_PACKET *)pItem->item)->pAddress = STAR_createAddress(
+                pPacket->pAddress->pPath, (U8)pPacket->pAddress->pathLength);
+        }
+        break;
+
+    case STAR_STREAM_ITEM_TYPE_TIMECODE:
+        pItem = STAR_createTimeCode(((SIM_TIMECODE *)pSource->item)->value);
+        break;
+
+    default:
+        break;
+    }
+
+    return pItem;
+}
+
+
+
+/* An item as it arrives at the other end of the direct loop. Like the GR718
+ * in between on the bench, the loop takes the leading path address off a
+ * packet sent with one */
+static STAR_STREAM_ITEM *SIM_loopItem(const STAR_STREAM_ITEM * const pSource)
+{
+    const SIM_PACKET *pPacket;
+
+    if (pSource->itemType != STAR_STREAM_ITEM_TYPE_SPACEWIRE_PACKET)
+    {
+        return SIM_copyItem(pSource);
+    }
+
+    pPacket = (const SIM_PACKET *)pSource->item;
+    if ((pPacket->pAddress != NULL) && (pPacket->pAddress->pathLength > 0U) &&
+        (pPacket->length > 0U) && (pPacket->pData[0] < 32U))
+    {
+        return SIM_newPacketItem(pPacket->pData + 1, pPacket->length - 1U,
+            pPacket->eop);
+    }
+
+    return SIM_newPacketItem(pPacket->pData, pPacket->length, pPacket->eop);
+}
+
+
+
+/* Append an item to the oldest receive operation posted on the channel */
+static void SIM_appendLocked(SIM_CHANNEL * const pChannel,
+    STAR_STREAM_ITEM * const pItem)
+{
+    SIM_OPERATION *pOp = pChannel->pRxHead;
+
+    pOp->pItems[pOp->itemCount++] = pItem;
+    pChannel->delivered++;
+    if (pOp->itemCount == pOp->maxItems)
+    {
+        pOp->status = STAR_TRANSFER_STATUS_COMPLETE;
+        pChannel->pRxHead = pOp->pNext;
+        if (pChannel->pRxHead == NULL)
+        {
+            pChannel->pRxTail = NULL;
+        }
+        pOp->pNext = NULL;
+        pthread_cond_broadcast(&simCond);
+    }
+}
+
+
+
+static U32 SIM_itemLength(const STAR_STREAM_ITEM * const pItem)
+{
+    if (pItem->itemType == STAR_STREAM_ITEM_TYPE_SPACEWIRE_PACKET)
+    {
+        return ((const SIM_PACKET *)pItem->item)->length;
+    }
+
+    return 1U;
+}
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*  Hands an item to the oldest receive operation posted on the channel.      */
+/*  SpaceWire is flow controlled: with no operation posted, a channel open    */
+/*  for receiving holds the item, in order, and once it holds                 */
+/*  SIM_RX_BUFFER_LENGTH bytes the transmit operation that sent the item      */
+/*  does not complete until a receive operation takes it. Takes ownership of  */
+/*  the item. Must be called with simLock held.                               */
+/*                                                                            */
+/******************************************************************************/
+static void SIM_deliverLocked(SIM_CHANNEL * const pChannel,
+    STAR_STREAM_ITEM * const pItem)
+{
+    SIM_HELD *pHeld;
+
+    if (!pChannel->open || (pChannel->receivers == 0U))
+    {
+        pChannel->dropped++;
+        STAR_destroyStreamItem(pItem);
+        return;
+    }
+
+    if (pChannel->pRxHead != NULL)
+    {
+        SIM_appendLocked(pChannel, pItem);
+        return;
+    }
+
+    pHeld = (SIM_HELD *)calloc(1U, sizeof(SIM_HELD));
+    if (pHeld == NULL)
+    {
+        pChannel->dropped++;
+        STAR_destroyStreamItem(pItem);
+        return;
+    }
+    pHeld->pItem = pItem;
+    pHeld->length = SIM_itemLength(pItem);
+    if ((pChannel->heldLength + pHeld->length > SIM_RX_BUFFER_LENGTH) &&
+        (simSendingOp != NULL))
+    {
+        pHeld->pTxOp = simSendingOp;
+        simSendingOp->stalled++;
+    }
+    pChannel->heldLength += pHeld->length;
+
+    if (pChannel->pHeldTail == NULL)
+    {
+        pChannel->pHeldHead = pHeld;
+    }
+    else
+    {
+        pChannel->pHeldTail->pNext = pHeld;
+    }
+    pChannel->pHeldTail = pHeld;
+}
+
+
+
+/* Take the oldest held item off the channel, ending the stall of its sender
+ * with status once the sender has nothing else held */
+static SIM_HELD *SIM_unholdLocked(SIM_CHANNEL * const pChannel,
+    const STAR_TRANSFER_STATUS status)
+{
+    SIM_HELD * const pHeld = pChannel->pHeldHead;
+    SIM_OPERATION * const pTxOp = pHeld->pTxOp;
+
+    pChannel->pHeldHead = pHeld->pNext;
+    if (pChannel->pHeldHead == NULL)
+    {
+        pChannel->pHeldTail = NULL;
+    }
+    pChannel->heldLength -= pHeld->length;
+
+    if ((pTxOp != NULL) && (--pTxOp->stalled == 0U) &&
+        (pTxOp->status == STAR_TRANSFER_STATUS_STARTED))
+    {
+        pTxOp->status = status;
+    }
+    pthread_cond_broadcast(&simCond);
+
+    return pHeld;
+}
+
+
+
+/* Move the held items into the receive operations posted, oldest first */
+static void SIM_releaseHeldLocked(SIM_CHANNEL * const pChannel)
+{
+    SIM_HELD *pHeld;
+
+    while ((pChannel->pHeldHead != NULL) && (pChannel->pRxHead != NULL))
+    {
+        pHeld = SIM_unholdLocked(pChannel, STAR_TRANSFER_STATUS_COMPLETE);
+        SIM_appendLocked(pChannel, pHeld->pItem);
+        free(pHeld);
+    }
+}
+
+
+
+/* Drop what a closed channel holds; the senders it stalls fail */
+static void SIM_dropHeldLocked(SIM_CHANNEL * const pChannel)
+{
+    SIM_HELD *pHeld;
+
+    while (pChannel->pHeldHead != NULL)
+    {
+        pHeld = SIM_unholdLocked(pChannel, STAR_TRANSFER_STATUS_ERROR);
+        pChannel->dropped++;
+        STAR_destroyStreamItem(pHeld->pItem);
+        free(pHeld);
+    }
+}
+
+
+
+/* A transmit operation cancelled or disposed of no longer waits for the
+ * items it sent */
+static void SIM_detachHeldLocked(SIM_OPERATION * const pTxOp)
+{
+    SIM_HELD *pHeld;
+    U32 d, c;
+
+    pTxOp->stalled -= GR718SIM_DetachSenderLocked(pTxOp);
+    for (d = 0U; (d < simDeviceCount) && (pTxOp->stalled > 0U); d++)
+    {
+        for (c = 0U; c < SIM_CHANNELS_PER_DEVICE; c++)
+        {
+            for (pHeld = simChannels[d][c].pHeldHead; pHeld != NULL;
+                pHeld = pHeld->pNext)
+            {
+                if (pHeld->pTxOp == pTxOp)
+                {
+                    pHeld->pTxOp = NULL;
+                    pTxOp->stalled--;
+                }
+            }
+        }
+    }
+}
+
+
+
+static void SIM_unlinkLocked(SIM_OPERATION * const pOp)
+{
+    SIM_CHANNEL *pChannel = pOp->pChannel;
+    SIM_OPERATION *pPrev = NULL, *pIter;
+
+    if (pChannel == NULL)
+    {
+        return;
+    }
+
+    for (pIter = pChannel->pRxHead; pIter != NULL; pIter = pIter->pNext)
+    {
+        if (pIter == pOp)
+        {
+            if (pPrev == NULL)
+            {
+                pChannel->pRxHead = pOp->pNext;
+            }
+            else
+            {
+                pPrev->pNext = pOp->pNext;
+            }
+            if (pChannel->pRxTail == pOp)
+            {
+                pChannel->pRxTail = pPrev;
+            }
+            break;
+        }
+        pPrev = pIter;
+    }
+    pOp->pNext = NULL;
+}
+
+
+
+static void SIM_clearItems(SIM_OPERATION * const pOp)
+{
+    U32 i;
+
+    for (i = 0U; i < pOp->itemCount; i++)
+    {
+        STAR_destroyStreamItem(pOp->pItems[i]);
+        pOp->pItems[i] = NULL;
+    }
+    pOp->itemCount = 0U;
+}
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*  Traffic source configured by STAR_SIM_TRAFFIC. Packets are injected in    */
+/*  one millisecond slots to approximate the requested packet rate.           */
+/*                                                                            */
+/******************************************************************************/
+static void *SIM_trafficThread(void *arg)
+{
+    SIM_TRAFFIC *pTraffic = (SIM_TRAFFIC *)arg;
+    SIM_CHANNEL *pChannel = SIM_findChannel(simDevices[0],
+        pTraffic->channelNumber);
+    U8 *pBuffer;
+    unsigned long sent = 0U, perSlot, i;
+    struct timespec next;
+    U32 n;
+
+    pBuffer = (U8 *)malloc(pTraffic->packetSize);
+    if (pBuffer == NULL)
+    {
+        return NULL;
+    }
+    for (n = 0U; n < pTraffic->packetSize; n++)
+    {
+        pBuffer[n] = (U8)n;
+    }
+
+    perSlot = pTraffic->packetsPerSecond / 1000U;
+    if (perSlot == 0U)
+    {
+        perSlot = 1U;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while ((pTraffic->packetCount == 0U) || (sent < pTraffic->packetCount))
+    {
+        for (i = 0U; i < perSlot; i++)
+        {
+            /* First bytes carry the sequence number, MSB first */
+            pBuffer[0] = (U8)(sent >> 24);
+            if (pTraffic->packetSize > 1U) pBuffer[1] = (U8)(sent >> 16);
+            if (pTraffic->packetSize > 2U) pBuffer[2] = (U8)(sent >> 8);
+            if (pTraffic->packetSize > 3U) pBuffer[3] = (U8)sent;
+
+            /* The link stops the source while the channel buffer is full */
+            pthread_mutex_lock(&simLock);
+            while (pChannel->open && (pChannel->receivers > 0U) &&
+                (pChannel->heldLength >= SIM_RX_BUFFER_LENGTH))
+            {
+                pthread_cond_wait(&simCond, &simLock);
+            }
+            pthread_mutex_unlock(&simLock);
+
+            SIM_injectPacket(simDevices[0], pTraffic->channelNumber, pBuffer,
+                pTraffic->packetSize, STAR_EOP_TYPE_EOP);
+            sent++;
+            if ((pTraffic->packetCount != 0U) && (sent >= pTraffic->packetCount))
+            {
+                break;
+            }
+        }
+
+        if (pTraffic->packetsPerSecond != 0U)
+        {
+            next.tv_nsec += (pTraffic->packetsPerSecond >= 1000U) ?
+                1000000L : (long)(1000000000UL / pTraffic->packetsPerSecond);
+            while (next.tv_nsec >= 1000000000L)
+            {
+                next.tv_nsec -= 1000000000L;
+                next.tv_sec++;
+            }
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        }
+    }
+
+    free(pBuffer);
+    return NULL;
+}
+
+
+
+unsigned long SIM_getDroppedPackets(STAR_DEVICE_ID deviceId, U8 channelNumber)
+{
+    SIM_CHANNEL *pChannel = SIM_findChannel(deviceId, channelNumber);
+    unsigned long dropped = 0U;
+
+    if (pChannel != NULL)
+    {
+        pthread_mutex_lock(&simLock);
+        dropped = pChannel->dropped;
+        pthread_mutex_unlock(&simLock);
+    }
+
+    return dropped;
+}
+
+
+
+unsigned long SIM_getDeliveredPackets(STAR_DEVICE_ID deviceId,
+    U8 channelNumber)
+{
+    SIM_CHANNEL *pChannel = SIM_findChannel(deviceId, channelNumber);
+    unsigned long delivered = 0U;
+
+    if (pChannel != NULL)
+    {
+        pthread_mutex_lock(&simLock);
+        delivered = pChannel->delivered;
+        pthread_mutex_unlock(&simLock);
+    }
+
+    return delivered;
+}
+
+
+
+/* Hooks of the router model, see gr718_sim.h */
+void SIM_Lock(void)
+{
+    pthread_mutex_lock(&simLock);
+}
+
+
+
+void SIM_Unlock(void)
+{
+    pthread_mutex_unlock(&simLock);
+}
+
+
+
+/* pSender, if not NULL, is the transmit operation a full channel stalls */
+void SIM_deliverPacketLocked(const STAR_DEVICE_ID deviceId,
+    const U8 channelNumber, const U8 * const pData, const U32 length,
+    const STAR_EOP_TYPE eop, void * const pSender)
+{
+    SIM_CHANNEL *pChannel = SIM_findChannel(deviceId, channelNumber);
+    SIM_OPERATION * const pSending = simSendingOp;
+    STAR_STREAM_ITEM *pItem;
+
+    if (pChannel != NULL)
+    {
+        pItem = SIM_newPacketItem(pData, length, eop);
+        if (pItem != NULL)
+        {
+            if (pSender != NULL)
+            {
+                simSendingOp = (SIM_OPERATION *)pSender;
+            }
+            SIM_deliverLocked(pChannel, pItem);
+            simSendingOp = pSending;
+        }
+    }
+}
+
+
+
+/* The transmit operation being submitted waits for one more item, that the
+ * router model holds; returns it, or NULL outside a submission */
+void *SIM_holdSenderLocked(void)
+{
+    if (simSendingOp != NULL)
+    {
+        simSendingOp->stalled++;
+    }
+
+    return simSendingOp;
+}
+
+
+
+/* The router model let go of an item of a transmit operation */
+void SIM_releaseSenderLocked(void * const pSender)
+{
+    SIM_OPERATION * const pTxOp = (SIM_OPERATION *)pSender;
+
+    if ((pTxOp != NULL) && (--pTxOp->stalled == 0U) &&
+        (pTxOp->status == STAR_TRANSFER_STATUS_STARTED))
+    {
+        pTxOp->status = STAR_TRANSFER_STATUS_COMPLETE;
+        pthread_cond_broadcast(&simCond);
+    }
+}
+
+
+
+/* Wait for the simulator to change, or until a time of CLOCK_MONOTONIC
+ * (0, no limit) */
+void SIM_waitLocked(const unsigned long long untilNs)
+{
+    struct timespec now, deadline;
+    unsigned long long nowNs, leftNs;
+
+    if (untilNs == 0ULL)
+    {
+        pthread_cond_wait(&simCond, &simLock);
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    nowNs = (unsigned long long)now.tv_sec * 1000000000ULL +
+        (unsigned long long)now.tv_nsec;
+    if (untilNs <= nowNs)
+    {
+        return;
+    }
+    leftNs = untilNs - nowNs;
+
+    /* simCond waits on CLOCK_REALTIME */
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += (time_t)(leftNs / 1000000000ULL);
+    deadline.tv_nsec += (long)(leftNs % 1000000000ULL);
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_nsec -= 1000000000L;
+        deadline.tv_sec++;
+    }
+    pthread_cond_timedwait(&simCond, &simLock, &deadline);
+}
+
+
+
+void SIM_wakeLocked(void)
+{
+    pthread_cond_broadcast(&simCond);
+}
+
+
+
+void SIM_deliverTimeCodeLocked(const STAR_DEVICE_ID deviceId,
+    const U8 channelNumber, const U8 value)
+{
+    SIM_CHANNEL *pChannel = SIM_findChannel(deviceId, channelNumber);
+    STAR_STREAM_ITEM *pItem;
+
+    if (pChannel != NULL)
+    {
+        pItem = STAR_createTimeCode(value);
+        if (pItem != NULL)
+        {
+            SIM_deliverLocked(pChannel, pItem);
+        }
+    }
+}
+
+
+
+/* An item sent on a Brick link cabled to the router model; 0 if it is not */
+static int SIM_toRouterLocked(const SIM_CHANNEL * const pChannel,
+    const STAR_STREAM_ITEM * const pItem)
+{
+    const SIM_PACKET *pPacket;
+
+    switch (pItem->itemType)
+    {
+    case STAR_STREAM_ITEM_TYPE_SPACEWIRE_PACKET:
+        pPacket = (const SIM_PACKET *)pItem->item;
+        return GR718SIM_ReceivePacketLocked(pChannel->deviceId,
+            pChannel->number, pPacket->pData, pPacket->length, pPacket->eop);
+
+    case STAR_STREAM_ITEM_TYPE_TIMECODE:
+        return GR718SIM_ReceiveTimeCodeLocked(pChannel->deviceId,
+            pChannel->number, ((const SIM_TIMECODE *)pItem->item)->value);
+
+    default:
+        return 0;
+    }
+}
+
+
+
+/**
+ * Make a packet arrive on a simulated channel, as if it had been received
+ * from the link.
+ *
+ * @return 1 if the packet was queued, held or dropped, 0 on error
+ */
+int SIM_injectPacket(STAR_DEVICE_ID deviceId, U8 channelNumber,
+    const U8 * const pData, const U32 length, const STAR_EOP_TYPE eop)
+{
+    SIM_CHANNEL *pChannel = SIM_findChannel(deviceId, channelNumber);
+    STAR_STREAM_ITEM *pItem;
+
+    if (pChannel == NULL)
+    {
+        return 0;
+    }
+
+    pItem = SIM_newPacketItem(pData, length, eop);
+    if (pItem == NULL)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&simLock);
+    SIM_deliverLocked(pChannel, pItem);
+    pthread_mutex_unlock(&simLock);
+
+    return 1;
+}
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*  STAR-API: devices and channels                                            */
+/*                                                                            */
+/******************************************************************************/
+STAR_DEVICE_ID *STAR_getDeviceListForType(STAR_DEVICE_TYPE deviceType,
+    U32 *pDeviceCount)
+{
+    (void)deviceType;
+    pthread_once(&simOnce, SIM_init);
+
+    *pDeviceCount = simDeviceCount;
+    if (simDeviceCount == 0U)
+    {
+        return NULL;
+    }
+
+    return simDevices;
+}
+
+
+
+void STAR_destroyDeviceList(STAR_DEVICE_ID *pDeviceList)
+{
+    (void)pDeviceList;
+}
+
+
+
+STAR_CHANNEL_MASK STAR_getDeviceChannels(STAR_DEVICE_ID deviceId)
+{
+    pthread_once(&simOnce, SIM_init);
+
+    return ((deviceId != 0U) && (deviceId <= simDeviceCount)) ? 7U : 0U;
+}
+
+
+
+STAR_CHANNEL_ID STAR_openChannelToLocalDevice(STAR_DEVICE_ID deviceId,
+    STAR_CHANNEL_DIRECTION direction, U8 channelNumber,
+    BOOL queueTransferOperations)
+{
+    SIM_CHANNEL *pChannel = SIM_findChannel(deviceId, channelNumber);
+    const int receiving = (direction != STAR_CHANNEL_DIRECTION_OUT);
+    int startTraffic = 0;
+
+    (void)queueTransferOperations;
+
+    if ((pChannel == NULL) || (channelNumber == 0U))
+    {
+        return 0U;
+    }
+
+    pthread_mutex_lock(&simLock);
+    pChannel->open = 1;
+    pChannel->deviceId = deviceId;
+    pChannel->number = channelNumber;
+    if (receiving)
+    {
+        pChannel->receivers++;
+    }
+    if ((deviceId == simDevices[0]) && !simTraffic.started &&
+        (simTraffic.channelNumber == channelNumber))
+    {
+        simTraffic.started = 1;
+        startTraffic = 1;
+    }
+    pthread_mutex_unlock(&simLock);
+
+    if (startTraffic &&
+        (pthread_create(&simTraffic.threadId, NULL, SIM_trafficThread,
+            &simTraffic) == 0))
+    {
+        pthread_detach(simTraffic.threadId);
+    }
+
+    return ((deviceId - 1U) * SIM_CHANNELS_PER_DEVICE) + channelNumber +
+        (receiving ? 0U : SIM_SEND_ONLY_ID);
+}
+
+
+
+BOOL STAR_closeChannel(STAR_CHANNEL_ID channelId)
+{
+    SIM_CHANNEL *pChannel = SIM_channelFromId(channelId);
+    SIM_OPERATION *pOp;
+
+    if (pChannel == NULL)
+    {
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&simLock);
+    pChannel->open = 0;
+    if ((channelId < SIM_SEND_ONLY_ID) && (pChannel->receivers > 0U))
+    {
+        pChannel->receivers--;
+    }
+    while ((pOp = pChannel->pRxHead) != NULL)
+    {
+        pChannel->pRxHead = pOp->pNext;
+        pOp->pNext = NULL;
+        pOp->status = STAR_TRANSFER_STATUS_CANCELLED;
+    }
+    pChannel->pRxTail = NULL;
+    SIM_dropHeldLocked(pChannel);
+    pthread_cond_broadcast(&simCond);
+    pthread_mutex_unlock(&simLock);
+
+    return TRUE;
+}
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*  STAR-API: transfer operations                                             */
+/*                                                                            */
+/******************************************************************************/
+static SIM_OPERATION *SIM_newOperation(const U32 maxItems, const int isRx)
+{
+    SIM_OPERATION *pOp;
+
+    pOp = (SIM_OPERATION *)calloc(1U, sizeof(SIM_OPERATION));
+    if (pOp == NULL)
+    {
+        return NULL;
+    }
+
+    pOp->pItems = (STAR_STREAM_ITEM **)calloc((maxItems > 0U) ? maxItems : 1U,
+        sizeof(STAR_STREAM_ITEM *));
+    if (pOp->pItems == NULL)
+    {
+        free(pOp);
+        return NULL;
+    }
+
+    pOp->isRx = isRx;
+    pOp->maxItems = maxItems;
+    pOp->status = STAR_TRANSFER_STATUS_NOT_STARTED;
+
+    return pOp;
+}
+
+
+
+STAR_TRANSFER_OPERATION *STAR_createRxOperation(U32 maxItemCount,
+    STAR_RECEIVE_TYPE receiveType)
+{
+    (void)receiveType;
+
+    if (maxItemCount == 0U)
+    {
+        return NULL;
+    }
+
+    return (STAR_TRANSFER_OPERATION *)SIM_newOperation(maxItemCount, 1);
+}
+
+
+
+STAR_TRANSFER_OPERATION *STAR_createTxOperation(STAR_STREAM_ITEM **pStreamItems,
+    U32 itemCount)
+{
+    SIM_OPERATION *pOp;
+    U32 i;
+
+    pOp = SIM_newOperation(itemCount, 0);
+    if (pOp == NULL)
+    {
+        return NULL;
+    }
+
+    /* The operation keeps its own copy, the caller may free the items */
+    for (i = 0U; i < itemCount; i++)
+    {
+        if ((pStreamItems[i] != NULL) && (pStreamItems[i]->item != NULL))
+        {
+            pOp->pItems[pOp->itemCount] = SIM_copyItem(pStreamItems[i]);
+            if (pOp->pItems[pOp->itemCount] != NULL)
+            {
+                pOp->itemCount++;
+            }
+        }
+    }
+
+    return (STAR_TRANSFER_OPERATION *)pOp;
+}
+
+
+
+BOOL STAR_submitTransferOperation(STAR_CHANNEL_ID channelId,
+    STAR_TRANSFER_OPERATION *pOperation)
+{
+    SIM_OPERATION *pOp = (SIM_OPERATION *)pOperation;
+    SIM_CHANNEL *pChannel = SIM_channelFromId(channelId), *pPeer;
+    STAR_STREAM_ITEM *pItem;
+    U32 i;
+
+    if ((pOp == NULL) || (pChannel == NULL) || !pChannel->open)
+    {
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&simLock);
+    if (pOp->status == STAR_TRANSFER_STATUS_STARTED)
+    {
+        pthread_mutex_unlock(&simLock);
+        return FALSE;
+    }
+
+    pOp->pChannel = pChannel;
+    if (pOp->isRx)
+    {
+        /* Re-submitting a receive operation discards what it held */
+        SIM_clearItems(pOp);
+        pOp->status = STAR_TRANSFER_STATUS_STARTED;
+        pOp->pNext = NULL;
+        if (pChannel->pRxTail == NULL)
+        {
+            pChannel->pRxHead = pOp;
+        }
+        else
+        {
+            pChannel->pRxTail->pNext = pOp;
+        }
+        pChannel->pRxTail = pOp;
+        SIM_releaseHeldLocked(pChannel);
+    }
+    else
+    {
+        pPeer = SIM_findChannel(pChannel->deviceId,
+            SIM_peerChannel(pChannel->number));
+        pOp->stalled = 0U;
+        simSendingOp = pOp;
+        for (i = 0U; i < pOp->itemCount; i++)
+        {
+            if (SIM_toRouterLocked(pChannel, pOp->pItems[i]))
+            {
+                continue;
+            }
+            pItem = SIM_loopItem(pOp->pItems[i]);
+            if ((pItem != NULL) && (pPeer != NULL))
+            {
+                SIM_deliverLocked(pPeer, pItem);
+            }
+            else if (pItem != NULL)
+            {
+                STAR_destroyStreamItem(pItem);
+            }
+        }
+        simSendingOp = NULL;
+        pOp->status = (pOp->stalled > 0U) ? STAR_TRANSFER_STATUS_STARTED :
+            STAR_TRANSFER_STATUS_COMPLETE;
+        pthread_cond_broadcast(&simCond);
+    }
+    pthread_mutex_unlock(&simLock);
+
+    return TRUE;
+}
+
+
+
+STAR_TRANSFER_STATUS STAR_waitOnTransferOperationCompletion(
+    STAR_TRANSFER_OPERATION *pOperation, int timeout)
+{
+    SIM_OPERATION *pOp = (SIM_OPERATION *)pOperation;
+    STAR_TRANSFER_STATUS status;
+    struct timespec deadline;
+    int waitStatus = 0;
+
+    if (pOp == NULL)
+    {
+        return STAR_TRANSFER_STATUS_ERROR;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    if (timeout >= 0)
+    {
+        deadline.tv_sec += timeout / 1000;
+        deadline.tv_nsec += (long)(timeout % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_nsec -= 1000000000L;
+            deadline.tv_sec++;
+        }
+    }
+
+    pthread_mutex_lock(&simLock);
+    while ((pOp->status == STAR_TRANSFER_STATUS_STARTED) &&
+        (waitStatus != ETIMEDOUT))
+    {
+        if (timeout < 0)
+        {
+            pthread_cond_wait(&simCond, &simLock);
+        }
+        else
+        {
+            waitStatus = pthread_cond_timedwait(&simCond, &simLock, &deadline);
+        }
+    }
+    status = pOp->status;
+    pthread_mutex_unlock(&simLock);
+
+    return status;
+}
+
+
+
+STAR_TRANSFER_STATUS STAR_getTransferStatus(STAR_TRANSFER_OPERATION *pOperation)
+{
+    SIM_OPERATION *pOp = (SIM_OPERATION *)pOperation;
+    STAR_TRANSFER_STATUS status;
+
+    if (pOp == NULL)
+    {
+        return STAR_TRANSFER_STATUS_ERROR;
+    }
+
+    pthread_mutex_lock(&simLock);
+    status = pOp->status;
+    pthread_mutex_unlock(&simLock);
+
+    return status;
+}
+
+
+
+BOOL STAR_cancelTransferOperation(STAR_TRANSFER_OPERATION *pOperation)
+{
+    SIM_OPERATION *pOp = (SIM_OPERATION *)pOperation;
+
+    if (pOp == NULL)
+    {
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&simLock);
+    if (pOp->status == STAR_TRANSFER_STATUS_STARTED)
+    {
+        SIM_unlinkLocked(pOp);
+        SIM_detachHeldLocked(pOp);
+        pOp->status = STAR_TRANSFER_STATUS_CANCELLED;
+        pthread_cond_broadcast(&simCond);
+    }
+    pthread_mutex_unlock(&simLock);
+
+    return TRUE;
+}
+
+
+
+U32 STAR_getTransferItemCount(STAR_TRANSFER_OPERATION *pOperation)
+{
+    SIM_OPERATION *pOp = (SIM_OPERATION *)pOperation;
+
+    return (pOp != NULL) ? pOp->itemCount : 0U;
+}
+
+
+
+STAR_STREAM_ITEM *STAR_getTransferItem(STAR_TRANSFER_OPERATION *pOperation,
+    U32 index)
+{
+    SIM_OPERATION *pOp = (SIM_OPERATION *)pOperation;
+
+    if ((pOp == NULL) || (index >= pOp->itemCount))
+    {
+        return NULL;
+    }
+
+    return pOp->pItems[index];
+}
+
+
+
+BOOL STAR_disposeTransferOperation(STAR_TRANSFER_OPERATION *pOperation)
+{
+    SIM_OPERATION *pOp = (SIM_OPERATION *)pOperation;
+
+    if (pOp == NULL)
+    {
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&simLock);
+    if (pOp->status == STAR_TRANSFER_STATUS_STARTED)
+    {
+        SIM_unlinkLocked(pOp);
+    }
+    SIM_detachHeldLocked(pOp);
+    pthread_mutex_unlock(&simLock);
+
+    SIM_clearItems(pOp);
+    free(pOp->pItems);
+    free(pOp);
+
+    return TRUE;
+}
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*  STAR-API: stream items                                                    */
+/*                                                                            */
+/******************************************************************************/
+STAR_STREAM_ITEM *STAR_createPacket(STAR_SPACEWIRE_ADDRESS *pAddress,
+    U8 *pData, U32 dataLength, STAR_EOP_TYPE eopType)
+{
+    STAR_STREAM_ITEM *pItem;
+    SIM_PACKET *pPacket;
+    U32 pathLength = 0U;
+
+    if (pAddress != NULL)
+    {
+        pathLength = pAddress->pathLength;
+    }
+
+    pItem = SIM_newPacketItem(NULL, pathLength + dataLength, eopType);
+    if (pItem == NULL)
+    {
+        return NULL;
+    }
+
+    /* The address path is sent ahead of the data, as it is on the wire */
+    pPacket = (SIM_PACKET *)pItem->item;
+    if (pathLength > 0U)
+    {
+        memcpy(pPacket->pData, pAddress->pPath, pathLength);
+    }
+    if (dataLength > 0U)
+    {
+        memcpy(pPacket->pData + pathLength, pData, dataLength);
+    }
+
+    if (pAddress != NULL)
+    {
+        pPacket->pAddress =
+            STAR_createAddress(pAddress->pPath, (U8)pathLength);
+    }
+
+    return pItem;
+}
+
+
+
+U8 *STAR_getPacketData(STAR_SPACEWIRE_PACKET *pPacket, U32 *pDataLength)
+{
+    SIM_PACKET *pSimPacket = (SIM_PACKET *)pPacket;
+    U32 pathLength = 0U;
+    U8 *pData;
+
+    *pDataLength = 0U;
+    if (pSimPacket == NULL)
+    {
+        return NULL;
+    }
+
+    if (pSimPacket->pAddress != NULL)
+    {
+        pathLength = pSimPacket->pAddress->pathLength;
+    }
+
+    pData = (U8 *)malloc((pSimPacket->length - pathLength) + 1U);
+    if (pData == NULL)
+    {
+        return NULL;
+    }
+    memcpy(pData, pSimPacket->pData + pathLength,
+        pSimPacket->length - pathLength);
+    *pDataLength = pSimPacket->length - pathLength;
+
+    return pData;
+}
+
+
+
+void STAR_destroyPacketData(U8 *pData)
+{
+    free(pData);
+}
+
+
+
+STAR_EOP_TYPE STAR_getPacketEOP(STAR_SPACEWIRE_PACKET *pPacket)
+{
+    SIM_PACKET *pSimPacket = (SIM_PACKET *)pPacket;
+
+    return (pSimPacket != NULL) ? pSimPacket->eop : STAR_EOP_TYPE_INVALID;
+}
+
+
+
+STAR_SPACEWIRE_ADDRESS *STAR_getPacketAddress(STAR_SPACEWIRE_PACKET *pPacket)
+{
+    SIM_PACKET *pSimPacket = (SIM_PACKET *)pPacket;
+
+    /* Received packets will not have an address set */
+    if ((pSimPacket == NULL) || (pSimPacket->pAddress == NULL))
+    {
+        return NULL;
+    }
+
+    return STAR_createAddress(pSimPacket->pAddress->pPath,
+        (U8)pSimPacket->pAddress->pathLength);
+}
+
+
+
+STAR_SPACEWIRE_ADDRESS *STAR_createAddress(U8 *pPath, U8 pathLength)
+{
+    STAR_SPACEWIRE_ADDRESS *pAddress;
+
+    pAddress = (STAR_SPACEWIRE_ADDRESS *)calloc(1U,
+        sizeof(STAR_SPACEWIRE_ADDRESS));
+    if (pAddress == NULL)
+    {
+        return NULL;
+    }
+
+    pAddress->pPath = (U8 *)malloc((pathLength > 0U) ? pathLength : 1U);
+    if (pAddress->pPath == NULL)
+    {
+        free(pAddress);
+        return NULL;
+    }
+    if (pathLength > 0U)
+    {
+        memcpy(pAddress->pPath, pPath, pathLength);
+    }
+    pAddress->pathLength = pathLength;
+
+    return pAddress;
+}
+
+
+
+void STAR_destroyAddress(STAR_SPACEWIRE_ADDRESS *pAddress)
+{
+    if (pAddress != NULL)
+    {
+        free(pAddress->pPath);
+        free(pAddress);
+    }
+}
+
+
+
+STAR_STREAM_ITEM *STAR_createTimeCode(U8 timecodeValue)
+{
+    STAR_STREAM_ITEM *pItem;
+    SIM_TIMECODE *pTimeCode;
+
+    pItem = (STAR_STREAM_ITEM *)calloc(1U, sizeof(STAR_STREAM_ITEM));
+    pTimeCode = (SIM_TIMECODE *)calloc(1U, sizeof(SIM_TIMECODE));
+    if ((pItem == NULL) || (pTimeCode == NULL))
+    {
+        free(pItem);
+        free(pTimeCode);
+        return NULL;
+    }
+
+    pTimeCode->value = timecodeValue;
+    pItem->itemType = STAR_STREAM_ITEM_TYPE_TIMECODE;
+    pItem->item = pTimeCode;
+
+    return pItem;
+}
+
+
+
+U8 STAR_getTimeCodeValue(STAR_TIMECODE *pTimeCode)
+{
+    return (pTimeCode != NULL) ? ((SIM_TIMECODE *)pTimeCode)->value : 0U;
+}
+
+
+
+/* The links of the model never change state, so no such event is made */
+U8 STAR_getLinkStateEventState(STAR_LINK_STATE_EVENT *pEvent)
+{
+    return (pEvent != NULL) ? ((SIM_LINK_EVENT *)pEvent)->state : 0U;
+}
+
+
+
+void STAR_destroyStreamItem(STAR_STREAM_ITEM *pStreamItem)
+{
+    SIM_PACKET *pPacket;
+
+    if (pStreamItem == NULL)
+    {
+        return;
+    }
+
+    if (pStreamItem->itemType == STAR_STREAM_ITEM_TYPE_SPACEWIRE_PACKET)
+    {
+        pPacket = (SIM_PACKET *)pStreamItem->item;
+        if (pPacket != NULL)
+        {
+            STAR_destroyAddress(pPacket->pAddress);
+            free(pPacket->pData);
+        }
+    }
+    free(pStreamItem->item);
+    free(pStreamItem);
+}
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*  STAR-System configuration API                                             */
+/*                                                                            */
+/******************************************************************************/
+BOOL CFG_MK2_getHardwareInfo(STAR_DEVICE_ID deviceId,
+    STAR_CFG_MK2_HARDWARE_INFO *pHardwareInfo)
+{
+    (void)deviceId;
+    memset(pHardwareInfo, 0, sizeof(*pHardwareInfo));
+
+    return TRUE;
+}
+
+
+
+void CFG_MK2_hardwareInfoToString(STAR_CFG_MK2_HARDWARE_INFO hardwareInfo,
+    char *pVersionStr, char *pBuildDateStr)
+{
+    (void)hardwareInfo;
+    strcpy(pVersionStr, "STAR-SIM");
+    strcpy(pBuildDateStr, __DATE__);
+}
+
+
+
+BOOL CFG_MK2_identify(STAR_DEVICE_ID deviceId)
+{
+    return (SIM_findChannel(deviceId, 0U) != NULL) ? TRUE : FALSE;
+}
+
+
+
+BOOL CFG_MK2_enableTimeCodeMaster(STAR_DEVICE_ID deviceId)
+{
+    return CFG_MK2_identify(deviceId);
+}
+
+
+
+BOOL CFG_BRICK_MK3_setBaseTransmitClock(STAR_DEVICE_ID deviceId,
+    U32 linkNumber, STAR_CFG_MK2_BASE_TRANSMIT_CLOCK baseTransmitClock)
+{
+    SIM_CHANNEL *pChannel = SIM_findChannel(deviceId, (U8)linkNumber);
+
+    if (pChannel == NULL)
+    {
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&simLock);
+    pChannel->clock = baseTransmitClock;
+    pthread_mutex_unlock(&simLock);
+
+    return TRUE;
+}
@@ -0,0 +1,54 @@
+/*
+  @file star_sim.h
+  @author Juan Manuel Gómez
+  @brief Software stand-in for the subset of the STAR-API used by the
+         collection.
+  @details When the collection is configured with --enable-star-sim the
+           programs link against star_sim.c instead of the STAR-Dundee
+           libraries, so they can be exercised without a Brick. The
+           headers of the STAR-System are still required to build.
+
+           Two Brick channels (1 and 2) are looped to each other, which
+           mimics the loopback cable through the GR718 used by the tests:
+           the leading path address of a packet is taken off on the way,
+           as the router does. Or they are cabled to a model of the GR718
+           itself (gr718_sim.h).
+           SpaceWire is flow controlled, so nothing arriving on a channel
+           open for receiving is lost: what arrives before a receive
+           operation is posted is held until one is, up to
+           SIM_RX_BUFFER_LENGTH bytes per channel. Beyond that the
+           transmit operation that sent it does not complete until it is
+           received, and the traffic source waits. What arrives on a
+           channel closed, or open only with STAR_CHANNEL_DIRECTION_OUT,
+           has no reader and is dropped and counted.
+
+           The stand-in is configured with environment variables:
+           STAR_SIM_DEVICES  Number of simulated Bricks (default 1).
+           STAR_SIM_TRAFFIC  Traffic source "channel:size:pps[:count]"
+                             injected on the first device once the
+                             channel is opened.
+           STAR_SIM_ROUTER   Cable links 1 and 2 of every Brick to a
+                             GR718B model instead of to each other, see
+                             gr718_sim.h.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef STAR_SIM_H
+#define STAR_SIM_H
+
+#include "star-dundee_types.h"
+#include "star-api.h"
+
+#define SIM_MAX_DEVICES 8
+#define SIM_CHANNELS_PER_DEVICE 32
+#define SIM_RX_BUFFER_LENGTH 65536
+
+unsigned long SIM_getDroppedPackets(STAR_DEVICE_ID deviceId, U8 channelNumber);
+
+unsigned long SIM_getDeliveredPackets(STAR_DEVICE_ID deviceId,
+    U8 channelNumber);
+
+int SIM_injectPacket(STAR_DEVICE_ID deviceId, U8 channelNumber,
+    const U8 * const pData, const U32 length, const STAR_EOP_TYPE eop);
+
+#endif
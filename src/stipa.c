@@ -4,14 +4,20 @@
   @brief Spacewire Test Interface Plato Audit GR718 
   @details Audit the values of the GR718B to monitor the 
   status of the system.
-  @param No parammeters needed.
-  @example ./stipa  
+  Without options, writes the port registers at 0x880.
+  With -a, reads the whole register space (routing table, port
+  control, status and router configuration) with pipelined RMAP
+  reads and writes a timestamped snapshot, see rtr_snapshot.h.
+  With -r, prints a snapshot file; no device is needed.
+  @param -a snapshot file to write, -r snapshot file to print.
+  @example ./stipa -a gr718.snap ; ./stipa -r gr718.snap
   @copyright jmgomez CSIC-IAA
 */
 
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include "system_config.h"
 #include "utility.h"
 #include "star-dundee_types.h"
@@ -21,6 +27,8 @@
 #include "cfg_api_mk2_types.h"
 //#include "cfg_api_brick_mk3.h"
 #include "rmap_packet_library.h"
+#include "rmap_engine.h"
+#include "rtr_snapshot.h"
 
 #define VERSION_INFO "Stipa v1.0"
 
@@ -38,19 +46,30 @@
 #define _ADDRESS_PATH 2
 #define _ADDRESS_PATH_SIZE 1
 
-void freePacketArray(void **packetArray, int count){
-  uint32_t opCounter = count;
-      while(opCounter > 0){
-	opCounter --;
-	free(packetArray[opCounter]);
-      }
-      free(packetArray);
-    }
+#define _AUDIT_WINDOW 64
+
+int printSnapshot(const char *fname);
+unsigned long auditRouter(RMAPENG *pEngine, const char *fname);
 
 int __cdecl  main(int argc, char * argv[]){
   STAR_DEVICE_ID* devices;
   STAR_DEVICE_ID deviceId;
   unsigned int deviceCount;
+  const char *auditFile = NULL;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "a:r:")) != -1){
+    switch (opt){
+    case 'a':
+      auditFile = optarg;
+      break;
+    case 'r':
+      return printSnapshot(optarg);
+    default:
+      printf("Usage: %s [-a snapshot] [-r snapshot]\n", argv[0]);
+      return 0;
+    }
+  }
 
   //Initialize
   devices = STAR_getDeviceListForType(STAR_DEVICE_TXRX_SUPPORTED, & deviceCount);
@@ -136,139 +155,102 @@ int __cdecl  main(int argc, char * argv[]){
   /* The Read Commands data size is always 1 register each time,   */
   /* that is 4 byte per command.                                   */
   /*****************************************************************/
-  /*       Create the Transmit and Receive Operations              */
-  STAR_TRANSFER_OPERATION **pConfigRouterTransferOp = NULL;
-  STAR_TRANSFER_OPERATION *pTxTransferOp = NULL, *pRxTransferOp = NULL;
-  STAR_STREAM_ITEM **pTxStreamItem = NULL;
-  unsigned int rxOp_itemCount= 0, txOp_itemCount = 0;
-
-  unsigned long byteSize =  0;
-  
-  void **pFillPacket;
-  unsigned long fillPacketLen, fillPacketLenCalculated;
-
+  /*       Write the registers. Every write is acknowledged by     */
+  /*       the GR718 and checked, see rmap_engine.h.               */
   U8 pTarget[]= {0,254};
   U8 pReply[] = {254};
   U8 pData[] = {0x00, 0x14, 0x02, 0x2E};
+  RMAPENG rmapEngine;
+  RMAPENG_ACCESS vWrites[10];
+  uint32_t writeCount = 10;
 
-  txOp_itemCount = 10;
-  
-  // Packet is pTarget 2 address and pReply 1. Use alignment.
   uint32_t opCounter= 0;
   uint32_t reg_address = 0;
   uint32_t reg_base = 0x880;
   uint32_t reg_byteSize = 0x4;
 
-  //Allocate Memmory for packet Matrix
-  pFillPacket = (void **) malloc(txOp_itemCount*sizeof(void *));
-  if (!pFillPacket){
-    puts("\nError: Could not allocate memory for the packet array.");
+  for(opCounter= 0; opCounter < writeCount; ++ opCounter){
+    reg_address = reg_base + reg_byteSize*opCounter;
+    RMAPENG_SetWrite(&vWrites[opCounter], reg_address, pData);
+  }
+
+  if (!RMAPENG_Init(&rmapEngine, testPortChannel, testPortChannel,
+                    pTarget, sizeof(pTarget), pReply, sizeof(pReply))){
     return 0;
   }
 
-  pTxStreamItem = malloc(txOp_itemCount * sizeof( STAR_STREAM_ITEM));
-  if (!pTxStreamItem){
-    puts("\nError: Could not allocate memory for the packet array.");
-    freePacketArray(pFillPacket, 0);
-    return 0;    
+  /***************************************************************/
+  /*    Send the writes and wait for their replies, or read the  */
+  /*    whole register space.                                    */
+  /***************************************************************/
+  unsigned long writesFailed;
+  if (auditFile != NULL){
+    writesFailed = auditRouter(&rmapEngine, auditFile);
+  }
+  else{
+    writesFailed = RMAPENG_Transfer(&rmapEngine, vWrites, writeCount);
+    RMAPENG_PrintReport(vWrites, writeCount);
   }
 
-  fillPacketLenCalculated = RMAP_CalculateWriteCommandPacketLength(2, 1, 4,1);
-  for(opCounter= 0; opCounter < txOp_itemCount; ++ opCounter){
-    //malloc Packet opCounter.
-    pFillPacket[opCounter] = malloc(fillPacketLenCalculated);
-    if (!pFillPacket[opCounter]){
-      puts("Error: Could not allocate mem for the packet.");
-      freePacketArray(pFillPacket, opCounter);
-      return 0;
-    }
+  /* Close the channels */
+  if (testPortChannel != 0U) {
+    STAR_closeChannel(testPortChannel);
+  }
 
-    printf("Packet %d ready to Fill.\n", opCounter);
+  if (testPortChannel2 != 0U) {
+    STAR_closeChannel(testPortChannel2);
+  }
 
-    //FillWrPacket to reg_address
-    reg_address = reg_base + reg_byteSize*opCounter;
-    status_link = RMAP_FillWriteCommandPacket(pTarget, 2, pReply, 1, 1, 0, 0, 0x00,
-					 0, reg_address, 0, pData, 4, 
-					 &fillPacketLen, NULL, 1, (U8 *)pFillPacket[opCounter],
-					 fillPacketLenCalculated);
-    if (!status_link ){
-      puts ("\bError: Could not fill the packet. ");
-      freePacketArray (pFillPacket, opCounter);
-      return 0;
-    }
- 
-    printf("Filled Wr packet %d to addr 0x%x .\n", opCounter, reg_address);
+  return writesFailed != 0;
+}
 
-  /* Create the packet to be transmitted */
-    pTxStreamItem[opCounter] = STAR_createPacket(NULL, (U8 *)pFillPacket[opCounter], fillPacketLen,
-				    STAR_EOP_TYPE_EOP);
 
-    if (pTxStreamItem[opCounter] == NULL){
-      puts("\nERROR: Unable to create the packet to be transmitted");
-      freePacketArray(pFillPacket, txOp_itemCount);
-      return 0;
-    }
+//Read every register of the snapshot and save them to fname.
+unsigned long auditRouter(RMAPENG *pEngine, const char *fname){
+  RMAPENG_ACCESS *vReads;
+  uint32_t readCount = RTRSNAP_RegisterCount();
+  unsigned long readsFailed;
+  unsigned long long startNs, timeNs, durationNs;
 
+  vReads = malloc(readCount * sizeof(RMAPENG_ACCESS));
+  if (!vReads){
+    puts("\nError: Could not allocate memory for the register reads.");
+    return readCount;
   }
+  RTRSNAP_SetReads(vReads);
 
-  /* Create the transmit transfer operation for the packet */
-  pTxTransferOp = STAR_createTxOperation(pTxStreamItem, txOp_itemCount);
-  if (pTxTransferOp == NULL)
-    {
-      puts("\nERROR: Unable to create the transfer operation to be transmitted");
-      return 0;
-    }
-
-  rxOp_itemCount = 1;
-  /* Create the receive operations. */
-  pRxTransferOp = STAR_createRxOperation(rxOp_itemCount, STAR_RECEIVE_PACKETS);
-  if (pRxTransferOp == NULL)
-    {
-      puts("\nERROR: Unable to create receive operation");
-      return 0;
-    }
+  pEngine->window = _AUDIT_WINDOW;
+  timeNs = RealTimeNs();
+  startNs = MonotonicTimeNs();
+  readsFailed = RMAPENG_Transfer(pEngine, vReads, readCount);
+  durationNs = MonotonicTimeNs() - startNs;
 
-  /***************************************************************/
-  /*    Submit the operations                                    */
-  /*                                                             */
-  /***************************************************************/
+  RMAPENG_PrintReport(vReads, readCount);
+  printf("Audit of %u registers in %.3f ms.\n", readCount, durationNs / 1e6);
 
-  /* Submit the transmit operation */
-  if (STAR_submitTransferOperation(testPortChannel, pTxTransferOp) == 0) {
-    printf("\nERROR occurred during transmit.  Test failed.\n");
-    return 0;
+  if (!RTRSNAP_Save(fname, vReads, readCount, timeNs, durationNs)){
+    readsFailed = readCount;
   }
-
-  //Wait the operations to finish.
-  STAR_TRANSFER_STATUS rxStatus, txStatus;
-
-  /* Wait on the transmit operation completing */
-  txStatus = STAR_waitOnTransferOperationCompletion(pTxTransferOp,
-						    STAR_INFINITE);
-  if(txStatus != STAR_TRANSFER_STATUS_COMPLETE) {
-    printf("\nERROR occurred during transmit.  Test failed.\n");
-    return 0;
+  else{
+    printf("Snapshot written to %s.\n", fname);
   }
 
-  //Free allocated resources
-  /* Dispose of the transfer operations */
-  if (pTxTransferOp != NULL) {
-    STAR_disposeTransferOperation(pTxTransferOp);
-  }
+  free(vReads);
+  return readsFailed;
+}
 
-  if (pRxTransferOp != NULL) {
-    STAR_disposeTransferOperation(pRxTransferOp);
-  }
 
-  if (pFillPacket != NULL){
-    //    RMAP_FreeBuffer(pFillPacket);
-    freePacketArray(pFillPacket, txOp_itemCount);
-  }
+//Print a snapshot written by -a.
+int printSnapshot(const char *fname){
+  RTRSNAP_FILE_HEADER header;
+  RTRSNAP_RECORD *vRecords;
 
-  /* Close the channels */
-  if (testPortChannel != 0U) {
-    STAR_closeChannel(testPortChannel);
+  vRecords = RTRSNAP_Load(fname, &header);
+  if (vRecords == NULL){
+    return 1;
   }
 
-
+  RTRSNAP_Print(&header, vRecords);
+  free(vRecords);
+  return header.failed != 0;
 }
@@ -0,0 +1,291 @@
+/*
+  @file stream_verify.c
+  @author Juan Manuel Gómez
+  @brief Verification of packet streams without the transmitted buffers.
+  @details See stream_verify.h.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <string.h>
+
+#include "stream_verify.h"
+#include "pattern.h"
+#include "rmap_crc.h"
+#include "utility.h"
+
+
+static void SVERIFY_put(U8 * const pData, uint64_t value, const int bytes)
+{
+    int i;
+
+    for (i = 0; i < bytes; i++)
+    {
+        pData[i] = (U8)value;
+        value >>= 8;
+    }
+}
+
+
+static uint64_t SVERIFY_get(const U8 * const pData, const int bytes)
+{
+    uint64_t value = 0U;
+    int i;
+
+    for (i = bytes - 1; i >= 0; i--)
+    {
+        value = (value << 8) | pData[i];
+    }
+    return value;
+}
+
+
+/* The header checks: magic, CRC and the length it announces */
+static int SVERIFY_headerValid(const U8 * const pPacket, const U32 length)
+{
+    return (length >= SVERIFY_HEADER_SIZE) &&
+        (pPacket[0] == SVERIFY_MAGIC) &&
+        (RMAPCRC_Calculate(pPacket, SVERIFY_HEADER_SIZE) == 0U) &&
+        (SVERIFY_get(pPacket + 3, 4) == length);
+}
+
+
+/* Whether an error just counted is printed, the first ones only */
+static int SVERIFY_report(const SVERIFY_STREAM * const pStream)
+{
+    return (SVERIFY_Errors(pStream) <= SVERIFY_REPORT_LIMIT);
+}
+
+
+
+/**
+ * Initialise a stream, for the transmitter or the receiver. Both sides
+ * must use the same stream ID, pattern and seed.
+ *
+ * @param pStream the stream
+ * @param streamId its ID, carried by every packet
+ * @param dataType the DATA_TYPE_* pattern of the payloads
+ * @param seed the seed of the payloads
+ */
+void SVERIFY_Init(SVERIFY_STREAM * const pStream, const U8 streamId,
+    const int dataType, const uint64_t seed)
+{
+    memset(pStream, 0, sizeof(SVERIFY_STREAM));
+    pStream->streamId = streamId;
+    pStream->dataType = dataType;
+    pStream->seed = seed;
+}
+
+
+
+/**
+ * Make the next packet of a stream: its header and payload.
+ *
+ * @param pStream the stream
+ * @param pPacket the packet
+ * @param length its length, at least SVERIFY_HEADER_SIZE
+ *
+ * @return 1 on success, 0 if the packet is too short
+ */
+int SVERIFY_Fill(SVERIFY_STREAM * const pStream, U8 * const pPacket,
+    const U32 length)
+{
+    const uint64_t sequence = pStream->next;
+
+    if (length < SVERIFY_HEADER_SIZE)
+    {
+        printf("SVERIFY_Fill: Packets of %u bytes cannot hold the header\n",
+            length);
+        return 0;
+    }
+
+    pPacket[0] = SVERIFY_MAGIC;
+    pPacket[1] = pStream->streamId;
+    pPacket[2] = (U8)pStream->dataType;
+    SVERIFY_put(pPacket + 3, length, 4);
+    SVERIFY_put(pPacket + 7, sequence, 8);
+    pPacket[15] = RMAPCRC_Calculate(pPacket, SVERIFY_HEADER_SIZE - 1U);
+    PATGEN_FillPacket(pPacket + SVERIFY_HEADER_SIZE,
+        length - SVERIFY_HEADER_SIZE, pStream->dataType, pStream->seed,
+        sequence);
+
+    pStream->next = sequence + 1U;
+    pStream->packets++;
+    pStream->bytes += length;
+    return 1;
+}
+
+
+
+/**
+ * The stream a received packet belongs to, to pick its SVERIFY_STREAM when
+ * several share a link.
+ *
+ * @return the stream ID, or -1 if the header does not check
+ */
+int SVERIFY_StreamOf(const U8 * const pPacket, const U32 length)
+{
+    return SVERIFY_headerValid(pPacket, length) ? pPacket[1] : -1;
+}
+
+
+
+/**
+ * The sequence number of a packet whose header checks (SVERIFY_StreamOf()).
+ */
+uint64_t SVERIFY_SequenceOf(const U8 * const pPacket)
+{
+    return SVERIFY_get(pPacket + 7, 8);
+}
+
+
+
+/**
+ * Check a received packet of a stream: header, order and payload.
+ *
+ * @param pStream the stream
+ * @param pPacket the packet received, without its address path
+ * @param length its length
+ *
+ * @return SVERIFY_OK, or the first of SVERIFY_BAD_HEADER,
+ *         SVERIFY_DUPLICATED, SVERIFY_STALE and SVERIFY_CORRUPTED found.
+ *         Lost and reordered packets do not fail the packet that shows
+ *         them; they are only counted.
+ */
+int SVERIFY_Check(SVERIFY_STREAM * const pStream, const U8 * const pPacket,
+    const U32 length)
+{
+    BUFFER_MISMATCH mismatch;
+    uint64_t sequence, distance;
+    int result = SVERIFY_OK;
+
+    if (!SVERIFY_headerValid(pPacket, length) ||
+        (pPacket[1] != pStream->streamId) ||
+        (pPacket[2] != (U8)pStream->dataType))
+    {
+        pStream->badHeaders++;
+        if (SVERIFY_report(pStream))
+        {
+            printf("\nERROR stream %u: packet of %u bytes after sequence"
+                " %llu has no valid header\n", pStream->streamId, length,
+                (unsigned long long)pStream->next);
+        }
+        return SVERIFY_BAD_HEADER;
+    }
+
+    sequence = SVERIFY_SequenceOf(pPacket);
+    pStream->packets++;
+    pStream->bytes += length;
+
+    if (sequence >= pStream->next)
+    {
+        /* Ahead of everything received: the gap is lost, for now */
+        distance = sequence - pStream->next + 1U;
+        if (distance > 1U)
+        {
+            pStream->lost += distance - 1U;
+            if (SVERIFY_report(pStream))
+            {
+                printf("\nERROR stream %u: packets %llu to %llu missing\n",
+                    pStream->streamId, (unsigned long long)pStream->next,
+                    (unsigned long long)sequence - 1U);
+            }
+        }
+        pStream->window = (distance < SVERIFY_WINDOW) ?
+            ((pStream->window << distance) | 1U) : 1U;
+        pStream->next = sequence + 1U;
+    }
+    else
+    {
+        distance = pStream->next - 1U - sequence;
+        if (distance >= SVERIFY_WINDOW)
+        {
+            /* Most likely one of a gap counted as lost: count it once */
+            if (pStream->lost > 0U)
+            {
+                pStream->lost--;
+            }
+            pStream->stale++;
+            result = SVERIFY_STALE;
+        }
+        else if (pStream->window & (1ULL << distance))
+        {
+            pStream->duplicated++;
+            result = SVERIFY_DUPLICATED;
+        }
+        else
+        {
+            pStream->window |= (1ULL << distance);
+            pStream->lost--;
+            pStream->reordered++;
+        }
+        if ((result != SVERIFY_OK) && SVERIFY_report(pStream))
+        {
+            printf("\nERROR stream %u: packet %llu %s, %llu received last\n",
+                pStream->streamId, (unsigned long long)sequence,
+                (result == SVERIFY_STALE) ? "arrived too late" :
+                "received twice", (unsigned long long)pStream->next - 1U);
+        }
+    }
+
+    if (PATGEN_CheckPacket(pPacket + SVERIFY_HEADER_SIZE,
+        length - SVERIFY_HEADER_SIZE, pStream->dataType, pStream->seed,
+        sequence, &mismatch) != 0U)
+    {
+        pStream->corrupted++;
+        if (SVERIFY_report(pStream))
+        {
+            printf("\nERROR stream %u: packet %llu has %lu bytes wrong,"
+                " from byte %lu to %lu\n", pStream->streamId,
+                (unsigned long long)sequence, mismatch.count,
+                mismatch.first + SVERIFY_HEADER_SIZE,
+                mismatch.last + SVERIFY_HEADER_SIZE);
+        }
+        if (result == SVERIFY_OK)
+        {
+            result = SVERIFY_CORRUPTED;
+        }
+    }
+
+    return result;
+}
+
+
+
+/**
+ * Close the count of a receiving stream once the transmitter is done:
+ * the packets sent past the highest one received are lost too.
+ *
+ * @param pStream the stream
+ * @param sent the number of packets the transmitter sent
+ */
+void SVERIFY_Finish(SVERIFY_STREAM * const pStream, const uint64_t sent)
+{
+    if (sent > pStream->next)
+    {
+        pStream->lost += sent - pStream->next;
+        pStream->next = sent;
+        pStream->window = 0U;
+    }
+}
+
+
+
+/* Lost, duplicated, stale, corrupted and bad packets; reordered packets
+ * arrived whole and are not errors */
+unsigned long long SVERIFY_Errors(const SVERIFY_STREAM * const pStream)
+{
+    return pStream->lost + pStream->duplicated + pStream->stale +
+        pStream->corrupted + pStream->badHeaders;
+}
+
+
+
+void SVERIFY_Print(FILE * const pFile, const SVERIFY_STREAM * const pStream)
+{
+    fprintf(pFile, "Stream %u: %llu packets, %llu bytes, %llu lost, "
+        "%llu reordered, %llu duplicated, %llu stale, %llu corrupted, "
+        "%llu bad headers\n", pStream->streamId, pStream->packets,
+        pStream->bytes, pStream->lost, pStream->reordered,
+        pStream->duplicated, pStream->stale, pStream->corrupted,
+        pStream->badHeaders);
+}
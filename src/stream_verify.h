@@ -0,0 +1,90 @@
+/*
+  @file stream_verify.h
+  @author Juan Manuel Gómez
+  @brief Verification of packet streams without the transmitted buffers.
+  @details Every packet of a stream starts with a header of
+           SVERIFY_HEADER_SIZE bytes, all fields little endian:
+
+             0     SVERIFY_MAGIC
+             1     stream ID
+             2     DATA_TYPE_* pattern of the payload
+             3-6   packet length, header included
+             7-14  sequence number, from 0
+             15    RMAP CRC-8 (rmap_crc.h) of bytes 0-14
+
+           The rest of the packet is the payload PATGEN_FillPacket()
+           (pattern.h) makes from the seed of the stream and the sequence
+           number. The receiver makes it again to check it, so it keeps
+           the same few words per stream whatever the length of the run.
+
+           The receiver remembers which of the last SVERIFY_WINDOW sequence
+           numbers arrived. A packet past the highest one received counts
+           the ones it skips as lost; one of them arriving later is counted
+           as reordered instead, a second copy of one as duplicated, and a
+           packet older than the window as stale instead of lost, as it can
+           no longer be told apart from a copy. Packets whose header does
+           not check, and payloads that differ, are counted apart. Only the
+           first SVERIFY_REPORT_LIMIT errors of a stream are printed.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef STREAM_VERIFY_H
+#define STREAM_VERIFY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "star-dundee_types.h"
+
+#define SVERIFY_HEADER_SIZE 16U
+#define SVERIFY_MAGIC 0xA5U
+#define SVERIFY_WINDOW 64U
+#define SVERIFY_REPORT_LIMIT 8U
+
+/* Results of SVERIFY_Check() */
+#define SVERIFY_OK 0
+#define SVERIFY_BAD_HEADER 1
+#define SVERIFY_CORRUPTED 2
+#define SVERIFY_DUPLICATED 3
+#define SVERIFY_STALE 4
+
+typedef struct
+{
+    U8 streamId;
+    int dataType;
+    uint64_t seed;
+
+    /* Transmitter: next sequence number to send. Receiver: one past the
+     * highest one received, and bit n of window set if next - 1 - n was */
+    uint64_t next;
+    uint64_t window;
+
+    unsigned long long packets;
+    unsigned long long bytes;
+    unsigned long long lost;
+    unsigned long long reordered;
+    unsigned long long duplicated;
+    unsigned long long stale;
+    unsigned long long corrupted;
+    unsigned long long badHeaders;
+} SVERIFY_STREAM;
+
+void SVERIFY_Init(SVERIFY_STREAM * const pStream, const U8 streamId,
+    const int dataType, const uint64_t seed);
+
+int SVERIFY_Fill(SVERIFY_STREAM * const pStream, U8 * const pPacket,
+    const U32 length);
+
+int SVERIFY_StreamOf(const U8 * const pPacket, const U32 length);
+
+uint64_t SVERIFY_SequenceOf(const U8 * const pPacket);
+
+int SVERIFY_Check(SVERIFY_STREAM * const pStream, const U8 * const pPacket,
+    const U32 length);
+
+void SVERIFY_Finish(SVERIFY_STREAM * const pStream, const uint64_t sent);
+
+unsigned long long SVERIFY_Errors(const SVERIFY_STREAM * const pStream);
+
+void SVERIFY_Print(FILE * const pFile, const SVERIFY_STREAM * const pStream);
+
+#endif
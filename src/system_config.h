@@ -53,5 +53,14 @@
 #define RTR_PCTRLCFG_BASE 0x00000880
 #define RTR_PCTRL_BASE 0x00000884
 
+// Register space of the GR718B read by the stipa audit.
+#define RTR_ADDRESS_COUNT 255     // routing table entries, addresses 1-255
+#define RTR_PORT_COUNT 19         // configuration port 0 and ports 1-18
+#define RTR_PCTRL0_BASE 0x00000800
+#define RTR_PTIMER_BASE 0x00000900
+#define RTR_PCTRL2_BASE 0x00000980
+#define RTR_RTRCFG_BASE 0x00000A00
+#define RTR_RTRCFG_COUNT 16       // router configuration to interrupt timers
+
 
 #endif
@@ -22,6 +22,7 @@
 #include "cfg_api_mk2_types.h"
 //#include "cfg_api_brick_mk3.h"
 #include "rmap_packet_library.h"
+#include "pkt_pool.h"
 
 #define VERSION_INFO "LA Route v1.0"
 
@@ -45,6 +46,9 @@ unsigned long printRxPackets(STAR_TRANSFER_OPERATION * const pTransferOp);
 void printPacket( STAR_SPACEWIRE_PACKET * StreamItemPacket);
 uint32_t LoopBackPacketToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t dst, uint8_t src, uint8_t *pValue, uint32_t reg_address);
 
+/* Command buffers, sized once for the commands each helper builds */
+static PKTPOOL cfgPool, loopPool;
+
 int __cdecl  main(int argc, char * argv[]){
   STAR_DEVICE_ID* devices;
   STAR_DEVICE_ID deviceId;
@@ -162,6 +166,12 @@ int __cdecl  main(int argc, char * argv[]){
     return 0;    
   }
 
+  if (!PKTPOOL_InitWriteCommand(&cfgPool, 1, 2, 1, 4) ||
+      !PKTPOOL_InitWriteCommand(&loopPool, 1, 1, 1, 4)){
+    puts("\nError: Could not allocate memory for the command buffers.");
+    return 0;
+  }
+
   uint32_t status;
 
   /**
@@ -279,6 +289,11 @@ int __cdecl  main(int argc, char * argv[]){
     STAR_disposeTransferOperation(pTxTransferOp);
   }
 
+  PKTPOOL_PrintStats(&cfgPool, "config");
+  PKTPOOL_PrintStats(&loopPool, "loopback");
+  PKTPOOL_Destroy(&cfgPool);
+  PKTPOOL_Destroy(&loopPool);
+
   /* Close the channels */
   if (testPortChannel != 0U) {
     STAR_closeChannel(testPortChannel);
@@ -305,8 +320,8 @@ void freePacketArray(void **packetArray, int count){
 //insert a Write Register Operation to the TxStream
 uint32_t LoopBackPacketToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t dst, uint8_t src, uint8_t *pValue, uint32_t reg_address){ 
 
-  void *pFillPacket;
-  unsigned long fillPacketLenCalculated, fillPacketLen;
+  U8 *pFillPacket;
+  unsigned long fillPacketLen;
 
   int status_link;
 
@@ -321,9 +336,7 @@ uint32_t LoopBackPacketToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t dst,
   //  pReply[1] = src;
 
   //Write operation of 4 bytes to update the value of a Register. 
-  fillPacketLenCalculated = RMAP_CalculateWriteCommandPacketLength(1, 1, 4,1);  
-
-  pFillPacket = malloc(fillPacketLenCalculated);
+  pFillPacket = PKTPOOL_Get(&loopPool);
   if (!pFillPacket){
     puts("Error: Could not allocate mem for the packet.");
     return 1;
@@ -332,25 +345,25 @@ uint32_t LoopBackPacketToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t dst,
   //FillWrPacket to reg_address
   status_link = RMAP_FillWriteCommandPacket(pTarget, 1, pReply, 1, 1, 0, 0, 0x00,
 					    0, reg_address, 0, pValue, 4, 
-					    &fillPacketLen, NULL, 1, (U8 *)pFillPacket,
-					    fillPacketLenCalculated);
+					    &fillPacketLen, NULL, 1, pFillPacket,
+					    loopPool.bufferSize);
   if (!status_link ){
     puts ("\bError: Could not fill the packet. ");
-    free(pFillPacket);
+    PKTPOOL_Put(&loopPool, pFillPacket);
     return 2;
   }
 
   // Create the packet to be transmitted
-  (*pTxStreamItem) = STAR_createPacket(NULL, (U8 *)pFillPacket, fillPacketLen,
+  (*pTxStreamItem) = STAR_createPacket(NULL, pFillPacket, fillPacketLen,
 					       STAR_EOP_TYPE_EOP);
 
-  if (pTxStreamItem == NULL){
+  if ((*pTxStreamItem) == NULL){
     puts("\nERROR: Unable to create the packet to be transmitted");
-    free(pFillPacket);
+    PKTPOOL_Put(&loopPool, pFillPacket);
     return 3;
   }
 
-  free(pFillPacket);
+  PKTPOOL_Put(&loopPool, pFillPacket);
   return 0;
 
 }
@@ -361,8 +374,8 @@ uint32_t LoopBackPacketToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t dst,
 //insert a Write Register Operation to the TxStream
 uint32_t RTRCFG_WrRegToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t *pValue, uint32_t reg_address){ 
 
-  void *pFillPacket;
-  unsigned long fillPacketLenCalculated, fillPacketLen;
+  U8 *pFillPacket;
+  unsigned long fillPacketLen;
 
   int status_link;
 
@@ -374,9 +387,7 @@ uint32_t RTRCFG_WrRegToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t *pValue
   U8 pReply[] = {254};
 
   //Write operation of 4 bytes to update the value of a Register. 
-  fillPacketLenCalculated = RMAP_CalculateWriteCommandPacketLength(2, 1, 4,1);  
-
-  pFillPacket = malloc(fillPacketLenCalculated);
+  pFillPacket = PKTPOOL_Get(&cfgPool);
   if (!pFillPacket){
     puts("Error: Could not allocate mem for the packet.");
     return 1;
@@ -385,25 +396,25 @@ uint32_t RTRCFG_WrRegToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t *pValue
   //FillWrPacket to reg_address
   status_link = RMAP_FillWriteCommandPacket(pTarget, 2, pReply, 1, 1, 0, 0, 0x00,
 					    0, reg_address, 0, pValue, 4, 
-					    &fillPacketLen, NULL, 1, (U8 *)pFillPacket,
-					    fillPacketLenCalculated);
+					    &fillPacketLen, NULL, 1, pFillPacket,
+					    cfgPool.bufferSize);
   if (!status_link ){
     puts ("\bError: Could not fill the packet. ");
-    free(pFillPacket);
+    PKTPOOL_Put(&cfgPool, pFillPacket);
     return 2;
   }
 
   // Create the packet to be transmitted
-  (*pTxStreamItem) = STAR_createPacket(NULL, (U8 *)pFillPacket, fillPacketLen,
+  (*pTxStreamItem) = STAR_createPacket(NULL, pFillPacket, fillPacketLen,
 					       STAR_EOP_TYPE_EOP);
 
-  if (pTxStreamItem == NULL){
+  if ((*pTxStreamItem) == NULL){
     puts("\nERROR: Unable to create the packet to be transmitted");
-    free(pFillPacket);
+    PKTPOOL_Put(&cfgPool, pFillPacket);
     return 3;
   }
 
-  free(pFillPacket);
+  PKTPOOL_Put(&cfgPool, pFillPacket);
   return 0;
 
 }
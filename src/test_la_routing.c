@@ -5,6 +5,7 @@
   @details Configures the routing table to implement a logical routing.
   Enable the Spw Interfaces and configure the baudrate to run clk_div = 0.
   Configure the Routing table to 
+  Every register write is acknowledged and verified (rmap_engine.h).
   @param No parammeters needed.
   @example ./la_routing
   @copyright jmgomez CSIC-IAA
@@ -22,6 +23,8 @@
 #include "cfg_api_mk2_types.h"
 //#include "cfg_api_brick_mk3.h"
 #include "rmap_packet_library.h"
+#include "pkt_pool.h"
+#include "rmap_engine.h"
 
 #define VERSION_INFO "LA Route v1.0"
 
@@ -39,12 +42,13 @@
 #define _ADDRESS_PATH 2
 #define _ADDRESS_PATH_SIZE 1
 
-void freePacketArray(void **packetArray, int count);
-uint32_t RTRCFG_WrRegToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t *pValue, uint32_t reg_address);
 unsigned long printRxPackets(STAR_TRANSFER_OPERATION * const pTransferOp);
 void printPacket( STAR_SPACEWIRE_PACKET * StreamItemPacket);
 uint32_t LoopBackPacketToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t dst, uint8_t src, uint8_t *pValue, uint32_t reg_address);
 
+/* Command buffers, sized once for the commands LoopBackPacketToStream builds */
+static PKTPOOL loopPool;
+
 int __cdecl  main(int argc, char * argv[]){
   STAR_DEVICE_ID* devices;
   STAR_DEVICE_ID deviceId;
@@ -135,19 +139,17 @@ int __cdecl  main(int argc, char * argv[]){
   /* that is 4 byte per command.                                   */
   /*****************************************************************/
   /*       Create the Transmit and Receive Operations              */
-  STAR_TRANSFER_OPERATION **pConfigRouterTransferOp = NULL;
   STAR_TRANSFER_OPERATION *pTxTransferOp = NULL, *pRxTransferOp = NULL;
   STAR_STREAM_ITEM **vTxStreamItem = NULL;
-  unsigned int rxOp_itemCount= 0, txOp_itemCount = 0, txRTPOP_Itemcount= 0;
+  unsigned int rxOp_itemCount= 0, txOp_itemCount = 0;
 
-  unsigned long byteSize =  0;
-  
   U8 pData[] = {0x00, 0x14, 0x02, 0x2E};
 
-  uint32_t rtr_config_cmd = 12;
+  uint32_t rtr_config_cmd = 10;
   uint32_t port_config_cmd = 10;
-  txOp_itemCount = rtr_config_cmd + port_config_cmd;
-  rxOp_itemCount = 1; // txOp_itemCount;
+  uint32_t test_packets = 2;
+  txOp_itemCount = test_packets;
+  rxOp_itemCount = 1;
   
   // Packet is pTarget 2 address and pReply 1. Use alignment.
   uint32_t opCounter= 0;
@@ -155,68 +157,74 @@ int __cdecl  main(int argc, char * argv[]){
   uint32_t reg_base = 0x804;
   uint32_t reg_byteSize = 0x4;
 
-  //Allocate Memory for TxStream Items
-  vTxStreamItem = malloc(txOp_itemCount * sizeof( STAR_STREAM_ITEM));
-  if (!vTxStreamItem){
-    puts("\nError: Could not allocate memory for the packet array.");    
-    return 0;    
-  }
+  /*****************************************************************/
+  /*    Configure the router. Every write is acknowledged by the   */
+  /*    GR718 and checked, see rmap_engine.h.                      */
+  /*****************************************************************/
+  U8 pTarget[] = {0, 254};
+  U8 pReply[] = {254};
+  RMAPENG rmapEngine;
+  RMAPENG_ACCESS vWrites[20];
+  uint32_t writeCount = 0;
 
-  uint32_t status;
   for(opCounter= 0; opCounter < port_config_cmd; ++ opCounter){
     reg_address = reg_base + reg_byteSize*opCounter;
-    //    vTxStreamItem[opCounter] = NULL;
-    status = RTRCFG_WrRegToStream( vTxStreamItem+opCounter, pData, reg_address);
-    if (status != 0){
-      printf("Error generating the Stream.");
-      return 0;
-    }
-    printf("Included packet %d to the Stream.\n", opCounter);
+    RMAPENG_SetWrite(&vWrites[writeCount++], reg_address, pData);
   }
 
   //Prepare the Packets to configure the routing table.
-  //We should use the port_config_cmd offset to insert items to the stream
   reg_base = 0x80;
   uint32_t reg_base_ctrl = 0x480;
-  uint32_t dev_address = 0x0;
   uint32_t offset = 0;
 
-  //  uint32_t val_data;
   U8 val_data[] = {0x00, 0x00, 0x04, 0x00};
   U8 val_data2[] = {0x00, 0x00, 0x00, 0x0C};
-  for(opCounter = 0 ; opCounter < (rtr_config_cmd-2); ++ opCounter){
-
+  for(opCounter = 0 ; opCounter < rtr_config_cmd; opCounter += 2){
     reg_address = reg_base + offset;
-    //    val_data = 1<<(opCounter+7);
-    //val_data = 0x10000000 | 1<<7;
-    status = RTRCFG_WrRegToStream( (vTxStreamItem + port_config_cmd)+opCounter, val_data, reg_address);
-    if (status != 0){
-      printf("Error generating the Stream.");
-      return 0;
-    }
-    printf("Included packet %d to the Stream.\n", opCounter + port_config_cmd );    
+    RMAPENG_SetWrite(&vWrites[writeCount++], reg_address, val_data);
 
-    opCounter ++;
     reg_address = reg_base_ctrl + offset;
-    //    val_data = 0x1000000D;
-    status = RTRCFG_WrRegToStream( (vTxStreamItem + port_config_cmd)+opCounter, val_data2, reg_address);
-    if (status != 0){
-      printf("Error generating the Stream.");
-      return 0;
-    }
-    printf("Included packet %d to the Stream.\n", opCounter + port_config_cmd );    
+    RMAPENG_SetWrite(&vWrites[writeCount++], reg_address, val_data2);
 
     offset += 4;
+  }
+
+  if (!RMAPENG_Init(&rmapEngine, testPortChannel, testPortChannel,
+                    pTarget, sizeof(pTarget), pReply, sizeof(pReply))){
+    return 0;
+  }
 
+  unsigned long writesFailed = RMAPENG_Transfer(&rmapEngine, vWrites, writeCount);
+  RMAPENG_PrintReport(vWrites, writeCount);
+  if (writesFailed != 0){
+    puts("\nError: The router configuration was not acknowledged.");
+    STAR_closeChannel(testPortChannel);
+    STAR_closeChannel(testPortChannel2);
+    return 0;
   }
 
+  //Allocate Memory for the test packets.
+  vTxStreamItem = calloc(txOp_itemCount, sizeof(STAR_STREAM_ITEM *));
+  if (!vTxStreamItem){
+    puts("\nError: Could not allocate memory for the packet array.");    
+    return 0;    
+  }
 
-  
+  if (!PKTPOOL_InitWriteCommand(&loopPool, 1, 2, 1, 4)){
+    puts("\nError: Could not allocate memory for the command buffers.");
+    return 0;
+  }
+
+  uint32_t status;
 
   // val_data = opCounter;
-  status = LoopBackPacketToStream ( (vTxStreamItem + port_config_cmd)+opCounter , 0x20, 0xFE, val_data, reg_address);
+  status = LoopBackPacketToStream ( vTxStreamItem , 0x20, 0xFE, val_data, reg_address);
   //val_data = opCounter + port_config_cmd;
-  status = LoopBackPacketToStream ( (vTxStreamItem + port_config_cmd)+opCounter+1 , 0x21, 0xFE, val_data, reg_address);
+  status |= LoopBackPacketToStream ( vTxStreamItem + 1 , 0x21, 0xFE, val_data, reg_address);
+  if (status != 0){
+    printf("Error generating the Stream.");
+    return 0;
+  }
 
   printf("Stream Ready.\n");
 
@@ -286,8 +294,12 @@ int __cdecl  main(int argc, char * argv[]){
 
 
   //Free allocated resources
-  if (vTxStreamItem != NULL)
+  if (vTxStreamItem != NULL){
+    for (opCounter = 0; opCounter < txOp_itemCount; ++opCounter)
+      if (vTxStreamItem[opCounter] != NULL)
+	STAR_destroyStreamItem(vTxStreamItem[opCounter]);
     free(vTxStreamItem);
+  }
 
   if (pRxTransferOp != NULL)
     STAR_disposeTransferOperation(pRxTransferOp);
@@ -297,6 +309,9 @@ int __cdecl  main(int argc, char * argv[]){
     STAR_disposeTransferOperation(pTxTransferOp);
   }
 
+  PKTPOOL_PrintStats(&loopPool, "loopback");
+  PKTPOOL_Destroy(&loopPool);
+
   /* Close the channels */
   if (testPortChannel != 0U) {
     STAR_closeChannel(testPortChannel);
@@ -310,21 +325,11 @@ int __cdecl  main(int argc, char * argv[]){
 }
 
 
-void freePacketArray(void **packetArray, int count){
-  uint32_t opCounter = count;
-  while(opCounter > 0){
-    opCounter --;
-    free(packetArray[opCounter]);
-  }
-  free(packetArray);
-}
-
-
 //insert a Write Register Operation to the TxStream
 uint32_t LoopBackPacketToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t dst, uint8_t src, uint8_t *pValue, uint32_t reg_address){ 
 
-  void *pFillPacket;
-  unsigned long fillPacketLenCalculated, fillPacketLen;
+  U8 *pFillPacket;
+  unsigned long fillPacketLen;
 
   int status_link;
 
@@ -339,9 +344,7 @@ uint32_t LoopBackPacketToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t dst,
   //  pReply[1] = src;
 
   //Write operation of 4 bytes to update the value of a Register. 
-  fillPacketLenCalculated = RMAP_CalculateWriteCommandPacketLength(2, 1, 4,1);  
-
-  pFillPacket = malloc(fillPacketLenCalculated);
+  pFillPacket = PKTPOOL_Get(&loopPool);
   if (!pFillPacket){
     puts("Error: Could not allocate mem for the packet.");
     return 1;
@@ -350,25 +353,25 @@ uint32_t LoopBackPacketToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t dst,
   //FillWrPacket to reg_address
   status_link = RMAP_FillWriteCommandPacket(pTarget, 2, pReply, 1, 1, 0, 0, 0x00,
 					    0, reg_address, 0, pValue, 4, 
-					    &fillPacketLen, NULL, 1, (U8 *)pFillPacket,
-					    fillPacketLenCalculated);
+					    &fillPacketLen, NULL, 1, pFillPacket,
+					    loopPool.bufferSize);
   if (!status_link ){
     puts ("\bError: Could not fill the packet. ");
-    free(pFillPacket);
+    PKTPOOL_Put(&loopPool, pFillPacket);
     return 2;
   }
 
   // Create the packet to be transmitted
-  (*pTxStreamItem) = STAR_createPacket(NULL, (U8 *)pFillPacket, fillPacketLen,
+  (*pTxStreamItem) = STAR_createPacket(NULL, pFillPacket, fillPacketLen,
 					       STAR_EOP_TYPE_EOP);
 
-  if (pTxStreamItem == NULL){
+  if ((*pTxStreamItem) == NULL){
     puts("\nERROR: Unable to create the packet to be transmitted");
-    free(pFillPacket);
+    PKTPOOL_Put(&loopPool, pFillPacket);
     return 3;
   }
 
-  free(pFillPacket);
+  PKTPOOL_Put(&loopPool, pFillPacket);
   return 0;
 
 }
@@ -376,56 +379,6 @@ uint32_t LoopBackPacketToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t dst,
 
  
 
-//insert a Write Register Operation to the TxStream
-uint32_t RTRCFG_WrRegToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t *pValue, uint32_t reg_address){ 
-
-  void *pFillPacket;
-  unsigned long fillPacketLenCalculated, fillPacketLen;
-
-  int status_link;
-
-
-  //Mandatory: We should include the address to Port 0 and the Target logical address 0xFE.
-  U8 pTarget[]= {0,254};
-
-  //Replies on the same port.
-  U8 pReply[] = {254};
-
-  //Write operation of 4 bytes to update the value of a Register. 
-  fillPacketLenCalculated = RMAP_CalculateWriteCommandPacketLength(2, 1, 4,1);  
-
-  pFillPacket = malloc(fillPacketLenCalculated);
-  if (!pFillPacket){
-    puts("Error: Could not allocate mem for the packet.");
-    return 1;
-  }
-
-  //FillWrPacket to reg_address
-  status_link = RMAP_FillWriteCommandPacket(pTarget, 2, pReply, 1, 1, 0, 0, 0x00,
-					    0, reg_address, 0, pValue, 4, 
-					    &fillPacketLen, NULL, 1, (U8 *)pFillPacket,
-					    fillPacketLenCalculated);
-  if (!status_link ){
-    puts ("\bError: Could not fill the packet. ");
-    free(pFillPacket);
-    return 2;
-  }
-
-  // Create the packet to be transmitted
-  (*pTxStreamItem) = STAR_createPacket(NULL, (U8 *)pFillPacket, fillPacketLen,
-					       STAR_EOP_TYPE_EOP);
-
-  if (pTxStreamItem == NULL){
-    puts("\nERROR: Unable to create the packet to be transmitted");
-    free(pFillPacket);
-    return 3;
-  }
-
-  free(pFillPacket);
-  return 0;
-
-}
-
 void printPacket( STAR_SPACEWIRE_PACKET * StreamItemPacket){
     unsigned char* pTxStreamData = NULL;
     STAR_SPACEWIRE_ADDRESS *pStreamItemAddress = NULL;
@@ -10,15 +10,43 @@
 	   the GR718 routes the packet to the reception link.
   @remark If the Router is not included, the received packet will include
           address path in the header, and will be detected as erroneous.
-  @todo Configurable input. The Packet size, the Address path should be
-        configurable.
-  @param No parammeters needed.
-  @example ./test_loopback  
+           With -b it becomes a benchmark: for every combination of
+           packet size, batch (packets per transfer operation) and depth
+           (operations in flight) it keeps the link busy with -n packets,
+           checks every packet received and reports the sustained Mbit/s
+           and packets/s and the p50/p99/p999 round trip of an operation,
+           from its submission to the completion of its receive
+           operation. The results can be written as CSV and JSON to
+           follow them between releases.
+           With -v every packet, the single one of the plain test
+           included, carries a stream header and a payload made from its
+           sequence number (stream_verify.h), and the receiver checks
+           order, loss, duplication and content as the packets arrive
+           instead of comparing them with the transmit buffer.
+           With -S it becomes a soak test: a verified stream runs for -S
+           seconds (0, until SIGINT or SIGTERM), paced to -r Mbit/s, and
+           every -i seconds one line gives the throughput, the errors, the
+           packets ended by an EEP, the link events (failed transmit
+           operations and receive stalls) and the round trip percentiles.
+           Everything is allocated before the traffic starts.
+  @todo Configurable input. The Address path should be configurable.
+  @param -b benchmark, -s sizes, -B batches, -d depths (comma separated
+         lists), -n packets per point, -c csv file, -j json file,
+         -v verify streams; -S seconds soak test, -r Mbit/s, -i interval,
+         with the first of -s, -B and -d.
+  @example ./test_loopback
+  @example ./test_loopback -b -s 64,1024,65536 -B 1,16 -d 1,4 -c lb.csv
+  @example ./test_loopback -b -v -s 4096 -n 100000
+  @example ./test_loopback -S 86400 -r 100 -i 60 -c soak.csv
   @copyright jmgomez CSIC-IAA
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
 #include "utility.h"
 #include "star-dundee_types.h"
 #include "star-api.h"
@@ -26,6 +54,11 @@
 #include "cfg_api_mk2.h"
 #include "cfg_api_mk2_types.h"
 #include "cfg_api_brick_mk3.h"
+#include "rx_view.h"
+#include "rx_stream.h"
+#include "pattern.h"
+#include "stream_verify.h"
+#include "lat_hist.h"
 
 #define VERSION_INFO "star-system_test v2.0"
 
@@ -33,38 +66,19 @@
 
 #define STAR_INFINITE 30000
 
-void printPacket( STAR_SPACEWIRE_PACKET * StreamItemPacket){
-    unsigned char* pTxStreamData = NULL;
-    STAR_SPACEWIRE_ADDRESS *pStreamItemAddress = NULL;
-    unsigned int pTxStreamDataSize = 0, i;
-    pTxStreamData = STAR_getPacketData(
-                    (STAR_SPACEWIRE_PACKET *)StreamItemPacket,
-                    &pTxStreamDataSize);	
+void printPacket(const U8 * const pData, const U32 dataSize){
+    unsigned int i;
 
-    pStreamItemAddress =  STAR_getPacketAddress ( (STAR_SPACEWIRE_PACKET *)StreamItemPacket);
-/*
-    printf("Packet  Address Path [Size: %d]\n", pStreamItemAddress->pathLength);
-    printf("===================\n");
-    for(i=0; i < pStreamItemAddress->pathLength ; ++i){
-    	printf( "\t0x%x" ,pStreamItemAddress->pPath[i]);
-	if (!((i+1) % 8 ) ){
-	    printf("\n");
-	}
-    }
-*/
-	    printf("\n");
+    printf("\n");
 
     printf("Packet  Data\n");
     printf("===================\n");
-    for ( i= 0; i < pTxStreamDataSize; ++i){
-    	printf( "\t0x%x" ,pTxStreamData[i]);
+    for ( i= 0; i < dataSize; ++i){
+    	printf( "\t0x%x" ,pData[i]);
 	if (!((i+1) % 8 ) ){
 	    printf("\n");
 	}
     }
-
-    STAR_destroyAddress(pStreamItemAddress);
-    STAR_destroyPacketData(pTxStreamData);
 }
 
 
@@ -72,10 +86,13 @@ unsigned long printRxPackets(STAR_TRANSFER_OPERATION * const pTransferOp)
 {
   unsigned long i;
   unsigned int rxPacketCount;
-  STAR_STREAM_ITEM *pRxStreamItem;
+  RXVIEW rxView;
+  const U8 *pRxData;
+  U32 rxDataSize;
 
-  /* Get the number of traffic items received */
-  rxPacketCount = STAR_getTransferItemCount(pTransferOp);
+  /* Map the traffic items received, see rx_view.h */
+  RXVIEW_Init(&rxView);
+  rxPacketCount = RXVIEW_Map(&rxView, pTransferOp);
   if (rxPacketCount == 0)
     {
       printf("No packets received.\n");
@@ -86,21 +103,21 @@ unsigned long printRxPackets(STAR_TRANSFER_OPERATION * const pTransferOp)
       for (i = 0U; i < rxPacketCount; i++)
         {
 	  /* Get the packet */
-	  pRxStreamItem = STAR_getTransferItem(pTransferOp, i);
-	  if ((pRxStreamItem == NULL) || (pRxStreamItem->itemType !=
-					  STAR_STREAM_ITEM_TYPE_SPACEWIRE_PACKET) ||
-	      (pRxStreamItem->item == NULL))
+	  pRxData = RXVIEW_Packet(&rxView, i, &rxDataSize);
+	  if (pRxData == NULL)
             {
 	      printf("\nERROR received an unexpected traffic type, or empty traffic item in item %lu\n",
 		     i);
             }
 	  else
             {
-	      printPacket( (STAR_SPACEWIRE_PACKET *)pRxStreamItem->item);
+	      printPacket(pRxData, rxDataSize);
             }
         }
     }
 
+  RXVIEW_Free(&rxView);
+
   /* Return the error count */
   return rxPacketCount;
 }
@@ -113,12 +130,13 @@ unsigned long comparePackets(STAR_TRANSFER_OPERATION * const pTransferOp,
 {
     unsigned long errorCount = 0U, i;
     unsigned int rxPacketCount;
-    STAR_STREAM_ITEM *pRxStreamItem;
-    char *pRxBuffer;
+    RXVIEW rxView;
+    const char *pRxBuffer;
     U32 rxPacketLength;
 
-    /* Get the number of traffic items received */
-    rxPacketCount = STAR_getTransferItemCount(pTransferOp);
+    /* Map the traffic items received, see rx_view.h */
+    RXVIEW_Init(&rxView);
+    rxPacketCount = RXVIEW_Map(&rxView, pTransferOp);
     if (rxPacketCount != packetCount)
     {
         printf("\nERROR expected to receive %lu packets but received %u.\n",
@@ -131,41 +149,31 @@ unsigned long comparePackets(STAR_TRANSFER_OPERATION * const pTransferOp,
         for (i = 0U; i < rxPacketCount; i++)
         {
             /* Get the packet */
-            pRxStreamItem = STAR_getTransferItem(pTransferOp, i);
-            if ((pRxStreamItem == NULL) || (pRxStreamItem->itemType !=
-                    STAR_STREAM_ITEM_TYPE_SPACEWIRE_PACKET) ||
-                (pRxStreamItem->item == NULL))
+            pRxBuffer = (const char *)RXVIEW_Packet(&rxView, i, &rxPacketLength);
+            if (pRxBuffer == NULL)
             {
                 printf("\nERROR received an unexpected traffic type, or empty traffic item in item %lu\n",
                     i);
                 errorCount++;
             }
+            else if (rxPacketLength != packetSize)
+            {
+                printf("\nERROR received a packet of length %u, expected length %lu in item %lu\n",
+                    rxPacketLength, packetSize, i);
+                errorCount++;
+            }
             else
             {
-                pRxBuffer = (char *)STAR_getPacketData(
-                    (STAR_SPACEWIRE_PACKET *)pRxStreamItem->item,
-                    &rxPacketLength);
-                if ((pRxBuffer == NULL) || (rxPacketLength != packetSize))
-                {
-                    printf("\nERROR received a packet of length %u, expected length %lu in item %lu\n",
-                        rxPacketLength, packetSize, i);
-                    errorCount++;
-                }
-                else
-                {
-                    /* Compare the buffers and increment the error count if */
-                    /* the buffers do not match */
-                    errorCount += BufferCompareChar(pBuffer + (packetSize * i),
-                        pRxBuffer, packetSize);
-                }
-                if (pRxBuffer != NULL)
-                {
-                    STAR_destroyPacketData((unsigned char *)pRxBuffer);
-                }
+                /* Compare the buffers and increment the error count if */
+                /* the buffers do not match */
+                errorCount += BufferCompareChar(pBuffer + (packetSize * i),
+                    pRxBuffer, packetSize);
             }
         }
     }
 
+    RXVIEW_Free(&rxView);
+
     /* Return the error count */
     return errorCount;
 }
@@ -184,6 +192,827 @@ unsigned long comparePackets(STAR_TRANSFER_OPERATION * const pTransferOp,
 #define _ADDRESS_PATH 1
 #define _ADDRESS_PATH_SIZE 1
 
+#define _BENCH_MAX_SIZE 65536
+#define _BENCH_MAX_LIST 32
+#define _BENCH_PACKETS 1024
+#define _BENCH_STREAM_ID 1
+
+#define _SOAK_SIZE 4096
+#define _SOAK_BATCH 16
+#define _SOAK_DEPTH 4
+#define _SOAK_INTERVAL 10
+#define _SOAK_WAIT_MS 1000
+#define _SOAK_DRAIN_WAITS 2
+#define _SOAK_POLL_NS 20000L
+
+
+typedef struct {
+  unsigned long size, batch, depth;
+  unsigned long packets, errors;
+  double mbps, pps;
+  double p50Us, p99Us, p999Us, maxUs;
+} BENCH_RESULT;
+
+
+/* Parse a comma separated list of numbers, 1 to max */
+static unsigned int parseList(const char *pList, unsigned long * const pValues,
+			      const unsigned long max)
+{
+  unsigned int count = 0;
+  char *pEnd;
+
+  while (*pList != '\0' && count < _BENCH_MAX_LIST){
+    pValues[count] = strtoul(pList, &pEnd, 0);
+    if (pEnd == pList || pValues[count] < 1 || pValues[count] > max)
+      return 0;
+    count++;
+    pList = (*pEnd == ',') ? pEnd + 1 : pEnd;
+  }
+
+  return (*pList == '\0') ? count : 0;
+}
+
+
+static int compareNs(const void *a, const void *b)
+{
+  const unsigned long long x = *(const unsigned long long *)a;
+  const unsigned long long y = *(const unsigned long long *)b;
+
+  return (x > y) - (x < y);
+}
+
+
+/* Nearest rank percentile of sorted samples, in microseconds */
+static double percentileUs(const unsigned long long * const pSorted,
+			   const unsigned long count, const double fraction)
+{
+  unsigned long rank = (unsigned long)(fraction * count + 0.999999);
+
+  if (rank < 1)
+    rank = 1;
+  if (rank > count)
+    rank = count;
+  return pSorted[rank - 1] / 1e3;
+}
+
+
+/*
+ * Check every packet of a receive operation against the verified stream,
+ * through a view kept between operations. Packets ended by an EEP are
+ * counted in *pEeps and not checked, the verifier counts them as lost.
+ * Returns the traffic items that are not packets.
+ */
+static unsigned long verifyPackets(RXVIEW * const pView,
+				   STAR_TRANSFER_OPERATION * const pTransferOp,
+				   SVERIFY_STREAM * const pStream,
+				   unsigned long long * const pEeps)
+{
+  unsigned long errorCount = 0, i;
+  unsigned int rxPacketCount;
+  const U8 *pRxData;
+  U32 rxDataSize;
+
+  rxPacketCount = RXVIEW_Map(pView, pTransferOp);
+  for (i = 0; i < rxPacketCount; ++i){
+    pRxData = RXVIEW_Packet(pView, i, &rxDataSize);
+    if (pRxData == NULL){
+      printf("\nERROR received an unexpected traffic type, or empty traffic item in item %lu\n",
+	     i);
+      errorCount++;
+    }
+    else if (pView->pItems[i].eop == STAR_EOP_TYPE_EEP)
+      (*pEeps)++;
+    else
+      SVERIFY_Check(pStream, pRxData, rxDataSize);
+  }
+  RXVIEW_Release(pView);
+
+  return errorCount;
+}
+
+
+/*
+ * Make the transmit operation of a slot with the next `batch` packets of
+ * the verified stream, releasing the ones the slot sent before. Each slot
+ * fills its own part of the buffer.
+ */
+static int buildVerifiedOp(STAR_SPACEWIRE_ADDRESS * const pAddressPath,
+			   SVERIFY_STREAM * const pStream, char * const pBuffer,
+			   const unsigned long size, const unsigned long batch,
+			   STAR_STREAM_ITEM ** const vItems,
+			   STAR_TRANSFER_OPERATION ** const ppOp)
+{
+  unsigned long i;
+
+  if (*ppOp != NULL){
+    STAR_disposeTransferOperation(*ppOp);
+    *ppOp = NULL;
+  }
+  for (i = 0; i < batch; ++i){
+    if (vItems[i] != NULL)
+      STAR_destroyStreamItem(vItems[i]);
+    vItems[i] = NULL;
+  }
+
+  for (i = 0; i < batch; ++i){
+    SVERIFY_Fill(pStream, (U8 *)pBuffer + i * size, size);
+    vItems[i] = STAR_createPacket(pAddressPath, (U8 *)pBuffer + i * size,
+				  size, STAR_EOP_TYPE_EOP);
+    if (vItems[i] == NULL){
+      puts("\nERROR: Unable to create the packets to be transmitted");
+      return 0;
+    }
+  }
+  *ppOp = STAR_createTxOperation(vItems, batch);
+  if (*ppOp == NULL){
+    puts("\nERROR: Unable to create the transmit operations");
+    return 0;
+  }
+
+  return 1;
+}
+
+
+/*
+ * One point of the benchmark. `depth` transmit operations of `batch`
+ * packets each are submitted in turn and the receive side is a stream of
+ * `depth` operations of `batch` packets, so operation n of both sides
+ * holds the same packets. Every transmit operation has packets of its
+ * own; verified, it is made again with new packets before it is
+ * submitted, otherwise they all carry the same data.
+ */
+static int benchPoint(const STAR_CHANNEL_ID txChannelId,
+		      const STAR_CHANNEL_ID rxChannelId,
+		      STAR_SPACEWIRE_ADDRESS * const pAddressPath,
+		      const unsigned long packets, const int verify,
+		      BENCH_RESULT * const pResult)
+{
+  const unsigned long size = pResult->size, batch = pResult->batch;
+  const unsigned long depth = pResult->depth;
+  const unsigned long slots = verify ? depth : 1;
+  unsigned long opCount, sent = 0, done = 0, slot, i, j;
+  STAR_STREAM_ITEM **vTxItems = NULL;
+  STAR_TRANSFER_OPERATION **vTxOps = NULL, *pRxOp;
+  STAR_TRANSFER_STATUS status;
+  unsigned long long *vSubmitNs = NULL, *vSamples = NULL;
+  unsigned long long startNs, nowNs, elapsedNs, eeps = 0;
+  SVERIFY_STREAM txStream, rxStream;
+  char *pTxBuffer = NULL;
+  RXSTREAM stream;
+  RXVIEW view;
+  int ok = 0;
+
+  opCount = (packets + batch - 1) / batch;
+  if (opCount < depth)
+    opCount = depth;
+  RXVIEW_Init(&view);
+  SVERIFY_Init(&txStream, _BENCH_STREAM_ID, DATA_TYPE_RANDOM,
+	       PATGEN_DEFAULT_SEED);
+  SVERIFY_Init(&rxStream, _BENCH_STREAM_ID, DATA_TYPE_RANDOM,
+	       PATGEN_DEFAULT_SEED);
+
+  pTxBuffer = malloc(slots * batch * size);
+  vTxItems = calloc(depth * batch, sizeof(STAR_STREAM_ITEM *));
+  vTxOps = calloc(depth, sizeof(STAR_TRANSFER_OPERATION *));
+  vSubmitNs = calloc(depth, sizeof(unsigned long long));
+  vSamples = calloc(opCount, sizeof(unsigned long long));
+  if (!pTxBuffer || !vTxItems || !vTxOps || !vSubmitNs || !vSamples){
+    puts("\nERROR: Unable to allocate the benchmark buffers");
+    goto release;
+  }
+
+  if (verify){
+    for (i = 0; i < depth; ++i)
+      if (!buildVerifiedOp(pAddressPath, &txStream,
+			   pTxBuffer + i * batch * size, size, batch,
+			   vTxItems + i * batch, &vTxOps[i]))
+	goto release;
+  }
+  else{
+    /* Every packet of the batch differs from its neighbours */
+    for (i = 0; i < batch * size; ++i)
+      pTxBuffer[i] = (char)(i + (i / size) * 7);
+
+    for (i = 0; i < depth; ++i){
+      for (j = 0; j < batch; ++j){
+	vTxItems[i * batch + j] =
+	  STAR_createPacket(pAddressPath, (U8 *)pTxBuffer + j * size, size,
+			    STAR_EOP_TYPE_EOP);
+	if (vTxItems[i * batch + j] == NULL){
+	  puts("\nERROR: Unable to create the packets to be transmitted");
+	  goto release;
+	}
+      }
+      vTxOps[i] = STAR_createTxOperation(vTxItems + i * batch, batch);
+      if (vTxOps[i] == NULL){
+	puts("\nERROR: Unable to create the transmit operations");
+	goto release;
+      }
+    }
+  }
+
+  if (!RXSTREAM_Open(&stream, rxChannelId, depth, batch))
+    goto release;
+
+  startNs = MonotonicTimeNs();
+  for (sent = 0; sent < depth; ++sent){
+    vSubmitNs[sent] = MonotonicTimeNs();
+    if (STAR_submitTransferOperation(txChannelId, vTxOps[sent]) == 0){
+      printf("\nERROR occurred during transmit.  Test failed.\n");
+      goto close;
+    }
+  }
+
+  for (done = 0; done < opCount; ++done){
+    slot = done % depth;
+    pRxOp = RXSTREAM_Next(&stream, STAR_INFINITE, &status);
+    nowNs = MonotonicTimeNs();
+    if (pRxOp == NULL){
+      printf("\nERROR occurred during receive.  Test failed.\n");
+      goto close;
+    }
+    vSamples[done] = nowNs - vSubmitNs[slot];
+    if (verify)
+      pResult->errors += verifyPackets(&view, pRxOp, &rxStream, &eeps);
+    else
+      pResult->errors += comparePackets(pRxOp, batch, size, pTxBuffer);
+
+    if (STAR_waitOnTransferOperationCompletion(vTxOps[slot], STAR_INFINITE) !=
+	STAR_TRANSFER_STATUS_COMPLETE){
+      printf("\nERROR occurred during transmit.  Test failed.\n");
+      goto close;
+    }
+    if (!RXSTREAM_Recycle(&stream))
+      goto close;
+    if (sent < opCount){
+      if (verify &&
+	  !buildVerifiedOp(pAddressPath, &txStream,
+			   pTxBuffer + slot * batch * size, size, batch,
+			   vTxItems + slot * batch, &vTxOps[slot]))
+	goto close;
+      vSubmitNs[slot] = MonotonicTimeNs();
+      if (STAR_submitTransferOperation(txChannelId, vTxOps[slot]) == 0){
+	printf("\nERROR occurred during transmit.  Test failed.\n");
+	goto close;
+      }
+      sent++;
+    }
+  }
+  elapsedNs = MonotonicTimeNs() - startNs;
+
+  if (verify){
+    SVERIFY_Finish(&rxStream, txStream.next);
+    pResult->errors += SVERIFY_Errors(&rxStream) + eeps;
+    if (SVERIFY_Errors(&rxStream) != 0)
+      SVERIFY_Print(stdout, &rxStream);
+  }
+
+  qsort(vSamples, opCount, sizeof(unsigned long long), compareNs);
+  pResult->packets = opCount * batch;
+  pResult->mbps = (pResult->packets * size * 8.0 * 1e3) / elapsedNs;
+  pResult->pps = (pResult->packets * 1e9) / elapsedNs;
+  pResult->p50Us = percentileUs(vSamples, opCount, 0.50);
+  pResult->p99Us = percentileUs(vSamples, opCount, 0.99);
+  pResult->p999Us = percentileUs(vSamples, opCount, 0.999);
+  pResult->maxUs = vSamples[opCount - 1] / 1e3;
+  ok = 1;
+
+ close:
+  RXSTREAM_Close(&stream);
+  /* A failed point leaves transmit operations behind, wait for them */
+  for (i = 0; i < depth && i < sent; ++i)
+    STAR_waitOnTransferOperationCompletion(vTxOps[i], STAR_INFINITE);
+ release:
+  if (!ok)
+    pResult->packets = done * batch;
+  if (vTxOps != NULL){
+    for (i = 0; i < depth; ++i)
+      if (vTxOps[i] != NULL)
+	STAR_disposeTransferOperation(vTxOps[i]);
+  }
+  if (vTxItems != NULL){
+    for (i = 0; i < depth * batch; ++i)
+      if (vTxItems[i] != NULL)
+	STAR_destroyStreamItem(vTxItems[i]);
+  }
+  free(vTxItems);
+  free(vTxOps);
+  free(vSubmitNs);
+  free(vSamples);
+  free(pTxBuffer);
+  RXVIEW_Free(&view);
+
+  return ok;
+}
+
+
+static int writeCsv(const char fname[], const BENCH_RESULT * const vResults,
+		    const unsigned int count)
+{
+  FILE *pFile;
+  unsigned int i;
+
+  pFile = fopen(fname, "w");
+  if (pFile == NULL){
+    printf("\nERROR: Unable to write %s\n", fname);
+    return 0;
+  }
+
+  fprintf(pFile, "size_bytes,batch,depth,packets,errors,mbps,pps,"
+	  "p50_us,p99_us,p999_us,max_us\n");
+  for (i = 0; i < count; ++i)
+    fprintf(pFile, "%lu,%lu,%lu,%lu,%lu,%.3f,%.0f,%.3f,%.3f,%.3f,%.3f\n",
+	    vResults[i].size, vResults[i].batch, vResults[i].depth,
+	    vResults[i].packets, vResults[i].errors, vResults[i].mbps,
+	    vResults[i].pps, vResults[i].p50Us, vResults[i].p99Us,
+	    vResults[i].p999Us, vResults[i].maxUs);
+
+  return fclose(pFile) == 0;
+}
+
+
+static int writeJson(const char fname[], const BENCH_RESULT * const vResults,
+		     const unsigned int count)
+{
+  FILE *pFile;
+  unsigned int i;
+  char date[32];
+  time_t now = time(NULL);
+
+  pFile = fopen(fname, "w");
+  if (pFile == NULL){
+    printf("\nERROR: Unable to write %s\n", fname);
+    return 0;
+  }
+
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+  fprintf(pFile, "{\n  \"program\": \"%s\",\n  \"date\": \"%s\",\n"
+	  "  \"results\": [\n", VERSION_INFO, date);
+  for (i = 0; i < count; ++i)
+    fprintf(pFile, "    {\"size_bytes\": %lu, \"batch\": %lu, "
+	    "\"depth\": %lu, \"packets\": %lu, \"errors\": %lu, "
+	    "\"mbps\": %.3f, \"pps\": %.0f, \"p50_us\": %.3f, "
+	    "\"p99_us\": %.3f, \"p999_us\": %.3f, \"max_us\": %.3f}%s\n",
+	    vResults[i].size, vResults[i].batch, vResults[i].depth,
+	    vResults[i].packets, vResults[i].errors, vResults[i].mbps,
+	    vResults[i].pps, vResults[i].p50Us, vResults[i].p99Us,
+	    vResults[i].p999Us, vResults[i].maxUs,
+	    (i + 1 < count) ? "," : "");
+  fprintf(pFile, "  ]\n}\n");
+
+  return fclose(pFile) == 0;
+}
+
+
+/*
+ * Sweep every size, batch and depth, print a table and write the files
+ * asked for. Returns the number of points that failed or had errors.
+ */
+static unsigned int runBenchmark(const STAR_CHANNEL_ID txChannelId,
+				 const STAR_CHANNEL_ID rxChannelId,
+				 const unsigned long * const vSizes,
+				 const unsigned int sizeCount,
+				 const unsigned long * const vBatches,
+				 const unsigned int batchCount,
+				 const unsigned long * const vDepths,
+				 const unsigned int depthCount,
+				 const unsigned long packets, const int verify,
+				 const char *pCsvName, const char *pJsonName)
+{
+  BENCH_RESULT *vResults, *pResult;
+  STAR_SPACEWIRE_ADDRESS *pAddressPath;
+  unsigned char path[] = {_ADDRESS_PATH};
+  unsigned int s, b, d, count = 0, failed = 0;
+
+  vResults = calloc(sizeCount * batchCount * depthCount, sizeof(BENCH_RESULT));
+  pAddressPath = STAR_createAddress(path, _ADDRESS_PATH_SIZE);
+  if (vResults == NULL || pAddressPath == NULL){
+    puts("\nERROR: Unable to allocate the benchmark results");
+    free(vResults);
+    return 1;
+  }
+
+  printf("%8s %6s %6s %9s %7s %10s %11s %10s %10s %10s %10s\n", "size",
+	 "batch", "depth", "packets", "errors", "Mbit/s", "pkt/s", "p50 us",
+	 "p99 us", "p999 us", "max us");
+  for (s = 0; s < sizeCount; ++s)
+    for (b = 0; b < batchCount; ++b)
+      for (d = 0; d < depthCount; ++d){
+	pResult = &vResults[count++];
+	pResult->size = vSizes[s];
+	pResult->batch = vBatches[b];
+	pResult->depth = vDepths[d];
+	if (!benchPoint(txChannelId, rxChannelId, pAddressPath, packets, verify,
+			pResult)){
+	  printf("%8lu %6lu %6lu  failed after %lu packets\n", pResult->size,
+		 pResult->batch, pResult->depth, pResult->packets);
+	  failed++;
+	  continue;
+	}
+	if (pResult->errors != 0)
+	  failed++;
+	printf("%8lu %6lu %6lu %9lu %7lu %10.2f %11.0f %10.2f %10.2f %10.2f %10.2f\n",
+	       pResult->size, pResult->batch, pResult->depth, pResult->packets,
+	       pResult->errors, pResult->mbps, pResult->pps, pResult->p50Us,
+	       pResult->p99Us, pResult->p999Us, pResult->maxUs);
+      }
+
+  if (pCsvName != NULL && writeCsv(pCsvName, vResults, count))
+    printf("Results written to %s.\n", pCsvName);
+  if (pJsonName != NULL && writeJson(pJsonName, vResults, count))
+    printf("Results written to %s.\n", pJsonName);
+
+  STAR_destroyAddress(pAddressPath);
+  free(vResults);
+  return failed;
+}
+
+
+static volatile sig_atomic_t soakStop;
+
+static void soakSignal(int signalNumber)
+{
+  (void)signalNumber;
+  soakStop = 1;
+}
+
+
+/*
+ * Whether the next transmit operation is due at the target rate, and if
+ * so the time of the one after. A link slower than the rate is not made
+ * up for with a burst afterwards.
+ */
+static int soakDue(unsigned long long * const pDueNs,
+		   const unsigned long long periodNs,
+		   const unsigned long long nowNs)
+{
+  if (periodNs == 0)
+    return 1;
+  if (*pDueNs > nowNs)
+    return 0;
+
+  if (*pDueNs + periodNs < nowNs)
+    *pDueNs = nowNs;
+  *pDueNs += periodNs;
+  return 1;
+}
+
+
+/*
+ * Wait for the next receive operation of the stream until a time of
+ * MonotonicTimeNs(). The last millisecond, below the resolution of the
+ * STAR-API wait, is polled, so the operation is seen complete when it
+ * completes and not after a blind sleep.
+ */
+static STAR_TRANSFER_OPERATION *soakReceive(RXSTREAM * const pStream,
+					    const unsigned long long untilNs,
+					    STAR_TRANSFER_STATUS * const pStatus)
+{
+  STAR_TRANSFER_OPERATION *pRxOp;
+  unsigned long long nowNs, leftNs;
+  struct timespec nap;
+
+  for (;;){
+    nowNs = MonotonicTimeNs();
+    leftNs = (untilNs > nowNs) ? untilNs - nowNs : 0;
+    pRxOp = RXSTREAM_Next(pStream, (int)(leftNs / 1000000ULL), pStatus);
+    if (pRxOp != NULL || *pStatus != STAR_TRANSFER_STATUS_STARTED ||
+	leftNs == 0)
+      return pRxOp;
+    if (leftNs < 1000000ULL){
+      nap.tv_sec = 0;
+      nap.tv_nsec = _SOAK_POLL_NS;
+      nanosleep(&nap, NULL);
+    }
+  }
+}
+
+
+/* Transmit side of the soak test */
+typedef struct {
+  STAR_CHANNEL_ID txChannelId;
+  STAR_SPACEWIRE_ADDRESS *pAddressPath;
+  unsigned long size, batch, depth;
+  unsigned long long periodNs, dueNs, sent, links;
+  STAR_STREAM_ITEM **vTxItems;
+  STAR_TRANSFER_OPERATION **vTxOps;
+  unsigned long long *vSubmitNs;
+  char *pTxBuffer;
+  SVERIFY_STREAM txStream;
+} SOAK_TX;
+
+
+/*
+ * Send the next operation of the soak test, in the slot of the one sent
+ * `depth` operations before, once that one is done.
+ */
+static int soakSend(SOAK_TX * const pTx)
+{
+  const unsigned long slot = (unsigned long)(pTx->sent % pTx->depth);
+  const unsigned long offset = slot * pTx->batch;
+
+  /* A failed transmit operation loses its packets, the receiver counts
+     them */
+  if (pTx->sent >= pTx->depth &&
+      STAR_waitOnTransferOperationCompletion(pTx->vTxOps[slot],
+					     STAR_INFINITE) !=
+      STAR_TRANSFER_STATUS_COMPLETE)
+    pTx->links++;
+
+  if (!buildVerifiedOp(pTx->pAddressPath, &pTx->txStream,
+		       pTx->pTxBuffer + offset * pTx->size, pTx->size,
+		       pTx->batch, pTx->vTxItems + offset, &pTx->vTxOps[slot]))
+    return 0;
+  pTx->vSubmitNs[slot] = MonotonicTimeNs();
+  if (STAR_submitTransferOperation(pTx->txChannelId, pTx->vTxOps[slot]) == 0){
+    printf("\nERROR occurred during transmit.  Test failed.\n");
+    return 0;
+  }
+  pTx->sent++;
+
+  return 1;
+}
+
+
+/* Whether every transmit operation sent is done */
+static int soakSendIdle(const SOAK_TX * const pTx)
+{
+  unsigned long i;
+
+  for (i = 0; i < pTx->depth && i < pTx->sent; ++i)
+    if (STAR_getTransferStatus(pTx->vTxOps[i]) ==
+	STAR_TRANSFER_STATUS_STARTED)
+      return 0;
+
+  return 1;
+}
+
+
+/* One line of statistics, CSV or a row of the table */
+static void soakPrint(FILE * const pFile, const int csv, const double timeS, const double mbps, const double pps,
+		      const unsigned long long packets,
+		      const unsigned long long errors,
+		      const unsigned long long total,
+		      const unsigned long long eeps,
+		      const unsigned long long links,
+		      const LATHIST * const pHist)
+{
+  const double p50 = LATHIST_Percentile(pHist, 0.50) / 1e3;
+  const double p99 = LATHIST_Percentile(pHist, 0.99) / 1e3;
+  const double p999 = LATHIST_Percentile(pHist, 0.999) / 1e3;
+
+  if (csv)
+    fprintf(pFile, "%.0f,%.3f,%.0f,%llu,%llu,%llu,%llu,%llu,%.3f,%.3f,%.3f,"
+	    "%.3f\n", timeS, mbps, pps, packets, errors, total, eeps, links,
+	    p50, p99, p999, pHist->maxNs / 1e3);
+  else
+    fprintf(pFile, "%8.0f %10.2f %10.0f %12llu %7llu %9llu %6llu %6llu %9.2f"
+	    " %9.2f %9.2f %9.2f\n", timeS, mbps, pps, packets, errors, total,
+	    eeps, links, p50, p99, p999, pHist->maxNs / 1e3);
+  fflush(pFile);
+}
+
+
+/*
+ * Soak test: a verified stream of `size` byte packets, `batch` per
+ * operation and `depth` operations in flight, paced to `rate` Mbit/s (0,
+ * as fast as the link goes), for `seconds` (0, until SIGINT or SIGTERM).
+ * Every `interval` seconds one line of statistics is printed, and written
+ * to the CSV file if any. The receive stream, the view, the buffers and
+ * the histograms are made once; the STAR-API copies the data of a packet,
+ * so each transmit operation is made again with its new packets, in place
+ * of the one its slot sent before. The round trip of an operation is
+ * from its submission to the receive operation seen complete. Returns the
+ * number of errors.
+ */
+static unsigned long long runSoak(const STAR_CHANNEL_ID txChannelId,
+				  const STAR_CHANNEL_ID rxChannelId,
+				  const unsigned long size,
+				  const unsigned long batch,
+				  const unsigned long depth,
+				  const unsigned long rate,
+				  const unsigned long seconds,
+				  const unsigned long interval,
+				  const char *pCsvName)
+{
+  unsigned char path[] = {_ADDRESS_PATH};
+  STAR_TRANSFER_OPERATION *pRxOp;
+  STAR_TRANSFER_STATUS status;
+  unsigned long long startNs, nowNs, reportNs, endNs, lastNs, untilNs, total;
+  unsigned long long done = 0, errors = 0, eeps = 0, itemErrors = 0;
+  unsigned long long lastPackets = 0, lastBytes = 0, lastErrors = 0;
+  unsigned long long lastEeps = 0, lastLinks = 0;
+  unsigned long i;
+  unsigned int drainWaits = 0;
+  SVERIFY_STREAM rxStream;
+  LATHIST *pIntervalHist, *pTotalHist;
+  struct sigaction action;
+  FILE *pCsv = NULL;
+  SOAK_TX tx;
+  RXSTREAM stream;
+  RXVIEW view;
+  int streamOpen = 0, stopping = 0, paced;
+  double spanS;
+
+  soakStop = 0;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = soakSignal;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  memset(&tx, 0, sizeof(tx));
+  tx.txChannelId = txChannelId;
+  tx.size = size;
+  tx.batch = batch;
+  tx.depth = depth;
+  tx.periodNs = rate ? (unsigned long long)batch * size * 8ULL * 1000ULL /
+    rate : 0;
+  SVERIFY_Init(&tx.txStream, _BENCH_STREAM_ID, DATA_TYPE_RANDOM,
+	       PATGEN_DEFAULT_SEED);
+  SVERIFY_Init(&rxStream, _BENCH_STREAM_ID, DATA_TYPE_RANDOM,
+	       PATGEN_DEFAULT_SEED);
+  RXVIEW_Init(&view);
+
+  tx.pAddressPath = STAR_createAddress(path, _ADDRESS_PATH_SIZE);
+  tx.pTxBuffer = malloc(depth * batch * size);
+  tx.vTxItems = calloc(depth * batch, sizeof(STAR_STREAM_ITEM *));
+  tx.vTxOps = calloc(depth, sizeof(STAR_TRANSFER_OPERATION *));
+  tx.vSubmitNs = calloc(depth, sizeof(unsigned long long));
+  pIntervalHist = calloc(1, sizeof(LATHIST));
+  pTotalHist = calloc(1, sizeof(LATHIST));
+  if (!tx.pAddressPath || !tx.pTxBuffer || !tx.vTxItems || !tx.vTxOps ||
+      !tx.vSubmitNs || !pIntervalHist || !pTotalHist){
+    puts("\nERROR: Unable to allocate the soak test buffers");
+    errors++;
+    goto release;
+  }
+  if (pCsvName != NULL){
+    pCsv = fopen(pCsvName, "w");
+    if (pCsv == NULL){
+      printf("\nERROR: Unable to write %s\n", pCsvName);
+      errors++;
+      goto release;
+    }
+    fprintf(pCsv, "time_s,mbps,pps,packets,errors,total_errors,eeps,"
+	    "link_events,p50_us,p99_us,p999_us,max_us\n");
+  }
+
+  if (!RXSTREAM_Open(&stream, rxChannelId, depth, batch)){
+    errors++;
+    goto release;
+  }
+  streamOpen = 1;
+
+  printf("Soak test: %lu B packets, %lu per operation, %lu in flight, ",
+	 size, batch, depth);
+  if (rate)
+    printf("%lu Mbit/s, ", rate);
+  if (seconds)
+    printf("%lu s.\n", seconds);
+  else
+    printf("until interrupted.\n");
+  printf("%8s %10s %10s %12s %7s %9s %6s %6s %9s %9s %9s %9s\n", "time s",
+	 "Mbit/s", "pkt/s", "packets", "errors", "total", "eep", "link",
+	 "p50 us", "p99 us", "p999 us", "max us");
+
+  startNs = lastNs = tx.dueNs = MonotonicTimeNs();
+  reportNs = startNs + interval * 1000000000ULL;
+  endNs = seconds ? startNs + seconds * 1000000000ULL : 0;
+
+  /* Receive operation n holds the packets of transmit operation n, unless
+     packets were lost before it. An operation is sent when it is due and
+     its slot is free, in between the receiver waits up to the due time */
+  for (;;){
+    nowNs = MonotonicTimeNs();
+    if (!stopping && (soakStop || (endNs && nowNs >= endNs)))
+      stopping = 1;
+    if (stopping && done >= tx.sent)
+      break;
+
+    untilNs = nowNs + _SOAK_WAIT_MS * 1000000ULL;
+    paced = 0;
+    if (!stopping && tx.sent < done + depth){
+      if (soakDue(&tx.dueNs, tx.periodNs, nowNs)){
+	if (!soakSend(&tx)){
+	  errors++;
+	  break;
+	}
+	continue;
+      }
+      if (tx.dueNs < untilNs){
+	untilNs = tx.dueNs;
+	paced = 1;
+      }
+    }
+
+    pRxOp = soakReceive(&stream, untilNs, &status);
+    nowNs = MonotonicTimeNs();
+    if (pRxOp != NULL){
+      LATHIST_Record(pIntervalHist, nowNs - tx.vSubmitNs[done % depth]);
+      LATHIST_Record(pTotalHist, nowNs - tx.vSubmitNs[done % depth]);
+      itemErrors += verifyPackets(&view, pRxOp, &rxStream, &eeps);
+      if (!RXSTREAM_Recycle(&stream)){
+	errors++;
+	break;
+      }
+      done++;
+    }
+    else if (status != STAR_TRANSFER_STATUS_STARTED){
+      printf("\nERROR occurred during receive.  Test failed.\n");
+      errors++;
+      break;
+    }
+    else if (paced)
+      ;
+    else if (stopping){
+      if (++drainWaits >= _SOAK_DRAIN_WAITS)
+	break;
+    }
+    else{
+      /* Nothing for a whole wait. If everything sent is done, packets were
+	 lost and the receive operation waits for the next ones */
+      tx.links++;
+      if (soakSendIdle(&tx) && !soakSend(&tx)){
+	errors++;
+	break;
+      }
+    }
+
+    if (nowNs >= reportNs){
+      total = SVERIFY_Errors(&rxStream) + itemErrors + eeps;
+      spanS = (nowNs > lastNs) ? (nowNs - lastNs) / 1e9 : 1e-9;
+      soakPrint(stdout, 0, (nowNs - startNs) / 1e9,
+		(rxStream.bytes - lastBytes) * 8.0 / spanS / 1e6,
+		(rxStream.packets - lastPackets) / spanS, rxStream.packets,
+		total - lastErrors, total, eeps - lastEeps,
+		tx.links - lastLinks, pIntervalHist);
+      if (pCsv != NULL)
+	soakPrint(pCsv, 1, (nowNs - startNs) / 1e9,
+		  (rxStream.bytes - lastBytes) * 8.0 / spanS / 1e6,
+		  (rxStream.packets - lastPackets) / spanS, rxStream.packets,
+		  total - lastErrors, total, eeps - lastEeps,
+		  tx.links - lastLinks, pIntervalHist);
+      lastNs = nowNs;
+      lastPackets = rxStream.packets;
+      lastBytes = rxStream.bytes;
+      lastErrors = total;
+      lastEeps = eeps;
+      lastLinks = tx.links;
+      LATHIST_Reset(pIntervalHist);
+      while (reportNs <= nowNs)
+	reportNs += interval * 1000000000ULL;
+    }
+  }
+
+  printf("\nSoak test ended after %.0f s.\n",
+	 (MonotonicTimeNs() - startNs) / 1e9);
+  SVERIFY_Finish(&rxStream, tx.txStream.next);
+  SVERIFY_Print(stdout, &rxStream);
+  printf("%llu packets ended by an EEP, %llu link events.\n", eeps,
+	 tx.links);
+  LATHIST_PrintHeader(stdout, "Operation round trip");
+  LATHIST_Print(stdout, pTotalHist, "tx submit->rx complete");
+  errors += SVERIFY_Errors(&rxStream) + itemErrors + eeps;
+
+  /* Give the transmit operations still in flight a last wait */
+  for (i = 0; i < depth && i < tx.sent; ++i)
+    STAR_waitOnTransferOperationCompletion(tx.vTxOps[i], _SOAK_WAIT_MS);
+ release:
+  action.sa_handler = SIG_DFL;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  if (streamOpen)
+    RXSTREAM_Close(&stream);
+  if (tx.vTxOps != NULL){
+    for (i = 0; i < depth; ++i)
+      if (tx.vTxOps[i] != NULL){
+	if (STAR_getTransferStatus(tx.vTxOps[i]) ==
+	    STAR_TRANSFER_STATUS_STARTED)
+	  STAR_cancelTransferOperation(tx.vTxOps[i]);
+	STAR_disposeTransferOperation(tx.vTxOps[i]);
+      }
+  }
+  if (tx.vTxItems != NULL){
+    for (i = 0; i < depth * batch; ++i)
+      if (tx.vTxItems[i] != NULL)
+	STAR_destroyStreamItem(tx.vTxItems[i]);
+  }
+  if (pCsv != NULL && fclose(pCsv) == 0)
+    printf("Statistics written to %s.\n", pCsvName);
+  if (tx.pAddressPath != NULL)
+    STAR_destroyAddress(tx.pAddressPath);
+  free(tx.vTxItems);
+  free(tx.vTxOps);
+  free(tx.vSubmitNs);
+  free(tx.pTxBuffer);
+  free(pIntervalHist);
+  free(pTotalHist);
+  RXVIEW_Free(&view);
+
+  return errors;
+}
+
 
 /******************************************************************/
 /*                                                                */
@@ -203,7 +1032,91 @@ int __cdecl main(int argc, char *argv[]){
   STAR_CHANNEL_ID rxChannelId = 0U, txChannelId = 0U;
   STAR_CFG_MK2_BASE_TRANSMIT_CLOCK clockRateParams;
 
-
+  unsigned long vSizes[_BENCH_MAX_LIST], vBatches[_BENCH_MAX_LIST];
+  unsigned long vDepths[_BENCH_MAX_LIST], packets = _BENCH_PACKETS;
+  unsigned int sizeCount = 0, batchCount = 2, depthCount = 2;
+  unsigned long soakSize = _SOAK_SIZE, soakBatch = _SOAK_BATCH;
+  unsigned long soakDepth = _SOAK_DEPTH, soakSeconds = 0, soakRate = 0;
+  unsigned long soakInterval = _SOAK_INTERVAL;
+  const char *pCsvName = NULL, *pJsonName = NULL;
+  int opt, benchmark = 0, verify = 0, soak = 0;
+
+  /* By default the sweep goes from 8 B to 64 KB, doubling */
+  for (i = 8; i <= _BENCH_MAX_SIZE; i *= 2)
+    vSizes[sizeCount++] = i;
+  vBatches[0] = 1;
+  vBatches[1] = 16;
+  vDepths[0] = 1;
+  vDepths[1] = 4;
+
+  while ((opt = getopt(argc, argv, "bs:B:d:n:c:j:vS:r:i:")) != -1){
+    switch (opt){
+    case 'b':
+      benchmark = 1;
+      break;
+    case 's':
+      sizeCount = parseList(optarg, vSizes, _BENCH_MAX_SIZE);
+      soakSize = vSizes[0];
+      break;
+    case 'B':
+      batchCount = parseList(optarg, vBatches, 1024);
+      soakBatch = vBatches[0];
+      break;
+    case 'd':
+      depthCount = parseList(optarg, vDepths, 64);
+      soakDepth = vDepths[0];
+      break;
+    case 'n':
+      packets = strtoul(optarg, NULL, 0);
+      break;
+    case 'c':
+      pCsvName = optarg;
+      break;
+    case 'j':
+      pJsonName = optarg;
+      break;
+    case 'v':
+      verify = 1;
+      break;
+    case 'S':
+      soak = 1;
+      soakSeconds = strtoul(optarg, NULL, 0);
+      break;
+    case 'r':
+      soakRate = strtoul(optarg, NULL, 0);
+      break;
+    case 'i':
+      soakInterval = strtoul(optarg, NULL, 0);
+      break;
+    default:
+      printf("Usage: %s [-v] [-b [-s sizes] [-B batches] [-d depths]"
+	     " [-n packets] [-c csv] [-j json]]\n"
+	     "       %s -S seconds [-s size] [-B batch] [-d depth]"
+	     " [-r Mbit/s] [-i interval] [-c csv]\n", argv[0], argv[0]);
+      return 1;
+    }
+  }
+  if (soak && (soakSize < SVERIFY_HEADER_SIZE || soakInterval == 0)){
+    printf("Error: Soak packets must hold the %u B stream header and the"
+	   " interval must be positive.\n", SVERIFY_HEADER_SIZE);
+    return 1;
+  }
+  if (verify){
+    /* The packets must hold the stream header, smaller sizes are dropped */
+    unsigned int kept = 0;
+
+    for (i = 0; i < sizeCount; ++i)
+      if (vSizes[i] >= SVERIFY_HEADER_SIZE)
+	vSizes[kept++] = vSizes[i];
+    sizeCount = kept;
+  }
+  if (sizeCount == 0 || batchCount == 0 || depthCount == 0 || packets == 0){
+    printf("Error: Sizes (1-%u, from %u with -v), batches (1-1024), depths"
+	   " (1-64) and packets must be comma separated lists of positive"
+	   " numbers.\n",
+	   _BENCH_MAX_SIZE, SVERIFY_HEADER_SIZE);
+    return 1;
+  }
 
 
   /***************************************************************/
@@ -286,6 +1199,25 @@ int __cdecl main(int argc, char *argv[]){
     }
 
   puts("Channels Opened.\n");	
+
+  if (soak){
+    unsigned long long errors = runSoak(txChannelId, rxChannelId, soakSize,
+					soakBatch, soakDepth, soakRate,
+					soakSeconds, soakInterval, pCsvName);
+    STAR_closeChannel(rxChannelId);
+    STAR_closeChannel(txChannelId);
+    return errors != 0;
+  }
+
+  if (benchmark){
+    unsigned int failed = runBenchmark(txChannelId, rxChannelId, vSizes,
+				       sizeCount, vBatches, batchCount,
+				       vDepths, depthCount, packets, verify,
+				       pCsvName, pJsonName);
+    STAR_closeChannel(rxChannelId);
+    STAR_closeChannel(txChannelId);
+    return failed != 0;
+  }
 	
   /*****************************************************************/
   /*    Allocate memory for the transmit buffer and construct      */
@@ -298,6 +1230,7 @@ int __cdecl main(int argc, char *argv[]){
   unsigned char newPath[128];
   unsigned int pathLen = 0;
   STAR_SPACEWIRE_ADDRESS *pAddressPath = NULL;
+  SVERIFY_STREAM txStream, rxStream;
 
   byteSize = _PACKET_SIZE;
   pathLen = _ADDRESS_PATH_SIZE;
@@ -311,10 +1244,17 @@ int __cdecl main(int argc, char *argv[]){
       puts("\nERROR: Unable to allocate memory for transmit buffer");
       return 0;
     }
-  /*Initialize with data*/
-  for(i=0; i< byteSize; ++i){
-    pTxBuffer[i] = i;
+  /*Initialize with data, the first packet of a verified stream with -v*/
+  if (verify){
+    SVERIFY_Init(&txStream, _BENCH_STREAM_ID, DATA_TYPE_RANDOM,
+		 PATGEN_DEFAULT_SEED);
+    rxStream = txStream;
+    SVERIFY_Fill(&txStream, (U8 *)pTxBuffer, byteSize);
   }
+  else
+    for(i=0; i< byteSize; ++i){
+      pTxBuffer[i] = i;
+    }
 
   /* Create a SpaceWire address from the path */
   pAddressPath = STAR_createAddress(newPath, pathLen);
@@ -337,7 +1277,7 @@ int __cdecl main(int argc, char *argv[]){
     }
 
   /* Print the Packet. Diabled for Packets bigger thant 64B */
-  printPacket((STAR_SPACEWIRE_PACKET *)pTxStreamItem->item);
+  printPacket((U8 *)pTxBuffer, byteSize);
 
   /* Create the transmit transfer operation for the packet */
   pTxTransferOp = STAR_createTxOperation(&pTxStreamItem, 1U);
@@ -394,7 +1334,20 @@ int __cdecl main(int argc, char *argv[]){
 
   //Compare the results
   int errorCount = 0;
-  errorCount += comparePackets(pRxTransferOp, 1U, byteSize, pTxBuffer);
+  if (verify){
+    RXVIEW view;
+    unsigned long long eeps = 0;
+
+    RXVIEW_Init(&view);
+    errorCount += verifyPackets(&view, pRxTransferOp, &rxStream, &eeps);
+    RXVIEW_Free(&view);
+    SVERIFY_Finish(&rxStream, txStream.next);
+    errorCount += SVERIFY_Errors(&rxStream) + eeps;
+    if (SVERIFY_Errors(&rxStream) != 0)
+      SVERIFY_Print(stdout, &rxStream);
+  }
+  else
+    errorCount += comparePackets(pRxTransferOp, 1U, byteSize, pTxBuffer);
   printf(" Error found in the communication: %i.\n", errorCount);
 
   printRxPackets((STAR_TRANSFER_OPERATION *)  pRxTransferOp);
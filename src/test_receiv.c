@@ -2,9 +2,14 @@
   @file test_receiv.c
   @author Juan Manuel Gómez
   @brief Receive files forever and store it on a file.
-  @details 
-  @param No parammeters needed.
-  @example ./test_rmap  
+  @details Keeps several receive operations in flight so the link always
+  has a posted buffer (see rx_stream.h). With -w the packets are recorded
+  in a memory-mapped ring file (see capture.h) instead of being printed;
+  read it back with capread. With -t every receive operation is timed
+  (see op_timing.h) and the histograms are printed at exit, or on SIGUSR1.
+  @param -d depth -b batch -n operations -w capture file -s ring size
+         -t timing
+  @example ./receiv -d 4 -b 64 -n 0 -w rx.cap -s 268435456
   @copyright jmgomez CSIC-IAA
 */
 
@@ -18,7 +23,15 @@
 #include "cfg_api_mk2_types.h"
 #include "cfg_api_brick_mk3.h"
 #include "rmap_packet_library.h"
-
+#include "rx_stream.h"
+#include "rx_view.h"
+#include "capture.h"
+#include "op_timing.h"
+#ifdef STAR_SIM
+#include "star_sim.h"
+#endif
+
+#include <unistd.h>
 #include <sys/time.h>
 
 clock_t start, finish;
@@ -69,6 +82,47 @@ int __cdecl main(int argc, char *argv[]){
   STAR_CHANNEL_ID rxChannelId = 0U, txChannelId = 0U;
   STAR_CFG_MK2_BASE_TRANSMIT_CLOCK clockRateParams;
 
+  unsigned int rxDepth = RXSTREAM_DEFAULT_DEPTH;
+  unsigned int rxBatch = RXSTREAM_DEFAULT_BATCH;
+  unsigned long rxOperations = 20;
+  const char *captureFile = NULL;
+  unsigned long captureSize = CAPTURE_DEFAULT_SIZE;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "d:b:n:w:s:t")) != -1)
+  {
+    switch (opt)
+    {
+    case 'd':
+      rxDepth = strtoul(optarg, NULL, 0);
+      break;
+    case 'b':
+      rxBatch = strtoul(optarg, NULL, 0);
+      break;
+    case 'n':
+      rxOperations = strtoul(optarg, NULL, 0);
+      break;
+    case 'w':
+      captureFile = optarg;
+      break;
+    case 's':
+      captureSize = strtoul(optarg, NULL, 0);
+      break;
+    case 't':
+      OPTIME_Enable();
+      break;
+    default:
+      printf("Usage: %s [-d depth] [-b batch] [-n operations] [-w file] [-s size] [-t]\n", argv[0]);
+      printf("depth: Receive operations kept in flight (default %u).\n", RXSTREAM_DEFAULT_DEPTH);
+      printf("batch: Packets held by each receive operation (default %u).\n", RXSTREAM_DEFAULT_BATCH);
+      printf("operations: Operations to consume, 0 receives forever (default 20).\n");
+      printf("file: Record the packets in a capture file instead of printing them.\n");
+      printf("size: Bytes of the capture ring, oldest packets are overwritten (default %lu).\n", CAPTURE_DEFAULT_SIZE);
+      printf("-t: Time the receive operations, printed at exit or on SIGUSR1.\n");
+      return 0;
+    }
+  }
+
 
   /***************************************************************/
   /*        Configuration                                        */
@@ -150,91 +204,99 @@ int __cdecl main(int argc, char *argv[]){
   }
 
   puts("Channels Opened.\n");	
+  OPTIME_Label(txChannelId, "SpW1 receive");
 	
   /*****************************************************************/
-  /*    Allocate memory for the transmit buffer and construct      */
-  /*    the packet to transmit.                                    */
+  /*    Post the receive operations. The stream keeps rxDepth      */
+  /*    operations of rxBatch packets queued on the channel, so    */
+  /*    the link always has a buffer while one is processed.       */
   /*****************************************************************/
-  unsigned long byteSize = 0;
+  STAR_TRANSFER_STATUS rxStatus;
+  STAR_TRANSFER_OPERATION *pRxTransferOp = NULL;
+  RXSTREAM rxStream;
+  RXVIEW rxView;
+  CAPTURE capture;
 
-  void *pFillPacket, *pBuildPacket;
-  unsigned long fillPacketLenCalculated, fillPacketLen;  
-  unsigned long buildPacketLen;
-  U8 pTarget[] = {0,254};
-  U8 pReply[] = {254};
-  U8 pData[] = {0x00, 0x14, 0x02, 0x2E};
-  char status;
+  if (captureFile != NULL && !CAPTURE_Create(&capture, captureFile, captureSize))
+  {
+    puts("\nERROR: Unable to create the capture file");
+    return 0;
+  }
 
-  byteSize = _PACKET_SIZE;
-  STAR_TRANSFER_STATUS rxStatus;
-  STAR_TRANSFER_OPERATION *pTxTransferOp = NULL, *pRxTransferOp = NULL;
-  STAR_STREAM_ITEM *pTxStreamItem = NULL;
-   
-  /* Create the receive operations. */
-  pRxTransferOp = STAR_createRxOperation(1, STAR_RECEIVE_PACKETS);
-  if (pRxTransferOp == NULL)
+  if (!RXSTREAM_Open(&rxStream, txChannelId, rxDepth, rxBatch))
   {
-    puts("\nERROR: Unable to create receive operation");
+    puts("\nERROR: Unable to create receive operations");
     return 0;
   }
 
+  RXVIEW_Init(&rxView);
+  printf("Receiving with %u operations of %u packets in flight.\n",
+         rxStream.depth, rxStream.batchSize);
+
   /***************************************************************/
-  /*    Submit the operations                                    */
+  /*    Consume the operations as they complete                  */
   /*                                                             */
   /***************************************************************/
-  int counter= 0;
-  while(counter < 20 || (rxStatus == STAR_TRANSFER_STATUS_COMPLETE))
+  unsigned long counter = 0;
+  while (rxOperations == 0 || counter < rxOperations)
   {
-    /* Submit the receive operation */
-    if (STAR_submitTransferOperation(txChannelId, pRxTransferOp) == 0)
-    {
-      printf("\nERROR occurred during receive.  Test Tfailed.\n");
-      return 0;
-    }
-
-    /* Wait on the receive operation completing */
-    rxStatus = STAR_waitOnTransferOperationCompletion(pRxTransferOp,
-                                                      STAR_INFINITE);
-    if (rxStatus != STAR_TRANSFER_STATUS_COMPLETE)
+    /* Wait on the oldest receive operation completing */
+    pRxTransferOp = RXSTREAM_Next(&rxStream, STAR_INFINITE, &rxStatus);
+    if (pRxTransferOp == NULL)
     {
+      if (rxStatus == STAR_TRANSFER_STATUS_STARTED)
+      {
+        continue;
+      }
       printf("\nERROR occurred during receive.  Test failed.\n");
-      return 0;
+      break;
     }
 
     // Store the received packet in the file.
-    /* Get the number of traffic items received */
-    unsigned int rxPacketCount = STAR_getTransferItemCount(pRxTransferOp);
+    /* Map the traffic items received, one copy of each packet */
+    unsigned int rxPacketCount = RXVIEW_Map(&rxView, pRxTransferOp);
     if (rxPacketCount == 0)
     {
       printf("No packets received.\n");
     }
+    else if (captureFile != NULL)
+    {
+      /* The API gives no per-packet arrival time: stamp the operation */
+      unsigned long long rxTimeNs = RealTimeNs();
+      unsigned int i = 0;
+      for (i = 0U; i < rxPacketCount; i++)
+      {
+        const RXVIEW_ITEM *pItem = &rxView.pItems[i];
+        if (pItem->pData == NULL)
+        {
+          continue;
+        }
+        CAPTURE_Write(&capture, rxTimeNs, (uint8_t)txChannelNumber,
+                      pItem->eop == STAR_EOP_TYPE_EOP ? CAPTURE_EOP_EOP :
+                      pItem->eop == STAR_EOP_TYPE_EEP ? CAPTURE_EOP_EEP :
+                      CAPTURE_EOP_NONE,
+                      pItem->pData, pItem->length);
+      }
+    }
     else
     {
       /* For each traffic item received */
-      int i = 0;
+      unsigned int i = 0;
       for (i = 0U; i < rxPacketCount; i++)
       {
         /* Get the packet */
-        STAR_STREAM_ITEM *pRxStreamItem = STAR_getTransferItem(pRxTransferOp, i);
-        if ((pRxStreamItem == NULL) || (pRxStreamItem->item == NULL) ||
-            (pRxStreamItem->itemType != STAR_STREAM_ITEM_TYPE_SPACEWIRE_PACKET) )
+        U32 streamDataSize = 0;
+        const U8 *pPacketBufferData = RXVIEW_Packet(&rxView, i, &streamDataSize);
+        if (pPacketBufferData == NULL)
         {
-          printf("\nERROR received an unexpected traffic type, or empty traffic item in item %lu\n", i);
+          printf("\nERROR received an unexpected traffic type, or empty traffic item in item %u\n", i);
         }
         else
         {
-
-          unsigned int streamDataSize = 0;
-          // Get the Packet Data and size from the stream Stream
-          unsigned char* pPacketBufferData = STAR_getPacketData((STAR_SPACEWIRE_PACKET *) pRxStreamItem->item,
-                                             &streamDataSize);
-          // Received packets will not have an address structure set. 
-          //STAR_SPACEWIRE_ADDRESS *pStreamItemAddress =  STAR_getPacketAddress ( (STAR_SPACEWIRE_PACKET *)pRxStreamItem->item);
-
           printf("\n");
 
-          printf("Packet Number:\t%d\n", counter);
-          int dat_iter = 0;
+          printf("Packet Number:\t%lu\n", (rxStream.opsCompleted - 1) * rxStream.batchSize + i);
+          unsigned int dat_iter = 0;
           for ( dat_iter= 0; dat_iter < streamDataSize; ++dat_iter){
 
             printf( "\t0x%x" ,pPacketBufferData[dat_iter]);
@@ -245,35 +307,47 @@ int __cdecl main(int argc, char *argv[]){
           }
 
           fflush(stdout);
-
-          //          STAR_destroyAddress(pStreamItemAddress);
-          STAR_destroyPacketData(pPacketBufferData);
         }
       }
     }
- 
+
+    /* The packet data is freed before the operation is reused */
+    RXVIEW_Release(&rxView);
+
+    /* Post the operation again behind the ones still in flight */
+    if (!RXSTREAM_Recycle(&rxStream))
+    {
+      printf("\nERROR unable to resubmit the receive operation.\n");
+      break;
+    }
+
     counter++;
   }
 
+  printf("\nReceived %lu packets in %lu operations, %lu errors.\n",
+         rxStream.itemsReceived, rxStream.opsCompleted, rxStream.errors);
+  if (captureFile != NULL)
+  {
+    printf("Captured %llu packets in %s, %llu overwritten, %llu too large.\n",
+           (unsigned long long)capture.pHeader->recordCount, captureFile,
+           (unsigned long long)capture.pHeader->overwritten,
+           (unsigned long long)capture.pHeader->rejected);
+    CAPTURE_Close(&capture);
+  }
+#ifdef STAR_SIM
+  printf("Packets dropped with no receiver open: %lu\n",
+         SIM_getDroppedPackets(deviceId, txChannelNumber));
+#endif
+
   /****************************************************************/
   /*    Free the resource                                         */
   /*                                                              */
   /****************************************************************/
 
-  /* Dispose of the transfer operations */
-  if (pTxTransferOp != NULL)
-  {
-    STAR_disposeTransferOperation(pTxTransferOp);
-  }
-
-  if (pRxTransferOp != NULL)
-  {
-    STAR_disposeTransferOperation(pRxTransferOp);
-  }
+  /* Cancel and dispose of the transfer operations */
+  RXVIEW_Free(&rxView);
+  RXSTREAM_Close(&rxStream);
 
-  if (pFillPacket != NULL){
-    RMAP_FreeBuffer(pFillPacket);
-  }
   /* Close the channels */
   if (rxChannelId != 0U)
   {
@@ -287,8 +361,3 @@ int __cdecl main(int argc, char *argv[]){
 
   return 0;
 }
-
-
-
-
-
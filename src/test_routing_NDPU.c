@@ -3,6 +3,8 @@
   @author Juan Manuel Gómez
   @brief Spacewire Test Logical Routing Plato GR718B
   @details Configures the routing table to implement a logical routing.
+  Every transfer operation is timed (op_timing.h): the histograms of both
+  links are printed at exit, or on SIGUSR1 while a route stalls.
   Enable the Spw Interfaces and configure the baudrate to run clk_div = 0.
   Configure the Routing table to 
   @param No parammeters needed.
@@ -13,6 +15,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include "system_config.h"
 #include "utility.h"
 #include "star-dundee_types.h"
@@ -22,6 +25,9 @@
 #include "cfg_api_mk2_types.h"
 //#include "cfg_api_brick_mk3.h"
 #include "rmap_packet_library.h"
+#include "pkt_pool.h"
+#include "rmap_engine.h"
+#include "op_timing.h"
 
 #define VERSION_INFO "LA Route v1.0"
 
@@ -39,8 +45,6 @@
 #define _ADDRESS_PATH 2
 #define _ADDRESS_PATH_SIZE 1
 
-void freePacketArray(void **packetArray, int count);
-uint32_t RTRCFG_WrRegToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t *pValue, uint32_t reg_address);
 unsigned long printRxPackets(STAR_TRANSFER_OPERATION * const pTransferOp);
 void printPacket( STAR_SPACEWIRE_PACKET * StreamItemPacket);
 uint32_t LoopBackPacketToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t dst, uint8_t src, uint8_t *pValue, uint32_t reg_address);
@@ -56,6 +60,9 @@ char pRTR_RTACTRL_PHY2[] = {0x00, 0x00, 0x00, 0x0C};
 
 
 
+/* Command buffers, sized once for the commands LoopBackPacketToStream builds */
+static PKTPOOL loopPool;
+
 int __cdecl  main(int argc, char * argv[]){
   STAR_DEVICE_ID* devices;
   STAR_DEVICE_ID deviceId;
@@ -135,6 +142,12 @@ int __cdecl  main(int argc, char * argv[]){
   puts("\nChannel Spw 1 Opened and ready to communicate.  ");
   puts("\n************************************************\n");
 
+  /* Time every operation on both links, the histograms are printed at */
+  /* exit, or on SIGUSR1 while waiting for a stalled route.            */
+  OPTIME_Enable();
+  OPTIME_Label(testPortChannel, "SpW1");
+  OPTIME_Label(testPortChannel2, "SpW2");
+
   /*****************************************************************/
   /*    Allocate memory for the transmit buffer and construct      */
   /*    the packet to transmit.                                    */
@@ -146,19 +159,17 @@ int __cdecl  main(int argc, char * argv[]){
   /* that is 4 byte per command.                                   */
   /*****************************************************************/
   /*       Create the Transmit and Receive Operations              */
-  STAR_TRANSFER_OPERATION **pConfigRouterTransferOp = NULL;
   STAR_TRANSFER_OPERATION *pTxTransferOp = NULL, *pRxTransferOp = NULL;
   STAR_STREAM_ITEM **vTxStreamItem = NULL;
-  unsigned int rxOp_itemCount= 0, txOp_itemCount = 0, txRTPOP_Itemcount= 0;
+  OPTIME_STAMP txStamp, rxStamp;
+  unsigned int rxOp_itemCount= 0, txOp_itemCount = 0;
 
-  unsigned long byteSize =  0;
-  
   U8 pData[16];
 
-  uint32_t rtr_config_cmd = 6;
   uint32_t port_config_cmd = 10;
-  txOp_itemCount = rtr_config_cmd + port_config_cmd;
-  rxOp_itemCount =  1; //txOp_itemCount;
+  uint32_t test_packets = 2;
+  txOp_itemCount = test_packets;
+  rxOp_itemCount =  1;
   
   // Packet is pTarget 2 address and pReply 1. Use alignment.
   uint32_t opCounter= 0;
@@ -166,47 +177,66 @@ int __cdecl  main(int argc, char * argv[]){
   uint32_t reg_base = 0x804;
   uint32_t reg_byteSize = 0x4;
 
-  //Allocate Memory for TxStream Items
-  vTxStreamItem = malloc(txOp_itemCount * sizeof( STAR_STREAM_ITEM));
-  if (!vTxStreamItem){
-    puts("\nError: Could not allocate memory for the packet array.");    
-    return 0;    
-  }
-
-  uint32_t status;
-  strncpy (pData, pRTR_PCTRL2_EN, 4);  
+  /*****************************************************************/
+  /*    Configure the router. Every write is acknowledged by the   */
+  /*    GR718 and checked, see rmap_engine.h.                      */
+  /*****************************************************************/
+  U8 pTarget[] = {0, 254};
+  U8 pReply[] = {254};
+  RMAPENG rmapEngine;
+  RMAPENG_ACCESS vWrites[14];
+  uint32_t writeCount = 0;
 
   for(opCounter= 0; opCounter < port_config_cmd; ++ opCounter){
     reg_address = reg_base + reg_byteSize*opCounter;
-    //    vTxStreamItem[opCounter] = NULL;
-    status = RTRCFG_WrRegToStream( vTxStreamItem+opCounter, pRTR_PCTRL2_EN, reg_address);
-    if (status != 0){
-      printf("Error generating the Stream.");
-      return 0;
-    }
-    printf("Included packet %d to the Stream.\n", opCounter);
+    RMAPENG_SetWrite(&vWrites[writeCount++], reg_address, (U8 *) pRTR_PCTRL2_EN);
   }
 
   //Prepare the Packets to configure the routing table.
-  strncpy (pData, pRTR_RTMAP_ADDR254, 4);
-  status = RTRCFG_WrRegToStream ( vTxStreamItem+ port_config_cmd   , pRTR_RTMAP_ADDR254, 0x000003F8);
+  RMAPENG_SetWrite(&vWrites[writeCount++], 0x000003F8, (U8 *) pRTR_RTMAP_ADDR254);
+  RMAPENG_SetWrite(&vWrites[writeCount++], 0x00000008, (U8 *) pRTR_RTMAP_PHY2);
+  RMAPENG_SetWrite(&vWrites[writeCount++], 0x000007F8, (U8 *) pRTR_RTACTRL_ADDR254);
+  RMAPENG_SetWrite(&vWrites[writeCount++], 0x00000408, (U8 *) pRTR_RTACTRL_PHY2);
 
-  strncpy (pData, pRTR_RTMAP_PHY2, 4);
-  status = RTRCFG_WrRegToStream ( vTxStreamItem+ port_config_cmd + 1, pRTR_RTMAP_PHY2, 0x00000008);
+  if (!RMAPENG_Init(&rmapEngine, testPortChannel, testPortChannel,
+                    pTarget, sizeof(pTarget), pReply, sizeof(pReply))){
+    return 0;
+  }
 
-  strncpy (pData, pRTR_RTACTRL_ADDR254, 4);
-  status = RTRCFG_WrRegToStream ( vTxStreamItem+ port_config_cmd + 2, pRTR_RTACTRL_ADDR254, 0x000007F8);
+  unsigned long writesFailed = RMAPENG_Transfer(&rmapEngine, vWrites, writeCount);
+  RMAPENG_PrintReport(vWrites, writeCount);
+  if (writesFailed != 0){
+    puts("\nError: The router configuration was not acknowledged.");
+    STAR_closeChannel(testPortChannel);
+    STAR_closeChannel(testPortChannel2);
+    return 0;
+  }
 
-  strncpy (pData, pRTR_RTACTRL_PHY2, 4);  
-  status = RTRCFG_WrRegToStream ( vTxStreamItem+ port_config_cmd + 3, pRTR_RTACTRL_PHY2, 0x00000408);
+  //Allocate Memory for the test packets.
+  vTxStreamItem = calloc(txOp_itemCount, sizeof(STAR_STREAM_ITEM *));
+  if (!vTxStreamItem){
+    puts("\nError: Could not allocate memory for the packet array.");    
+    return 0;    
+  }
 
+  if (!PKTPOOL_InitWriteCommand(&loopPool, 1, 1, 1, 4)){
+    puts("\nError: Could not allocate memory for the command buffers.");
+    return 0;
+  }
+
+  uint32_t status;
 
   //Test packets.
+  memcpy (pData, pRTR_RTACTRL_PHY2, 4);
 
   // val_data = opCounter;
-  status = LoopBackPacketToStream ( (vTxStreamItem + port_config_cmd)+ 4 , 0x20, 0xFE, pData, reg_address);
+  status = LoopBackPacketToStream ( vTxStreamItem , 0x20, 0xFE, pData, reg_address);
   //val_data = opCounter + port_config_cmd;
-  status = LoopBackPacketToStream ( (vTxStreamItem + port_config_cmd)+ 5 , 0x21, 0xFE, pData, reg_address);
+  status |= LoopBackPacketToStream ( vTxStreamItem + 1 , 0x21, 0xFE, pData, reg_address);
+  if (status != 0){
+    printf("Error generating the Stream.");
+    return 0;
+  }
 
   printf("Stream Ready.\n");
 
@@ -232,7 +262,7 @@ int __cdecl  main(int argc, char * argv[]){
     }
 
   /* Submit the receive operation */
-  if (STAR_submitTransferOperation(testPortChannel2, pRxTransferOp) == 0)
+  if (OPTIME_Submit(&rxStamp, testPortChannel2, OPTIME_RX, pRxTransferOp) == 0)
     {
       printf("\nERROR occurred during receive.  Test Tfailed.\n");
       return 0;
@@ -246,7 +276,7 @@ int __cdecl  main(int argc, char * argv[]){
   /***************************************************************/
 
   /* Submit the transmit operation */
-  if (STAR_submitTransferOperation(testPortChannel, pTxTransferOp) == 0) {
+  if (OPTIME_Submit(&txStamp, testPortChannel, OPTIME_TX, pTxTransferOp) == 0) {
     printf("\nERROR occurred during transmit.  Test failed.\n");
     return 0;
   }
@@ -255,8 +285,7 @@ int __cdecl  main(int argc, char * argv[]){
   STAR_TRANSFER_STATUS rxStatus, txStatus;
 
   /* Wait on the transmit operation completing */
-  txStatus = STAR_waitOnTransferOperationCompletion(pTxTransferOp,
-						    STAR_INFINITE);
+  txStatus = OPTIME_Wait(&txStamp, pTxTransferOp, STAR_INFINITE);
   if(txStatus != STAR_TRANSFER_STATUS_COMPLETE) {
     printf("\nERROR occurred during transmit.  Test failed.\n");
     return 0;
@@ -264,8 +293,7 @@ int __cdecl  main(int argc, char * argv[]){
 
 
   /* Wait on the receive operation completing */
-  rxStatus = STAR_waitOnTransferOperationCompletion(pRxTransferOp,
-						    STAR_INFINITE);
+  rxStatus = OPTIME_Wait(&rxStamp, pRxTransferOp, STAR_INFINITE);
   if (rxStatus != STAR_TRANSFER_STATUS_COMPLETE)
     {
       printf("\nERROR occurred during receive.  Test failed.\n");
@@ -273,11 +301,16 @@ int __cdecl  main(int argc, char * argv[]){
     }
 
   printRxPackets((STAR_TRANSFER_OPERATION *)  pRxTransferOp);
+  OPTIME_Consumed(&rxStamp);
 
 
   //Free allocated resources
-  if (vTxStreamItem != NULL)
+  if (vTxStreamItem != NULL){
+    for (opCounter = 0; opCounter < txOp_itemCount; ++opCounter)
+      if (vTxStreamItem[opCounter] != NULL)
+	STAR_destroyStreamItem(vTxStreamItem[opCounter]);
     free(vTxStreamItem);
+  }
 
   if (pRxTransferOp != NULL)
     STAR_disposeTransferOperation(pRxTransferOp);
@@ -287,6 +320,9 @@ int __cdecl  main(int argc, char * argv[]){
     STAR_disposeTransferOperation(pTxTransferOp);
   }
 
+  PKTPOOL_PrintStats(&loopPool, "loopback");
+  PKTPOOL_Destroy(&loopPool);
+
   /* Close the channels */
   if (testPortChannel != 0U) {
     STAR_closeChannel(testPortChannel);
@@ -300,21 +336,11 @@ int __cdecl  main(int argc, char * argv[]){
 }
 
 
-void freePacketArray(void **packetArray, int count){
-  uint32_t opCounter = count;
-  while(opCounter > 0){
-    opCounter --;
-    free(packetArray[opCounter]);
-  }
-  free(packetArray);
-}
-
-
 //insert a Write Register Operation to the TxStream
 uint32_t LoopBackPacketToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t dst, uint8_t src, uint8_t *pValue, uint32_t reg_address){ 
 
-  void *pFillPacket;
-  unsigned long fillPacketLenCalculated, fillPacketLen;
+  U8 *pFillPacket;
+  unsigned long fillPacketLen;
 
   int status_link;
 
@@ -329,9 +355,7 @@ uint32_t LoopBackPacketToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t dst,
   //  pReply[1] = src;
 
   //Write operation of 4 bytes to update the value of a Register. 
-  fillPacketLenCalculated = RMAP_CalculateWriteCommandPacketLength(1, 1, 4,1);  
-
-  pFillPacket = malloc(fillPacketLenCalculated);
+  pFillPacket = PKTPOOL_Get(&loopPool);
   if (!pFillPacket){
     puts("Error: Could not allocate mem for the packet.");
     return 1;
@@ -340,25 +364,25 @@ uint32_t LoopBackPacketToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t dst,
   //FillWrPacket to reg_address
   status_link = RMAP_FillWriteCommandPacket(pTarget, 1, pReply, 1, 1, 0, 0, 0x00,
 					    0, reg_address, 0, pValue, 4, 
-					    &fillPacketLen, NULL, 1, (U8 *)pFillPacket,
-					    fillPacketLenCalculated);
+					    &fillPacketLen, NULL, 1, pFillPacket,
+					    loopPool.bufferSize);
   if (!status_link ){
     puts ("\bError: Could not fill the packet. ");
-    free(pFillPacket);
+    PKTPOOL_Put(&loopPool, pFillPacket);
     return 2;
   }
 
   // Create the packet to be transmitted
-  (*pTxStreamItem) = STAR_createPacket(NULL, (U8 *)pFillPacket, fillPacketLen,
+  (*pTxStreamItem) = STAR_createPacket(NULL, pFillPacket, fillPacketLen,
 					       STAR_EOP_TYPE_EOP);
 
-  if (pTxStreamItem == NULL){
+  if ((*pTxStreamItem) == NULL){
     puts("\nERROR: Unable to create the packet to be transmitted");
-    free(pFillPacket);
+    PKTPOOL_Put(&loopPool, pFillPacket);
     return 3;
   }
 
-  free(pFillPacket);
+  PKTPOOL_Put(&loopPool, pFillPacket);
   return 0;
 
 }
@@ -366,56 +390,6 @@ uint32_t LoopBackPacketToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t dst,
 
  
 
-//insert a Write Register Operation to the TxStream
-uint32_t RTRCFG_WrRegToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t *pValue, uint32_t reg_address){ 
-
-  void *pFillPacket;
-  unsigned long fillPacketLenCalculated, fillPacketLen;
-
-  int status_link;
-
-
-  //Mandatory: We should include the address to Port 0 and the Target logical address 0xFE.
-  U8 pTarget[]= {0,254};
-
-  //Replies on the same port.
-  U8 pReply[] = {254};
-
-  //Write operation of 4 bytes to update the value of a Register. 
-  fillPacketLenCalculated = RMAP_CalculateWriteCommandPacketLength(2, 1, 4,1);  
-
-  pFillPacket = malloc(fillPacketLenCalculated);
-  if (!pFillPacket){
-    puts("Error: Could not allocate mem for the packet.");
-    return 1;
-  }
-
-  //FillWrPacket to reg_address
-  status_link = RMAP_FillWriteCommandPacket(pTarget, 2, pReply, 1, 1, 0, 0, 0x00,
-					    0, reg_address, 0, pValue, 4, 
-					    &fillPacketLen, NULL, 1, (U8 *)pFillPacket,
-					    fillPacketLenCalculated);
-  if (!status_link ){
-    puts ("\bError: Could not fill the packet. ");
-    free(pFillPacket);
-    return 2;
-  }
-
-  // Create the packet to be transmitted
-  (*pTxStreamItem) = STAR_createPacket(NULL, (U8 *)pFillPacket, fillPacketLen,
-					       STAR_EOP_TYPE_EOP);
-
-  if (pTxStreamItem == NULL){
-    puts("\nERROR: Unable to create the packet to be transmitted");
-    free(pFillPacket);
-    return 3;
-  }
-
-  free(pFillPacket);
-  return 0;
-
-}
-
 void printPacket( STAR_SPACEWIRE_PACKET * StreamItemPacket){
     unsigned char* pTxStreamData = NULL;
     STAR_SPACEWIRE_ADDRESS *pStreamItemAddress = NULL;
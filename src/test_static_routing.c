@@ -22,6 +22,7 @@
 #include "cfg_api_mk2_types.h"
 //#include "cfg_api_brick_mk3.h"
 #include "rmap_packet_library.h"
+#include "rmap_engine.h"
 
 #define VERSION_INFO "LA Route v1.0"
 
@@ -39,8 +40,6 @@
 #define _ADDRESS_PATH 2
 #define _ADDRESS_PATH_SIZE 1
 
-uint32_t RTRCFG_WrRegToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t *pValue, uint32_t reg_address);
-
 int __cdecl  main(int argc, char * argv[]){
   STAR_DEVICE_ID* devices;
   STAR_DEVICE_ID deviceId;
@@ -119,117 +118,56 @@ int __cdecl  main(int argc, char * argv[]){
   /* The Read Commands data size is always 1 register each time,   */
   /* that is 4 byte per command.                                   */
   /*****************************************************************/
-  /*       Create the Transmit and Receive Operations              */
-  STAR_TRANSFER_OPERATION **pConfigRouterTransferOp = NULL;
-  STAR_TRANSFER_OPERATION *pTxTransferOp = NULL;
-  STAR_STREAM_ITEM **vTxStreamItem = NULL;
-  unsigned int txOp_itemCount = 0;
+  /*       Configure the router. Every write is acknowledged by    */
+  /*       the GR718 and checked, see rmap_engine.h.               */
+  U8 pTarget[] = {0, 254};
+  U8 pReply[] = {254};
+  RMAPENG rmapEngine;
+  RMAPENG_ACCESS vWrites[10];
+  uint32_t writeCount = 0;
 
-  unsigned long byteSize =  0;
-  
   U8 pData[] = {0x00, 0x14, 0x02, 0x2E};
 
-  uint32_t rtr_config_cmd = 12;
-  uint32_t port_config_cmd = 10;
-  txOp_itemCount = 0xA; // rtr_config_cmd + port_config_cmd;
-  
-  // Packet is pTarget 2 address and pReply 1. Use alignment.
-  uint32_t opCounter= 0;
-  uint32_t reg_address = 0;
-  uint32_t reg_base = 0x804;
-  uint32_t reg_byteSize = 0x4;
-
-  //Allocate Memory for TxStream Items
-  vTxStreamItem = malloc(txOp_itemCount * sizeof( STAR_STREAM_ITEM));
-  if (!vTxStreamItem){
-    puts("\nError: Could not allocate memory for the packet array.");    
-    return 0;    
-  }
-
-  uint32_t status;
-
   /**
    * Configures the Router 
    */
   //Packet 1: Enables IF1
-  reg_address = 0x804;
-  status = RTRCFG_WrRegToStream( vTxStreamItem, pData, reg_address);
+  RMAPENG_SetWrite(&vWrites[writeCount++], 0x804, pData);
   //Packet 2: Enables IF2
-  reg_address = 0x808;
-  status = RTRCFG_WrRegToStream( vTxStreamItem+1, pData, reg_address);
+  RMAPENG_SetWrite(&vWrites[writeCount++], 0x808, pData);
   //Packet 3: Enables IF3
-  reg_address = 0x80C;
-  status = RTRCFG_WrRegToStream( vTxStreamItem+2, pData, reg_address);
+  RMAPENG_SetWrite(&vWrites[writeCount++], 0x80C, pData);
   //Packet 4: Enables IF4
-  reg_address = 0x810;
-  status = RTRCFG_WrRegToStream( vTxStreamItem+3, pData, reg_address);
+  RMAPENG_SetWrite(&vWrites[writeCount++], 0x810, pData);
   //Packet 5: Enables IF5
-  reg_address = 0x814;
-  status = RTRCFG_WrRegToStream( vTxStreamItem+4, pData, reg_address);
+  RMAPENG_SetWrite(&vWrites[writeCount++], 0x814, pData);
   //Packet 6: Enables IF6
-  reg_address = 0x818;
-  status = RTRCFG_WrRegToStream( vTxStreamItem+5, pData, reg_address);
+  RMAPENG_SetWrite(&vWrites[writeCount++], 0x818, pData);
   //Packet 7: Enables IF7
-  reg_address = 0x81C;
-  status = RTRCFG_WrRegToStream( vTxStreamItem+6, pData, reg_address);
+  RMAPENG_SetWrite(&vWrites[writeCount++], 0x81C, pData);
   //Packet 8: Enables IF8
-  reg_address = 0x820;
-  status = RTRCFG_WrRegToStream( vTxStreamItem+7, pData, reg_address);
+  RMAPENG_SetWrite(&vWrites[writeCount++], 0x820, pData);
 
   //Packet 9: Routing table 0x21 (33) to IF1.
-  reg_address = 0x84;
   U8 rtrICU_data[] = {0x00, 0x00, 0x00, 0x02};
-  status = RTRCFG_WrRegToStream( vTxStreamItem+8, rtrICU_data, reg_address);
+  RMAPENG_SetWrite(&vWrites[writeCount++], 0x84, rtrICU_data);
   //Packet A: Routing table 0x21 Control.
-  reg_address = 0x484;
   U8 rtr2ICU_data[] = {0x00, 0x00, 0x00, 0x0C};
-  status = RTRCFG_WrRegToStream( vTxStreamItem+9, rtr2ICU_data, reg_address);
-
-  printf("Stream Ready.\n");
+  RMAPENG_SetWrite(&vWrites[writeCount++], 0x484, rtr2ICU_data);
 
-  /* Create the transmit transfer operation for the packet */
-  pTxTransferOp = STAR_createTxOperation(vTxStreamItem, txOp_itemCount);
-  if (pTxTransferOp == NULL)
-    {
-      puts("\nERROR: Unable to create the transfer operation to be transmitted");
-      return 0;
-    }
-  else{
-    printf("Tx operation created. \n");
+  if (!RMAPENG_Init(&rmapEngine, testPortChannel, testPortChannel,
+                    pTarget, sizeof(pTarget), pReply, sizeof(pReply))){
+    return 0;
   }
 
-
   /***************************************************************/
-  /*    Submit the operations                                    */
+  /*    Send the writes and wait for their replies               */
   /*                                                             */
   /***************************************************************/
-
-  /* Submit the transmit operation */
-  if (STAR_submitTransferOperation(testPortChannel, pTxTransferOp) == 0) {
-    printf("\nERROR occurred during transmit.  Test failed.\n");
-    return 0;
-  }
-
-  //Wait the operations to finish.
-  STAR_TRANSFER_STATUS rxStatus, txStatus;
-
-  /* Wait on the transmit operation completing */
-  txStatus = STAR_waitOnTransferOperationCompletion(pTxTransferOp,
-						    STAR_INFINITE);
-  if(txStatus != STAR_TRANSFER_STATUS_COMPLETE) {
-    printf("\nERROR occurred during transmit.  Test failed.\n");
-    return 0;
-  }
-
-  //Dispose the resources
-
-  //Free allocated resources
-  if (vTxStreamItem != NULL)
-    free(vTxStreamItem);
-
-  /* Dispose of the transfer operations */
-  if (pTxTransferOp != NULL) {
-    STAR_disposeTransferOperation(pTxTransferOp);
+  unsigned long writesFailed = RMAPENG_Transfer(&rmapEngine, vWrites, writeCount);
+  RMAPENG_PrintReport(vWrites, writeCount);
+  if (writesFailed != 0){
+    puts("\nError: The router configuration was not acknowledged.");
   }
 
   /* Close the channels */
@@ -237,57 +175,5 @@ int __cdecl  main(int argc, char * argv[]){
     STAR_closeChannel(testPortChannel);
   }
 
+  return writesFailed != 0;
 }
-
-
-
-//insert a Write Register Operation to the TxStream
-uint32_t RTRCFG_WrRegToStream (STAR_STREAM_ITEM **pTxStreamItem, uint8_t *pValue, uint32_t reg_address){ 
-
-  void *pFillPacket;
-  unsigned long fillPacketLenCalculated, fillPacketLen;
-
-  int status_link;
-
-
-  //Mandatory: We should include the address to Port 0 and the Target logical address 0xFE.
-  U8 pTarget[]= {0,254};
-
-  //Replies on the same port.
-  U8 pReply[] = {254};
-
-  //Write operation of 4 bytes to update the value of a Register. 
-  fillPacketLenCalculated = RMAP_CalculateWriteCommandPacketLength(2, 1, 4,1);  
-
-  pFillPacket = malloc(fillPacketLenCalculated);
-  if (!pFillPacket){
-    puts("Error: Could not allocate mem for the packet.");
-    return 1;
-  }
-
-  //FillWrPacket to reg_address
-  status_link = RMAP_FillWriteCommandPacket(pTarget, 2, pReply, 1, 1, 0, 0, 0x00,
-					    0, reg_address, 0, pValue, 4, 
-					    &fillPacketLen, NULL, 1, (U8 *)pFillPacket,
-					    fillPacketLenCalculated);
-  if (!status_link ){
-    puts ("\bError: Could not fill the packet. ");
-    free(pFillPacket);
-    return 2;
-  }
-
-  // Create the packet to be transmitted
-  (*pTxStreamItem) = STAR_createPacket(NULL, (U8 *)pFillPacket, fillPacketLen,
-					       STAR_EOP_TYPE_EOP);
-
-  if (pTxStreamItem == NULL){
-    puts("\nERROR: Unable to create the packet to be transmitted");
-    free(pFillPacket);
-    return 3;
-  }
-
-  free(pFillPacket);
-  return 0;
-
-}
-
@@ -2,9 +2,22 @@
   @file test_time_code.c
   @author Juan Manuel Gómez
   @brief Spacewire Test time code difusion for Plato GR718B
-  @details 
-  @param No parammeters needed.
-  @example ./timecode
+  @details A time-code master sends incrementing 6-bit time-codes from one
+           link every period, waking on absolute deadlines on a real-time
+           thread, while another link receives them through the router.
+           At the end it prints how late the master woke up and, for the
+           received codes, the period jitter, the missed codes and the
+           latency from the master.
+           With -a every other link of the Brick receives at once, one
+           thread each, which maps how long a code takes to reach each
+           router port cabled to the Brick.
+  @param period Period of the time-codes in microseconds (0x for hex).
+         -n codes to send (default 64, 0 = until Ctrl-C), -t master link
+         (default 1), -c receiving link (default 2), -a receive on all the
+         other links, -P SCHED_FIFO priority of the master (default 80,
+         0 = normal scheduling), -p pin the workers to CPUs.
+  @example ./timecode -n 1000 0x3E8
+  @example ./timecode -a -n 10000 1000
   @copyright jmgomez CSIC-IAA
 */
 
@@ -13,6 +26,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "system_config.h"
 #include "utility.h"
 #include "star-dundee_types.h"
@@ -22,6 +40,11 @@
 #include "cfg_api_mk2_types.h"
 //#include "cfg_api_brick_mk3.h"
 #include "rmap_packet_library.h"
+#include "rmap_crc.h"
+#include "rx_dispatch.h"
+#include "rx_stream.h"
+#include "lat_hist.h"
+#include "work_pool.h"
 
 #define VERSION_INFO "LA Route v1.0"
 
@@ -39,12 +62,38 @@
 #define _ADDRESS_PATH 2
 #define _ADDRESS_PATH_SIZE 1
 
-uint32_t GR718_ReadRegister(STAR_STREAM_ITEM **pTxStreamItem, uint32_t reg_addr);
-uint32_t processRxOperation(STAR_TRANSFER_OPERATION * const pTransferOp);
-uint32_t processPacket( STAR_SPACEWIRE_PACKET * streamItemPacket);
-uint32_t processRegister(STAR_SPACEWIRE_PACKET * streamItemPacket);
+#define _RX_QUEUE_ITEMS 16
+#define _RX_SLOT_LENGTH 1024
+#define _RX_DEPTH 8
+#define _RX_POLL_MS 100
 
+#define _TIMECODES 64
+#define _DEFAULT_CODES 64
+#define _DEFAULT_PRIORITY 80
+#define _MAX_LINKS 32
 
+uint32_t GR718_ReadRegister(STAR_STREAM_ITEM **pTxStreamItem, uint32_t reg_addr);
+uint32_t processRxOperation(RXDISP * const pDispatch,
+                            STAR_TRANSFER_OPERATION * const pTransferOp,
+                            const uint32_t link);
+uint32_t processPacket(const uint8_t * pStreamData, uint32_t streamDataSize);
+uint32_t processRegister(const uint8_t * pStreamData, uint32_t streamDataSize);
+
+/* Handlers of what the receive operations bring (rx_dispatch.h) */
+static int initDispatch(RXDISP * const pDispatch, void * const pContext);
+
+
+
+/* What a receiver saw, written by its time-code handler only */
+struct timecode_rx{
+  uint32_t received;
+  uint32_t missed;
+  uint32_t duplicated;
+  uint8_t lastCode;
+  unsigned long long lastNs;
+  LATHIST jitter;                           //|interval - periods elapsed|
+  LATHIST latency;                          //master submit -> received
+};
 
 //  pthread_attr_init(tinfo);
 struct thread_info{
@@ -56,184 +105,292 @@ struct thread_info{
   //For efficiency, it allows to access directly to the end.
   struct STAR_STREAM_ITEM *last;
 
+  //Master: SCHED_FIFO priority, 0 for none.
+  int priority;
+
+  //Receivers: their link, dispatcher and time-codes seen.
+  uint32_t link;
+  RXDISP dispatch;
+  struct timecode_rx rx;
 };
 
+/* What the master sent, read by the time-code handlers of every receiver */
+static struct{
+  unsigned long long periodNs;
+  uint32_t codes;                           //to send, 0 = until Ctrl-C
+  unsigned long long sentNs[_TIMECODES];    //last send of each value
+
+  //Master
+  uint32_t sent;
+  uint32_t overruns;                        //deadlines skipped
+  uint32_t txErrors;
+  LATHIST wakeLate;                         //deadline -> submit
+} tcLog;
+
+static volatile sig_atomic_t stopRequested;
+static int masterDone;                      //set by the master, read by every receiver
+
+static void requestStop(int signalNumber){
+  (void) signalNumber;
+  stopRequested = 1;
+}
+
+
+/* Sleep until a time of MonotonicTimeNs(), or until Ctrl-C */
+static void sleepUntil(const unsigned long long dueNs){
+  struct timespec due;
+
+  due.tv_sec = (time_t) (dueNs / 1000000000ULL);
+  due.tv_nsec = (long) (dueNs % 1000000000ULL);
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR &&
+         !stopRequested)
+    ;
+}
+
 
 /**
  *  @brief Transmit TimeCodes
+ *  @details One code every period, on absolute deadlines so that the time
+ *           spent sending does not add up. A router forwards only the code
+ *           following the last one, so the values go 1, 2, ... 63, 0, 1...
+ *           When a deadline is missed, the deadlines already past are
+ *           skipped and counted as overruns, and the next code waits for
+ *           the first deadline still ahead, keeping the period phase.
  */
-void *timecode_thread(void *arg)
+void timecode_job(void *arg)
 {
   struct thread_info *params;
-  const uint32_t number_of_timecodes = 1;
-
-  uint8_t g_currentTimecode = 0;
+  struct sched_param schedParam, workerParam;
+  int workerPolicy;
+  STAR_STREAM_ITEM *vTimeCodes[_TIMECODES];
+  STAR_TRANSFER_OPERATION *vTxOps[_TIMECODES];
+  STAR_TRANSFER_STATUS txStatus;
+  unsigned long long dueNs, nowNs, late;
+  uint32_t k, value;
 
   params = (struct thread_info *) arg;
 
-  /* Create a time-code */
-  STAR_STREAM_ITEM *timecode = STAR_createTimeCode(g_currentTimecode);
-
-  if (timecode)
-  {
+  //Real-time priority while the master runs, given back to the worker after.
+  pthread_getschedparam(pthread_self(), &workerPolicy, &workerParam);
+  if (params->priority > 0){
+    memset(&schedParam, 0, sizeof(schedParam));
+    schedParam.sched_priority = params->priority;
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &schedParam) != 0)
+      printf("Warning: no permission for SCHED_FIFO, the master runs with "
+             "normal priority.\n");
+  }
 
-    /* Create the transmit transfer operation for the packet */
-    STAR_TRANSFER_OPERATION *pTxTransferOp = STAR_createTxOperation(&timecode, number_of_timecodes);
-    if (pTxTransferOp == NULL)
-    {
-      puts("\nERROR: Unable to create the transfer operation to be transmitted");
-      pthread_exit( 0);
-    }
-    else{
-      printf("Tx operation created. \n");
-    }
-      
-    /***************************************************************/
-    /*    Submit the TX operations                                    */
-    /*                                                             */
-    /***************************************************************/
-    /* Submit the transmit operation */
-    if (STAR_submitTransferOperation(params->channelId, pTxTransferOp) == 0) {
-      printf("\nERROR occurred during submit.\nTest failed.\n");
-    //	return 0;
+  //An item and an operation per value, made before the first deadline.
+  memset(vTxOps, 0, sizeof(vTxOps));
+  for (value = 0; value < _TIMECODES; ++value){
+    vTimeCodes[value] = STAR_createTimeCode((U8) value);
+    if (vTimeCodes[value] != NULL)
+      vTxOps[value] = STAR_createTxOperation(&vTimeCodes[value], 1);
+    if (vTxOps[value] == NULL){
+      puts("\nERROR: Unable to create the time-code operations.");
+      tcLog.txErrors++;
+      goto cleanup;
     }
+  }
 
-    /* Wait on the transmit operation completing */
-    STAR_TRANSFER_STATUS  txStatus = STAR_waitOnTransferOperationCompletion(pTxTransferOp,
+  dueNs = MonotonicTimeNs() + tcLog.periodNs;
+  for (k = 0; (tcLog.codes == 0 || k < tcLog.codes) && !stopRequested; ++k){
+    value = (k + 1) % _TIMECODES;
+
+    sleepUntil(dueNs);
+    if (stopRequested)
+      break;
+    nowNs = MonotonicTimeNs();
+    LATHIST_Record(&tcLog.wakeLate, (nowNs > dueNs) ? nowNs - dueNs : 0);
+
+    __atomic_store_n(&tcLog.sentNs[value], nowNs, __ATOMIC_RELEASE);
+    if (STAR_submitTransferOperation(params->channelId, vTxOps[value]) == 0){
+      printf("\nERROR occurred during submit of time-code %u.\n", value);
+      tcLog.txErrors++;
+      break;
+    }
+    txStatus = STAR_waitOnTransferOperationCompletion(vTxOps[value],
                                                       STAR_INFINITE);
-
-    if(txStatus == STAR_TRANSFER_STATUS_COMPLETE) 
-    {
-      printf("Time-code %d transmitted successfully.\n", g_currentTimecode);
+    if (txStatus != STAR_TRANSFER_STATUS_COMPLETE){
+      printf("\nTimecode %u Transmission error.\n", value);
+      tcLog.txErrors++;
     }
-    else
-    {
-      printf("\nTimecode Transmission error.\n");
-      
+    tcLog.sent++;
+
+    dueNs += tcLog.periodNs;
+    nowNs = MonotonicTimeNs();
+    if (nowNs > dueNs){
+      late = (nowNs - dueNs) / tcLog.periodNs + 1;
+      tcLog.overruns += (uint32_t) late;
+      dueNs += late * tcLog.periodNs;
     }
+  }
 
-    /* Dispose of transfer operation */
-    STAR_disposeTransferOperation(pTxTransferOp);
-    
-    /* Destroy time-code */
-    STAR_destroyStreamItem(timecode);    
+ cleanup:
+  for (value = 0; value < _TIMECODES; ++value){
+    if (vTxOps[value] != NULL)
+      STAR_disposeTransferOperation(vTxOps[value]);
+    if (vTimeCodes[value] != NULL)
+      STAR_destroyStreamItem(vTimeCodes[value]);
   }
 
-  //  pthread_exit(0);
+  //The last codes are still on their way to the receiver.
+  sleepUntil(MonotonicTimeNs() + 2 * tcLog.periodNs + 100000000ULL);
+  __atomic_store_n(&masterDone, 1, __ATOMIC_RELEASE);
+  pthread_setschedparam(pthread_self(), workerPolicy, &workerParam);
+
   printf ("End of Thread TX.\n");
-  return 0;
 }
 
-void *rx_thread(void *arg)
+
+/**
+ *  @brief Receive operations of a link through the dispatcher, until the
+ *         master is done.
+ */
+void rx_job(void *arg)
 {
-  struct thread_info params;
-  STAR_STREAM_ITEM * pRxStreamItem;
-  STAR_TRANSFER_OPERATION *pRxTransferOp = NULL;
-  const uint32_t number_of_items = 1;
-  uint32_t packetReceived = 0, i;
+  //main keeps the params, where the handlers write, until the pool is idle.
+  struct thread_info *params = (struct thread_info *) arg;
+  STAR_TRANSFER_OPERATION *pRxTransferOp;
   STAR_TRANSFER_STATUS rxStatus;
+  RXSTREAM stream;
 
-  packetReceived = 0;
-  while(packetReceived < 20)
-  {
-    //It should be safer to reserve space for the params and do a copy. This avoid 
-    //memory corruption in case the thread creator, frees the memory of the parammeters.
-    params.channelId = ((struct thread_info *) arg)->channelId;
+  //Several operations of one item in flight: each code completes its own.
+  if (!RXSTREAM_Open(&stream, params->channelId, _RX_DEPTH, 1)){
+    printf("[RXThread] : Error, unable to create receive operations.\n");
+    __atomic_store_n(&masterDone, 1, __ATOMIC_RELEASE);
+    return;
+  }
 
-    // Create an RX operation to receive the Packet on port 1.
-    pRxTransferOp = STAR_createRxOperation(number_of_items , STAR_RECEIVE_PACKETS);
+  while (!__atomic_load_n(&masterDone, __ATOMIC_ACQUIRE))
+  {
+    pRxTransferOp = RXSTREAM_Next(&stream, _RX_POLL_MS, &rxStatus);
     if (pRxTransferOp == NULL)
     {
-      printf("[RXThread] : Error, unable to create receive operation.\n");
-      pthread_exit(0);
+      if (rxStatus == STAR_TRANSFER_STATUS_STARTED)
+        continue;
+      printf("\nERROR occurred during receive.  Test failed.\n");
+      break;
     }
 
-    /* Submit the receive operation */
-    if (STAR_submitTransferOperation( params.channelId, pRxTransferOp) == 0)
+    //Packets and time-codes, each to its handler.
+    processRxOperation(&params->dispatch, pRxTransferOp, params->link);
+    if (!RXSTREAM_Recycle(&stream))
     {
       printf("\nERROR occurred during receive.  Test failed.\n");
-      pthread_exit(0);
+      break;
     }
+  }
 
-    //    printf ("RX opReady.\n");
+  RXSTREAM_Close(&stream);
 
-    /* Wait on the receive operation completing */
+  printf("End of thread RX on link %u.\n", params->link);
+}
 
-    while(!packetReceived)
-    {
-      rxStatus = STAR_waitOnTransferOperationCompletion(pRxTransferOp,
-							STAR_INFINITE);
-      if (rxStatus != STAR_TRANSFER_STATUS_COMPLETE)
-      {
-        printf("\nERROR occurred during receive.  Test failed.\n");
-        return 0;
-      }
-      else
-      {
-        packetReceived ++;	  
-        printf("Packet %d Received.\n", packetReceived);
-      }
-    }
 
-    //  processRxOperation( pRxTransferOp);
-    packetReceived = STAR_getTransferItemCount(pRxTransferOp);
-    if (packetReceived != 0 )
-    {
-      for(i=0; i< packetReceived; ++i)
-      {
-        //Get element index i on the STREAM ITEM.
-        pRxStreamItem = STAR_getTransferItem (pRxTransferOp, i);
-        if (pRxStreamItem != NULL && pRxStreamItem->item != NULL &&
-            pRxStreamItem->itemType == STAR_STREAM_ITEM_TYPE_SPACEWIRE_PACKET)
-        {
-          //Add to file instead of printf.
-          processPacket( pRxStreamItem->item);
-        }
-      }
-    }
+/* What the master and the receivers measured, one block per link */
+static void printTimeCodeReport(const struct thread_info * const vReceivers,
+                                const uint32_t receivers){
+  const struct timecode_rx *pRx;
+  unsigned long long p50, fastest = ~0ULL, slowest = 0;
+  char name[40];
+  uint32_t i;
 
+  printf("\nTime-codes sent: %u every %.1f us, %u deadlines skipped, "
+         "%u transmit errors.\n", tcLog.sent, tcLog.periodNs / 1e3,
+         tcLog.overruns, tcLog.txErrors);
+  for (i = 0; i < receivers; ++i){
+    pRx = &vReceivers[i].rx;
+    printf("Time-codes received on link %u: %u, %u missed, %u duplicated.\n",
+           vReceivers[i].link, pRx->received, pRx->missed, pRx->duplicated);
   }
 
-  if (pRxTransferOp != NULL)
-    STAR_disposeTransferOperation(pRxTransferOp);
+  LATHIST_PrintHeader(stdout, "Time-codes");
+  LATHIST_Print(stdout, &tcLog.wakeLate, "master wake-up late");
+  for (i = 0; i < receivers; ++i){
+    pRx = &vReceivers[i].rx;
+    snprintf(name, sizeof(name), "link %u period jitter", vReceivers[i].link);
+    LATHIST_Print(stdout, &pRx->jitter, name);
+    snprintf(name, sizeof(name), "link %u latency", vReceivers[i].link);
+    LATHIST_Print(stdout, &pRx->latency, name);
+
+    if (LATHIST_Count(&pRx->latency) > 0){
+      p50 = LATHIST_Percentile(&pRx->latency, 0.50);
+      fastest = MIN(fastest, p50);
+      slowest = MAX(slowest, p50);
+    }
+  }
 
-  //  pthread_exit(0);
-  printf("End of thread RX.\n");
-  
-  return 0;
+  //How far apart the ports see the same tick.
+  if (receivers > 1 && slowest >= fastest)
+    printf("Median latency skew between links: %.2f us.\n",
+           (slowest - fastest) / 1e3);
 }
 
+
 int __cdecl  main(int argc, char * argv[]){
   STAR_DEVICE_ID* devices;
   STAR_DEVICE_ID deviceId;
   unsigned int deviceCount;
-
-  const uint32_t threads_nr = 0;
-  const uint32_t max_threads_nr = 16;
-  pthread_t threads[max_threads_nr];
-
-
-  if (argc < 2)
-    {
-      printf ("Usage: ./%s period.\n", argv[0]);
-      printf ("period: Period of the timecode in hexadecimal, beginning with 0x.\n");
-      //      return 0;
+  uint32_t masterLink = _SPW1_INTERFACE, rxLink = _SPW2_INTERFACE;
+  struct thread_info *vReceivers, *pReceiver;
+  uint32_t receivers = 0, link, i;
+  int priority = _DEFAULT_PRIORITY, allLinks = 0, pin = 0, failed;
+  WPOOL workPool;
+  unsigned long periodUs;
+  struct sigaction action;
+  char *pEnd;
+  int opt;
+
+  tcLog.codes = _DEFAULT_CODES;
+  while ((opt = getopt(argc, argv, "n:t:c:aP:p")) != -1){
+    switch (opt){
+    case 'n':
+      tcLog.codes = strtoul(optarg, NULL, 0);
+      break;
+    case 't':
+      masterLink = strtoul(optarg, NULL, 0);
+      break;
+    case 'c':
+      rxLink = strtoul(optarg, NULL, 0);
+      break;
+    case 'a':
+      allLinks = 1;
+      break;
+    case 'P':
+      priority = atoi(optarg);
+      break;
+    case 'p':
+      pin = 1;
+      break;
+    default:
+      optind = argc + 1;
+    }
   }
-  else
-  {
 
-    char address[] = {0x00, 0x00, 0x00, 0x00};
-    //Use "0x" to define the base of the number.
-    if (strncmp(argv[1], "0x",2) != 0)
+  if (optind != argc - 1)
     {
-      printf("Usage: ./%s address.\n", argv[1]);
-      printf("The address should be in hexadecimal. 0xFFFFFFFF.");
+      printf ("Usage: ./%s [-n codes] [-t link] [-c link | -a] [-P priority] [-p] period.\n", argv[0]);
+      printf ("period: Period of the timecode in microseconds, 0x for hexadecimal.\n");
       return 0;
-    }
-    uint32_t reg_address = strtoul(argv[1], NULL, 16);
-    printf ("Proceed to read 0x%x : .\n", reg_address);
   }
 
+  periodUs = strtoul(argv[optind], &pEnd, 0);
+  if (*pEnd != '\0' || periodUs == 0 || (!allLinks && masterLink == rxLink) ||
+      masterLink < 1 || masterLink >= _MAX_LINKS ||
+      rxLink < 1 || rxLink >= _MAX_LINKS ||
+      priority < 0 || priority > sched_get_priority_max(SCHED_FIFO)){
+    printf("Error: Invalid period, links or priority.\n");
+    return 0;
+  }
+  tcLog.periodNs = periodUs * 1000ULL;
+  if (allLinks)
+    printf ("Time-code master on link %u every %lu us, received on every "
+            "other link.\n", masterLink, periodUs);
+  else
+    printf ("Time-code master on link %u every %lu us, received on link %u.\n",
+            masterLink, periodUs, rxLink);
+
   //Initialize
   devices = STAR_getDeviceListForType(STAR_DEVICE_TXRX_SUPPORTED, & deviceCount);
   if (devices == NULL){
@@ -263,18 +420,18 @@ int __cdecl  main(int argc, char * argv[]){
 
   STAR_CHANNEL_MASK channelMask;
   channelMask = STAR_getDeviceChannels(deviceId);
-  if ( channelMask != 7U){
-    puts("\nError: Almost one interface is required.");
+  if ((channelMask & (1U << masterLink)) == 0 ||
+      (!allLinks && (channelMask & (1U << rxLink)) == 0)){
+    puts("\nError: The device has not the links requested.");
     return 0;
   }
 
   /***************************************************************/
   /*        Configurate Baudrate                                 */
   /*                                                             */
-  /* Channel 1 = Transmit interface                              */
-  /*
+  /* Master link = Transmit interface                            */
+  /*                                                             */
   /* BaudRate  = 100 Mbps (100*2/4)*2                            */
-  /* Packet Size = 1 KB                                          */
   /***************************************************************/
   STAR_CHANNEL_ID testPortChannel;
   STAR_CFG_MK2_BASE_TRANSMIT_CLOCK clockRateParams; 
@@ -283,18 +440,54 @@ int __cdecl  main(int argc, char * argv[]){
   clockRateParams.multiplier = _TX_BAUDRATE_MUL;
   clockRateParams.divisor = _TX_BAUDRATE_DIV;
 
-  status_link = CFG_BRICK_MK3_setBaseTransmitClock(deviceId, _SPW1_INTERFACE, clockRateParams);
+  status_link = CFG_BRICK_MK3_setBaseTransmitClock(deviceId, masterLink, clockRateParams);
   if ( status_link == 0){
     puts("\nError: Could not configure baudrate.");
     return 0;
   }
   
-  testPortChannel = STAR_openChannelToLocalDevice(deviceId, STAR_CHANNEL_DIRECTION_INOUT, _SPW1_INTERFACE, TRUE);
+  testPortChannel = STAR_openChannelToLocalDevice(deviceId, STAR_CHANNEL_DIRECTION_INOUT, masterLink, TRUE);
   if(testPortChannel == 0){
     puts("\nError : Unable to open the Channel.");
+    return 0;
   }
 
-  puts("\nChannel Spw 1 Opened and ready to communicate.  ");
+  //A receiver per link listening, each with its own dispatcher.
+  vReceivers = calloc(_MAX_LINKS, sizeof(struct thread_info));
+  if (vReceivers == NULL){
+    puts("\nError: Could not allocate memory for the receivers.");
+    return 0;
+  }
+  for (link = 1; link < _MAX_LINKS; ++link){
+    if ((channelMask & (1U << link)) == 0 || link == masterLink ||
+        (!allLinks && link != rxLink))
+      continue;
+
+    pReceiver = &vReceivers[receivers++];
+    pReceiver->link = link;
+    snprintf(pReceiver->threadName, sizeof(pReceiver->threadName),
+             "Receiv%u", link);
+    LATHIST_Reset(&pReceiver->rx.jitter);
+    LATHIST_Reset(&pReceiver->rx.latency);
+    if (!initDispatch(&pReceiver->dispatch, pReceiver)){
+      puts("\nError: Could not allocate memory for the receive queues.");
+      return 0;
+    }
+    pReceiver->channelId = STAR_openChannelToLocalDevice(deviceId, STAR_CHANNEL_DIRECTION_INOUT, link, TRUE);
+    if (pReceiver->channelId == 0){
+      printf("\nError : Unable to open the Channel of link %u.\n", link);
+      return 0;
+    }
+  }
+  if (receivers == 0){
+    puts("\nError: No other link to receive on.");
+    return 0;
+  }
+
+  printf("\nChannels Spw %u and", masterLink);
+  for (i = 0; i < receivers; ++i)
+    printf(" %u", vReceivers[i].link);
+  puts(" Opened and ready to communicate.  ");
   puts("\n************************************************\n");
 
   /* Enable the device as a time-code master */
@@ -306,75 +499,73 @@ int __cdecl  main(int argc, char * argv[]){
   {
     puts("Error enabling device as a time-code master");
   }
-  /*****************************************************************/
-  /*    Allocate memory for the transmit buffer and construct      */
-  /*    the packet to transmit.                                    */
-  /*****************************************************************/
-  /*                                                               */
-  /* We should read the regiters of the GR718B. We should transmit */
-  /* RMAP Read Commands to GR718 Port 0.                           */
-  /* The Read Commands data size is always 1 register each time,   */
-  /* that is 4 byte per command.                                   */
-  /*****************************************************************/
-
-  struct thread_info timecode_params, tinfo;
-  pthread_attr_t attr;
-  uint32_t thread_status;
-
-  //main should wait for threads before free resources, closing channel.
-  pthread_attr_init(&attr);
-  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
-
-  //Lets create a Trhead to manage the RX operations.
-  tinfo.channelId = testPortChannel;
-  strcpy(tinfo.threadName, "Receiv");
-  
+
+  struct thread_info timecode_params;
+
   timecode_params.channelId = testPortChannel;
+  timecode_params.priority = priority;
   strcpy (timecode_params.threadName, "TimeCodeMaster");
 
-  thread_status = pthread_create(& (tinfo.threadId), &attr, 
-				  rx_thread, (void *) & tinfo);
-  if (thread_status){
-    printf("Error createing the RX thread.\n");
+  LATHIST_Reset(&tcLog.wakeLate);
+
+  //Page faults would delay the master as much as the scheduler.
+  if (priority > 0 && mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    printf("Warning: could not lock the memory (%s).\n", strerror(errno));
+
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = requestStop;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  //A worker per receiver and one for the master: they all run at once.
+  if (WPOOL_Open(&workPool, receivers + 1, pin) == 0){
+    printf("Error creating the workers.\n");
+    return 0;
+  }
+  for (i = 0; i < receivers; ++i)
+    if (!WPOOL_Submit(&workPool, i, rx_job, (void *) & vReceivers[i]))
+      break;
+  if (i < receivers ||
+      !WPOOL_Submit(&workPool, receivers, timecode_job, (void *) &timecode_params)){
+    printf("Error queueing the jobs.\n");
+    //No master: the receivers queued would wait for it forever.
+    __atomic_store_n(&masterDone, 1, __ATOMIC_RELEASE);
+    WPOOL_Wait(&workPool);
+    WPOOL_Close(&workPool);
     return 0;
   }
 
-  thread_status = pthread_create(& timecode_params.threadId, &attr, 
-				 timecode_thread,(void *) &timecode_params);
-  if (thread_status)
-    {
-      printf("Error creating TX thread.\n");
-    }
+  printf ("Jobs queued.\n");
 
-  printf ("Threads create.\n");
+  WPOOL_Wait(&workPool);
 
-  void *st;
-  pthread_join(timecode_params.threadId, NULL);
-  pthread_join(tinfo.threadId, NULL);
+  printf("End of jobs.\n\n");
 
-  printf("End of threads.\n\n");
+  WPOOL_PrintReport(&workPool);
+  WPOOL_Close(&workPool);
+  printTimeCodeReport(vReceivers, receivers);
 
   /* Close the channels */
   if (testPortChannel != 0U) {
     STAR_closeChannel(testPortChannel);
   }
+  failed = tcLog.txErrors != 0;
+  for (i = 0; i < receivers; ++i){
+    STAR_closeChannel(vReceivers[i].channelId);
+    RXDISP_Free(&vReceivers[i].dispatch);
+    failed |= vReceivers[i].rx.received == 0;
+  }
+  free(vReceivers);
   //    pthread_exit(NULL);
-    exit(0);
+  exit(failed);
 
 }
 
-uint32_t processPacket( STAR_SPACEWIRE_PACKET * streamItemPacket){
-  uint8_t *pStreamData = NULL;
-  STAR_SPACEWIRE_ADDRESS *pStreamItemAddress = NULL;
-  uint32_t streamDataSize = 0;
+uint32_t processPacket(const uint8_t * pStreamData, uint32_t streamDataSize){
   uint32_t i;
 
-  pStreamData = STAR_getPacketData( (STAR_SPACEWIRE_PACKET *) streamItemPacket,
-				     &streamDataSize);	
-
-  
-  pStreamItemAddress = STAR_getPacketAddress ( (STAR_SPACEWIRE_PACKET *) streamItemPacket);
-
+  //Received packets do not carry an address path, only the data is printed.
   for (i=0; i<streamDataSize; ++i)
     {
       printf( "\t0x%x" ,pStreamData[i]);
@@ -383,27 +574,26 @@ uint32_t processPacket( STAR_SPACEWIRE_PACKET * streamItemPacket){
 	  printf("\n");
 	}
     }
-
-  printf("\n");
-
-  STAR_destroyAddress(pStreamItemAddress);
-  STAR_destroyPacketData(pStreamData);
   
   return 0;
 }
 
 
-uint32_t processRegister(STAR_SPACEWIRE_PACKET * streamItemPacket){
-  uint8_t *pStreamData = NULL;
-  STAR_SPACEWIRE_ADDRESS * pStreamItemAddress = NULL;
-  uint32_t streamDataSize = 0;
-  
+uint32_t processRegister(const uint8_t * pStreamData, uint32_t streamDataSize){
   uint32_t reg_value  = 0xA5A5A5A5;
-  uint8_t *pReg_value = &reg_value;
-  uint8_t *pRplyData;
+  uint8_t *pReg_value = (uint8_t *) &reg_value;
+  const uint8_t *pRplyData;
 
-  pStreamData = STAR_getPacketData( (STAR_SPACEWIRE_PACKET *) streamItemPacket, 
-				    & streamDataSize);
+  //The reply carries 4 data bytes followed by the data CRC.
+  if (streamDataSize < 5){
+    printf ("Reply too short to hold a register: %u bytes.\n", streamDataSize);
+    return reg_value;
+  }
+
+  //The CRC of the data followed by its CRC is 0.
+  if (RMAPCRC_Calculate(pStreamData + (streamDataSize - 5), 5) != 0){
+    printf ("Data CRC error in the reply.\n");
+  }
 
   //  memcpy (& reg_value, pStreamData+(streamDataSize - (4 +1)), 4);
  
@@ -422,43 +612,89 @@ uint32_t processRegister(STAR_SPACEWIRE_PACKET * streamItemPacket){
 }
 
 
-uint32_t processRxOperation(STAR_TRANSFER_OPERATION * const pTransferOp)
+//Handlers of the items of a receive operation, by type.
+static void onPacket(const RXDISP_EVENT * const pEvent, void * const pContext)
 {
-  uint32_t i, j, k;
-  STAR_STREAM_ITEM *pRxStreamItem;
-  
-  uint32_t rxPacketCount;
-  rxPacketCount = STAR_getTransferItemCount(pTransferOp);
-  if (rxPacketCount != 0 )
+  (void) pContext;
+  if (pEvent->pData != NULL)
     {
-      for(i=0; i< rxPacketCount; ++i)
-	{
-	  //Get element index i on the STREAM ITEM.
-	  pRxStreamItem = STAR_getTransferItem (pTransferOp, i);
-	  if (pRxStreamItem != NULL && pRxStreamItem->item != NULL )
-	    {
-	      switch ( pRxStreamItem->itemType )
-		{
-		case STAR_STREAM_ITEM_TYPE_SPACEWIRE_PACKET:
-		  printf("SpaceWire Packet Received.\n");
-		  //processPacket((STAR_SPACEWIRE_PACKET *) pRxStreamItem->item);		  
-		  processRegister( pRxStreamItem->item);
-		  break;
-		case STAR_STREAM_ITEM_TYPE_TIMECODE:
-		  printf("Time Code Received.\n");
-		  break;
-		case STAR_STREAM_ITEM_TYPE_LINK_STATE_EVENT:
-		  printf("Link State Event Received.\n");
-		  break;
-		case STAR_STREAM_ITEM_TYPE_DATA_CHUNK: 
-		  printf("Spacewire Data Chunk Received.\n");
-		  break;
-		deafult:
-		  printf("Unrecognized packet type.\n");
-		}
-	    }
-	}
+      printf("SpaceWire Packet Received.\n");
+      processRegister(pEvent->pData, pEvent->length);
+    }
+}
+
+//Each code against the previous one received and against its send time.
+static void onTimeCode(const RXDISP_EVENT * const pEvent, void * const pContext)
+{
+  struct timecode_rx * const pRx = &((struct thread_info *) pContext)->rx;
+  const uint8_t code = pEvent->timeCode % _TIMECODES;
+  const unsigned long long rxNs = pEvent->routedNs;
+  unsigned long long sentNs, expectedNs;
+  uint32_t step;
+
+  //A send time is that of this code only if it is recent: values repeat.
+  sentNs = __atomic_load_n(&tcLog.sentNs[code], __ATOMIC_ACQUIRE);
+  if (sentNs != 0 && rxNs >= sentNs &&
+      rxNs - sentNs < (_TIMECODES / 2) * tcLog.periodNs)
+    LATHIST_Record(&pRx->latency, rxNs - sentNs);
+
+  if (pRx->received > 0){
+    step = (uint32_t) (code + _TIMECODES - pRx->lastCode) % _TIMECODES;
+    if (step == 0){
+      pRx->duplicated++;
+      return;
     }
+    pRx->missed += step - 1;
+    expectedNs = step * tcLog.periodNs;
+    LATHIST_Record(&pRx->jitter, (rxNs - pRx->lastNs > expectedNs) ?
+                   rxNs - pRx->lastNs - expectedNs :
+                   expectedNs - (rxNs - pRx->lastNs));
+  }
+  pRx->received++;
+  pRx->lastCode = code;
+  pRx->lastNs = rxNs;
+}
+
+static void onOther(const RXDISP_EVENT * const pEvent, void * const pContext)
+{
+  (void) pContext;
+  if (pEvent->type == RXDISP_LINK_EVENT)
+    printf("Link %u State Event Received, state %u.\n", pEvent->link,
+           pEvent->linkState);
+  else if (pEvent->type == RXDISP_DATA_CHUNK)
+    printf("Spacewire Data Chunk Received.\n");
+  else
+    printf("Unrecognized packet type.\n");
+}
+
+//The time-codes go to the timecode_rx of the receiver in pContext.
+static int initDispatch(RXDISP * const pDispatch, void * const pContext)
+{
+  int type;
+
+  RXDISP_Init(pDispatch);
+  if (!RXDISP_Register(pDispatch, RXDISP_PACKET, onPacket, NULL,
+                       _RX_QUEUE_ITEMS, _RX_SLOT_LENGTH) ||
+      !RXDISP_Register(pDispatch, RXDISP_TIMECODE, onTimeCode, pContext,
+                       _RX_QUEUE_ITEMS, 0))
+    return 0;
+  for (type = RXDISP_LINK_EVENT; type < RXDISP_TYPES; ++type)
+    if (!RXDISP_Register(pDispatch, type, onOther, NULL, _RX_QUEUE_ITEMS, 0))
+      return 0;
+
+  return 1;
+}
+
+
+uint32_t processRxOperation(RXDISP * const pDispatch,
+                            STAR_TRANSFER_OPERATION * const pTransferOp,
+                            const uint32_t link)
+{
+  uint32_t rxPacketCount;
+
+  //Every item to the handler of its type, in this same thread.
+  rxPacketCount = RXDISP_Route(pDispatch, pTransferOp, (U8) link);
+  RXDISP_PollAll(pDispatch);
 
   return rxPacketCount;
 }
@@ -499,6 +735,7 @@ uint32_t GR718_ReadRegister(STAR_STREAM_ITEM **pTxStreamItem, uint32_t reg_addr)
   /* Create the packet to be transmitted */
   (*pTxStreamItem) = STAR_createPacket(NULL, (U8 *)pFillPacket, fillPacketLen,
 				    STAR_EOP_TYPE_EOP);
+  free(pFillPacket);
 
   if ( (*pTxStreamItem) == NULL )
     {
@@ -0,0 +1,254 @@
+/*
+  @file traffic_gen.c
+  @author Juan Manuel Gómez
+  @brief Token bucket pacing of the packets of a traffic generator.
+  @details See traffic_gen.h.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "traffic_gen.h"
+
+/* Tokens short of a packet that still pay for it, rounding of the sums */
+#define TGEN_EPSILON 1e-9
+
+
+/* An exponential interval, in nanoseconds, of mean one packet */
+static double TGEN_exponential(TGEN_PACER * const pPacer)
+{
+    const double u = ((double)(PATGEN_Next(&pPacer->random) >> 11) + 0.5) *
+        (1.0 / 9007199254740992.0);
+
+    return -log(u) * pPacer->cost / pPacer->tokensPerNs;
+}
+
+
+/* Tokens accrued up to now, the bucket never above its capacity */
+static void TGEN_refill(TGEN_PACER * const pPacer,
+    const unsigned long long nowNs)
+{
+    if (nowNs <= pPacer->lastNs)
+    {
+        return;
+    }
+
+    if (pPacer->profile == TGEN_POISSON)
+    {
+        while (pPacer->nextTokenNs <= nowNs)
+        {
+            if (pPacer->tokens + pPacer->cost >
+                pPacer->capacity + TGEN_EPSILON)
+            {
+                /* Full: the tokens of the gap are lost, start again */
+                pPacer->nextTokenNs = nowNs +
+                    (unsigned long long)TGEN_exponential(pPacer);
+                break;
+            }
+            pPacer->tokens += pPacer->cost;
+            pPacer->nextTokenNs += (unsigned long long)TGEN_exponential(pPacer);
+        }
+    }
+    else
+    {
+        pPacer->tokens += (nowNs - pPacer->lastNs) * pPacer->tokensPerNs;
+        if (pPacer->tokens > pPacer->capacity)
+        {
+            pPacer->tokens = pPacer->capacity;
+        }
+    }
+    pPacer->lastNs = nowNs;
+}
+
+
+
+/**
+ * Initialise a pacer.
+ *
+ * @param pPacer the pacer
+ * @param profile TGEN_CONSTANT, TGEN_BURST or TGEN_POISSON
+ * @param unit TGEN_BITS or TGEN_PACKETS, the unit of the rate
+ * @param rate the rate, in bits or packets per second
+ * @param packetSize the bytes of data of a packet
+ * @param burst the packets of a burst, or the least the bucket holds
+ * @param seed the seed of the Poisson intervals
+ * @param nowNs the current time, MonotonicTimeNs()
+ *
+ * @return 1 on success, 0 if a parameter is out of range
+ */
+int TGEN_Init(TGEN_PACER * const pPacer, const int profile, const int unit,
+    const double rate, const unsigned int packetSize,
+    const unsigned int burst, const uint64_t seed,
+    const unsigned long long nowNs)
+{
+    memset(pPacer, 0, sizeof(TGEN_PACER));
+    if ((profile < TGEN_CONSTANT) || (profile > TGEN_POISSON) ||
+        !(rate > 0.0) || (packetSize == 0U) || (burst == 0U))
+    {
+        puts("TGEN_Init: The profile, rate, packet size or burst is wrong");
+        return 0;
+    }
+
+    pPacer->profile = profile;
+    pPacer->burst = burst;
+    pPacer->cost = (unit == TGEN_BITS) ? packetSize * 8.0 : 1.0;
+    pPacer->tokensPerNs = rate / 1e9;
+    pPacer->capacity = pPacer->cost * burst;
+    if (profile == TGEN_BURST)
+    {
+        /* The tokens past a full bucket go to the next burst */
+        pPacer->capacity += pPacer->tokensPerNs * TGEN_MAX_SLEEP_NS;
+    }
+    else if (pPacer->capacity < pPacer->tokensPerNs * TGEN_MAX_SLEEP_NS)
+    {
+        pPacer->capacity = pPacer->tokensPerNs * TGEN_MAX_SLEEP_NS;
+    }
+    pPacer->lastNs = nowNs;
+    PATGEN_Seed(&pPacer->random, seed);
+
+    /* A constant stream starts with its first packet, a burst once the
+     * bucket has filled, a Poisson one at its first arrival */
+    if (profile == TGEN_CONSTANT)
+    {
+        pPacer->tokens = pPacer->cost;
+    }
+    else if (profile == TGEN_POISSON)
+    {
+        pPacer->nextTokenNs = nowNs +
+            (unsigned long long)TGEN_exponential(pPacer);
+    }
+
+    return 1;
+}
+
+
+
+/**
+ * Take the packets that may leave now.
+ *
+ * @param pPacer the pacer
+ * @param nowNs the current time
+ * @param most the most packets the caller takes at once
+ *
+ * @return the packets to send now, 0 to `most`
+ */
+unsigned int TGEN_Take(TGEN_PACER * const pPacer,
+    const unsigned long long nowNs, const unsigned int most)
+{
+    unsigned int count;
+    double paid;
+
+    TGEN_refill(pPacer, nowNs);
+
+    if (pPacer->profile == TGEN_BURST)
+    {
+        if ((pPacer->pending == 0U) &&
+            (pPacer->tokens + TGEN_EPSILON >= pPacer->cost * pPacer->burst))
+        {
+            pPacer->pending = pPacer->burst;
+            pPacer->tokens -= pPacer->cost * pPacer->burst;
+            if (pPacer->tokens < 0.0)
+            {
+                pPacer->tokens = 0.0;
+            }
+        }
+        count = (pPacer->pending < most) ? pPacer->pending : most;
+        pPacer->pending -= count;
+        return count;
+    }
+
+    paid = floor(pPacer->tokens / pPacer->cost + TGEN_EPSILON);
+    count = (paid < (double)most) ? (unsigned int)paid : most;
+    pPacer->tokens -= count * pPacer->cost;
+    if (pPacer->tokens < 0.0)
+    {
+        pPacer->tokens = 0.0;
+    }
+
+    return count;
+}
+
+
+
+/**
+ * When TGEN_Take() will let the next packet leave, if no packet is taken
+ * meanwhile.
+ *
+ * @return a time, nowNs if a packet may leave already
+ */
+unsigned long long TGEN_NextNs(const TGEN_PACER * const pPacer,
+    const unsigned long long nowNs)
+{
+    unsigned long long readyNs;
+    double missing;
+
+    if (pPacer->profile == TGEN_BURST)
+    {
+        if (pPacer->pending != 0U)
+        {
+            return nowNs;
+        }
+        missing = pPacer->cost * pPacer->burst - pPacer->tokens;
+    }
+    else
+    {
+        missing = pPacer->cost - pPacer->tokens;
+    }
+    if (missing <= TGEN_EPSILON)
+    {
+        return nowNs;
+    }
+
+    if (pPacer->profile == TGEN_POISSON)
+    {
+        readyNs = pPacer->nextTokenNs;
+    }
+    else
+    {
+        readyNs = pPacer->lastNs +
+            (unsigned long long)ceil(missing / pPacer->tokensPerNs);
+    }
+
+    return (readyNs > nowNs) ? readyNs : nowNs;
+}
+
+
+
+/**
+ * The profile of a name: "constant", "burst" or "poisson".
+ *
+ * @return the profile, or -1 if the name is none of them
+ */
+int TGEN_ParseProfile(const char * const pName)
+{
+    int profile;
+
+    for (profile = TGEN_CONSTANT; profile <= TGEN_POISSON; profile++)
+    {
+        if (strcmp(pName, TGEN_ProfileString(profile)) == 0)
+        {
+            return profile;
+        }
+    }
+
+    return -1;
+}
+
+
+
+const char *TGEN_ProfileString(const int profile)
+{
+    switch (profile)
+    {
+    case TGEN_CONSTANT:
+        return "constant";
+    case TGEN_BURST:
+        return "burst";
+    case TGEN_POISSON:
+        return "poisson";
+    default:
+        return "unknown";
+    }
+}
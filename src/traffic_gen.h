@@ -0,0 +1,82 @@
+/*
+  @file traffic_gen.h
+  @author Juan Manuel Gómez
+  @brief Token bucket pacing of the packets of a traffic generator.
+  @details A pacer lets packets go at a target rate, in bits or in packets
+           per second. Tokens accrue at that rate in a bucket; a packet
+           takes the bits of its data, or one token, and the bucket holds
+           `burst` packets of them, or the tokens of TGEN_MAX_SLEEP_NS if
+           more, so that a caller who oversleeps catches up afterwards.
+           The profile decides how the tokens come and go:
+
+             TGEN_CONSTANT  tokens accrue evenly; packets leave as soon
+                            as they are paid for.
+             TGEN_BURST     tokens accrue evenly, but packets leave only
+                            once `burst` of them are paid for, all at
+                            once, then nothing until the next are.
+             TGEN_POISSON   tokens come one packet at a time, at
+                            exponential intervals of the same mean, so the
+                            packets are a Poisson process of that rate.
+
+           TGEN_Take() returns how many packets may leave now, up to the
+           most the caller can put in one transfer operation, and
+           TGEN_NextNs() when the next one may. A caller that sleeps at
+           least TGEN_MIN_SLEEP_NS between operations finds several
+           packets paid for once the rate is high enough, and sends them
+           in one operation: the higher the rate, the fuller the
+           operations. The Poisson intervals come from the payload
+           generator (pattern.h), so a seed repeats a run.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef TRAFFIC_GEN_H
+#define TRAFFIC_GEN_H
+
+#include <stdint.h>
+#include "pattern.h"
+
+/* Profiles */
+#define TGEN_CONSTANT 0
+#define TGEN_BURST 1
+#define TGEN_POISSON 2
+
+/* Units of the rate */
+#define TGEN_BITS 0
+#define TGEN_PACKETS 1
+
+/* Shortest sleep worth waiting for, shorter waits send at once */
+#define TGEN_MIN_SLEEP_NS 50000ULL
+
+/* Longest a caller may oversleep, or be held, without losing tokens */
+#define TGEN_MAX_SLEEP_NS 10000000ULL
+
+typedef struct
+{
+    int profile;
+    unsigned int burst;
+    double cost;            /* tokens of a packet */
+    double capacity;        /* tokens the bucket holds */
+    double tokensPerNs;
+    double tokens;
+    unsigned int pending;               /* TGEN_BURST, still to leave */
+    unsigned long long lastNs;
+    unsigned long long nextTokenNs;     /* TGEN_POISSON */
+    PATGEN random;
+} TGEN_PACER;
+
+int TGEN_Init(TGEN_PACER * const pPacer, const int profile, const int unit,
+    const double rate, const unsigned int packetSize,
+    const unsigned int burst, const uint64_t seed,
+    const unsigned long long nowNs);
+
+unsigned int TGEN_Take(TGEN_PACER * const pPacer,
+    const unsigned long long nowNs, const unsigned int most);
+
+unsigned long long TGEN_NextNs(const TGEN_PACER * const pPacer,
+    const unsigned long long nowNs);
+
+int TGEN_ParseProfile(const char * const pName);
+
+const char *TGEN_ProfileString(const int profile);
+
+#endif
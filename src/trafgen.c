@@ -0,0 +1,421 @@
+/*
+  @file trafgen.c
+  @author Juan Manuel Gómez
+  @brief Rate controlled traffic generator.
+  @details Sends packets on every channel asked for, on every device, at
+  a target rate in Mbit/s (-r) or packets/s (-R) per channel, paced by a
+  token bucket (see traffic_gen.h) with one of three profiles:
+    constant  evenly spaced packets.
+    burst     -b packets back to back, then silence, the same mean rate.
+    poisson   exponential intervals, the same mean rate.
+  Packets paid for at the same time leave in one transfer operation of up
+  to -B packets, with -d operations in flight; past a few thousand
+  packets/s the operations fill up. Each channel runs on its own worker
+  thread (dev_manager.h). The packets are those of a verified stream
+  (stream_verify.h) whose ID is the channel number, seeded with -S, so a
+  receiver can check them. -m and -D set the base transmit clock of the
+  links before the traffic starts.
+  Runs for -t seconds or -n packets per channel, or until Ctrl-C, then
+  prints per channel the rate reached, the mean packets per operation and
+  the time the operations in flight held it back. A channel that reaches
+  less than 95% of the target rate fails.
+  @param -c channels, -s packet size, -r Mbit/s, -R packets/s, -P profile,
+  -b burst, -B batch, -d depth, -t seconds, -n packets, -a address path,
+  -m clock multiplier, -D clock divisor, -S seed, -p pin the workers.
+  The address path is 1 by default, -a "" sends without one.
+  @example ./trafgen -c 1 -s 1024 -r 50 -P poisson -t 60
+  @example ./trafgen -c 1,2 -s 64 -R 20000 -P burst -b 32 -m 2 -D 4
+  @copyright jmgomez CSIC-IAA
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include "utility.h"
+#include "star-dundee_types.h"
+#include "star-api.h"
+#include "cfg_api_mk2.h"
+#include "cfg_api_mk2_types.h"
+#include "cfg_api_brick_mk3.h"
+#include "dev_manager.h"
+#include "pattern.h"
+#include "stream_verify.h"
+#include "traffic_gen.h"
+
+#define VERSION_INFO "Traffic Generator v1.0"
+
+#define _TIMEOUT 5000
+#define _MAX_PATH 16
+#define _LINK_BASE_MBPS 200.0
+//Share of the target rate a channel must reach.
+#define _RATE_TOLERANCE 0.95
+
+typedef struct{
+  int profile, unit;
+  double rate;
+  U32 packetSize, burst, batch, depth;
+  unsigned long packetCount, seconds;
+  U8 path[_MAX_PATH];
+  U8 pathLength;
+  int setClock;
+  STAR_CFG_MK2_BASE_TRANSMIT_CLOCK clock;
+  uint64_t seed;
+} GEN_ARGS;
+
+static volatile sig_atomic_t stopRequested;
+
+static void requestStop(int signalNumber){
+  (void) signalNumber;
+  stopRequested = 1;
+}
+
+int generatorJob(DEVMGR_WORKER * const pWorker, void * const pArgument);
+
+
+/* Parse a comma separated list of bytes */
+static int parsePath(const char *pList, U8 * const pPath, U8 * const pLength){
+  unsigned long value;
+  char *pEnd;
+
+  *pLength = 0;
+  while (*pList != '\0'){
+    value = strtoul(pList, &pEnd, 0);
+    if (pEnd == pList || value > 255 || *pLength == _MAX_PATH)
+      return 0;
+    pPath[(*pLength)++] = (U8) value;
+    pList = (*pEnd == ',') ? pEnd + 1 : pEnd;
+  }
+
+  return 1;
+}
+
+
+int __cdecl  main(int argc, char * argv[]){
+  DEVMGR manager;
+  GEN_ARGS args;
+  STAR_CHANNEL_MASK channels = 0;
+  struct sigaction action;
+  const char *pChannel;
+  char *pEnd;
+  unsigned int failed;
+  double linkMbps, offeredMbps;
+  int opt, pin = 0;
+
+  memset(&args, 0, sizeof(args));
+  args.profile = TGEN_CONSTANT;
+  args.unit = TGEN_BITS;
+  args.rate = 10e6;
+  args.packetSize = 1024;
+  args.burst = 16;
+  args.batch = 16;
+  args.depth = 4;
+  args.path[0] = 1;
+  args.pathLength = 1;
+  args.seed = PATGEN_DEFAULT_SEED;
+
+  while ((opt = getopt(argc, argv, "c:s:r:R:P:b:B:d:t:n:a:m:D:S:p")) != -1){
+    switch (opt){
+    case 'c':
+      for (pChannel = optarg; *pChannel != '\0'; pChannel = pEnd){
+        unsigned long channel = strtoul(pChannel, &pEnd, 0);
+        if (pEnd == pChannel || channel < 1 || channel > 31){
+          printf("Invalid channel list %s.\n", optarg);
+          return 1;
+        }
+        channels |= 1U << channel;
+        if (*pEnd == ',')
+          pEnd++;
+      }
+      break;
+    case 's':
+      args.packetSize = strtoul(optarg, NULL, 0);
+      break;
+    case 'r':
+      args.unit = TGEN_BITS;
+      args.rate = strtod(optarg, NULL) * 1e6;
+      break;
+    case 'R':
+      args.unit = TGEN_PACKETS;
+      args.rate = strtod(optarg, NULL);
+      break;
+    case 'P':
+      args.profile = TGEN_ParseProfile(optarg);
+      if (args.profile < 0){
+        printf("Unknown profile %s.\n", optarg);
+        return 1;
+      }
+      break;
+    case 'b':
+      args.burst = strtoul(optarg, NULL, 0);
+      break;
+    case 'B':
+      args.batch = strtoul(optarg, NULL, 0);
+      break;
+    case 'd':
+      args.depth = strtoul(optarg, NULL, 0);
+      break;
+    case 't':
+      args.seconds = strtoul(optarg, NULL, 0);
+      break;
+    case 'n':
+      args.packetCount = strtoul(optarg, NULL, 0);
+      break;
+    case 'a':
+      if (!parsePath(optarg, args.path, &args.pathLength)){
+        printf("Invalid address path %s.\n", optarg);
+        return 1;
+      }
+      break;
+    case 'm':
+      args.setClock = 1;
+      args.clock.multiplier = strtoul(optarg, NULL, 0);
+      break;
+    case 'D':
+      args.setClock = 1;
+      args.clock.divisor = strtoul(optarg, NULL, 0);
+      break;
+    case 'S':
+      args.seed = strtoull(optarg, NULL, 0);
+      break;
+    case 'p':
+      pin = 1;
+      break;
+    default:
+      printf("Usage: %s [-c channels] [-s size] [-r Mbit/s | -R packets/s]"
+             " [-P constant|burst|poisson] [-b burst] [-B batch] [-d depth]"
+             " [-t seconds] [-n packets] [-a path] [-m mul] [-D div]"
+             " [-S seed] [-p]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (channels == 0)
+    channels = 1U << 1;
+  if (args.packetSize < SVERIFY_HEADER_SIZE || !(args.rate > 0) ||
+      args.burst < 1 || args.batch < 1 || args.depth < 1){
+    printf("Error: The packet size must be at least %u B, and the rate, the"
+           " burst, the batch and the depth positive.\n", SVERIFY_HEADER_SIZE);
+    return 1;
+  }
+  if (args.setClock){
+    if (args.clock.multiplier < 1 || args.clock.divisor < 1){
+      puts("Error: The clock needs both -m and -D, at least 1.");
+      return 1;
+    }
+    /* Data characters are 10 bits on the wire */
+    linkMbps = _LINK_BASE_MBPS * args.clock.multiplier / args.clock.divisor;
+    offeredMbps = (args.unit == TGEN_BITS) ? args.rate / 1e6 :
+      args.rate * args.packetSize * 8.0 / 1e6;
+    if (offeredMbps > linkMbps * 0.8)
+      printf("Warning: %.1f Mbit/s is above the %.1f Mbit/s of data of a"
+             " %.0f Mbit/s link.\n", offeredMbps, linkMbps * 0.8, linkMbps);
+  }
+
+  if (DEVMGR_Open(&manager, STAR_DEVICE_TXRX_SUPPORTED, channels, pin) == 0){
+    puts("Error: No compatible device found.");
+    return 1;
+  }
+  printf("%u devices, %u workers: %s, %.1f %s per channel, %u B packets.\n",
+         manager.deviceCount, manager.workerCount,
+         TGEN_ProfileString(args.profile),
+         (args.unit == TGEN_BITS) ? args.rate / 1e6 : args.rate,
+         (args.unit == TGEN_BITS) ? "Mbit/s" : "packets/s", args.packetSize);
+
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = requestStop;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  failed = DEVMGR_Run(&manager, generatorJob, &args);
+  DEVMGR_PrintReport(&manager);
+
+  DEVMGR_Close(&manager);
+
+  return failed != 0;
+}
+
+
+/* Sleep until a time of MonotonicTimeNs(), or until Ctrl-C */
+static void sleepUntil(const unsigned long long dueNs){
+  struct timespec due;
+
+  due.tv_sec = (time_t) (dueNs / 1000000000ULL);
+  due.tv_nsec = (long) (dueNs % 1000000000ULL);
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR &&
+         !stopRequested)
+    ;
+}
+
+
+//Paced packets on the channel of the worker, until time, count or Ctrl-C.
+int generatorJob(DEVMGR_WORKER * const pWorker, void * const pArgument){
+  const GEN_ARGS *pArgs = (const GEN_ARGS *) pArgument;
+  STAR_SPACEWIRE_ADDRESS *pAddress = NULL;
+  STAR_CHANNEL_ID channelId = 0;
+  STAR_TRANSFER_OPERATION **vOps;
+  STAR_STREAM_ITEM **vItems;
+  U32 *vCounts;
+  U8 *pBuffer, *pPacket;
+  TGEN_PACER pacer;
+  SVERIFY_STREAM stream;
+  unsigned long long startNs, nowNs, endNs, dueNs, heldNs = 0, ops = 0;
+  U32 i, slot, count, most;
+  int status = 0, behind;
+
+  if (pArgs->setClock &&
+      !CFG_BRICK_MK3_setBaseTransmitClock(pWorker->deviceId,
+                                          pWorker->channelNumber,
+                                          pArgs->clock)){
+    snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH,
+             "Unable to set the clock of link %u", pWorker->channelNumber);
+    return 1;
+  }
+
+  channelId = STAR_openChannelToLocalDevice(pWorker->deviceId, STAR_CHANNEL_DIRECTION_OUT,
+                                            pWorker->channelNumber, TRUE);
+  if (pArgs->pathLength > 0)
+    pAddress = STAR_createAddress((U8 *) pArgs->path, pArgs->pathLength);
+  pBuffer = malloc((size_t) pArgs->depth * pArgs->batch * pArgs->packetSize);
+  vItems = calloc((size_t) pArgs->depth * pArgs->batch, sizeof(STAR_STREAM_ITEM *));
+  vOps = calloc(pArgs->depth, sizeof(STAR_TRANSFER_OPERATION *));
+  vCounts = calloc(pArgs->depth, sizeof(U32));
+  if (channelId == 0 || (pArgs->pathLength > 0 && !pAddress) || !pBuffer ||
+      !vItems || !vOps || !vCounts){
+    snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH,
+             "Unable to open channel %u", pWorker->channelNumber);
+    status = 1;
+  }
+
+  SVERIFY_Init(&stream, pWorker->channelNumber, DATA_TYPE_RANDOM, pArgs->seed);
+  startNs = MonotonicTimeNs();
+  endNs = pArgs->seconds ? startNs + pArgs->seconds * 1000000000ULL : 0;
+  //Every channel its own Poisson intervals.
+  if (!status &&
+      !TGEN_Init(&pacer, pArgs->profile, pArgs->unit, pArgs->rate,
+                 pArgs->packetSize,
+                 (pArgs->profile == TGEN_BURST) ? pArgs->burst : pArgs->batch,
+                 pArgs->seed + pWorker->deviceIndex * 32 + pWorker->channelNumber,
+                 startNs))
+    status = 1;
+
+  while (!status && !stopRequested){
+    nowNs = MonotonicTimeNs();
+    if (endNs && nowNs >= endNs)
+      break;
+    most = pArgs->batch;
+    if (pArgs->packetCount && pArgs->packetCount - pWorker->packets < most)
+      most = (U32) (pArgs->packetCount - pWorker->packets);
+    if (most == 0)
+      break;
+
+    count = TGEN_Take(&pacer, nowNs, most);
+    if (count == 0){
+      //Not too soon, so that the next operation gathers what is paid then.
+      dueNs = TGEN_NextNs(&pacer, nowNs);
+      if (dueNs < nowNs + TGEN_MIN_SLEEP_NS)
+        dueNs = nowNs + TGEN_MIN_SLEEP_NS;
+      if (endNs && dueNs > endNs)
+        dueNs = endNs;
+      sleepUntil(dueNs);
+      continue;
+    }
+
+    //The slot of the operation sent depth operations before, once done.
+    slot = (U32) (ops % pArgs->depth);
+    if (vOps[slot] != NULL){
+      if (STAR_waitOnTransferOperationCompletion(vOps[slot], _TIMEOUT) !=
+          STAR_TRANSFER_STATUS_COMPLETE){
+        snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH,
+                 "Transmit failed after %llu packets", pWorker->packets);
+        status = 1;
+        break;
+      }
+      heldNs += MonotonicTimeNs() - nowNs;
+      STAR_disposeTransferOperation(vOps[slot]);
+      vOps[slot] = NULL;
+      for (i = 0; i < vCounts[slot]; ++i){
+        STAR_destroyStreamItem(vItems[slot * pArgs->batch + i]);
+        vItems[slot * pArgs->batch + i] = NULL;
+      }
+    }
+
+    for (i = 0; i < count; ++i){
+      pPacket = pBuffer + ((size_t) slot * pArgs->batch + i) * pArgs->packetSize;
+      SVERIFY_Fill(&stream, pPacket, pArgs->packetSize);
+      vItems[slot * pArgs->batch + i] = STAR_createPacket(pAddress, pPacket,
+                                                          pArgs->packetSize,
+                                                          STAR_EOP_TYPE_EOP);
+      if (vItems[slot * pArgs->batch + i] == NULL)
+        break;
+    }
+    if (i < count){
+      snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH,
+               "Unable to create packets after %llu packets", pWorker->packets);
+      pWorker->errors += count;
+      status = 1;
+      break;
+    }
+    vCounts[slot] = count;
+    vOps[slot] = STAR_createTxOperation(vItems + slot * pArgs->batch, count);
+    if (vOps[slot] == NULL ||
+        !STAR_submitTransferOperation(channelId, vOps[slot])){
+      snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH,
+               "Unable to submit after %llu packets", pWorker->packets);
+      pWorker->errors += count;
+      //Never in flight, so not waited for nor counted again below.
+      if (vOps[slot] != NULL)
+        STAR_disposeTransferOperation(vOps[slot]);
+      vOps[slot] = NULL;
+      status = 1;
+      break;
+    }
+    ops++;
+    pWorker->packets += count;
+    pWorker->bytes += (unsigned long long) count * pArgs->packetSize;
+  }
+
+  //The operations still in flight, then everything made.
+  for (slot = 0; vOps != NULL && slot < pArgs->depth; ++slot)
+    if (vOps[slot] != NULL){
+      if (STAR_waitOnTransferOperationCompletion(vOps[slot], _TIMEOUT) !=
+          STAR_TRANSFER_STATUS_COMPLETE){
+        STAR_cancelTransferOperation(vOps[slot]);
+        pWorker->errors += vCounts[slot];
+        status = 1;
+      }
+      STAR_disposeTransferOperation(vOps[slot]);
+    }
+  for (i = 0; vItems != NULL && i < pArgs->depth * pArgs->batch; ++i)
+    if (vItems[i] != NULL)
+      STAR_destroyStreamItem(vItems[i]);
+
+  nowNs = MonotonicTimeNs();
+  //A channel that could not keep up with the pacer fails.
+  behind = !status &&
+    ((pArgs->unit == TGEN_BITS) ? pWorker->bytes * 8.0 : pWorker->packets) *
+    1e9 / (nowNs - startNs) < pArgs->rate * _RATE_TOLERANCE;
+  if (!status)
+    snprintf(pWorker->summary, DEVMGR_SUMMARY_LENGTH,
+             "%s%.2f Mbit/s, %.0f packets/s, %.1f packets/op, held %.1f%%",
+             behind ? "Short of the target, " : "",
+             pWorker->bytes * 8.0 * 1e3 / (nowNs - startNs),
+             pWorker->packets * 1e9 / (nowNs - startNs),
+             ops ? (double) pWorker->packets / ops : 0.0,
+             heldNs * 100.0 / (nowNs - startNs));
+
+  if (channelId != 0)
+    STAR_closeChannel(channelId);
+  if (pAddress != NULL)
+    STAR_destroyAddress(pAddress);
+  free(pBuffer);
+  free(vItems);
+  free(vOps);
+  free(vCounts);
+  return status || behind;
+}
@@ -25,24 +25,60 @@
 #endif
 #include <string.h>
 #include <errno.h>
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
 
 #include "utility.h"
+#include "pattern.h"
+
+#if defined(_MSC_VER)
+    #define UTILITY_THREAD __declspec(thread)
+#else
+    #define UTILITY_THREAD __thread
+#endif
+/* Each thread has a generator of its own, see pattern.h */
+static UTILITY_THREAD PATGEN threadGenerator;
+static UTILITY_THREAD int threadGeneratorSeeded;
+
+static PATGEN *ThreadGenerator(void)
+{
+    if (!threadGeneratorSeeded)
+    {
+        PATGEN_Seed(&threadGenerator, PATGEN_DEFAULT_SEED);
+        threadGeneratorSeeded = 1;
+    }
+
+    return &threadGenerator;
+}
+
 
 /******************************************************************************/
 /*                                                                            */
-/* Generates a 16-bit random number                                           */
+/* Seeds the random numbers of the calling thread. Threads start from         */
+/* PATGEN_DEFAULT_SEED, so every run gives the same numbers.                  */
 /*                                                                            */
 /******************************************************************************/
-unsigned int random16(void)
+void random_seed(const unsigned long long seed)
 {
-    unsigned int value = rand();
+    PATGEN_Seed(&threadGenerator, seed);
+    threadGeneratorSeeded = 1;
+}
 
-    if ((unsigned int )rand() > (RAND_MAX / 2))
-    {
-        value += RAND_MAX;
-    }
 
-    return value;
+/******************************************************************************/
+/*                                                                            */
+/* Generates a 16-bit random number                                           */
+/*                                                                            */
+/******************************************************************************/
+unsigned int random16(void)
+{
+    return (unsigned int)(PATGEN_Next(ThreadGenerator()) >> 48);
 }
 
 
@@ -53,13 +89,7 @@ unsigned int random16(void)
 /******************************************************************************/
 unsigned int random32(void)
 {
-    unsigned int value;
-
-    value = random16();
-    value *= 0x10000U;
-    value += random16();
-
-    return value;
+    return (unsigned int)(PATGEN_Next(ThreadGenerator()) >> 32);
 }
 
 
@@ -177,6 +207,112 @@ int file_append_chunk(const unsigned char * const pData, const long dataSize,
 
 
 
+#ifndef _WIN32
+/******************************************************************************/
+/*                                                                            */
+/*  Creates (or truncates) a file of a fixed size and maps it for writing.    */
+/*  The file is preallocated, so writes through the map never extend it.      */
+/*  Returns NULL if the file could not be created or mapped.                  */
+/*                                                                            */
+/******************************************************************************/
+void *file_map_create(const char fname[], const unsigned long size,
+    int * const pFd)
+{
+    void *pMap;
+    int fd;
+
+    fd = open(fname, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        printf("\nfile_map_create: Trouble opening file: %s\n", fname);
+        return NULL;
+    }
+
+    if (posix_fallocate(fd, 0, (off_t)size) != 0)
+    {
+        printf("\nfile_map_create: Unable to reserve %lu bytes for %s\n",
+            size, fname);
+        close(fd);
+        return NULL;
+    }
+
+    pMap = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (pMap == MAP_FAILED)
+    {
+        printf("\nfile_map_create: Unable to map file: %s\n", fname);
+        close(fd);
+        return NULL;
+    }
+
+    *pFd = fd;
+    return pMap;
+}
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*  Maps an existing file read-only, whole.                                   */
+/*  Returns NULL if the file could not be opened or mapped.                   */
+/*                                                                            */
+/******************************************************************************/
+void *file_map_open(const char fname[], unsigned long * const pSize,
+    int * const pFd)
+{
+    struct stat fileStat;
+    void *pMap;
+    int fd;
+
+    fd = open(fname, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("\nfile_map_open: Trouble opening file: %s\n", fname);
+        return NULL;
+    }
+
+    if ((fstat(fd, &fileStat) != 0) || (fileStat.st_size == 0))
+    {
+        printf("\nfile_map_open: Empty or unreadable file: %s\n", fname);
+        close(fd);
+        return NULL;
+    }
+
+    pMap = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (pMap == MAP_FAILED)
+    {
+        printf("\nfile_map_open: Unable to map file: %s\n", fname);
+        close(fd);
+        return NULL;
+    }
+
+    *pSize = (unsigned long)fileStat.st_size;
+    *pFd = fd;
+    return pMap;
+}
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*  Flushes and releases a map created by file_map_create/file_map_open.      */
+/*                                                                            */
+/******************************************************************************/
+void file_unmap(void * const pMap, const unsigned long size, const int fd)
+{
+    if (pMap != NULL)
+    {
+        msync(pMap, size, MS_SYNC);
+        munmap(pMap, size);
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+}
+#endif
+
+
+
 /******************************************************************************/
 /*                                                                            */
 /*  FillBuffer                                                                */
@@ -186,65 +322,241 @@ int file_append_chunk(const unsigned char * const pData, const long dataSize,
 void FillBufferRandomChar(char * const pBuffer, const unsigned int size,
     const int dataType)
 {
-    unsigned int n;
-    switch (dataType)
+    /* Random values come from the generator of the calling thread */
+    PATGEN_Fill(ThreadGenerator(), pBuffer, size, dataType);
+}
+
+
+
+/******************************************************************************/
+/*                                                                            */
+/*  Buffer compare function: Used instead of memcmp() for debugging           */
+/*  Returns the number of errors found                                        */
+/*                                                                            */
+/******************************************************************************/
+unsigned long BufferCompareChar(const char * const pBuffer1,
+    const char * const pBuffer2, const unsigned long size)
+{
+    BUFFER_MISMATCH mismatch;
+
+    if (BufferCompare(pBuffer1, pBuffer2, size, &mismatch) != 0U)
+    {
+        BufferPrintMismatch(pBuffer1, pBuffer2, size, &mismatch);
+    }
+
+    return mismatch.count;
+}
+
+
+
+/* Account the differing bytes of a block, given one bit per byte */
+static void BufferAccount(BUFFER_MISMATCH * const pMismatch,
+    const unsigned long offset, const unsigned long long bytes)
+{
+#if defined(__GNUC__)
+    if (pMismatch->count == 0U)
+    {
+        pMismatch->first = offset + (unsigned long)__builtin_ctzll(bytes);
+    }
+    pMismatch->count += (unsigned long)__builtin_popcountll(bytes);
+    pMismatch->last = offset + 63U - (unsigned long)__builtin_clzll(bytes);
+#else
+    unsigned long bit;
+
+    for (bit = 0U; bit < 64U; bit++)
+    {
+        if ((bytes & (1ULL << bit)) != 0U)
+        {
+            if (pMismatch->count == 0U)
+            {
+                pMismatch->first = offset + bit;
+            }
+            pMismatch->count++;
+            pMismatch->last = offset + bit;
+        }
+    }
+#endif
+}
+
+
+
+/**
+ * Compare two buffers without printing anything. The buffers are compared
+ * 64 bytes at a time with SSE2 where available, 8 bytes at a time
+ * otherwise, and only the blocks that differ are looked at byte by byte.
+ *
+ * @param pBuffer1 the first buffer
+ * @param pBuffer2 the second buffer
+ * @param size the number of bytes to compare
+ * @param pMismatch updated with the count, first and last differing bytes
+ *
+ * @return the number of bytes that differ
+ */
+unsigned long BufferCompare(const void * const pBuffer1,
+    const void * const pBuffer2, const unsigned long size,
+    BUFFER_MISMATCH * const pMismatch)
+{
+    const unsigned char * const p1 = (const unsigned char *)pBuffer1;
+    const unsigned char * const p2 = (const unsigned char *)pBuffer2;
+    unsigned long long word1, word2, bytes;
+    unsigned long i = 0U, j;
+
+    pMismatch->count = 0U;
+    pMismatch->first = size;
+    pMismatch->last = size;
+
+#if defined(__SSE2__)
+    for (; i + 64U <= size; i += 64U)
     {
-    case DATA_TYPE_0:       /* Fill with zeros */
-        memset(pBuffer, 0, size);
-        break;
+        __m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(p1 + i)),
+            _mm_loadu_si128((const __m128i *)(p2 + i)));
+        __m128i x1 = _mm_xor_si128(
+            _mm_loadu_si128((const __m128i *)(p1 + i + 16U)),
+            _mm_loadu_si128((const __m128i *)(p2 + i + 16U)));
+        __m128i x2 = _mm_xor_si128(
+            _mm_loadu_si128((const __m128i *)(p1 + i + 32U)),
+            _mm_loadu_si128((const __m128i *)(p2 + i + 32U)));
+        __m128i x3 = _mm_xor_si128(
+            _mm_loadu_si128((const __m128i *)(p1 + i + 48U)),
+            _mm_loadu_si128((const __m128i *)(p2 + i + 48U)));
+        const __m128i zero = _mm_setzero_si128();
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(
+            _mm_or_si128(x0, x1), _mm_or_si128(x2, x3)), zero)) == 0xFFFF)
+        {
+            continue;
+        }
 
-    case DATA_TYPE_1:       /* Fill with ones */
-        memset(pBuffer, 1, size);
-        break;
+        /* One bit per byte that differs, byte 0 in bit 0 */
+        bytes = (unsigned long long)(~_mm_movemask_epi8(
+                _mm_cmpeq_epi8(x0, zero)) & 0xFFFF) |
+            ((unsigned long long)(~_mm_movemask_epi8(
+                _mm_cmpeq_epi8(x1, zero)) & 0xFFFF) << 16) |
+            ((unsigned long long)(~_mm_movemask_epi8(
+                _mm_cmpeq_epi8(x2, zero)) & 0xFFFF) << 32) |
+            ((unsigned long long)(~_mm_movemask_epi8(
+                _mm_cmpeq_epi8(x3, zero)) & 0xFFFF) << 48);
+        BufferAccount(pMismatch, i, bytes);
+    }
+#endif
 
-    case DATA_TYPE_RANDOM:      /* Fill with random values */
-        for (n = 0U; n < size; n++)
+    for (; i + 8U <= size; i += 8U)
+    {
+        memcpy(&word1, p1 + i, sizeof(word1));
+        memcpy(&word2, p2 + i, sizeof(word2));
+        if (word1 == word2)
         {
-            *(pBuffer + n) = (char) random32();
+            continue;
         }
-        break;
 
-    case DATA_TYPE_COUNT:       /* Fill with simple count */
-        for (n = 0U; n < size; n++)
+        bytes = 0U;
+        for (j = 0U; j < 8U; j++)
         {
-            *(pBuffer + n) = (char)n;
+            if (p1[i + j] != p2[i + j])
+            {
+                bytes |= 1ULL << j;
+            }
         }
-        break;
+        BufferAccount(pMismatch, i, bytes);
+    }
 
-    case DATA_TYPE_NOT_COUNT:   /* Fill with not of simple count */
-        for (n = 0U; n < size; n++)
+    for (; i < size; i++)
+    {
+        if (p1[i] != p2[i])
         {
-            *(pBuffer + n) = 0xFF - (char)n;
+            BufferAccount(pMismatch, i, 1ULL);
         }
-        break;
     }
+
+    return pMismatch->count;
 }
 
 
 
-/******************************************************************************/
-/*                                                                            */
-/*  Buffer compare function: Used instead of memcmp() for debugging           */
-/*  Returns the number of errors found                                        */
-/*                                                                            */
-/******************************************************************************/
-unsigned long BufferCompareChar(const char * const pBuffer1,
-    const char * const pBuffer2, const unsigned long size)
+/**
+ * Print what BufferCompare() found in a few lines: the differing bytes as
+ * ranges, up to BUFFER_MISMATCH_RANGES of them, and a hexdump of both
+ * buffers from the first difference, up to BUFFER_MISMATCH_DUMP bytes.
+ *
+ * @param pExpected the buffer that was sent
+ * @param pActual the buffer that was received
+ * @param size the number of bytes compared
+ * @param pMismatch the result of BufferCompare() on the buffers
+ */
+void BufferPrintMismatch(const void * const pExpected,
+    const void * const pActual, const unsigned long size,
+    const BUFFER_MISMATCH * const pMismatch)
 {
-    unsigned int errorCount = 0U;
-    unsigned long i;
+    const unsigned char * const pE = (const unsigned char *)pExpected;
+    const unsigned char * const pA = (const unsigned char *)pActual;
+    unsigned long i, start, ranges = 0U, end, line, j;
+
+    if (pMismatch->count == 0U)
+    {
+        return;
+    }
 
-    for (i = 0U; i < size; i++)
+    printf("Error in %lu of %lu bytes, from byte %lu to byte %lu:",
+        pMismatch->count, size, pMismatch->first, pMismatch->last);
+    for (i = pMismatch->first; i <= pMismatch->last; i++)
     {
-        if (*(pBuffer1 + i) != *(pBuffer2 + i))
+        if (pE[i] == pA[i])
         {
-            errorCount++;
-            printf("Error in byte %8lu, should be 0x%2x actually 0x%2x\n", i,
-                *(pBuffer1 + i), *(pBuffer2 + i));
+            continue;
         }
+
+        start = i;
+        while ((i < pMismatch->last) && (pE[i + 1U] != pA[i + 1U]))
+        {
+            i++;
+        }
+        if (ranges < BUFFER_MISMATCH_RANGES)
+        {
+            if (start == i)
+            {
+                printf(" %lu", start);
+            }
+            else
+            {
+                printf(" %lu-%lu", start, i);
+            }
+        }
+        ranges++;
     }
+    if (ranges > BUFFER_MISMATCH_RANGES)
+    {
+        printf(" and %lu more ranges", ranges - BUFFER_MISMATCH_RANGES);
+    }
+    printf("\n");
 
-    return errorCount;
+    /* Lines of 16 bytes, the first one holding the first difference */
+    end = pMismatch->first - (pMismatch->first % 16U) + BUFFER_MISMATCH_DUMP;
+    if (end > size)
+    {
+        end = size;
+    }
+    for (line = pMismatch->first - (pMismatch->first % 16U); line < end;
+        line += 16U)
+    {
+        printf("%8lu should be", line);
+        for (j = line; (j < line + 16U) && (j < end); j++)
+        {
+            printf(" %02x", pE[j]);
+        }
+        printf("\n%8s actually ", "");
+        for (j = line; (j < line + 16U) && (j < end); j++)
+        {
+            if (pE[j] != pA[j])
+            {
+                printf(" %02x", pA[j]);
+            }
+            else
+            {
+                printf(" ..");
+            }
+        }
+        printf("\n");
+    }
 }
 
 
@@ -318,3 +630,35 @@ int SizeOfFile(const char filePath[])
 }
 
 
+
+/**
+ * Read the monotonic clock, for measuring intervals.
+ *
+ * @return the current time in nanoseconds from an arbitrary origin
+ */
+unsigned long long MonotonicTimeNs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((unsigned long long)now.tv_sec * 1000000000ULL) +
+        (unsigned long long)now.tv_nsec;
+}
+
+
+
+/**
+ * Read the wall clock, for time-stamping records.
+ *
+ * @return the current time in nanoseconds since the Epoch
+ */
+unsigned long long RealTimeNs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    return ((unsigned long long)now.tv_sec * 1000000000ULL) +
+        (unsigned long long)now.tv_nsec;
+}
@@ -32,6 +32,18 @@
 #define DATA_TYPE_COUNT         3
 #define DATA_TYPE_NOT_COUNT     4
 
+/* Mismatch report of BufferPrintMismatch(): ranges listed, bytes dumped */
+#define BUFFER_MISMATCH_RANGES  8
+#define BUFFER_MISMATCH_DUMP    64
+
+/* Result of BufferCompare() */
+typedef struct
+{
+    unsigned long count;        /* bytes that differ */
+    unsigned long first;        /* offset of the first, size if none */
+    unsigned long last;         /* offset of the last, size if none */
+} BUFFER_MISMATCH;
+
 
 
 #ifdef _WIN32
@@ -50,6 +62,7 @@
 
 unsigned int random32(void);
 unsigned int random16(void);
+void random_seed(const unsigned long long seed);
 
 void FillBuffer(unsigned int *pBuffer, unsigned long size, int dataType);
 
@@ -64,6 +77,14 @@ void debug_print(char *s);
 unsigned long BufferCompareChar(const char * const pBuffer1,
     const char * const pBuffer2, const unsigned long size);
 
+unsigned long BufferCompare(const void * const pBuffer1,
+    const void * const pBuffer2, const unsigned long size,
+    BUFFER_MISMATCH * const pMismatch);
+
+void BufferPrintMismatch(const void * const pExpected,
+    const void * const pActual, const unsigned long size,
+    const BUFFER_MISMATCH * const pMismatch);
+
 int readSpaceWireAddress(STAR_SPACEWIRE_ADDRESS** pAddress);
 
 int SizeOfFile(const char filePath[]);
@@ -74,12 +95,24 @@ int file_read_chunk(const char fname[], char * const pBuffer, const long offset,
 int file_append_chunk(const unsigned char * const pData, const long dataSize,
 const char fname[]);
 
+void *file_map_create(const char fname[], const unsigned long size,
+    int * const pFd);
+
+void *file_map_open(const char fname[], unsigned long * const pSize,
+    int * const pFd);
+
+void file_unmap(void * const pMap, const unsigned long size, const int fd);
+
 void CopyNumberToMemory(void * const pBuffer, const U32 number,
     const unsigned long len);
 
 void CopyNumberFromMemory(U32 * const pNumber, void * const pBuffer,
     const unsigned long len);
 
+unsigned long long MonotonicTimeNs(void);
+
+unsigned long long RealTimeNs(void);
+
 
 
 
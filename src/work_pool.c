@@ -0,0 +1,275 @@
+/*
+  @file work_pool.c
+  @author Juan Manuel Gómez
+  @brief Long-lived worker threads with a queue of jobs each.
+  @details See work_pool.h.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include "work_pool.h"
+#include "utility.h"
+
+
+static void *WPOOL_thread(void *arg)
+{
+    WPOOL_WORKER * const pWorker = (WPOOL_WORKER *)arg;
+    unsigned long long startNs;
+    WPOOL_ITEM item;
+
+    pthread_mutex_lock(&pWorker->lock);
+    for (;;)
+    {
+        while ((pWorker->queued == 0U) && !pWorker->stop)
+        {
+            pthread_cond_wait(&pWorker->ready, &pWorker->lock);
+        }
+        /* Closing still runs what was queued before */
+        if (pWorker->queued == 0U)
+        {
+            break;
+        }
+
+        item = pWorker->items[pWorker->head];
+        pWorker->head = (pWorker->head + 1U) % WPOOL_QUEUE_LENGTH;
+        pWorker->queued--;
+        pWorker->running = 1;
+        pthread_cond_broadcast(&pWorker->idle);
+        pthread_mutex_unlock(&pWorker->lock);
+
+        startNs = MonotonicTimeNs();
+        item.job(item.pArgument);
+
+        pthread_mutex_lock(&pWorker->lock);
+        pWorker->busyNs += MonotonicTimeNs() - startNs;
+        pWorker->jobs++;
+        pWorker->running = 0;
+        pthread_cond_broadcast(&pWorker->idle);
+    }
+    pthread_mutex_unlock(&pWorker->lock);
+
+    return NULL;
+}
+
+
+
+/**
+ * Start the workers of a pool. The pool must stay where it is until
+ * WPOOL_Close().
+ *
+ * @param pPool the pool
+ * @param workers the threads to start, at most WPOOL_MAX_WORKERS
+ * @param pin pin each worker to its own CPU, in turn
+ *
+ * @return the number of workers started, 0 on error
+ */
+unsigned int WPOOL_Open(WPOOL * const pPool, const unsigned int workers,
+    const int pin)
+{
+    WPOOL_WORKER *pWorker;
+    pthread_attr_t attr;
+    long cpuCount;
+    unsigned int i;
+#ifdef __linux__
+    cpu_set_t cpus;
+#endif
+
+    memset(pPool, 0, sizeof(WPOOL));
+    if ((workers == 0U) || (workers > WPOOL_MAX_WORKERS))
+    {
+        puts("WPOOL_Open: Invalid number of workers");
+        return 0U;
+    }
+
+    cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpuCount < 1)
+    {
+        cpuCount = 1;
+    }
+
+    pPool->openNs = MonotonicTimeNs();
+    for (i = 0U; i < workers; i++)
+    {
+        pWorker = &pPool->workers[i];
+        pWorker->index = i;
+        pWorker->cpu = pin ? (int)(i % (unsigned long)cpuCount) : -1;
+        pthread_mutex_init(&pWorker->lock, NULL);
+        pthread_cond_init(&pWorker->ready, NULL);
+        pthread_cond_init(&pWorker->idle, NULL);
+
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+#ifdef __linux__
+        if (pWorker->cpu >= 0)
+        {
+            CPU_ZERO(&cpus);
+            CPU_SET(pWorker->cpu, &cpus);
+            pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+        }
+#endif
+        pWorker->started = pthread_create(&pWorker->thread, &attr,
+            WPOOL_thread, pWorker) == 0;
+        pthread_attr_destroy(&attr);
+
+        pPool->workerCount++;
+        if (!pWorker->started)
+        {
+            puts("WPOOL_Open: Unable to start a worker");
+            WPOOL_Close(pPool);
+            return 0U;
+        }
+    }
+
+    return pPool->workerCount;
+}
+
+
+
+/**
+ * Queue a job to the worker of a key, waiting for room in its queue.
+ * A job of that worker finds no room if its queue is full: the worker
+ * would wait on itself, so the job is not queued.
+ *
+ * @param pPool the pool
+ * @param key jobs of the same key run in order on the same worker
+ * @param job the job
+ * @param pArgument passed to the job
+ *
+ * @return 1 on success, 0 if the pool is closed or the job submits to
+ *         its own worker, whose queue is full
+ */
+int WPOOL_Submit(WPOOL * const pPool, const unsigned long key,
+    const WPOOL_JOB job, void * const pArgument)
+{
+    WPOOL_WORKER *pWorker;
+    unsigned int tail;
+
+    if ((pPool->workerCount == 0U) || (job == NULL))
+    {
+        return 0;
+    }
+    pWorker = &pPool->workers[key % pPool->workerCount];
+
+    pthread_mutex_lock(&pWorker->lock);
+    if ((pWorker->queued == WPOOL_QUEUE_LENGTH) &&
+        pthread_equal(pthread_self(), pWorker->thread))
+    {
+        pthread_mutex_unlock(&pWorker->lock);
+        puts("WPOOL_Submit: Queue of the calling worker full");
+        return 0;
+    }
+    while ((pWorker->queued == WPOOL_QUEUE_LENGTH) && !pWorker->stop)
+    {
+        pthread_cond_wait(&pWorker->idle, &pWorker->lock);
+    }
+    if (pWorker->stop)
+    {
+        pthread_mutex_unlock(&pWorker->lock);
+        return 0;
+    }
+
+    tail = (pWorker->head + pWorker->queued) % WPOOL_QUEUE_LENGTH;
+    pWorker->items[tail].job = job;
+    pWorker->items[tail].pArgument = pArgument;
+    pWorker->queued++;
+    if (pWorker->queued > pWorker->mostQueued)
+    {
+        pWorker->mostQueued = pWorker->queued;
+    }
+    pthread_cond_signal(&pWorker->ready);
+    pthread_mutex_unlock(&pWorker->lock);
+
+    return 1;
+}
+
+
+
+/* Until no worker has a job queued or running, including those that jobs
+ * submit while waiting */
+void WPOOL_Wait(WPOOL * const pPool)
+{
+    WPOOL_WORKER *pWorker;
+    unsigned int i, busy;
+
+    do
+    {
+        busy = 0U;
+        for (i = 0U; i < pPool->workerCount; i++)
+        {
+            pWorker = &pPool->workers[i];
+            pthread_mutex_lock(&pWorker->lock);
+            while ((pWorker->queued != 0U) || pWorker->running)
+            {
+                busy = 1U;
+                pthread_cond_wait(&pWorker->idle, &pWorker->lock);
+            }
+            pthread_mutex_unlock(&pWorker->lock);
+        }
+    } while (busy);
+}
+
+
+
+/* One line per worker: jobs run, time busy and its share of the time the
+ * pool has been open */
+void WPOOL_PrintReport(WPOOL * const pPool)
+{
+    const unsigned long long openNs = MonotonicTimeNs() - pPool->openNs;
+    WPOOL_WORKER *pWorker;
+    unsigned long long jobs, busyNs;
+    unsigned int i, mostQueued;
+
+    printf("%-6s %-4s %10s %12s %8s %11s\n", "worker", "cpu", "jobs",
+        "busy ms", "busy %", "most queued");
+    for (i = 0U; i < pPool->workerCount; i++)
+    {
+        pWorker = &pPool->workers[i];
+        pthread_mutex_lock(&pWorker->lock);
+        jobs = pWorker->jobs;
+        busyNs = pWorker->busyNs;
+        mostQueued = pWorker->mostQueued;
+        pthread_mutex_unlock(&pWorker->lock);
+
+        printf("%-6u %-4d %10llu %12.3f %8.1f %11u\n", i, pWorker->cpu, jobs,
+            busyNs / 1e6, openNs ? 100.0 * busyNs / openNs : 0.0,
+            mostQueued);
+    }
+}
+
+
+
+/* Run what is queued, then stop and join the workers */
+void WPOOL_Close(WPOOL * const pPool)
+{
+    WPOOL_WORKER *pWorker;
+    unsigned int i;
+
+    for (i = 0U; i < pPool->workerCount; i++)
+    {
+        pWorker = &pPool->workers[i];
+        pthread_mutex_lock(&pWorker->lock);
+        pWorker->stop = 1;
+        pthread_cond_broadcast(&pWorker->ready);
+        pthread_cond_broadcast(&pWorker->idle);
+        pthread_mutex_unlock(&pWorker->lock);
+    }
+
+    for (i = 0U; i < pPool->workerCount; i++)
+    {
+        pWorker = &pPool->workers[i];
+        if (pWorker->started)
+        {
+            pthread_join(pWorker->thread, NULL);
+        }
+        pthread_cond_destroy(&pWorker->idle);
+        pthread_cond_destroy(&pWorker->ready);
+        pthread_mutex_destroy(&pWorker->lock);
+    }
+    pPool->workerCount = 0U;
+}
@@ -0,0 +1,81 @@
+/*
+  @file work_pool.h
+  @author Juan Manuel Gómez
+  @brief Long-lived worker threads with a queue of jobs each.
+  @details The test programs used to start a thread per transfer, which
+           did one create/submit/wait/dispose cycle and ended. The pool
+           starts its workers once, optionally pinned each to its own CPU,
+           and WPOOL_Submit() queues jobs to them for as long as it is
+           open.
+
+           A job goes to the worker of its key, the key modulo the number
+           of workers: jobs given the same key, such as the number of the
+           channel they use, run one after the other on the same thread and
+           in the order they were submitted, while jobs of other keys run
+           concurrently. A job may submit further jobs, to other keys; one
+           submitted to its own worker when the queue is full is refused
+           rather than waiting on the worker that would make room.
+
+           Every worker accounts the jobs it ran and the time it spent on
+           them, which WPOOL_PrintReport() shows as its utilisation since
+           the pool was opened.
+  @copyright jmgomez CSIC-IAA
+*/
+
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <pthread.h>
+
+#define WPOOL_MAX_WORKERS 64
+#define WPOOL_QUEUE_LENGTH 64
+
+typedef void (*WPOOL_JOB)(void * const pArgument);
+
+typedef struct
+{
+    WPOOL_JOB job;
+    void *pArgument;
+} WPOOL_ITEM;
+
+typedef struct
+{
+    pthread_t thread;
+    unsigned int index;
+    int cpu;                    /* CPU the worker is pinned to, or -1 */
+    int started;
+
+    pthread_mutex_t lock;
+    pthread_cond_t ready;       /* a job queued, or the pool closing */
+    pthread_cond_t idle;        /* room in the queue, or nothing to do */
+    WPOOL_ITEM items[WPOOL_QUEUE_LENGTH];
+    unsigned int head;
+    unsigned int queued;
+    int running;                /* a job in progress */
+    int stop;
+
+    unsigned long long jobs;
+    unsigned long long busyNs;
+    unsigned int mostQueued;
+} WPOOL_WORKER;
+
+typedef struct
+{
+    WPOOL_WORKER workers[WPOOL_MAX_WORKERS];
+    unsigned int workerCount;
+    unsigned long long openNs;
+} WPOOL;
+
+unsigned int WPOOL_Open(WPOOL * const pPool, const unsigned int workers,
+    const int pin);
+
+int WPOOL_Submit(WPOOL * const pPool, const unsigned long key,
+    const WPOOL_JOB job, void * const pArgument);
+
+void WPOOL_Wait(WPOOL * const pPool);
+
+void WPOOL_PrintReport(WPOOL * const pPool);
+
+void WPOOL_Close(WPOOL * const pPool);
+
+#endif